@@ -0,0 +1,506 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * zbench runs microbenchmarks against libzpool internals, typically
+ * sweeping the number of concurrent threads to show how a code path
+ * scales.  Suites which need a pool get a single file-backed vdev from
+ * zbench_pool_create(), or a mirror of file vdevs from
+ * zbench_pool_create_mirror().  Results are printed as a table, or as
+ * tab-separated fields without a header when -H is given so that they
+ * can be collected and compared between releases.
+ */
+
+#include <sys/zfs_context.h>
+#include <sys/spa.h>
+#include <sys/dmu.h>
+#include <sys/dmu_tx.h>
+#include <sys/dbuf.h>
+#include <sys/txg.h>
+#include <sys/fs/zfs.h>
+#include <sys/time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <umem.h>
+
+#include "zbench.h"
+
+zbench_opts_t zbo_opts;
+
+static const zbench_opts_t zbo_opts_defaults = {
+	.zbo_dir = "/tmp",
+	.zbo_pool = "zbench",
+	.zbo_vdev_size = 512ULL << 20,
+	.zbo_blocksize = 16ULL << 10,
+	.zbo_nblocks = 4096,
+	.zbo_max_threads = 0,
+	.zbo_seconds = 5,
+	.zbo_scripted = 0,
+	.zbo_v = 0,
+};
+
+static const zbench_suite_t zbench_suites[] = {
+	{ "arc_hash", "ARC hash table cache hits via arc_read()",
+	    zbench_arc_run },
+	{ "dmu_read", "Batched and per-block ARC hits via dmu_read()",
+	    zbench_dmu_run },
+	{ "taskq", "taskq dispatch throughput by number of taskq threads",
+	    zbench_taskq_run },
+	{ "compress", "Every compression algorithm and level on ztest data",
+	    zbench_compress_run },
+	{ "checksum", "Every checksum function and implementation",
+	    zbench_checksum_run },
+	{ "vdev_queue", "Physical reads through the vdev queue of a file vdev",
+	    zbench_vdev_queue_run },
+	{ "hedge", "Uncached reads of a mirror with and without hedging",
+	    zbench_hedge_run },
+};
+
+#define	ZBENCH_SUITES	(sizeof (zbench_suites) / sizeof (zbench_suite_t))
+
+static void
+usage(boolean_t requested)
+{
+	const zbench_opts_t *o = &zbo_opts_defaults;
+	FILE *fp = requested ? stdout : stderr;
+
+	(void) fprintf(fp, "Usage: zbench [options] [suite ...]\n"
+	    "\t[-d directory for vdev files (default: %s)]\n"
+	    "\t[-p pool name (default: %s)]\n"
+	    "\t[-s vdev size (default: %llu)]\n"
+	    "\t[-b block size (default: %llu)]\n"
+	    "\t[-n number of blocks (default: %llu)]\n"
+	    "\t[-t maximum number of threads (default: CPU count)]\n"
+	    "\t[-T seconds per measurement (default: %d)]\n"
+	    "\t[-H scripted mode, tab-separated without header]\n"
+	    "\t[-l list suites]\n"
+	    "\t[-v increase verbosity]\n"
+	    "\t[-h (print help)]\n",
+	    o->zbo_dir, o->zbo_pool,
+	    (u_longlong_t)o->zbo_vdev_size,
+	    (u_longlong_t)o->zbo_blocksize,
+	    (u_longlong_t)o->zbo_nblocks,
+	    o->zbo_seconds);
+
+	exit(requested ? 0 : 1);
+}
+
+static void
+list_suites(void)
+{
+	for (int i = 0; i < ZBENCH_SUITES; i++) {
+		(void) printf("%-16s %s\n", zbench_suites[i].zs_name,
+		    zbench_suites[i].zs_desc);
+	}
+	exit(0);
+}
+
+static void
+process_options(int argc, char **argv)
+{
+	zbench_opts_t *o = &zbo_opts;
+	int opt;
+
+	bcopy(&zbo_opts_defaults, o, sizeof (*o));
+
+	while ((opt = getopt(argc, argv, "d:p:s:b:n:t:T:Hlvh")) != -1) {
+		switch (opt) {
+		case 'd':
+			(void) strlcpy(o->zbo_dir, optarg,
+			    sizeof (o->zbo_dir));
+			break;
+		case 'p':
+			(void) strlcpy(o->zbo_pool, optarg,
+			    sizeof (o->zbo_pool));
+			break;
+		case 's':
+			o->zbo_vdev_size = MAX(SPA_MINDEVSIZE,
+			    strtoull(optarg, NULL, 0));
+			break;
+		case 'b':
+			o->zbo_blocksize = strtoull(optarg, NULL, 0);
+			if (!ISP2(o->zbo_blocksize) ||
+			    o->zbo_blocksize < SPA_MINBLOCKSIZE ||
+			    o->zbo_blocksize > SPA_OLD_MAXBLOCKSIZE) {
+				ERR("invalid block size %s\n", optarg);
+				usage(B_FALSE);
+			}
+			break;
+		case 'n':
+			o->zbo_nblocks = MAX(1, strtoull(optarg, NULL, 0));
+			break;
+		case 't':
+			o->zbo_max_threads = MAX(1, atoi(optarg));
+			break;
+		case 'T':
+			o->zbo_seconds = MAX(1, atoi(optarg));
+			break;
+		case 'H':
+			o->zbo_scripted = 1;
+			break;
+		case 'l':
+			list_suites();
+			break;
+		case 'v':
+			o->zbo_v++;
+			break;
+		case 'h':
+			usage(B_TRUE);
+			break;
+		case '?':
+		default:
+			usage(B_FALSE);
+			break;
+		}
+	}
+
+	if (o->zbo_max_threads == 0)
+		o->zbo_max_threads = boot_ncpus;
+}
+
+/* Number of file vdevs of the pool, for zbench_pool_destroy() */
+static int zbench_pool_files;
+
+static void
+zbench_vdev_path(char *path, size_t len, int f)
+{
+	if (f == 0) {
+		(void) snprintf(path, len, "%s/%s.vdev", zbo_opts.zbo_dir,
+		    zbo_opts.zbo_pool);
+	} else {
+		(void) snprintf(path, len, "%s/%s.vdev.%d", zbo_opts.zbo_dir,
+		    zbo_opts.zbo_pool, f);
+	}
+}
+
+static nvlist_t *
+zbench_vdev_file(int f)
+{
+	nvlist_t *file;
+	char *path;
+	int fd;
+
+	path = umem_alloc(MAXPATHLEN, UMEM_NOFAIL);
+	zbench_vdev_path(path, MAXPATHLEN, f);
+	fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0666);
+	if (fd == -1) {
+		ERR("can't open %s: %s\n", path, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	if (ftruncate(fd, zbo_opts.zbo_vdev_size) != 0) {
+		ERR("can't ftruncate %s: %s\n", path, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	(void) close(fd);
+
+	file = fnvlist_alloc();
+	fnvlist_add_string(file, ZPOOL_CONFIG_TYPE, VDEV_TYPE_FILE);
+	fnvlist_add_string(file, ZPOOL_CONFIG_PATH, path);
+	fnvlist_add_uint64(file, ZPOOL_CONFIG_ASHIFT, SPA_MINBLOCKSHIFT);
+	umem_free(path, MAXPATHLEN);
+
+	return (file);
+}
+
+/*
+ * Create and open a pool backed by a single file vdev, or by a mirror of
+ * that many file vdevs when children is more than 1.
+ */
+static spa_t *
+zbench_pool_create_impl(int children)
+{
+	nvlist_t **files, *top, *root;
+	spa_t *spa;
+
+	files = umem_alloc(children * sizeof (nvlist_t *), UMEM_NOFAIL);
+	for (int f = 0; f < children; f++)
+		files[f] = zbench_vdev_file(f);
+	zbench_pool_files = children;
+
+	if (children > 1) {
+		top = fnvlist_alloc();
+		fnvlist_add_string(top, ZPOOL_CONFIG_TYPE, VDEV_TYPE_MIRROR);
+		fnvlist_add_nvlist_array(top, ZPOOL_CONFIG_CHILDREN, files,
+		    children);
+	} else {
+		top = fnvlist_dup(files[0]);
+	}
+
+	root = fnvlist_alloc();
+	fnvlist_add_string(root, ZPOOL_CONFIG_TYPE, VDEV_TYPE_ROOT);
+	fnvlist_add_nvlist_array(root, ZPOOL_CONFIG_CHILDREN, &top, 1);
+
+	(void) spa_destroy(zbo_opts.zbo_pool);
+	VERIFY0(spa_create(zbo_opts.zbo_pool, root, NULL, NULL, NULL));
+	fnvlist_free(root);
+	fnvlist_free(top);
+	for (int f = 0; f < children; f++)
+		fnvlist_free(files[f]);
+	umem_free(files, children * sizeof (nvlist_t *));
+
+	VERIFY0(spa_open(zbo_opts.zbo_pool, &spa, FTAG));
+	return (spa);
+}
+
+spa_t *
+zbench_pool_create(void)
+{
+	return (zbench_pool_create_impl(1));
+}
+
+spa_t *
+zbench_pool_create_mirror(int children)
+{
+	ASSERT3S(children, >, 1);
+	return (zbench_pool_create_impl(children));
+}
+
+void
+zbench_pool_destroy(spa_t *spa)
+{
+	char *path;
+
+	spa_close(spa, FTAG);
+	VERIFY0(spa_destroy(zbo_opts.zbo_pool));
+
+	path = umem_alloc(MAXPATHLEN, UMEM_NOFAIL);
+	for (int f = 0; f < zbench_pool_files; f++) {
+		zbench_vdev_path(path, MAXPATHLEN, f);
+		(void) unlink(path);
+	}
+	umem_free(path, MAXPATHLEN);
+}
+
+/*
+ * Create an object in os holding nblocks blocks of random data, and wait
+ * for it to be written out so that every block has a block pointer.
+ */
+uint64_t
+zbench_object_create(objset_t *os, uint64_t blocksize, uint64_t nblocks)
+{
+	uint64_t chunk = MAX(blocksize, 1ULL << 20);
+	uint64_t size = blocksize * nblocks;
+	uint64_t object;
+	dmu_tx_t *tx;
+	char *data;
+
+	tx = dmu_tx_create(os);
+	dmu_tx_hold_bonus(tx, DMU_NEW_OBJECT);
+	VERIFY0(dmu_tx_assign(tx, TXG_WAIT));
+	object = dmu_object_alloc(os, DMU_OT_UINT64_OTHER, blocksize,
+	    DMU_OT_NONE, 0, tx);
+	dmu_tx_commit(tx);
+
+	data = umem_alloc(chunk, UMEM_NOFAIL);
+	for (uint64_t i = 0; i < chunk / sizeof (uint64_t); i++)
+		((uint64_t *)data)[i] = ((uint64_t)rand() << 32) | rand();
+
+	for (uint64_t off = 0; off < size; off += chunk) {
+		uint64_t len = MIN(chunk, size - off);
+
+		tx = dmu_tx_create(os);
+		dmu_tx_hold_write(tx, object, off, len);
+		VERIFY0(dmu_tx_assign(tx, TXG_WAIT));
+		dmu_write(os, object, off, len, data, tx);
+		dmu_tx_commit(tx);
+	}
+	umem_free(data, chunk);
+
+	txg_wait_synced(dmu_objset_pool(os), 0);
+
+	return (object);
+}
+
+/*
+ * Copy out the block pointers and bookmarks of the first nblocks blocks
+ * of an object created by zbench_object_create().
+ */
+void
+zbench_object_bps(objset_t *os, uint64_t object, uint64_t blocksize,
+    uint64_t nblocks, blkptr_t *bps, zbookmark_phys_t *zbs)
+{
+	for (uint64_t i = 0; i < nblocks; i++) {
+		dmu_buf_t *db;
+
+		VERIFY0(dmu_buf_hold(os, object, i * blocksize, FTAG, &db,
+		    DMU_READ_NO_PREFETCH));
+		bps[i] = *((dmu_buf_impl_t *)db)->db_blkptr;
+		SET_BOOKMARK(&zbs[i], dmu_objset_id(os), object, 0, i);
+		dmu_buf_rele(db, FTAG);
+	}
+}
+
+/*
+ * Thread counts are swept in powers of two up to, and always including,
+ * the -t limit.  Returns 0 once the limit has been measured.
+ */
+int
+zbench_threads_next(int threads)
+{
+	if (threads >= zbo_opts.zbo_max_threads)
+		return (0);
+	return (MIN(threads * 2, zbo_opts.zbo_max_threads));
+}
+
+typedef struct zbench_thread {
+	zbench_func_t	zt_func;
+	void		*zt_arg;
+	int		zt_id;
+	hrtime_t	zt_deadline;
+	hrtime_t	zt_end;
+	uint64_t	zt_ops;
+} zbench_thread_t;
+
+static void
+zbench_thread(void *arg)
+{
+	zbench_thread_t *zt = arg;
+
+	zt->zt_ops = zt->zt_func(zt->zt_arg, zt->zt_id, zt->zt_deadline);
+	zt->zt_end = gethrtime();
+	thread_exit();
+}
+
+/*
+ * Run func on nthreads threads for the configured number of seconds.
+ * Returns the total number of operations and the wall time they took.
+ */
+uint64_t
+zbench_run_threads(int nthreads, zbench_func_t func, void *arg,
+    hrtime_t *elapsed)
+{
+	zbench_thread_t *zt;
+	kthread_t **tids;
+	hrtime_t start, end = 0;
+	uint64_t ops = 0;
+
+	zt = umem_zalloc(nthreads * sizeof (zbench_thread_t), UMEM_NOFAIL);
+	tids = umem_zalloc(nthreads * sizeof (kthread_t *), UMEM_NOFAIL);
+
+	start = gethrtime();
+	for (int t = 0; t < nthreads; t++) {
+		zt[t].zt_func = func;
+		zt[t].zt_arg = arg;
+		zt[t].zt_id = t;
+		zt[t].zt_deadline = start + SEC2NSEC(zbo_opts.zbo_seconds);
+		tids[t] = thread_create(NULL, 0, zbench_thread, &zt[t], 0,
+		    NULL, TS_RUN | TS_JOINABLE, defclsyspri);
+	}
+	for (int t = 0; t < nthreads; t++) {
+		VERIFY0(thread_join(tids[t]));
+		ops += zt[t].zt_ops;
+		end = MAX(end, zt[t].zt_end);
+	}
+	*elapsed = end - start;
+
+	umem_free(tids, nthreads * sizeof (kthread_t *));
+	umem_free(zt, nthreads * sizeof (zbench_thread_t));
+
+	return (ops);
+}
+
+/*
+ * Print one measurement.  Suites which compress data also report the
+ * compression ratio, others pass a ratio of 0 which is shown as "-".
+ */
+void
+zbench_report_ratio(const char *suite, const char *bcase, int threads,
+    uint64_t ops, uint64_t bytes, hrtime_t elapsed, double ratio)
+{
+	double secs = (double)MAX(elapsed, 1) / NANOSEC;
+	static boolean_t header = B_FALSE;
+	char rbuf[16] = "-";
+
+	if (ratio > 0)
+		(void) snprintf(rbuf, sizeof (rbuf), "%.2f", ratio);
+
+	if (zbo_opts.zbo_scripted) {
+		(void) printf("%s\t%s\t%d\t%llu\t%llu\t%llu\t%.0f\t%.2f\t%s\n",
+		    suite, bcase, threads, (u_longlong_t)ops,
+		    (u_longlong_t)bytes, (u_longlong_t)elapsed,
+		    ops / secs, bytes / secs / (1024 * 1024), rbuf);
+		return;
+	}
+
+	if (!header) {
+		(void) printf("%-12s %-28s %7s %14s %14s %10s %6s\n",
+		    "SUITE", "CASE", "THREADS", "OPS", "OPS/S", "MiB/S",
+		    "RATIO");
+		header = B_TRUE;
+	}
+	(void) printf("%-12s %-28s %7d %14llu %14.0f %10.2f %6s\n",
+	    suite, bcase, threads, (u_longlong_t)ops, ops / secs,
+	    bytes / secs / (1024 * 1024), rbuf);
+}
+
+void
+zbench_report(const char *suite, const char *bcase, int threads,
+    uint64_t ops, uint64_t bytes, hrtime_t elapsed)
+{
+	zbench_report_ratio(suite, bcase, threads, ops, bytes, elapsed, 0);
+}
+
+static const zbench_suite_t *
+zbench_find_suite(const char *name)
+{
+	for (int i = 0; i < ZBENCH_SUITES; i++) {
+		if (strcmp(zbench_suites[i].zs_name, name) == 0)
+			return (&zbench_suites[i]);
+	}
+	return (NULL);
+}
+
+int
+main(int argc, char **argv)
+{
+	int err = 0;
+
+	(void) setvbuf(stdout, NULL, _IOLBF, 0);
+
+	dprintf_setup(&argc, argv);
+
+	process_options(argc, argv);
+	argc -= optind;
+	argv += optind;
+
+	for (int i = 0; i < argc; i++) {
+		if (zbench_find_suite(argv[i]) == NULL) {
+			ERR("unknown suite '%s'\n", argv[i]);
+			usage(B_FALSE);
+		}
+	}
+
+	kernel_init(SPA_MODE_READ | SPA_MODE_WRITE);
+
+	if (argc == 0) {
+		for (int i = 0; i < ZBENCH_SUITES && err == 0; i++)
+			err = zbench_suites[i].zs_run();
+	} else {
+		for (int i = 0; i < argc && err == 0; i++)
+			err = zbench_find_suite(argv[i])->zs_run();
+	}
+
+	kernel_fini();
+
+	return (err);
+}
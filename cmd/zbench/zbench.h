@@ -0,0 +1,95 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+#ifndef	ZBENCH_H
+#define	ZBENCH_H
+
+#include <sys/spa.h>
+#include <sys/dmu.h>
+
+typedef struct zbench_opts {
+	char zbo_dir[ZFS_MAX_DATASET_NAME_LEN];
+	char zbo_pool[ZFS_MAX_DATASET_NAME_LEN];
+	uint64_t zbo_vdev_size;
+	uint64_t zbo_blocksize;
+	uint64_t zbo_nblocks;
+	int zbo_max_threads;
+	int zbo_seconds;
+	int zbo_scripted;
+	int zbo_v;
+} zbench_opts_t;
+
+extern zbench_opts_t zbo_opts;
+
+/*
+ * A benchmark suite.  zs_run() is called once with the kernel
+ * initialized and reports its results with zbench_report().
+ */
+typedef struct zbench_suite {
+	const char *zs_name;
+	const char *zs_desc;
+	int (*zs_run)(void);
+} zbench_suite_t;
+
+/*
+ * Per-thread worker.  It is expected to run until the deadline passes and
+ * return the number of operations it completed.
+ */
+typedef uint64_t (*zbench_func_t)(void *arg, int id, hrtime_t deadline);
+
+#define	D_ALL	0
+#define	D_INFO	1
+#define	D_DEBUG	2
+
+#define	LOG(lvl, a...)				\
+{						\
+	if (zbo_opts.zbo_v >= lvl)		\
+		(void) fprintf(stdout, a);	\
+}						\
+
+#define	ERR(a...)	(void) fprintf(stderr, a)
+
+extern spa_t *zbench_pool_create(void);
+extern spa_t *zbench_pool_create_mirror(int children);
+extern void zbench_pool_destroy(spa_t *spa);
+extern uint64_t zbench_object_create(objset_t *os, uint64_t blocksize,
+    uint64_t nblocks);
+extern void zbench_object_bps(objset_t *os, uint64_t object,
+    uint64_t blocksize, uint64_t nblocks, blkptr_t *bps,
+    zbookmark_phys_t *zbs);
+extern int zbench_threads_next(int threads);
+extern uint64_t zbench_run_threads(int nthreads, zbench_func_t func,
+    void *arg, hrtime_t *elapsed);
+extern void zbench_report(const char *suite, const char *bcase, int threads,
+    uint64_t ops, uint64_t bytes, hrtime_t elapsed);
+extern void zbench_report_ratio(const char *suite, const char *bcase,
+    int threads, uint64_t ops, uint64_t bytes, hrtime_t elapsed,
+    double ratio);
+
+extern int zbench_arc_run(void);
+extern int zbench_dmu_run(void);
+extern int zbench_taskq_run(void);
+extern int zbench_compress_run(void);
+extern int zbench_checksum_run(void);
+extern int zbench_vdev_queue_run(void);
+extern int zbench_hedge_run(void);
+
+#endif /* ZBENCH_H */
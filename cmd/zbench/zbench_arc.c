@@ -0,0 +1,122 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * ARC hash table benchmark: every thread repeatedly calls arc_read() on
+ * randomly chosen blocks which are all resident in the ARC, so that each
+ * call is a cache hit resolved through buf_hash_find().
+ */
+
+#include <sys/zfs_context.h>
+#include <sys/spa.h>
+#include <sys/dmu.h>
+#include <sys/arc.h>
+#include <sys/zio.h>
+#include <stdio.h>
+#include <umem.h>
+
+#include "zbench.h"
+
+typedef struct zbench_arc {
+	spa_t			*za_spa;
+	uint64_t		za_nblocks;
+	blkptr_t		*za_bps;
+	zbookmark_phys_t	*za_zbs;
+} zbench_arc_t;
+
+static void
+zbench_arc_read(zbench_arc_t *za, uint64_t i)
+{
+	arc_flags_t aflags = ARC_FLAG_WAIT;
+	arc_buf_t *abuf = NULL;
+
+	VERIFY0(arc_read(NULL, za->za_spa, &za->za_bps[i], arc_getbuf_func,
+	    &abuf, ZIO_PRIORITY_SYNC_READ, ZIO_FLAG_CANFAIL, &aflags,
+	    &za->za_zbs[i]));
+	VERIFY3P(abuf, !=, NULL);
+	arc_buf_destroy(abuf, &abuf);
+}
+
+static uint64_t
+zbench_arc_hits(void *arg, int id, hrtime_t deadline)
+{
+	zbench_arc_t *za = arg;
+	uint64_t x = (id + 1) * 0x9E3779B97F4A7C15ULL;
+	uint64_t ops = 0;
+
+	do {
+		for (int i = 0; i < 64; i++) {
+			/* xorshift64 */
+			x ^= x << 13;
+			x ^= x >> 7;
+			x ^= x << 17;
+			zbench_arc_read(za, x % za->za_nblocks);
+		}
+		ops += 64;
+	} while (gethrtime() < deadline);
+
+	return (ops);
+}
+
+int
+zbench_arc_run(void)
+{
+	zbench_arc_t za;
+	objset_t *os;
+	uint64_t object;
+	hrtime_t elapsed;
+
+	za.za_spa = zbench_pool_create();
+	za.za_nblocks = zbo_opts.zbo_nblocks;
+	za.za_bps = umem_alloc(za.za_nblocks * sizeof (blkptr_t),
+	    UMEM_NOFAIL);
+	za.za_zbs = umem_alloc(za.za_nblocks * sizeof (zbookmark_phys_t),
+	    UMEM_NOFAIL);
+
+	VERIFY0(dmu_objset_own(zbo_opts.zbo_pool, DMU_OST_ANY, B_FALSE,
+	    B_TRUE, FTAG, &os));
+	object = zbench_object_create(os, zbo_opts.zbo_blocksize,
+	    za.za_nblocks);
+	zbench_object_bps(os, object, zbo_opts.zbo_blocksize, za.za_nblocks,
+	    za.za_bps, za.za_zbs);
+
+	/* Make sure every block is resident before measuring. */
+	for (uint64_t i = 0; i < za.za_nblocks; i++)
+		zbench_arc_read(&za, i);
+
+	LOG(D_INFO, "arc_hash: %llu blocks of %llu bytes\n",
+	    (u_longlong_t)za.za_nblocks,
+	    (u_longlong_t)zbo_opts.zbo_blocksize);
+
+	for (int t = 1; t != 0; t = zbench_threads_next(t)) {
+		uint64_t ops = zbench_run_threads(t, zbench_arc_hits, &za,
+		    &elapsed);
+		zbench_report("arc_hash", "hit", t, ops,
+		    ops * zbo_opts.zbo_blocksize, elapsed);
+	}
+
+	dmu_objset_disown(os, B_TRUE, FTAG);
+	umem_free(za.za_zbs, za.za_nblocks * sizeof (zbookmark_phys_t));
+	umem_free(za.za_bps, za.za_nblocks * sizeof (blkptr_t));
+	zbench_pool_destroy(za.za_spa);
+
+	return (0);
+}
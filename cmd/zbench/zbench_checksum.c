@@ -0,0 +1,317 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Checksum benchmark: every thread checksums its own set of
+ * ZBENCH_CHECKSUM_NBLOCKS blocks of -b bytes with every function in
+ * zio_checksum_table, and for fletcher4, SHA-256, SHA-512 and BLAKE3 with
+ * every implementation the CPU supports.  Each operation is one block.
+ * Before measuring, the checksums of all implementations of a function are
+ * compared.  The fastest implementations are selected again at the end.
+ */
+
+#include <sys/zfs_context.h>
+#include <sys/abd.h>
+#include <sys/zio_checksum.h>
+#include <sys/sha2.h>
+#include <sys/blake3.h>
+#include <zfs_fletcher.h>
+#include <stdio.h>
+
+#include "zbench.h"
+
+#define	ZBENCH_CHECKSUM_NBLOCKS	8
+
+/*
+ * The implementations of a checksum function, selected by index.
+ */
+typedef struct zbench_checksum_impl {
+	const char	*zci_name;
+	uint32_t	(*zci_getcnt)(void);
+	void		(*zci_setid)(uint32_t id);
+	const char	*(*zci_getname)(void);
+	void		(*zci_fastest)(void);
+} zbench_checksum_impl_t;
+
+typedef struct zbench_checksum {
+	zio_checksum_info_t	*zc_ci;
+	void			*zc_tmpl;
+} zbench_checksum_t;
+
+#define	ZBENCH_FLETCHER_4_MAX	16
+
+static char zbench_fletcher_4_buf[256];
+static const char *zbench_fletcher_4_names[ZBENCH_FLETCHER_4_MAX];
+static uint32_t zbench_fletcher_4_cnt;
+static uint32_t zbench_fletcher_4_id;
+
+/*
+ * Fletcher 4 implementations are only listed by name, as "[fastest] scalar
+ * superscalar ...", with the selected one in brackets.
+ */
+static uint32_t
+zbench_fletcher_4_getcnt(void)
+{
+	char *name, *last;
+
+	if (zbench_fletcher_4_cnt != 0)
+		return (zbench_fletcher_4_cnt);
+
+	(void) fletcher_4_get(zbench_fletcher_4_buf,
+	    sizeof (zbench_fletcher_4_buf));
+	for (name = strtok_r(zbench_fletcher_4_buf, " []", &last);
+	    name != NULL && zbench_fletcher_4_cnt < ZBENCH_FLETCHER_4_MAX;
+	    name = strtok_r(NULL, " []", &last)) {
+		if (strcmp(name, "fastest") != 0)
+			zbench_fletcher_4_names[zbench_fletcher_4_cnt++] = name;
+	}
+
+	return (zbench_fletcher_4_cnt);
+}
+
+static void
+zbench_fletcher_4_setid(uint32_t id)
+{
+	VERIFY0(fletcher_4_impl_set(zbench_fletcher_4_names[id]));
+	zbench_fletcher_4_id = id;
+}
+
+static const char *
+zbench_fletcher_4_getname(void)
+{
+	return (zbench_fletcher_4_names[zbench_fletcher_4_id]);
+}
+
+static void
+zbench_fletcher_4_fastest(void)
+{
+	VERIFY0(fletcher_4_impl_set("fastest"));
+}
+
+static uint32_t
+zbench_sha256_getcnt(void)
+{
+	return (sha2_impl_getcnt(SHA256));
+}
+
+static void
+zbench_sha256_setid(uint32_t id)
+{
+	sha2_impl_setid(SHA256, id);
+}
+
+static const char *
+zbench_sha256_getname(void)
+{
+	return (sha2_impl_getname(SHA256));
+}
+
+static void
+zbench_sha256_fastest(void)
+{
+	VERIFY0(sha2_impl_set(SHA256, "fastest"));
+}
+
+static uint32_t
+zbench_sha512_getcnt(void)
+{
+	return (sha2_impl_getcnt(SHA512));
+}
+
+static void
+zbench_sha512_setid(uint32_t id)
+{
+	sha2_impl_setid(SHA512, id);
+}
+
+static const char *
+zbench_sha512_getname(void)
+{
+	return (sha2_impl_getname(SHA512));
+}
+
+static void
+zbench_sha512_fastest(void)
+{
+	VERIFY0(sha2_impl_set(SHA512, "fastest"));
+}
+
+static void
+zbench_blake3_fastest(void)
+{
+	VERIFY0(blake3_impl_set("fastest"));
+}
+
+static const zbench_checksum_impl_t zbench_checksum_impls[] = {
+	{ "fletcher4", zbench_fletcher_4_getcnt, zbench_fletcher_4_setid,
+	    zbench_fletcher_4_getname, zbench_fletcher_4_fastest },
+	{ "sha256", zbench_sha256_getcnt, zbench_sha256_setid,
+	    zbench_sha256_getname, zbench_sha256_fastest },
+	{ "sha512", zbench_sha512_getcnt, zbench_sha512_setid,
+	    zbench_sha512_getname, zbench_sha512_fastest },
+	{ "blake3", blake3_impl_getcnt, blake3_impl_setid,
+	    blake3_impl_getname, zbench_blake3_fastest },
+};
+
+static const zbench_checksum_impl_t *
+zbench_checksum_find_impl(const char *name)
+{
+	for (int i = 0; i < ARRAY_SIZE(zbench_checksum_impls); i++) {
+		if (strcmp(zbench_checksum_impls[i].zci_name, name) == 0)
+			return (&zbench_checksum_impls[i]);
+	}
+	return (NULL);
+}
+
+static void
+zbench_checksum_fill(abd_t *abd, uint64_t size, uint64_t seed)
+{
+	uint64_t *buf = abd_to_buf(abd);
+
+	for (uint64_t j = 0; j < size / sizeof (uint64_t); j++)
+		buf[j] = (seed + 1) * 0x9E3779B97F4A7C15ULL ^ (j << 17) ^ j;
+}
+
+static uint64_t
+zbench_checksum_run_thread(void *arg, int id, hrtime_t deadline)
+{
+	zbench_checksum_t *zc = arg;
+	uint64_t size = zbo_opts.zbo_blocksize;
+	abd_t *abds[ZBENCH_CHECKSUM_NBLOCKS];
+	zio_cksum_t zcp;
+	uint64_t ops = 0;
+
+	for (int i = 0; i < ZBENCH_CHECKSUM_NBLOCKS; i++) {
+		abds[i] = abd_alloc_linear(size, B_FALSE);
+		zbench_checksum_fill(abds[i], size,
+		    id * ZBENCH_CHECKSUM_NBLOCKS + i);
+	}
+
+	do {
+		for (int i = 0; i < ZBENCH_CHECKSUM_NBLOCKS; i++) {
+			zc->zc_ci->ci_func[ZIO_CHECKSUM_NATIVE](abds[i], size,
+			    zc->zc_tmpl, &zcp);
+		}
+		ops += ZBENCH_CHECKSUM_NBLOCKS;
+	} while (gethrtime() < deadline);
+
+	for (int i = 0; i < ZBENCH_CHECKSUM_NBLOCKS; i++)
+		abd_free(abds[i]);
+
+	return (ops);
+}
+
+static void
+zbench_checksum_measure(zbench_checksum_t *zc, const char *impl)
+{
+	uint64_t size = zbo_opts.zbo_blocksize;
+	hrtime_t elapsed;
+	char bcase[48];
+
+	(void) snprintf(bcase, sizeof (bcase), "%s/%s/%lluK",
+	    zc->zc_ci->ci_name, impl, (u_longlong_t)(size >> 10));
+
+	for (int t = 1; t != 0; t = zbench_threads_next(t)) {
+		uint64_t ops;
+
+		ops = zbench_run_threads(t, zbench_checksum_run_thread, zc,
+		    &elapsed);
+		zbench_report("checksum", bcase, t, ops, ops * size, elapsed);
+	}
+}
+
+/*
+ * Every implementation must produce the checksum of the first one.
+ */
+static void
+zbench_checksum_verify(zbench_checksum_t *zc,
+    const zbench_checksum_impl_t *zci)
+{
+	uint64_t size = zbo_opts.zbo_blocksize;
+	abd_t *abd = abd_alloc_linear(size, B_FALSE);
+	zio_cksum_t expected, actual;
+
+	zbench_checksum_fill(abd, size, 0);
+	for (uint32_t id = 0; id < zci->zci_getcnt(); id++) {
+		zci->zci_setid(id);
+		zc->zc_ci->ci_func[ZIO_CHECKSUM_NATIVE](abd, size, zc->zc_tmpl,
+		    id == 0 ? &expected : &actual);
+		if (id != 0 && !ZIO_CHECKSUM_EQUAL(expected, actual)) {
+			ERR("checksum: %s implementation %s differs\n",
+			    zc->zc_ci->ci_name, zci->zci_getname());
+			VERIFY(ZIO_CHECKSUM_EQUAL(expected, actual));
+		}
+	}
+
+	abd_free(abd);
+}
+
+int
+zbench_checksum_run(void)
+{
+	zio_cksum_salt_t salt;
+	zbench_checksum_t zc;
+
+	for (int i = 0; i < sizeof (salt.zcs_bytes); i++)
+		salt.zcs_bytes[i] = i;
+
+	LOG(D_INFO, "checksum: %d blocks of %llu bytes per thread\n",
+	    ZBENCH_CHECKSUM_NBLOCKS, (u_longlong_t)zbo_opts.zbo_blocksize);
+
+	for (int c = 0; c < ZIO_CHECKSUM_FUNCTIONS; c++) {
+		const zbench_checksum_impl_t *zci;
+
+		zc.zc_ci = &zio_checksum_table[c];
+
+		/*
+		 * Skip "off" and "noparity", and the embedded checksums which
+		 * reuse the functions of the others.
+		 */
+		if (zc.zc_ci->ci_func[ZIO_CHECKSUM_NATIVE] == NULL ||
+		    zc.zc_ci->ci_func[ZIO_CHECKSUM_NATIVE] ==
+		    zio_checksum_table[ZIO_CHECKSUM_OFF].ci_func[
+		    ZIO_CHECKSUM_NATIVE] ||
+		    (zc.zc_ci->ci_flags & ZCHECKSUM_FLAG_EMBEDDED))
+			continue;
+
+		zc.zc_tmpl = NULL;
+		if (zc.zc_ci->ci_tmpl_init != NULL)
+			zc.zc_tmpl = zc.zc_ci->ci_tmpl_init(&salt);
+
+		zci = zbench_checksum_find_impl(zc.zc_ci->ci_name);
+		if (zci == NULL) {
+			zbench_checksum_measure(&zc, "generic");
+		} else {
+			zbench_checksum_verify(&zc, zci);
+			for (uint32_t id = 0; id < zci->zci_getcnt(); id++) {
+				zci->zci_setid(id);
+				zbench_checksum_measure(&zc,
+				    zci->zci_getname());
+			}
+			zci->zci_fastest();
+		}
+
+		if (zc.zc_tmpl != NULL)
+			zc.zc_ci->ci_tmpl_free(zc.zc_tmpl);
+	}
+
+	return (0);
+}
@@ -0,0 +1,352 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Compression benchmark: every thread compresses, or decompresses, its own
+ * set of ZBENCH_COMPRESS_NBLOCKS blocks of -b bytes with every algorithm
+ * and level in zio_compress_table, the way zio_write_compress() does.
+ * Each operation is one block.  The blocks are filled from corpora made of
+ * the data ztest writes, and the ratio of every algorithm on each corpus
+ * is measured, and the round trip verified, before the timed runs.
+ * Decompression only counts the blocks which compressed.  gzip and zstd
+ * are also measured with zio_compress_earlyabort, applied to blocks of any
+ * size for the run.
+ */
+
+#include <sys/zfs_context.h>
+#include <sys/abd.h>
+#include <sys/zio.h>
+#include <sys/zio_compress.h>
+#include <sys/fs/zfs.h>
+#include <stdio.h>
+
+#include "zbench.h"
+
+#define	ZBENCH_COMPRESS_NBLOCKS	8
+
+extern int zio_compress_earlyabort;
+extern unsigned int zio_compress_earlyabort_size;
+
+/* ztest_block_tag_t, see cmd/ztest */
+typedef struct zbench_block_tag {
+	uint64_t	bt_magic;
+	uint64_t	bt_objset;
+	uint64_t	bt_object;
+	uint64_t	bt_dnodesize;
+	uint64_t	bt_offset;
+	uint64_t	bt_gen;
+	uint64_t	bt_txg;
+	uint64_t	bt_crtxg;
+} zbench_block_tag_t;
+
+#define	ZBENCH_BT_MAGIC		0x123456789abcdefULL
+
+typedef enum zbench_corpus {
+	ZBENCH_CORPUS_PATTERN,
+	ZBENCH_CORPUS_TAG,
+	ZBENCH_CORPUS_MIXED,
+	ZBENCH_CORPUS_RANDOM,
+	ZBENCH_CORPORA
+} zbench_corpus_t;
+
+static const char *zbench_corpus_names[ZBENCH_CORPORA] = {
+	"pattern", "tag", "mixed", "random"
+};
+
+/* The sectors of the mixed corpus cycle through these */
+static const zbench_corpus_t zbench_corpus_mixed[] = {
+	ZBENCH_CORPUS_PATTERN, ZBENCH_CORPUS_TAG, ZBENCH_CORPUS_RANDOM
+};
+
+typedef struct zbench_compress {
+	enum zio_compress	zc_compress;
+	uint8_t			zc_level;
+	zbench_corpus_t		zc_corpus;
+	boolean_t		zc_decompress;
+	boolean_t		zc_earlyabort;
+} zbench_compress_t;
+
+static uint64_t
+zbench_compress_random(uint64_t *state)
+{
+	uint64_t x = *state;
+
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	*state = x;
+
+	return (x);
+}
+
+/*
+ * Fill a sector as ztest_io() would: the same letter repeated, with
+ * fletcher2 collisions induced in every other one, a block tag followed by
+ * older zeroed data, or random data.
+ */
+static void
+zbench_compress_fill_sector(zbench_corpus_t corpus, uint64_t *buf,
+    uint64_t off, uint64_t *state)
+{
+	zbench_block_tag_t *bt = (zbench_block_tag_t *)buf;
+	uint64_t words = SPA_MINBLOCKSIZE / sizeof (uint64_t);
+
+	switch (corpus) {
+	case ZBENCH_CORPUS_PATTERN:
+		(void) memset(buf, 'a' + (off >> SPA_MINBLOCKSHIFT) % 5,
+		    SPA_MINBLOCKSIZE);
+		if (zbench_compress_random(state) & 1) {
+			buf[0] ^= 1ULL << 63;
+			buf[4] ^= 1ULL << 63;
+		}
+		break;
+	case ZBENCH_CORPUS_TAG:
+		bzero(buf, SPA_MINBLOCKSIZE);
+		bt->bt_magic = ZBENCH_BT_MAGIC;
+		bt->bt_objset = 54;
+		bt->bt_object = 1 + (*state & 0xff);
+		bt->bt_dnodesize = 512;
+		bt->bt_offset = off;
+		bt->bt_gen = zbench_compress_random(state) & 0xffff;
+		bt->bt_txg = 4 + (zbench_compress_random(state) & 0xfff);
+		bt->bt_crtxg = 4;
+		break;
+	default:
+		for (uint64_t i = 0; i < words; i++)
+			buf[i] = zbench_compress_random(state);
+		break;
+	}
+}
+
+static void
+zbench_compress_fill(zbench_corpus_t corpus, abd_t *abd, uint64_t size,
+    uint64_t seed)
+{
+	uint64_t *buf = abd_to_buf(abd);
+	uint64_t state = 0x9E3779B97F4A7C15ULL * (seed + 1);
+
+	for (uint64_t off = 0; off < size; off += SPA_MINBLOCKSIZE) {
+		zbench_corpus_t sc = corpus;
+
+		if (corpus == ZBENCH_CORPUS_MIXED) {
+			sc = zbench_corpus_mixed[(off >> SPA_MINBLOCKSHIFT) %
+			    ARRAY_SIZE(zbench_corpus_mixed)];
+		}
+		zbench_compress_fill_sector(sc, &buf[off / sizeof (uint64_t)],
+		    off, &state);
+	}
+}
+
+/*
+ * Compress blocks like zio_write_compress(), returning the physical size
+ * which would have been written.
+ */
+static uint64_t
+zbench_compress_block(zbench_compress_t *zc, abd_t *abd, void *dst,
+    uint64_t size)
+{
+	uint64_t c_len;
+
+	c_len = zio_compress_data(zc->zc_compress, abd, dst, size,
+	    zc->zc_level, zc->zc_earlyabort);
+	return (MIN(c_len, size));
+}
+
+static uint64_t
+zbench_compress_run_thread(void *arg, int id, hrtime_t deadline)
+{
+	zbench_compress_t *zc = arg;
+	uint64_t size = zbo_opts.zbo_blocksize;
+	abd_t *abds[ZBENCH_COMPRESS_NBLOCKS];
+	void *cbufs[ZBENCH_COMPRESS_NBLOCKS];
+	uint64_t c_lens[ZBENCH_COMPRESS_NBLOCKS];
+	uint64_t ops = 0, nc = 0;
+	void *dst;
+
+	dst = umem_alloc(size, UMEM_NOFAIL);
+	for (int i = 0; i < ZBENCH_COMPRESS_NBLOCKS; i++) {
+		abds[i] = abd_alloc_linear(size, B_FALSE);
+		zbench_compress_fill(zc->zc_corpus, abds[i], size,
+		    id * ZBENCH_COMPRESS_NBLOCKS + i);
+		cbufs[i] = umem_alloc(size, UMEM_NOFAIL);
+		c_lens[i] = zbench_compress_block(zc, abds[i], cbufs[i], size);
+		if (c_lens[i] < size)
+			nc++;
+	}
+
+	if (zc->zc_decompress && nc == 0)
+		goto out;
+
+	do {
+		for (int i = 0; i < ZBENCH_COMPRESS_NBLOCKS; i++) {
+			if (!zc->zc_decompress) {
+				(void) zbench_compress_block(zc, abds[i], dst,
+				    size);
+			} else if (c_lens[i] < size) {
+				VERIFY0(zio_decompress_data_buf(
+				    zc->zc_compress, cbufs[i], dst, c_lens[i],
+				    size, NULL));
+			}
+		}
+		ops += zc->zc_decompress ? nc : ZBENCH_COMPRESS_NBLOCKS;
+	} while (gethrtime() < deadline);
+
+out:
+	for (int i = 0; i < ZBENCH_COMPRESS_NBLOCKS; i++) {
+		umem_free(cbufs[i], size);
+		abd_free(abds[i]);
+	}
+	umem_free(dst, size);
+
+	return (ops);
+}
+
+/*
+ * Returns the compression ratio of the corpus, checking that every block
+ * which compressed decompresses to the original data.
+ */
+static double
+zbench_compress_ratio(zbench_compress_t *zc)
+{
+	uint64_t size = zbo_opts.zbo_blocksize;
+	uint64_t lsize = 0, psize = 0;
+	abd_t *abd = abd_alloc_linear(size, B_FALSE);
+	void *cbuf = umem_alloc(size, UMEM_NOFAIL);
+	void *dbuf = umem_alloc(size, UMEM_NOFAIL);
+
+	for (int i = 0; i < ZBENCH_COMPRESS_NBLOCKS; i++) {
+		uint64_t c_len;
+
+		zbench_compress_fill(zc->zc_corpus, abd, size, i);
+		c_len = zbench_compress_block(zc, abd, cbuf, size);
+		if (c_len < size) {
+			VERIFY0(zio_decompress_data_buf(zc->zc_compress, cbuf,
+			    dbuf, c_len, size, NULL));
+			VERIFY0(bcmp(abd_to_buf(abd), dbuf, size));
+		}
+		lsize += size;
+		psize += c_len;
+	}
+
+	umem_free(dbuf, size);
+	umem_free(cbuf, size);
+	abd_free(abd);
+
+	return ((double)lsize / MAX(psize, 1));
+}
+
+static void
+zbench_compress_measure(zbench_compress_t *zc, const char *name)
+{
+	uint64_t size = zbo_opts.zbo_blocksize;
+	hrtime_t elapsed;
+	double ratio;
+	char bcase[48];
+
+	ratio = zbench_compress_ratio(zc);
+	LOG(D_INFO, "compress: %s on %s compresses %.2fx%s\n", name,
+	    zbench_corpus_names[zc->zc_corpus], ratio,
+	    zc->zc_earlyabort ? " with earlyabort" : "");
+
+	for (int t = 1; t != 0; t = zbench_threads_next(t)) {
+		uint64_t ops;
+
+		zc->zc_decompress = B_FALSE;
+		ops = zbench_run_threads(t, zbench_compress_run_thread, zc,
+		    &elapsed);
+		(void) snprintf(bcase, sizeof (bcase), "%s/%s/%s", name,
+		    zbench_corpus_names[zc->zc_corpus],
+		    zc->zc_earlyabort ? "earlyabort" : "comp");
+		zbench_report_ratio("compress", bcase, t, ops, ops * size,
+		    elapsed, ratio);
+
+		/*
+		 * Incompressible corpora have nothing to decompress, and
+		 * earlyabort doesn't change how blocks decompress.
+		 */
+		if (ratio <= 1.0 || zc->zc_earlyabort)
+			continue;
+
+		zc->zc_decompress = B_TRUE;
+		ops = zbench_run_threads(t, zbench_compress_run_thread, zc,
+		    &elapsed);
+		(void) snprintf(bcase, sizeof (bcase), "%s/%s/decomp", name,
+		    zbench_corpus_names[zc->zc_corpus]);
+		zbench_report_ratio("compress", bcase, t, ops, ops * size,
+		    elapsed, ratio);
+	}
+}
+
+int
+zbench_compress_run(void)
+{
+	int earlyabort = zio_compress_earlyabort;
+	unsigned int earlyabort_size = zio_compress_earlyabort_size;
+	zbench_compress_t zc;
+	const char *name;
+
+	LOG(D_INFO, "compress: %d blocks of %llu bytes per thread\n",
+	    ZBENCH_COMPRESS_NBLOCKS, (u_longlong_t)zbo_opts.zbo_blocksize);
+
+	for (int c = 0; c < ZIO_COMPRESS_FUNCTIONS; c++) {
+		if (zio_compress_table[c].ci_compress == NULL)
+			continue;
+
+		zc.zc_compress = c;
+		for (int l = 0; l < ZIO_ZSTD_LEVEL_LEVELS; l++) {
+			uint64_t prop = c;
+
+			if (c == ZIO_COMPRESS_ZSTD) {
+				/* Every level with a property name */
+				if (l == ZIO_ZSTD_LEVEL_INHERIT ||
+				    zfs_prop_index_to_string(
+				    ZFS_PROP_COMPRESSION,
+				    ZIO_COMPLEVEL_ZSTD(l), &name) != 0)
+					continue;
+				prop = ZIO_COMPLEVEL_ZSTD(l);
+			} else if (l != 0) {
+				break;
+			}
+			VERIFY0(zfs_prop_index_to_string(ZFS_PROP_COMPRESSION,
+			    prop, &name));
+
+			zc.zc_level = l;
+			for (int k = 0; k < ZBENCH_CORPORA; k++) {
+				zc.zc_corpus = k;
+				zc.zc_earlyabort = B_FALSE;
+				zbench_compress_measure(&zc, name);
+
+				if (c != ZIO_COMPRESS_ZSTD &&
+				    (c < ZIO_COMPRESS_GZIP_1 ||
+				    c > ZIO_COMPRESS_GZIP_9))
+					continue;
+				zio_compress_earlyabort = 1;
+				zio_compress_earlyabort_size = 0;
+				zc.zc_earlyabort = B_TRUE;
+				zbench_compress_measure(&zc, name);
+				zio_compress_earlyabort = earlyabort;
+				zio_compress_earlyabort_size = earlyabort_size;
+			}
+		}
+	}
+
+	return (0);
+}
@@ -0,0 +1,142 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * DMU read benchmark: every thread repeatedly calls dmu_read() on randomly
+ * chosen 1 MiB ranges of an object which is resident in the ARC.  The dbuf
+ * cache is disabled for the duration, so that every block is looked up in
+ * the ARC again.  The arc-miss cases flush the pool's unreferenced buffers
+ * from the ARC before each read, so that the blocks come from disk.  Each
+ * case is run with the batched ARC read path (dbuf_read_batch at its
+ * default) and with one arc_read() per block.
+ */
+
+#include <sys/zfs_context.h>
+#include <sys/spa.h>
+#include <sys/dmu.h>
+#include <sys/dbuf.h>
+#include <sys/arc.h>
+#include <stdio.h>
+#include <umem.h>
+
+#include "zbench.h"
+
+#define	ZBENCH_DMU_READ_SIZE	(1ULL << 20)
+
+extern unsigned long dbuf_cache_max_bytes;
+extern int dbuf_read_batch;
+
+typedef struct zbench_dmu {
+	spa_t		*zd_spa;
+	objset_t	*zd_os;
+	uint64_t	zd_object;
+	uint64_t	zd_size;
+	uint64_t	zd_len;
+	boolean_t	zd_cold;
+} zbench_dmu_t;
+
+static uint64_t
+zbench_dmu_reads(void *arg, int id, hrtime_t deadline)
+{
+	zbench_dmu_t *zd = arg;
+	uint64_t x = (id + 1) * 0x9E3779B97F4A7C15ULL;
+	uint64_t nchunks = zd->zd_size / zd->zd_len;
+	uint64_t ops = 0;
+	char *buf;
+
+	buf = umem_alloc(zd->zd_len, UMEM_NOFAIL);
+	do {
+		/* xorshift64 */
+		x ^= x << 13;
+		x ^= x >> 7;
+		x ^= x << 17;
+		if (zd->zd_cold)
+			arc_flush(zd->zd_spa, B_FALSE);
+		VERIFY0(dmu_read(zd->zd_os, zd->zd_object,
+		    (x % nchunks) * zd->zd_len, zd->zd_len, buf,
+		    DMU_READ_NO_PREFETCH));
+		ops++;
+	} while (gethrtime() < deadline);
+	umem_free(buf, zd->zd_len);
+
+	return (ops);
+}
+
+int
+zbench_dmu_run(void)
+{
+	unsigned long cache_max_bytes = dbuf_cache_max_bytes;
+	int read_batch = dbuf_read_batch;
+	uint64_t nblocks = zbo_opts.zbo_nblocks;
+	uint64_t blocksize = zbo_opts.zbo_blocksize;
+	zbench_dmu_t zd;
+	char *buf;
+	hrtime_t elapsed;
+
+	zd.zd_spa = zbench_pool_create();
+	VERIFY0(dmu_objset_own(zbo_opts.zbo_pool, DMU_OST_ANY, B_FALSE,
+	    B_TRUE, FTAG, &zd.zd_os));
+	zd.zd_object = zbench_object_create(zd.zd_os, blocksize, nblocks);
+	zd.zd_size = blocksize * nblocks;
+	zd.zd_len = MIN(ZBENCH_DMU_READ_SIZE, zd.zd_size);
+
+	/* Make sure every block is resident before measuring. */
+	buf = umem_alloc(zd.zd_len, UMEM_NOFAIL);
+	for (uint64_t off = 0; off + zd.zd_len <= zd.zd_size;
+	    off += zd.zd_len) {
+		VERIFY0(dmu_read(zd.zd_os, zd.zd_object, off, zd.zd_len, buf,
+		    DMU_READ_NO_PREFETCH));
+	}
+	umem_free(buf, zd.zd_len);
+
+	LOG(D_INFO, "dmu_read: %llu blocks of %llu bytes, %llu byte reads\n",
+	    (u_longlong_t)nblocks, (u_longlong_t)blocksize,
+	    (u_longlong_t)zd.zd_len);
+
+	dbuf_cache_max_bytes = 0;
+	for (int c = 0; c < 2; c++) {
+		zd.zd_cold = (c == 1);
+		for (int t = 1; t != 0; t = zbench_threads_next(t)) {
+			uint64_t ops;
+
+			dbuf_read_batch = read_batch;
+			ops = zbench_run_threads(t, zbench_dmu_reads, &zd,
+			    &elapsed);
+			zbench_report("dmu_read", zd.zd_cold ?
+			    "arc-miss/batch" : "arc-hit/batch", t, ops,
+			    ops * zd.zd_len, elapsed);
+
+			dbuf_read_batch = 1;
+			ops = zbench_run_threads(t, zbench_dmu_reads, &zd,
+			    &elapsed);
+			zbench_report("dmu_read", zd.zd_cold ?
+			    "arc-miss/single" : "arc-hit/single", t, ops,
+			    ops * zd.zd_len, elapsed);
+		}
+	}
+	dbuf_read_batch = read_batch;
+	dbuf_cache_max_bytes = cache_max_bytes;
+
+	dmu_objset_disown(zd.zd_os, B_TRUE, FTAG);
+	zbench_pool_destroy(zd.zd_spa);
+
+	return (0);
+}
@@ -0,0 +1,117 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Hedged read benchmark: every thread reads randomly chosen blocks of an
+ * object on a 2-way mirror of file vdevs, flushing the pool's buffers from
+ * the ARC before each read so that every read goes to a mirror child.  The
+ * file vdevs are served from the page cache, so hedges hardly ever fire and
+ * the hedge-on cases measure what setting up a hedge costs a read which
+ * did not need one.  The cases are run with zfs_vdev_hedge cleared and set.
+ */
+
+#include <sys/zfs_context.h>
+#include <sys/spa.h>
+#include <sys/dmu.h>
+#include <sys/dbuf.h>
+#include <sys/arc.h>
+#include <stdio.h>
+#include <umem.h>
+
+#include "zbench.h"
+
+extern unsigned long dbuf_cache_max_bytes;
+extern int zfs_vdev_hedge;
+
+typedef struct zbench_hedge {
+	spa_t		*zh_spa;
+	objset_t	*zh_os;
+	uint64_t	zh_object;
+	uint64_t	zh_blocksize;
+	uint64_t	zh_nblocks;
+} zbench_hedge_t;
+
+static uint64_t
+zbench_hedge_reads(void *arg, int id, hrtime_t deadline)
+{
+	zbench_hedge_t *zh = arg;
+	uint64_t x = (id + 1) * 0x9E3779B97F4A7C15ULL;
+	uint64_t ops = 0;
+	char *buf;
+
+	buf = umem_alloc(zh->zh_blocksize, UMEM_NOFAIL);
+	do {
+		/* xorshift64 */
+		x ^= x << 13;
+		x ^= x >> 7;
+		x ^= x << 17;
+		arc_flush(zh->zh_spa, B_FALSE);
+		VERIFY0(dmu_read(zh->zh_os, zh->zh_object,
+		    (x % zh->zh_nblocks) * zh->zh_blocksize, zh->zh_blocksize,
+		    buf, DMU_READ_NO_PREFETCH));
+		ops++;
+	} while (gethrtime() < deadline);
+	umem_free(buf, zh->zh_blocksize);
+
+	return (ops);
+}
+
+int
+zbench_hedge_run(void)
+{
+	unsigned long cache_max_bytes = dbuf_cache_max_bytes;
+	int hedge = zfs_vdev_hedge;
+	zbench_hedge_t zh;
+	hrtime_t elapsed;
+
+	zh.zh_spa = zbench_pool_create_mirror(2);
+	VERIFY0(dmu_objset_own(zbo_opts.zbo_pool, DMU_OST_ANY, B_FALSE,
+	    B_TRUE, FTAG, &zh.zh_os));
+	zh.zh_blocksize = zbo_opts.zbo_blocksize;
+	zh.zh_nblocks = zbo_opts.zbo_nblocks;
+	zh.zh_object = zbench_object_create(zh.zh_os, zh.zh_blocksize,
+	    zh.zh_nblocks);
+
+	LOG(D_INFO, "hedge: %llu blocks of %llu bytes on a 2-way mirror\n",
+	    (u_longlong_t)zh.zh_nblocks, (u_longlong_t)zh.zh_blocksize);
+
+	dbuf_cache_max_bytes = 0;
+	for (int t = 1; t != 0; t = zbench_threads_next(t)) {
+		uint64_t ops;
+
+		zfs_vdev_hedge = 0;
+		ops = zbench_run_threads(t, zbench_hedge_reads, &zh, &elapsed);
+		zbench_report("hedge", "hedge-off", t, ops,
+		    ops * zh.zh_blocksize, elapsed);
+
+		zfs_vdev_hedge = 1;
+		ops = zbench_run_threads(t, zbench_hedge_reads, &zh, &elapsed);
+		zbench_report("hedge", "hedge-on", t, ops,
+		    ops * zh.zh_blocksize, elapsed);
+	}
+	zfs_vdev_hedge = hedge;
+	dbuf_cache_max_bytes = cache_max_bytes;
+
+	dmu_objset_disown(zh.zh_os, B_TRUE, FTAG);
+	zbench_pool_destroy(zh.zh_spa);
+
+	return (0);
+}
@@ -0,0 +1,111 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * taskq dispatch benchmark: a single thread dispatches batches of empty
+ * tasks to a taskq and waits for each batch to finish, so that the time is
+ * dominated by queueing, waking up and running tasks.  Each operation is
+ * one task run.  The taskq is created with as many threads as the current
+ * thread count, and the cases are run with tasks allocated by
+ * taskq_dispatch() and with preallocated entries via taskq_dispatch_ent().
+ */
+
+#include <sys/zfs_context.h>
+#include <stdio.h>
+
+#include "zbench.h"
+
+#define	ZBENCH_TASKQ_BATCH	1024
+
+typedef struct zbench_taskq {
+	taskq_t		*zt_tq;
+	boolean_t	zt_ent;
+	taskq_ent_t	zt_ents[ZBENCH_TASKQ_BATCH];
+} zbench_taskq_t;
+
+/* ARGSUSED */
+static void
+zbench_taskq_noop(void *arg)
+{
+}
+
+/* ARGSUSED */
+static uint64_t
+zbench_taskq_dispatch(void *arg, int id, hrtime_t deadline)
+{
+	zbench_taskq_t *zt = arg;
+	uint64_t ops = 0;
+
+	do {
+		for (int i = 0; i < ZBENCH_TASKQ_BATCH; i++) {
+			if (zt->zt_ent) {
+				taskq_dispatch_ent(zt->zt_tq,
+				    zbench_taskq_noop, NULL, 0,
+				    &zt->zt_ents[i]);
+			} else {
+				VERIFY3U(taskq_dispatch(zt->zt_tq,
+				    zbench_taskq_noop, NULL, TQ_SLEEP), !=,
+				    TASKQID_INVALID);
+			}
+		}
+		taskq_wait(zt->zt_tq);
+		ops += ZBENCH_TASKQ_BATCH;
+	} while (gethrtime() < deadline);
+
+	return (ops);
+}
+
+int
+zbench_taskq_run(void)
+{
+	zbench_taskq_t *zt;
+	hrtime_t elapsed;
+
+	zt = kmem_zalloc(sizeof (zbench_taskq_t), KM_SLEEP);
+	for (int i = 0; i < ZBENCH_TASKQ_BATCH; i++)
+		taskq_init_ent(&zt->zt_ents[i]);
+
+	LOG(D_INFO, "taskq: batches of %d tasks from one thread\n",
+	    ZBENCH_TASKQ_BATCH);
+
+	for (int t = 1; t != 0; t = zbench_threads_next(t)) {
+		uint64_t ops;
+
+		zt->zt_tq = taskq_create("zbench_taskq", t, maxclsyspri,
+		    t, INT_MAX, TASKQ_PREPOPULATE);
+
+		zt->zt_ent = B_FALSE;
+		ops = zbench_run_threads(1, zbench_taskq_dispatch, zt,
+		    &elapsed);
+		zbench_report("taskq", "dispatch", t, ops, 0, elapsed);
+
+		zt->zt_ent = B_TRUE;
+		ops = zbench_run_threads(1, zbench_taskq_dispatch, zt,
+		    &elapsed);
+		zbench_report("taskq", "dispatch_ent", t, ops, 0, elapsed);
+
+		taskq_destroy(zt->zt_tq);
+	}
+
+	kmem_free(zt, sizeof (zbench_taskq_t));
+
+	return (0);
+}
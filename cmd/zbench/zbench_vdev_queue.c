@@ -0,0 +1,155 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * vdev queue benchmark: every thread repeatedly issues a batch of
+ * ZBENCH_VQ_DEPTH physical reads of -b bytes at random offsets of the file
+ * vdev of the pool, through its vdev queue, and waits for them.  Each
+ * operation is one read.  The sync case only uses the sync read class,
+ * the mixed case alternates every read between the sync read, async read
+ * and scrub classes so that the class scheduling of the queue is involved.
+ * The cases are run with zfs_vdev_lockless_submit set and cleared.
+ */
+
+#include <sys/zfs_context.h>
+#include <sys/spa.h>
+#include <sys/spa_impl.h>
+#include <sys/vdev_impl.h>
+#include <sys/zio.h>
+#include <sys/abd.h>
+#include <stdio.h>
+
+#include "zbench.h"
+
+#define	ZBENCH_VQ_DEPTH		16
+
+extern int zfs_vdev_lockless_submit;
+
+static const zio_priority_t zbench_vq_mixed[] = {
+	ZIO_PRIORITY_SYNC_READ, ZIO_PRIORITY_ASYNC_READ, ZIO_PRIORITY_SCRUB
+};
+
+typedef struct zbench_vq {
+	spa_t		*zv_spa;
+	vdev_t		*zv_vd;
+	boolean_t	zv_mixed;
+} zbench_vq_t;
+
+static uint64_t
+zbench_vq_random(uint64_t *state)
+{
+	uint64_t x = *state;
+
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	*state = x;
+
+	return (x);
+}
+
+static uint64_t
+zbench_vq_run_thread(void *arg, int id, hrtime_t deadline)
+{
+	zbench_vq_t *zv = arg;
+	vdev_t *vd = zv->zv_vd;
+	uint64_t size = zbo_opts.zbo_blocksize;
+	uint64_t nblocks = (vd->vdev_psize - VDEV_LABEL_START_SIZE -
+	    VDEV_LABEL_END_SIZE) / size;
+	uint64_t state = 0x9E3779B97F4A7C15ULL * (id + 1);
+	abd_t *abds[ZBENCH_VQ_DEPTH];
+	uint64_t ops = 0;
+
+	for (int i = 0; i < ZBENCH_VQ_DEPTH; i++)
+		abds[i] = abd_alloc_linear(size, B_FALSE);
+
+	spa_config_enter(zv->zv_spa, SCL_STATE, FTAG, RW_READER);
+	do {
+		zio_t *pio = zio_root(zv->zv_spa, NULL, NULL, 0);
+
+		for (int i = 0; i < ZBENCH_VQ_DEPTH; i++) {
+			uint64_t offset = VDEV_LABEL_START_SIZE +
+			    (zbench_vq_random(&state) % nblocks) * size;
+			zio_priority_t p = zv->zv_mixed ?
+			    zbench_vq_mixed[(ops + i) %
+			    ARRAY_SIZE(zbench_vq_mixed)] :
+			    ZIO_PRIORITY_SYNC_READ;
+
+			zio_nowait(zio_read_phys(pio, vd, offset, size,
+			    abds[i], ZIO_CHECKSUM_OFF, NULL, NULL, p,
+			    ZIO_FLAG_CANFAIL | ZIO_FLAG_DONT_CACHE |
+			    ZIO_FLAG_DONT_RETRY, B_FALSE));
+		}
+		VERIFY0(zio_wait(pio));
+		ops += ZBENCH_VQ_DEPTH;
+	} while (gethrtime() < deadline);
+	spa_config_exit(zv->zv_spa, SCL_STATE, FTAG);
+
+	for (int i = 0; i < ZBENCH_VQ_DEPTH; i++)
+		abd_free(abds[i]);
+
+	return (ops);
+}
+
+int
+zbench_vdev_queue_run(void)
+{
+	int lockless_submit = zfs_vdev_lockless_submit;
+	uint64_t size = zbo_opts.zbo_blocksize;
+	zbench_vq_t zv;
+	hrtime_t elapsed;
+	char bcase[48];
+
+	zv.zv_spa = zbench_pool_create();
+	zv.zv_vd = zv.zv_spa->spa_root_vdev->vdev_child[0];
+	ASSERT(zv.zv_vd->vdev_ops->vdev_op_leaf);
+
+	LOG(D_INFO, "vdev_queue: batches of %d reads of %llu bytes per "
+	    "thread\n", ZBENCH_VQ_DEPTH, (u_longlong_t)size);
+
+	for (int m = 0; m < 2; m++) {
+		zv.zv_mixed = (m != 0);
+		for (int t = 1; t != 0; t = zbench_threads_next(t)) {
+			uint64_t ops;
+
+			zfs_vdev_lockless_submit = B_TRUE;
+			ops = zbench_run_threads(t, zbench_vq_run_thread, &zv,
+			    &elapsed);
+			(void) snprintf(bcase, sizeof (bcase), "%s/lockless",
+			    zv.zv_mixed ? "mixed" : "sync");
+			zbench_report("vdev_queue", bcase, t, ops, ops * size,
+			    elapsed);
+
+			zfs_vdev_lockless_submit = B_FALSE;
+			ops = zbench_run_threads(t, zbench_vq_run_thread, &zv,
+			    &elapsed);
+			(void) snprintf(bcase, sizeof (bcase), "%s/locked",
+			    zv.zv_mixed ? "mixed" : "sync");
+			zbench_report("vdev_queue", bcase, t, ops, ops * size,
+			    elapsed);
+		}
+	}
+
+	zfs_vdev_lockless_submit = lockless_submit;
+	zbench_pool_destroy(zv.zv_spa);
+
+	return (0);
+}
@@ -192,6 +192,7 @@ enum iostat_type {
 	IOS_QUEUES = 2,
 	IOS_L_HISTO = 3,
 	IOS_RQ_HISTO = 4,
+	IOS_S_HISTO = 5,
 	IOS_COUNT,	/* always last element */
 };
 
@@ -201,9 +202,10 @@ enum iostat_type {
 #define	IOS_QUEUES_M	(1ULL << IOS_QUEUES)
 #define	IOS_L_HISTO_M	(1ULL << IOS_L_HISTO)
 #define	IOS_RQ_HISTO_M	(1ULL << IOS_RQ_HISTO)
+#define	IOS_S_HISTO_M	(1ULL << IOS_S_HISTO)
 
 /* Mask of all the histo bits */
-#define	IOS_ANYHISTO_M (IOS_L_HISTO_M | IOS_RQ_HISTO_M)
+#define	IOS_ANYHISTO_M (IOS_L_HISTO_M | IOS_RQ_HISTO_M | IOS_S_HISTO_M)
 
 /*
  * Lookup table for iostat flags to nvlist names.  Basically a list
@@ -252,6 +254,20 @@ static const char *vsx_type_to_nvlist[IOS_COUNT][13] = {
 	    ZPOOL_CONFIG_VDEV_IND_TRIM_HISTO,
 	    ZPOOL_CONFIG_VDEV_AGG_TRIM_HISTO,
 	    NULL},
+	[IOS_S_HISTO] = {
+	    ZPOOL_CONFIG_VDEV_STAGE_W_ISSUE_HISTO,
+	    ZPOOL_CONFIG_VDEV_STAGE_W_COMPRESS_HISTO,
+	    ZPOOL_CONFIG_VDEV_STAGE_W_ENCRYPT_HISTO,
+	    ZPOOL_CONFIG_VDEV_STAGE_W_CKSUM_HISTO,
+	    ZPOOL_CONFIG_VDEV_STAGE_W_ALLOC_HISTO,
+	    ZPOOL_CONFIG_VDEV_STAGE_W_READY_HISTO,
+	    ZPOOL_CONFIG_VDEV_STAGE_W_IO_START_HISTO,
+	    ZPOOL_CONFIG_VDEV_STAGE_W_IO_DONE_HISTO,
+	    ZPOOL_CONFIG_VDEV_STAGE_R_IO_START_HISTO,
+	    ZPOOL_CONFIG_VDEV_STAGE_R_IO_DONE_HISTO,
+	    ZPOOL_CONFIG_VDEV_STAGE_R_ASSESS_HISTO,
+	    ZPOOL_CONFIG_VDEV_STAGE_R_CKSUM_HISTO,
+	    NULL},
 };
 
 
@@ -370,7 +386,7 @@ get_usage(zpool_help_t idx)
 		    "\t    [--rewind-to-checkpoint] <pool | id> [newpool]\n"));
 	case HELP_IOSTAT:
 		return (gettext("\tiostat [[[-c [script1,script2,...]"
-		    "[-lq]]|[-rw]] [-T d | u] [-ghHLpPvy]\n"
+		    "[-lq]]|[-rsw]] [-T d | u] [-ghHLpPvy]\n"
 		    "\t    [[pool ...]|[pool vdev ...]|[vdev ...]]"
 		    " [[-n] interval [count]]\n"));
 	case HELP_LABELCLEAR:
@@ -3870,6 +3886,7 @@ static const name_and_columns_t iostat_top_labels[][IOSTAT_MAX_LABELS] =
 	[IOS_RQ_HISTO] = {{"sync_read", 2}, {"sync_write", 2},
 	    {"async_read", 2}, {"async_write", 2}, {"scrub", 2},
 	    {"trim", 2}, {NULL}},
+	[IOS_S_HISTO] = {{"write_stage", 8}, {"read_stage", 4}, {NULL}},
 };
 
 /* Shorthand - if "columns" field not set, default to 1 column */
@@ -3886,11 +3903,15 @@ static const name_and_columns_t iostat_bottom_labels[][IOSTAT_MAX_LABELS] =
 	    {"write"}, {"read"}, {"write"}, {"scrub"}, {"trim"}, {NULL}},
 	[IOS_RQ_HISTO] = {{"ind"}, {"agg"}, {"ind"}, {"agg"}, {"ind"}, {"agg"},
 	    {"ind"}, {"agg"}, {"ind"}, {"agg"}, {"ind"}, {"agg"}, {NULL}},
+	[IOS_S_HISTO] = {{"issue"}, {"comp"}, {"crypt"}, {"cksum"},
+	    {"alloc"}, {"ready"}, {"io"}, {"iodone"}, {"io"}, {"iodone"},
+	    {"assess"}, {"cksum"}, {NULL}},
 };
 
 static const char *histo_to_title[] = {
 	[IOS_L_HISTO] = "latency",
 	[IOS_RQ_HISTO] = "req_size",
+	[IOS_S_HISTO] = "latency",
 };
 
 /*
@@ -3946,6 +3967,7 @@ default_column_width(iostat_cbdata_t *cb, enum iostat_type type)
 		[IOS_QUEUES] = 6,   /* 1M queue entries */
 		[IOS_L_HISTO] = 10, /* 1B ns = 10sec */
 		[IOS_RQ_HISTO] = 6, /* 1M queue entries */
+		[IOS_S_HISTO] = 10, /* 1B ns = 10sec */
 	};
 
 	if (cb->cb_literal)
@@ -4379,7 +4401,7 @@ print_iostat_histo(struct stat_array *nva, unsigned int len,
 
 	for (j = start_bucket; j < buckets; j++) {
 		/* Print histogram bucket label */
-		if (cb->cb_flags & IOS_L_HISTO_M) {
+		if (cb->cb_flags & (IOS_L_HISTO_M | IOS_S_HISTO_M)) {
 			/* Ending range of this bucket */
 			val = (1UL << (j + 1)) - 1;
 			zfs_nicetime(val, buf, sizeof (buf));
@@ -4746,7 +4768,8 @@ children:
 
 	free(calcvs);
 
-	if (!cb->cb_verbose)
+	/* Pipeline stage latencies are only kept for the whole pool */
+	if (!cb->cb_verbose || (cb->cb_flags & IOS_S_HISTO_M))
 		return (ret);
 
 	if (nvlist_lookup_nvlist_array(newnv, ZPOOL_CONFIG_CHILDREN,
@@ -5448,7 +5471,7 @@ get_namewidth_iostat(zpool_handle_t *zhp, void *data)
 }
 
 /*
- * zpool iostat [[-c [script1,script2,...]] [-lq]|[-rw]] [-ghHLpPvy] [-n name]
+ * zpool iostat [[-c [script1,script2,...]] [-lq]|[-rsw]] [-ghHLpPvy] [-n name]
  *              [-T d|u] [[ pool ...]|[pool vdev ...]|[vdev ...]]
  *              [interval [count]]
  *
@@ -5465,6 +5488,7 @@ get_namewidth_iostat(zpool_handle_t *zhp, void *data)
  *	-q	Display queue depths
  *	-w	Display latency histograms
  *	-r	Display request size histogram
+ *	-s	Display pool-wide zio pipeline stage latency histograms
  *	-T	Display a timestamp in date(1) or Unix format
  *	-n	Only print headers once
  *
@@ -5486,6 +5510,7 @@ zpool_do_iostat(int argc, char **argv)
 	zpool_list_t *list;
 	boolean_t verbose = B_FALSE;
 	boolean_t latency = B_FALSE, l_histo = B_FALSE, rq_histo = B_FALSE;
+	boolean_t s_histo = B_FALSE;
 	boolean_t queues = B_FALSE, parsable = B_FALSE, scripted = B_FALSE;
 	boolean_t omit_since_boot = B_FALSE;
 	boolean_t guid = B_FALSE;
@@ -5497,12 +5522,12 @@ zpool_do_iostat(int argc, char **argv)
 
 	/* Used for printing error message */
 	const char flag_to_arg[] = {[IOS_LATENCY] = 'l', [IOS_QUEUES] = 'q',
-	    [IOS_L_HISTO] = 'w', [IOS_RQ_HISTO] = 'r'};
+	    [IOS_L_HISTO] = 'w', [IOS_RQ_HISTO] = 'r', [IOS_S_HISTO] = 's'};
 
 	uint64_t unsupported_flags;
 
 	/* check options */
-	while ((c = getopt(argc, argv, "c:gLPT:vyhplqrwnH")) != -1) {
+	while ((c = getopt(argc, argv, "c:gLPT:vyhplqrswnH")) != -1) {
 		switch (c) {
 		case 'c':
 			if (cmd != NULL) {
@@ -5562,6 +5587,9 @@ zpool_do_iostat(int argc, char **argv)
 		case 'r':
 			rq_histo = B_TRUE;
 			break;
+		case 's':
+			s_histo = B_TRUE;
+			break;
 		case 'y':
 			omit_since_boot = B_TRUE;
 			break;
@@ -5669,18 +5697,28 @@ zpool_do_iostat(int argc, char **argv)
 		return (1);
 	}
 
-	if ((l_histo || rq_histo) && (cmd != NULL || latency || queues)) {
+	if ((l_histo || rq_histo || s_histo) &&
+	    (cmd != NULL || latency || queues)) {
+		pool_list_free(list);
+		(void) fprintf(stderr,
+		    gettext("[-r|-s|-w] isn't allowed with [-c|-l|-q]\n"));
+		usage(B_FALSE);
+		return (1);
+	}
+
+	if (l_histo + rq_histo + s_histo > 1) {
 		pool_list_free(list);
 		(void) fprintf(stderr,
-		    gettext("[-r|-w] isn't allowed with [-c|-l|-q]\n"));
+		    gettext("Only one of [-r|-s|-w] can be passed at a "
+		    "time\n"));
 		usage(B_FALSE);
 		return (1);
 	}
 
-	if (l_histo && rq_histo) {
+	if (s_histo && cb.cb_vdev_names_count != 0) {
 		pool_list_free(list);
 		(void) fprintf(stderr,
-		    gettext("Only one of [-r|-w] can be passed at a time\n"));
+		    gettext("-s only reports whole pools, not vdevs\n"));
 		usage(B_FALSE);
 		return (1);
 	}
@@ -5699,6 +5737,8 @@ zpool_do_iostat(int argc, char **argv)
 		cb.cb_flags = IOS_L_HISTO_M;
 	} else if (rq_histo) {
 		cb.cb_flags = IOS_RQ_HISTO_M;
+	} else if (s_histo) {
+		cb.cb_flags = IOS_S_HISTO_M;
 	} else {
 		cb.cb_flags = IOS_DEFAULT_M;
 		if (latency)
@@ -45,6 +45,7 @@
 #endif
 
 #define	membar_producer()		smp_wmb()
+#define	membar_consumer()		smp_rmb()
 #define	physmem				zfs_totalram_pages
 
 #define	xcopyin(from, to, size)		copy_from_user(to, from, size)
@@ -114,6 +114,22 @@ extern void SHA512Update(SHA512_CTX *, const void *, size_t);
 
 extern void SHA512Final(void *, SHA512_CTX *);
 
+/*
+ * Selection of the SHA-256 and SHA-512 block transform implementations,
+ * mech being any of the algorithm types above.
+ */
+extern void sha2_impl_init(void);
+
+extern void sha2_impl_fini(void);
+
+extern int sha2_impl_set(uint64_t mech, const char *name);
+
+extern uint32_t sha2_impl_getcnt(uint64_t mech);
+
+extern void sha2_impl_setid(uint64_t mech, uint32_t id);
+
+extern const char *sha2_impl_getname(uint64_t mech);
+
 #ifdef _SHA2_IMPL
 /*
  * The following types/functions are all private to the implementation
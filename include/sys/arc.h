@@ -62,6 +62,7 @@ _NOTE(CONSTCOND) } while (0)
 typedef struct arc_buf_hdr arc_buf_hdr_t;
 typedef struct arc_buf arc_buf_t;
 typedef struct arc_prune arc_prune_t;
+typedef struct arc_dataset arc_dataset_t;
 
 /*
  * Because the ARC can store encrypted data, errors (not due to bugs) may arise
@@ -224,6 +225,21 @@ typedef enum arc_state_type {
 	ARC_STATE_NUMTYPES
 } arc_state_type_t;
 
+/*
+ * One read of an arc_read_batch().  The caller fills in everything up to
+ * and including arb_flags; the rest is filled in by the ARC.
+ */
+typedef struct arc_read_batch_ent {
+	blkptr_t		arb_bp;
+	zbookmark_phys_t	arb_zb;
+	arc_read_done_func_t	*arb_done;
+	void			*arb_private;
+	int			arb_zio_flags;
+	arc_flags_t		arb_flags;
+	int			arb_error;
+	zio_t			*arb_zio;
+} arc_read_batch_ent_t;
+
 typedef struct arc_buf_info {
 	arc_state_type_t	abi_state_type;
 	arc_buf_contents_t	abi_state_contents;
@@ -292,6 +308,8 @@ int arc_referenced(arc_buf_t *buf);
 int arc_read(zio_t *pio, spa_t *spa, const blkptr_t *bp,
     arc_read_done_func_t *done, void *priv, zio_priority_t priority,
     int flags, arc_flags_t *arc_flags, const zbookmark_phys_t *zb);
+void arc_read_batch(zio_t *pio, spa_t *spa, arc_read_batch_ent_t *arb, int n,
+    zio_priority_t priority);
 zio_t *arc_write(zio_t *pio, spa_t *spa, uint64_t txg,
     blkptr_t *bp, arc_buf_t *buf, boolean_t l2arc, const zio_prop_t *zp,
     arc_write_done_func_t *ready, arc_write_done_func_t *child_ready,
@@ -304,6 +322,11 @@ void arc_remove_prune_callback(arc_prune_t *p);
 void arc_freed(spa_t *spa, const blkptr_t *bp);
 
 void arc_flush(spa_t *spa, boolean_t retry);
+
+arc_dataset_t *arc_dataset_register(spa_t *spa, uint64_t objset);
+void arc_dataset_unregister(arc_dataset_t *ad);
+void arc_dataset_stats(arc_dataset_t *ad, uint64_t *size, uint64_t *hits,
+    uint64_t *misses);
 void arc_tempreserve_clear(uint64_t reserve);
 int arc_tempreserve_space(spa_t *spa, uint64_t reserve, uint64_t txg);
 
@@ -117,6 +117,25 @@ struct arc_write_callback {
 	arc_buf_t		*awcb_buf;
 };
 
+/*
+ * Per-dataset ARC accounting, created by arc_dataset_register().  Every
+ * L1 header holding a block of a registered dataset references its entry,
+ * and the header's logical size is charged to ad_size for as long as it is
+ * in the MRU or MFU state.  The entry stays in arc_dataset_tree until the
+ * last registration and the last header reference are gone, so that a
+ * dataset which is registered again finds its existing charges.
+ */
+struct arc_dataset {
+	avl_node_t	ad_node;
+	uint64_t	ad_guid;	/* spa load guid */
+	uint64_t	ad_objset;	/* objset id */
+	uint64_t	ad_holds;	/* registrations, arc_dataset_lock */
+	uint64_t	ad_refcnt;	/* holds + headers, atomic */
+	uint64_t	ad_size;	/* bytes in MRU/MFU, atomic */
+	aggsum_t	ad_hits;
+	aggsum_t	ad_misses;
+};
+
 /*
  * ARC buffers are separated into multiple structs as a memory saving measure:
  *   - Common fields struct, always defined, and embedded within it:
@@ -176,6 +195,9 @@ typedef struct l1arc_buf_hdr {
 
 	arc_callback_t		*b_acb;
 	abd_t			*b_pabd;
+
+	/* protected by hash lock, see arc_hdr_set_dataset() */
+	arc_dataset_t		*b_dataset;
 } l1arc_buf_hdr_t;
 
 typedef enum l2arc_dev_hdr_flags_t {
@@ -368,12 +390,27 @@ typedef struct l2arc_lb_ptr_buf {
 /*
  * L2ARC Internals
  */
+/*
+ * Per-device L2ARC feed statistics, exported as the "l2arc-<vdev guid>"
+ * kstat of the pool.  Only updated by the device's feed thread.
+ */
+typedef struct l2arc_dev_stats {
+	kstat_named_t		l2ds_feeds;
+	kstat_named_t		l2ds_feed_busy;
+	kstat_named_t		l2ds_abort_lowmem;
+	kstat_named_t		l2ds_write_target;
+	kstat_named_t		l2ds_write_bytes;
+	kstat_named_t		l2ds_feed_interval_ms;
+} l2arc_dev_stats_t;
+
 typedef struct l2arc_dev {
 	vdev_t			*l2ad_vdev;	/* vdev */
 	spa_t			*l2ad_spa;	/* spa */
 	uint64_t		l2ad_hand;	/* next write location */
 	uint64_t		l2ad_start;	/* first addr on device */
 	uint64_t		l2ad_end;	/* last addr on device */
+	int			l2ad_daddr_shift; /* l2hdr address units */
+	uint16_t		l2ad_id;	/* index in l2arc_dev_ids */
 	boolean_t		l2ad_first;	/* first sweep through */
 	boolean_t		l2ad_writing;	/* currently writing */
 	kmutex_t		l2ad_mtx;	/* lock for buffer list */
@@ -411,6 +448,15 @@ typedef struct l2arc_dev {
 	 */
 	zfs_refcount_t		l2ad_lb_count;
 	boolean_t		l2ad_trim_all; /* TRIM whole device */
+	/*
+	 * Feed thread writing to this device, see l2arc_feed_thread().
+	 */
+	kthread_t		*l2ad_feed_thread;
+	kmutex_t		l2ad_feed_lock;
+	kcondvar_t		l2ad_feed_cv;
+	boolean_t		l2ad_feed_exit;
+	l2arc_dev_stats_t	l2ad_feed_stats;
+	kstat_t			*l2ad_feed_ksp;
 } l2arc_dev_t;
 
 /*
@@ -443,13 +489,23 @@ typedef struct arc_buf_hdr_crypt {
 	uint8_t			b_mac[ZIO_DATA_MAC_LEN];
 } arc_buf_hdr_crypt_t;
 
+/*
+ * Since a header in the arc_l2c_only state consists of little more than
+ * the common fields and this struct, the L2ARC fields are packed: the
+ * device is a 16-bit index into l2arc_dev_ids, and the disk address is
+ * stored relative to the device's l2ad_start in units of
+ * 1 << l2ad_daddr_shift (the device sector size), split over a 32-bit
+ * and an 8-bit field.  The index, the high address bits and the ARC state
+ * live in otherwise unused bytes of the common fields (b_l2dev,
+ * b_l2daddr_hi and b_l2arcs_state), which takes an L2ARC-only header
+ * from 96 to 80 bytes on LP64.  Use l2arc_hdr_dev(), l2arc_hdr_daddr()
+ * and their setters rather than accessing these fields directly.
+ */
 typedef struct l2arc_buf_hdr {
 	/* protected by arc_buf_hdr mutex */
-	l2arc_dev_t		*b_dev;		/* L2ARC device */
-	uint64_t		b_daddr;	/* disk address, offset byte */
-	uint32_t		b_hits;
-	arc_state_type_t	b_arcs_state;
 	list_node_t		b_l2node;
+	uint32_t		b_daddr_lo;	/* disk address, low bits */
+	uint32_t		b_hits;		/* atomic */
 } l2arc_buf_hdr_t;
 
 typedef struct l2arc_write_callback {
@@ -464,10 +520,14 @@ struct arc_buf_hdr {
 	dva_t			b_dva;
 	uint64_t		b_birth;
 
-	arc_buf_contents_t	b_type;
+	uint8_t			b_type;		/* arc_buf_contents_t */
 	uint8_t			b_complevel;
-	uint8_t			b_reserved1; /* used for 4 byte alignment */
-	uint16_t		b_reserved2; /* used for 4 byte alignment */
+
+	/* L2ARC fields, see l2arc_buf_hdr_t */
+	uint8_t			b_l2daddr_hi;	/* disk address, high bits */
+	uint8_t			b_l2arcs_state;	/* arc_state_type_t */
+	uint16_t		b_l2dev;	/* index in l2arc_dev_ids */
+	uint16_t		b_reserved;	/* used for 8 byte alignment */
 	arc_buf_hdr_t		*b_hash_next;
 	arc_flags_t		b_flags;
 
@@ -554,6 +614,25 @@ typedef struct arc_stats {
 	kstat_named_t arcstat_evict_l2_eligible_mru;
 	kstat_named_t arcstat_evict_l2_ineligible;
 	kstat_named_t arcstat_evict_l2_skip;
+	/*
+	 * Number of eviction passes split across the arc_evict taskq, and
+	 * the number of tasks they were split into.
+	 */
+	kstat_named_t arcstat_evict_parallel;
+	kstat_named_t arcstat_evict_tasks;
+	/*
+	 * Total bytes evicted by parallel eviction tasks, and the most
+	 * evicted by any single task.
+	 */
+	kstat_named_t arcstat_evict_task_bytes;
+	kstat_named_t arcstat_evict_task_bytes_max;
+	/*
+	 * Number of datasets holding more than zfs_arc_dataset_limit_percent
+	 * of arc_c as of the last eviction, and the bytes evicted from them
+	 * ahead of other datasets' buffers.
+	 */
+	kstat_named_t arcstat_evict_datasets_over_limit;
+	kstat_named_t arcstat_evict_dataset_limit_bytes;
 	kstat_named_t arcstat_hash_elements;
 	kstat_named_t arcstat_hash_elements_max;
 	kstat_named_t arcstat_hash_collisions;
@@ -748,6 +827,37 @@ typedef struct arc_stats {
 	 * Not updated directly; only synced in arc_kstat_update.
 	 */
 	kstat_named_t arcstat_mfu_ghost_evictable_metadata;
+	/*
+	 * Entries and logical bytes currently recorded by compact ghost
+	 * tracking (zfs_arc_ghost_compact), and the memory used by its
+	 * filters.
+	 */
+	kstat_named_t arcstat_ghost_compact_entries;
+	kstat_named_t arcstat_ghost_compact_size;
+	kstat_named_t arcstat_ghost_compact_mem;
+	/*
+	 * Header memory the recorded entries would have used on the ghost
+	 * lists.  Not updated directly; only synced in arc_kstat_update.
+	 */
+	kstat_named_t arcstat_ghost_compact_saved;
+	/*
+	 * Number of times a filter generation filled up and the oldest
+	 * generation was discarded.
+	 */
+	kstat_named_t arcstat_ghost_compact_rotations;
+	/*
+	 * Read misses checked against the filters, and those which matched
+	 * and were counted as MRU or MFU ghost hits.
+	 */
+	kstat_named_t arcstat_ghost_compact_lookups;
+	kstat_named_t arcstat_ghost_compact_hits;
+	/*
+	 * Estimated chance, in parts per million, that a lookup matches a
+	 * block which was never recorded, derived from how full the
+	 * filters are.  Not updated directly; only synced in
+	 * arc_kstat_update.
+	 */
+	kstat_named_t arcstat_ghost_compact_fp_ppm;
 	kstat_named_t arcstat_l2_hits;
 	kstat_named_t arcstat_l2_misses;
 	/*
@@ -781,6 +891,21 @@ typedef struct arc_stats {
 	kstat_named_t arcstat_l2_psize;
 	/* Not updated directly; only synced in arc_kstat_update. */
 	kstat_named_t arcstat_l2_hdr_size;
+	/*
+	 * Memory saved by the packed l2arc_buf_hdr_t in L2ARC-only headers,
+	 * compared to the previous unpacked layout.  Not updated directly;
+	 * only synced in arc_kstat_update.
+	 */
+	kstat_named_t arcstat_l2_hdr_saved;
+	/*
+	 * Logical bytes of buffers the L2ARC admission filter (l2arc_admit)
+	 * let through and turned away.  A rejected buffer is counted again
+	 * every time a feed considers it.
+	 */
+	kstat_named_t arcstat_l2_admit_bytes;
+	kstat_named_t arcstat_l2_reject_bytes;
+	/* Number of times the admission filter counters were halved. */
+	kstat_named_t arcstat_l2_admit_resets;
 	/*
 	 * Number of L2ARC log blocks written. These are used for restoring the
 	 * L2ARC. Updated during writing of L2ARC log blocks.
@@ -0,0 +1,97 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Interface declarations for BLAKE3 hashing, following the BLAKE3
+ * specification and reference implementation by Jack O'Connor, Jean-Philippe
+ * Aumasson, Samuel Neves and Zooko Wilcox-O'Hearn (public domain / CC0).
+ */
+
+#ifndef	_SYS_BLAKE3_H
+#define	_SYS_BLAKE3_H
+
+#ifdef  _KERNEL
+#include <sys/types.h>
+#else
+#include <stdint.h>
+#include <stdlib.h>
+#endif
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#define	BLAKE3_KEY_LEN		32
+#define	BLAKE3_OUT_LEN		32
+#define	BLAKE3_MAX_DEPTH	54
+#define	BLAKE3_BLOCK_LEN	64
+#define	BLAKE3_CHUNK_LEN	1024
+
+/*
+ * State of the chunk which is currently being hashed.
+ */
+typedef struct {
+	uint32_t	cv[8];
+	uint64_t	chunk_counter;
+	uint8_t		buf[BLAKE3_BLOCK_LEN];
+	uint8_t		buf_len;
+	uint8_t		blocks_compressed;
+	uint8_t		flags;
+} blake3_chunk_state_t;
+
+/*
+ * Hashing context.  The chaining values of completed subtrees are kept on
+ * a stack, one per level of the tree, so the context is fairly large and
+ * callers in the kernel should not keep it on the stack.
+ */
+typedef struct {
+	uint32_t		key[8];
+	blake3_chunk_state_t	chunk;
+	uint8_t			cv_stack_len;
+	uint8_t			cv_stack[(BLAKE3_MAX_DEPTH + 1) *
+	    BLAKE3_OUT_LEN];
+	/* implementation selected when the context was initialized */
+	const void		*ops;
+} BLAKE3_CTX;
+
+extern void Blake3_Init(BLAKE3_CTX *ctx);
+extern void Blake3_InitKeyed(BLAKE3_CTX *ctx,
+    const uint8_t key[BLAKE3_KEY_LEN]);
+extern void Blake3_Update(BLAKE3_CTX *ctx, const void *input, size_t len);
+extern void Blake3_Final(const BLAKE3_CTX *ctx, uint8_t *out);
+extern void Blake3_FinalSeek(const BLAKE3_CTX *ctx, uint64_t seek,
+    uint8_t *out, size_t out_len);
+
+/*
+ * Implementation selection, see the zfs_blake3_impl module parameter.
+ */
+extern void blake3_impl_init(void);
+extern void blake3_impl_fini(void);
+extern int blake3_impl_set(const char *name);
+extern uint32_t blake3_impl_getcnt(void);
+extern void blake3_impl_setid(uint32_t id);
+extern const char *blake3_impl_getname(void);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* _SYS_BLAKE3_H */
@@ -56,11 +56,20 @@ typedef struct dataset_kstat_values {
 	 * entry is removed from the unlinked set
 	 */
 	kstat_named_t dkv_nunlinked;
+	/*
+	 * arc_size is the logical size of the dataset's blocks cached in
+	 * the ARC (MRU and MFU), arc_hits and arc_misses count arc_read()
+	 * calls for its blocks since the dataset was first registered
+	 */
+	kstat_named_t dkv_arc_size;
+	kstat_named_t dkv_arc_hits;
+	kstat_named_t dkv_arc_misses;
 } dataset_kstat_values_t;
 
 typedef struct dataset_kstats {
 	dataset_aggsum_stats_t dk_aggsums;
 	kstat_t *dk_kstats;
+	struct arc_dataset *dk_arc;
 } dataset_kstats_t;
 
 void dataset_kstats_create(dataset_kstats_t *, objset_t *);
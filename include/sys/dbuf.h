@@ -321,16 +321,37 @@ typedef struct dmu_buf_impl {
 	uint8_t db_dirtycnt;
 } dmu_buf_impl_t;
 
-/* Note: the dbuf hash table is exposed only for the mdb module */
+/*
+ * The dbuf hash table is private to dbuf.c, which walks it for other
+ * consumers with dbuf_hash_walk().  The types are here for debuggers.
+ */
 #define	DBUF_MUTEXES 8192
-#define	DBUF_HASH_MUTEX(h, idx) (&(h)->hash_mutexes[(idx) & (DBUF_MUTEXES-1)])
+#define	DBUF_HASH_MUTEX(idx) (&dbuf_hash_mutexes[(idx) & (DBUF_MUTEXES-1)])
+typedef struct dbuf_hash_mutex {
+	kmutex_t hm_lock;
+	volatile uint64_t hm_seq;	/* odd while a writer is active */
+} dbuf_hash_mutex_t;
+
+/*
+ * While the table is being grown hash_old is the previous, half as big,
+ * table, of which the first hash_migrated buckets have been moved over.
+ * Tables are never changed in place; see dbuf_hash_grow().
+ */
 typedef struct dbuf_hash_table {
 	uint64_t hash_table_mask;
 	dmu_buf_impl_t **hash_table;
-	kmutex_t hash_mutexes[DBUF_MUTEXES];
+	uint64_t hash_old_mask;
+	dmu_buf_impl_t **hash_old;
+	volatile uint64_t hash_migrated;
 } dbuf_hash_table_t;
 
-typedef void (*dbuf_prefetch_fn)(void *, boolean_t);
+extern dbuf_hash_mutex_t dbuf_hash_mutexes[DBUF_MUTEXES];
+
+/*
+ * Prefetch completion callback: arg, level and blkid of the prefetched
+ * block, and how long the read took, or 0 if no read was issued for it.
+ */
+typedef void (*dbuf_prefetch_fn)(void *, uint64_t, uint64_t, hrtime_t);
 
 uint64_t dbuf_whichblock(const struct dnode *di, const int64_t level,
     const uint64_t offset);
@@ -363,8 +384,14 @@ void dbuf_rele_and_unlock(dmu_buf_impl_t *db, void *tag, boolean_t evicting);
 
 dmu_buf_impl_t *dbuf_find(struct objset *os, uint64_t object, uint8_t level,
     uint64_t blkid);
+typedef void (*dbuf_walk_fn)(dmu_buf_impl_t *, void *);
+void dbuf_walk_cached(spa_t *spa, dbuf_walk_fn func, void *arg);
+typedef int (*dbuf_hash_walk_fn)(dmu_buf_impl_t *, void *);
+int dbuf_hash_walk(uint64_t idx, dbuf_hash_walk_fn func, void *arg);
+uint64_t dbuf_hash_size(void);
 
 int dbuf_read(dmu_buf_impl_t *db, zio_t *zio, uint32_t flags);
+void dbuf_read_array(dmu_buf_impl_t **dbs, int n, zio_t *zio, uint32_t flags);
 void dmu_buf_will_not_fill(dmu_buf_t *db, dmu_tx_t *tx);
 void dmu_buf_will_fill(dmu_buf_t *db, dmu_tx_t *tx);
 void dmu_buf_fill_done(dmu_buf_t *db, dmu_tx_t *tx);
@@ -394,7 +421,7 @@ void dbuf_free_range(struct dnode *dn, uint64_t start, uint64_t end,
 
 void dbuf_new_size(dmu_buf_impl_t *db, int size, dmu_tx_t *tx);
 
-void dbuf_stats_init(dbuf_hash_table_t *hash);
+void dbuf_stats_init(void);
 void dbuf_stats_destroy(void);
 
 int dbuf_dnode_findbp(dnode_t *dn, uint64_t level, uint64_t blkid,
@@ -381,6 +381,8 @@ typedef struct dmu_buf {
 #define	DMU_POOL_ZPOOL_CHECKPOINT	"com.delphix:zpool_checkpoint"
 #define	DMU_POOL_LOG_SPACEMAP_ZAP	"com.delphix:log_spacemap_zap"
 #define	DMU_POOL_DELETED_CLONES		"com.delphix:deleted_clones"
+/* not feature-gated; older software ignores it, see spa_warmset.c */
+#define	DMU_POOL_ARC_WARMSET		"org.openzfs:arc_warmset"
 
 /*
  * Allocate an object from this objset.  The range of object numbers
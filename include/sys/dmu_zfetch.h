@@ -52,6 +52,35 @@ typedef struct zstream {
 	uint64_t	zs_pf_blkid1;	/* first block to prefetch */
 	uint64_t	zs_pf_blkid;	/* block to prefetch up to */
 
+	/*
+	 * Strided streams (zs_stride != 0) expect the next access of
+	 * zs_nblks blocks at zs_blkid = zs_last_blkid + zs_stride, which
+	 * is negative for backward streams.  zs_pf_blkid1 and zs_pf_blkid
+	 * are then the first blocks of the first access to prefetch and of
+	 * the access to prefetch up to.  A stream which was never hit
+	 * remembers the distance between its last two accesses in
+	 * zs_stride_cand, and becomes strided when the next access is the
+	 * same distance away.
+	 */
+	int64_t		zs_stride;
+	int64_t		zs_stride_cand;
+	uint64_t	zs_last_blkid;	/* first block of last access */
+	uint64_t	zs_nblks;	/* blocks per strided access */
+	uint64_t	zs_hits;	/* accesses which matched the stream */
+
+	/*
+	 * The prefetch window of the stream is adapted to the completion
+	 * latency of its prefetches and to the rate the stream is read at.
+	 * zs_catchup is set when a prefetch completes for a block that the
+	 * reader has already asked for.  The latency and zs_catchup are
+	 * updated from prefetch completion without holding zf_lock, so they
+	 * are only accessed atomically.
+	 */
+	uint64_t	zs_distance;	/* max bytes to prefetch ahead */
+	uint64_t	zs_lat;		/* average prefetch latency (ns) */
+	uint64_t	zs_rate;	/* average read rate (bytes/sec) */
+	uint32_t	zs_catchup;	/* reader waited for a prefetch */
+
 	/*
 	 * We will next prefetch the L1 indirect block of this level-0
 	 * block id.
@@ -694,6 +694,20 @@ typedef struct zpool_load_policy {
 #define	ZPOOL_CONFIG_VDEV_AGG_SCRUB_HISTO	"vdev_agg_scrub_histo"
 #define	ZPOOL_CONFIG_VDEV_AGG_TRIM_HISTO	"vdev_agg_trim_histo"
 
+/* Pool-wide zio pipeline stage latency histograms (root vdev only) */
+#define	ZPOOL_CONFIG_VDEV_STAGE_W_ISSUE_HISTO	"vdev_stage_w_issue_histo"
+#define	ZPOOL_CONFIG_VDEV_STAGE_W_COMPRESS_HISTO "vdev_stage_w_compress_histo"
+#define	ZPOOL_CONFIG_VDEV_STAGE_W_ENCRYPT_HISTO	"vdev_stage_w_encrypt_histo"
+#define	ZPOOL_CONFIG_VDEV_STAGE_W_CKSUM_HISTO	"vdev_stage_w_cksum_histo"
+#define	ZPOOL_CONFIG_VDEV_STAGE_W_ALLOC_HISTO	"vdev_stage_w_alloc_histo"
+#define	ZPOOL_CONFIG_VDEV_STAGE_W_READY_HISTO	"vdev_stage_w_ready_histo"
+#define	ZPOOL_CONFIG_VDEV_STAGE_W_IO_START_HISTO "vdev_stage_w_io_start_histo"
+#define	ZPOOL_CONFIG_VDEV_STAGE_W_IO_DONE_HISTO	"vdev_stage_w_io_done_histo"
+#define	ZPOOL_CONFIG_VDEV_STAGE_R_IO_START_HISTO "vdev_stage_r_io_start_histo"
+#define	ZPOOL_CONFIG_VDEV_STAGE_R_IO_DONE_HISTO	"vdev_stage_r_io_done_histo"
+#define	ZPOOL_CONFIG_VDEV_STAGE_R_ASSESS_HISTO	"vdev_stage_r_assess_histo"
+#define	ZPOOL_CONFIG_VDEV_STAGE_R_CKSUM_HISTO	"vdev_stage_r_cksum_histo"
+
 /* Number of slow IOs */
 #define	ZPOOL_CONFIG_VDEV_SLOW_IOS		"vdev_slow_ios"
 
@@ -920,6 +920,8 @@ typedef struct spa_stats {
 	spa_history_list_t	mmp_history;
 	spa_history_kstat_t	state;		/* pool state */
 	spa_history_kstat_t	iostats;
+	spa_history_kstat_t	zio_stages;	/* pipeline stage latency */
+	spa_history_kstat_t	mirror_latency;	/* mirror child latency */
 } spa_stats_t;
 
 typedef enum txg_state {
@@ -981,6 +983,11 @@ extern void spa_iostats_trim_add(spa_t *spa, trim_type_t type,
     uint64_t extents_written, uint64_t bytes_written,
     uint64_t extents_skipped, uint64_t bytes_skipped,
     uint64_t extents_failed, uint64_t bytes_failed);
+extern int zfs_zio_stage_histograms;
+extern void spa_zio_stage_add(spa_t *spa, zio_type_t type,
+    zio_priority_t priority, int stage, hrtime_t delta);
+extern void spa_zio_stage_histo(spa_t *spa, zio_type_t type, int stage,
+    uint64_t *histo);
 extern void spa_import_progress_add(spa_t *spa);
 extern void spa_import_progress_remove(uint64_t spa_guid);
 extern int spa_import_progress_set_mmp_check(uint64_t pool_guid,
@@ -1177,6 +1184,10 @@ extern void vdev_cache_stat_fini(void);
 extern void vdev_mirror_stat_init(void);
 extern void vdev_mirror_stat_fini(void);
 
+/* vdev hedged reads */
+extern void vdev_hedge_stat_init(void);
+extern void vdev_hedge_stat_fini(void);
+
 /* Initialization and termination */
 extern void spa_init(spa_mode_t mode);
 extern void spa_fini(void);
@@ -329,6 +329,11 @@ struct spa {
 	uint64_t	spa_livelists_to_delete; /* set of livelists to free */
 	livelist_condense_entry_t	spa_to_condense; /* next to condense */
 
+	zthr_t		*spa_warmset_zthr;	/* ARC warm set save/restore */
+	uint64_t	spa_warmset_object;	/* MOS object of ARC warm set */
+	boolean_t	spa_warmset_restore;	/* warm set restore pending */
+	hrtime_t	spa_warmset_saved;	/* last warm set update */
+
 	char		*spa_root;		/* alternate root directory */
 	uint64_t	spa_ena;		/* spa-wide ereport ENA */
 	int		spa_last_open_failed;	/* error if last open failed */
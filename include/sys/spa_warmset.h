@@ -0,0 +1,59 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+#ifndef _SYS_SPA_WARMSET_H
+#define	_SYS_SPA_WARMSET_H
+
+#include <sys/spa.h>
+#include <sys/zio.h>
+#include <sys/zthr.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/*
+ * One block of the ARC warm set.  The bookmark is needed to read the
+ * block back, e.g. to find the key of an encrypted block later on.
+ */
+typedef struct spa_warmset_ent {
+	blkptr_t		swe_bp;
+	zbookmark_phys_t	swe_zb;
+} spa_warmset_ent_t;
+
+/*
+ * Bonus buffer of the warm set object.
+ */
+typedef struct spa_warmset_phys {
+	uint64_t	swp_count;	/* number of entries */
+	uint64_t	swp_nmeta;	/* of which indirect or dnode blocks */
+	uint64_t	swp_txg;	/* last synced txg when taken */
+	uint64_t	swp_timestamp;	/* time when taken */
+} spa_warmset_phys_t;
+
+boolean_t spa_warmset_thread_check(void *, zthr_t *);
+void spa_warmset_thread(void *, zthr_t *);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _SYS_SPA_WARMSET_H */
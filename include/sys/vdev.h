@@ -171,6 +171,8 @@ extern void vdev_queue_change_io_priority(zio_t *zio, zio_priority_t priority);
 extern int vdev_queue_length(vdev_t *vd);
 extern uint64_t vdev_queue_last_offset(vdev_t *vd);
 
+extern uint64_t vdev_mirror_latency(vdev_t *vd);
+
 extern void vdev_config_dirty(vdev_t *vd);
 extern void vdev_config_clean(vdev_t *vd);
 extern int vdev_config_sync(vdev_t **svd, int svdcount, uint64_t txg);
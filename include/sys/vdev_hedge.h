@@ -0,0 +1,106 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+#ifndef _SYS_VDEV_HEDGE_H
+#define	_SYS_VDEV_HEDGE_H
+
+#include <sys/spa.h>
+#include <sys/zio.h>
+#include <sys/vdev_impl.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+typedef struct vdev_hedge vdev_hedge_t;
+typedef struct vdev_hedge_read vdev_hedge_read_t;
+
+typedef enum vdev_hedge_type {
+	VDEV_HEDGE_MIRROR,
+	VDEV_HEDGE_RAIDZ,
+	VDEV_HEDGE_TYPES
+} vdev_hedge_type_t;
+
+typedef enum vdev_hedge_state {
+	VDEV_HEDGE_IDLE,
+	VDEV_HEDGE_ISSUED,
+	VDEV_HEDGE_DONE
+} vdev_hedge_state_t;
+
+typedef struct vdev_hedge_ops {
+	/*
+	 * Called with vh_lock held until it returns B_TRUE, when one of the
+	 * child reads completes, or with a NULL read when the hedge timer
+	 * expires.  Issues any further reads with vdev_hedge_issue() and
+	 * returns B_TRUE once the data of vh_zio is complete enough to
+	 * resume it, after setting up its vsd for vdev_op_io_done.
+	 */
+	boolean_t	(*vho_update)(vdev_hedge_t *vh, vdev_hedge_read_t *vhr);
+
+	/* Optional, called with the zio of every child read which succeeded */
+	void		(*vho_done)(vdev_hedge_read_t *vhr, zio_t *zio);
+
+	vdev_hedge_type_t vho_type;
+	boolean_t	vho_verify;	/* children verify the checksum */
+} vdev_hedge_ops_t;
+
+struct vdev_hedge_read {
+	vdev_hedge_t	*vhr_hedge;
+	zio_t		*vhr_zio;	/* created but not yet issued */
+	vdev_t		*vhr_vd;
+	abd_t		*vhr_abd;	/* private buffer of the read */
+	uint64_t	vhr_size;
+	hrtime_t	vhr_timestamp;	/* when the read was issued */
+	boolean_t	vhr_late;	/* issued by the timer */
+	int		vhr_error;
+	vdev_hedge_state_t vhr_state;
+};
+
+struct vdev_hedge {
+	kmutex_t	vh_lock;
+	zio_t		*vh_zio;	/* paused read, NULL once resumed */
+	zio_t		*vh_root;	/* parent of the child reads */
+	vdev_t		*vh_vd;		/* vdev of vh_zio */
+	const vdev_hedge_ops_t *vh_ops;
+	taskqid_t	vh_timer;
+	boolean_t	vh_fired;	/* the timer expired */
+	boolean_t	vh_hedged;	/* reads were issued by the timer */
+	boolean_t	vh_sealed;	/* vh_root was issued */
+	boolean_t	vh_ready;	/* vho_update said to resume */
+	boolean_t	vh_held;	/* vh_root holds SCL_ZIO */
+	uint32_t	vh_refs;
+	int		vh_nreads;
+	vdev_hedge_read_t vh_reads[0];
+};
+
+extern boolean_t vdev_hedge_enabled(zio_t *zio);
+extern vdev_hedge_t *vdev_hedge_alloc(zio_t *zio, int nreads,
+    const vdev_hedge_ops_t *ops);
+extern void vdev_hedge_issue(vdev_hedge_t *vh, int i, vdev_t *vd,
+    uint64_t offset, uint64_t size);
+extern void vdev_hedge_start(vdev_hedge_t *vh);
+extern void vdev_hedge_won(vdev_hedge_t *vh);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* _SYS_VDEV_HEDGE_H */
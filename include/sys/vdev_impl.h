@@ -65,6 +65,9 @@ extern int zfs_vdev_queue_depth_pct;
 extern int zfs_vdev_def_queue_depth;
 extern uint32_t zfs_vdev_async_write_max_active;
 
+/* Buckets of the child read latency histogram, see vdev_hedge.c */
+#define	VDEV_HEDGE_BUCKETS	32
+
 /*
  * Virtual device operations
  */
@@ -155,6 +158,12 @@ typedef struct vdev_queue_class {
 	 * LBA-ordered vs FIFO.
 	 */
 	avl_tree_t	vqc_queued_tree;
+
+	/*
+	 * Submitted without vq_lock, linked by io_queue_next, and moved
+	 * into vqc_queued_tree by whoever next holds it.
+	 */
+	zio_t		*vqc_submitted;
 } vdev_queue_class_t;
 
 struct vdev_queue {
@@ -172,6 +181,7 @@ struct vdev_queue {
 	hrtime_t	vq_io_delta_ts;
 	zio_t		vq_io_search; /* used as local for stack reduction */
 	kmutex_t	vq_lock;
+	uint32_t	vq_issuing;	/* vq_lock holder issues submissions */
 };
 
 typedef enum vdev_alloc_bias {
@@ -444,6 +454,12 @@ struct vdev {
 	hrtime_t	vdev_mmp_pending; /* 0 if write finished	*/
 	uint64_t	vdev_mmp_kstat_id;	/* to find kstat entry */
 	uint64_t	vdev_expansion_time;	/* vdev's last expansion time */
+	uint64_t	vdev_mirror_lat;	/* mirror child read latency */
+	hrtime_t	vdev_mirror_lat_ts;	/* last latency sample */
+	uint64_t	vdev_mirror_reads;	/* samples in vdev_mirror_lat */
+	/* latency of the reads as a child, see vdev_hedge_sample() */
+	uint32_t	vdev_hedge_histo[VDEV_HEDGE_BUCKETS];
+	uint32_t	vdev_hedge_samples;	/* see vdev_hedge_sample() */
 	list_node_t	vdev_leaf_node;		/* leaf vdev list */
 
 	/*
@@ -461,23 +461,36 @@ typedef struct taskq_ent {
 	uintptr_t		tqent_flags;
 } taskq_ent_t;
 
+/*
+ * Every taskq thread has its own queue of tasks, which other threads of the
+ * taskq steal from when they run out of work.
+ */
+typedef struct taskq_worker {
+	kmutex_t	tqw_lock;	/* protects tqw_task and tqw_freelist */
+	taskq_ent_t	tqw_task;	/* queue of pending tasks */
+	taskq_ent_t	*tqw_freelist;	/* cached task entries */
+	int		tqw_nfree;
+	struct taskq	*tqw_taskq;
+} __attribute__((aligned(64))) taskq_worker_t;
+
 typedef struct taskq {
 	char		tq_name[TASKQ_NAMELEN + 1];
-	kmutex_t	tq_lock;
-	krwlock_t	tq_threadlock;
+	kmutex_t	tq_lock;	/* idle threads and waiters */
 	kcondvar_t	tq_dispatch_cv;
 	kcondvar_t	tq_wait_cv;
 	kthread_t	**tq_threadlist;
+	taskq_worker_t	*tq_workers;
+	int		tq_nworkers;
 	int		tq_flags;
-	int		tq_active;
-	int		tq_nthreads;
-	int		tq_nalloc;
-	int		tq_minalloc;
+	int		tq_nthreads;	/* threads not yet exited */
+	uint32_t	tq_nidle;	/* threads waiting for tasks */
+	uint32_t	tq_next;	/* next worker to dispatch to */
+	uint64_t	tq_nqueued;	/* tasks not yet finished */
+	uint32_t	tq_nalloc;
+	int		tq_minfree;	/* entries cached per worker */
 	int		tq_maxalloc;
 	kcondvar_t	tq_maxalloc_cv;
 	int		tq_maxalloc_wait;
-	taskq_ent_t	*tq_freelist;
-	taskq_ent_t	tq_task;
 } taskq_t;
 
 #define	TQENT_FLAG_PREALLOC	0x1	/* taskq_dispatch_ent used */
@@ -90,7 +90,10 @@ enum zio_checksum {
 	ZIO_CHECKSUM_SKEIN,
 #if !defined(__FreeBSD__)
 	ZIO_CHECKSUM_EDONR,
+#else
+	ZIO_CHECKSUM_EDONR_UNSUPPORTED,	/* keeps the on-disk numbering */
 #endif
+	ZIO_CHECKSUM_BLAKE3,
 	ZIO_CHECKSUM_FUNCTIONS
 };
 
@@ -488,6 +491,7 @@ struct zio {
 	hrtime_t	io_delay;	/* Device access time (disk or */
 					/* file). */
 	avl_node_t	io_queue_node;
+	zio_t		*io_queue_next;	/* vdev queue submission list */
 	avl_node_t	io_offset_node;
 	avl_node_t	io_alloc_node;
 	zio_alloc_list_t 	io_alloc_list;
@@ -500,6 +504,8 @@ struct zio {
 	enum zio_stage	io_orig_stage;
 	enum zio_stage	io_orig_pipeline;
 	enum zio_stage	io_pipeline_trace;
+	enum zio_stage	io_stage_timed;	/* for zfs_zio_stage_histograms */
+	hrtime_t	io_stage_start;
 	int		io_error;
 	int		io_child_error[ZIO_CHILD_TYPES];
 	uint64_t	io_children[ZIO_CHILD_TYPES][ZIO_WAIT_TYPES];
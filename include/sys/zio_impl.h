@@ -151,6 +151,10 @@ enum zio_stage {
 	ZIO_STAGE_DONE			= 1 << 24	/* RWFCI */
 };
 
+#define	ZIO_STAGES	25	/* highbit64(ZIO_STAGE_DONE) */
+
+extern const char *zio_stage_names[ZIO_STAGES];
+
 #define	ZIO_INTERLOCK_STAGES			\
 	(ZIO_STAGE_READY |			\
 	ZIO_STAGE_DONE)
@@ -38,71 +38,198 @@ static pthread_key_t taskq_tsd;
 
 #define	TASKQ_ACTIVE	0x00010000
 
+/*
+ * Each taskq thread owns a worker with its own queue of tasks, so that
+ * dispatchers and threads only contend on the lock of a single worker
+ * rather than on one lock for the whole taskq.  Tasks dispatched from a
+ * thread of the taskq go to that thread's own queue, other tasks are spread
+ * round-robin over the workers.  A thread whose queue is empty steals from
+ * the other workers before going to sleep.  Every queue is run oldest
+ * first, so a taskq with a single thread still runs its tasks in order.
+ *
+ * tq_nqueued counts the tasks which have not yet finished and is updated
+ * atomically, tq_lock is only taken to sleep on or wake up idle threads
+ * and taskq_wait() callers.
+ *
+ * Every worker also caches up to tq_minfree task entries, which between
+ * them hold the minalloc entries the taskq was created with, so that
+ * taskq_dispatch() usually takes an entry and queues it under the lock of
+ * a single worker.  A thread returns the entries of the tasks it ran to its
+ * own cache.  TASKQ_PREPOPULATE fills the caches when the taskq is created.
+ */
+
+static taskq_worker_t *
+taskq_worker(taskq_t *tq)
+{
+	taskq_worker_t *tqw = pthread_getspecific(taskq_tsd);
+
+	if (tqw != NULL && tqw->tqw_taskq == tq)
+		return (tqw);
+	if (tq->tq_nworkers == 1)
+		return (&tq->tq_workers[0]);
+	return (&tq->tq_workers[atomic_inc_32_nv(&tq->tq_next) %
+	    tq->tq_nworkers]);
+}
+
 static taskq_ent_t *
 task_alloc(taskq_t *tq, int tqflags)
 {
 	taskq_ent_t *t;
 	int rv;
 
-again:	if ((t = tq->tq_freelist) != NULL && tq->tq_nalloc >= tq->tq_minalloc) {
-		ASSERT(!(t->tqent_flags & TQENT_FLAG_PREALLOC));
-		tq->tq_freelist = t->tqent_next;
-	} else {
-		if (tq->tq_nalloc >= tq->tq_maxalloc) {
-			if (!(tqflags & KM_SLEEP))
-				return (NULL);
+	while (atomic_inc_32_nv(&tq->tq_nalloc) > (uint32_t)tq->tq_maxalloc) {
+		atomic_dec_32(&tq->tq_nalloc);
+		if (!(tqflags & KM_SLEEP))
+			return (NULL);
+
+		/*
+		 * We don't want to exceed tq_maxalloc, but we can't
+		 * wait for other tasks to complete (and thus free up
+		 * task structures) without risking deadlock with
+		 * the caller.  So, we just delay for one second
+		 * to throttle the allocation rate. If we have tasks
+		 * complete before one second timeout expires then
+		 * task_free will signal us and we will immediately
+		 * retry the allocation.
+		 */
+		mutex_enter(&tq->tq_lock);
+		tq->tq_maxalloc_wait++;
+		rv = cv_timedwait(&tq->tq_maxalloc_cv,
+		    &tq->tq_lock, ddi_get_lbolt() + hz);
+		tq->tq_maxalloc_wait--;
+		mutex_exit(&tq->tq_lock);
+		if (rv <= 0) {
+			atomic_inc_32(&tq->tq_nalloc);
+			break;
+		}
+	}
 
-			/*
-			 * We don't want to exceed tq_maxalloc, but we can't
-			 * wait for other tasks to complete (and thus free up
-			 * task structures) without risking deadlock with
-			 * the caller.  So, we just delay for one second
-			 * to throttle the allocation rate. If we have tasks
-			 * complete before one second timeout expires then
-			 * taskq_ent_free will signal us and we will
-			 * immediately retry the allocation.
-			 */
-			tq->tq_maxalloc_wait++;
-			rv = cv_timedwait(&tq->tq_maxalloc_cv,
-			    &tq->tq_lock, ddi_get_lbolt() + hz);
-			tq->tq_maxalloc_wait--;
-			if (rv > 0)
-				goto again;		/* signaled */
+	t = kmem_alloc(sizeof (taskq_ent_t), tqflags);
+	if (t == NULL) {
+		atomic_dec_32(&tq->tq_nalloc);
+		return (NULL);
+	}
+	/* Make sure we start without any flags */
+	t->tqent_flags = 0;
+	return (t);
+}
+
+static void
+task_free(taskq_t *tq, taskq_worker_t *tqw, taskq_ent_t *t)
+{
+	/* Don't bother taking the lock of a worker with a full cache. */
+	if (tqw->tqw_nfree < tq->tq_minfree) {
+		mutex_enter(&tqw->tqw_lock);
+		if (tqw->tqw_nfree < tq->tq_minfree) {
+			t->tqent_next = tqw->tqw_freelist;
+			tqw->tqw_freelist = t;
+			tqw->tqw_nfree++;
+			t = NULL;
 		}
-		mutex_exit(&tq->tq_lock);
+		mutex_exit(&tqw->tqw_lock);
+	}
 
-		t = kmem_alloc(sizeof (taskq_ent_t), tqflags);
+	if (t != NULL) {
+		kmem_free(t, sizeof (taskq_ent_t));
+		atomic_dec_32(&tq->tq_nalloc);
+	}
 
+	if (tq->tq_maxalloc_wait) {
 		mutex_enter(&tq->tq_lock);
-		if (t != NULL) {
-			/* Make sure we start without any flags */
-			t->tqent_flags = 0;
-			tq->tq_nalloc++;
-		}
+		cv_signal(&tq->tq_maxalloc_cv);
+		mutex_exit(&tq->tq_lock);
 	}
-	return (t);
 }
 
+/*
+ * Queue a task on a worker of the taskq, whose lock the caller holds.
+ * taskq_wakeup() must be called once the lock is dropped.
+ */
 static void
-task_free(taskq_t *tq, taskq_ent_t *t)
+taskq_enqueue(taskq_t *tq, taskq_worker_t *tqw, taskq_ent_t *t,
+    uint_t tqflags)
 {
-	if (tq->tq_nalloc <= tq->tq_minalloc) {
-		t->tqent_next = tq->tq_freelist;
-		tq->tq_freelist = t;
+	ASSERT(tq->tq_flags & TASKQ_ACTIVE);
+	ASSERT(MUTEX_HELD(&tqw->tqw_lock));
+
+	if (tqflags & TQ_FRONT) {
+		t->tqent_next = tqw->tqw_task.tqent_next;
+		t->tqent_prev = &tqw->tqw_task;
 	} else {
-		tq->tq_nalloc--;
-		mutex_exit(&tq->tq_lock);
-		kmem_free(t, sizeof (taskq_ent_t));
+		t->tqent_next = &tqw->tqw_task;
+		t->tqent_prev = tqw->tqw_task.tqent_prev;
+	}
+	t->tqent_next->tqent_prev = t;
+	t->tqent_prev->tqent_next = t;
+
+	/*
+	 * The task can't be run before the worker lock is dropped, so the
+	 * count doesn't go negative.  Raising it after the task was queued
+	 * also orders the queueing before taskq_wakeup() looks at tq_nidle,
+	 * see taskq_thread().
+	 */
+	atomic_inc_64(&tq->tq_nqueued);
+}
+
+/*
+ * Wake up an idle thread, if there is one, to run or steal a task which
+ * was just queued.
+ */
+static void
+taskq_wakeup(taskq_t *tq)
+{
+	if (tq->tq_nidle != 0) {
 		mutex_enter(&tq->tq_lock);
+		cv_signal(&tq->tq_dispatch_cv);
+		mutex_exit(&tq->tq_lock);
 	}
+}
 
-	if (tq->tq_maxalloc_wait)
-		cv_signal(&tq->tq_maxalloc_cv);
+/*
+ * Returns B_TRUE if any worker has tasks queued.
+ */
+static boolean_t
+taskq_has_tasks(taskq_t *tq)
+{
+	for (int i = 0; i < tq->tq_nworkers; i++) {
+		taskq_worker_t *tqw = &tq->tq_workers[i];
+
+		if (tqw->tqw_task.tqent_next != &tqw->tqw_task)
+			return (B_TRUE);
+	}
+	return (B_FALSE);
+}
+
+/*
+ * Take the oldest task off a worker's queue.
+ */
+static taskq_ent_t *
+taskq_dequeue(taskq_worker_t *tqw)
+{
+	taskq_ent_t *t;
+
+	/* Don't bother taking the lock of a worker with nothing queued. */
+	if (tqw->tqw_task.tqent_next == &tqw->tqw_task)
+		return (NULL);
+
+	mutex_enter(&tqw->tqw_lock);
+	if ((t = tqw->tqw_task.tqent_next) == &tqw->tqw_task) {
+		mutex_exit(&tqw->tqw_lock);
+		return (NULL);
+	}
+	t->tqent_prev->tqent_next = t->tqent_next;
+	t->tqent_next->tqent_prev = t->tqent_prev;
+	t->tqent_next = NULL;
+	t->tqent_prev = NULL;
+	mutex_exit(&tqw->tqw_lock);
+
+	return (t);
 }
 
 taskqid_t
 taskq_dispatch(taskq_t *tq, task_func_t func, void *arg, uint_t tqflags)
 {
+	taskq_worker_t *tqw;
 	taskq_ent_t *t;
 
 	if (taskq_now) {
@@ -110,26 +237,24 @@ taskq_dispatch(taskq_t *tq, task_func_t func, void *arg, uint_t tqflags)
 		return (1);
 	}
 
-	mutex_enter(&tq->tq_lock);
-	ASSERT(tq->tq_flags & TASKQ_ACTIVE);
-	if ((t = task_alloc(tq, tqflags)) == NULL) {
-		mutex_exit(&tq->tq_lock);
-		return (0);
-	}
-	if (tqflags & TQ_FRONT) {
-		t->tqent_next = tq->tq_task.tqent_next;
-		t->tqent_prev = &tq->tq_task;
+	tqw = taskq_worker(tq);
+	mutex_enter(&tqw->tqw_lock);
+	if ((t = tqw->tqw_freelist) != NULL) {
+		ASSERT(!(t->tqent_flags & TQENT_FLAG_PREALLOC));
+		tqw->tqw_freelist = t->tqent_next;
+		tqw->tqw_nfree--;
 	} else {
-		t->tqent_next = &tq->tq_task;
-		t->tqent_prev = tq->tq_task.tqent_prev;
+		mutex_exit(&tqw->tqw_lock);
+		if ((t = task_alloc(tq, tqflags)) == NULL)
+			return (0);
+		mutex_enter(&tqw->tqw_lock);
 	}
-	t->tqent_next->tqent_prev = t;
-	t->tqent_prev->tqent_next = t;
 	t->tqent_func = func;
 	t->tqent_arg = arg;
 	t->tqent_flags = 0;
-	cv_signal(&tq->tq_dispatch_cv);
-	mutex_exit(&tq->tq_lock);
+	taskq_enqueue(tq, tqw, t, tqflags);
+	mutex_exit(&tqw->tqw_lock);
+	taskq_wakeup(tq);
 	return (1);
 }
 
@@ -160,6 +285,8 @@ void
 taskq_dispatch_ent(taskq_t *tq, task_func_t func, void *arg, uint_t flags,
     taskq_ent_t *t)
 {
+	taskq_worker_t *tqw;
+
 	ASSERT(func != NULL);
 
 	/*
@@ -167,31 +294,23 @@ taskq_dispatch_ent(taskq_t *tq, task_func_t func, void *arg, uint_t flags,
 	 * to ensure that we don't free it later.
 	 */
 	t->tqent_flags |= TQENT_FLAG_PREALLOC;
+	t->tqent_func = func;
+	t->tqent_arg = arg;
 	/*
 	 * Enqueue the task to the underlying queue.
 	 */
-	mutex_enter(&tq->tq_lock);
-
-	if (flags & TQ_FRONT) {
-		t->tqent_next = tq->tq_task.tqent_next;
-		t->tqent_prev = &tq->tq_task;
-	} else {
-		t->tqent_next = &tq->tq_task;
-		t->tqent_prev = tq->tq_task.tqent_prev;
-	}
-	t->tqent_next->tqent_prev = t;
-	t->tqent_prev->tqent_next = t;
-	t->tqent_func = func;
-	t->tqent_arg = arg;
-	cv_signal(&tq->tq_dispatch_cv);
-	mutex_exit(&tq->tq_lock);
+	tqw = taskq_worker(tq);
+	mutex_enter(&tqw->tqw_lock);
+	taskq_enqueue(tq, tqw, t, flags);
+	mutex_exit(&tqw->tqw_lock);
+	taskq_wakeup(tq);
 }
 
 void
 taskq_wait(taskq_t *tq)
 {
 	mutex_enter(&tq->tq_lock);
-	while (tq->tq_task.tqent_next != &tq->tq_task || tq->tq_active != 0)
+	while (tq->tq_nqueued != 0)
 		cv_wait(&tq->tq_wait_cv, &tq->tq_lock);
 	mutex_exit(&tq->tq_lock);
 }
@@ -211,36 +330,54 @@ taskq_wait_outstanding(taskq_t *tq, taskqid_t id)
 static void
 taskq_thread(void *arg)
 {
-	taskq_t *tq = arg;
+	taskq_worker_t *tqw = arg;
+	taskq_t *tq = tqw->tqw_taskq;
+	int self = tqw - tq->tq_workers;
 	taskq_ent_t *t;
 	boolean_t prealloc;
 
-	VERIFY0(pthread_setspecific(taskq_tsd, tq));
+	VERIFY0(pthread_setspecific(taskq_tsd, tqw));
 
-	mutex_enter(&tq->tq_lock);
-	while (tq->tq_flags & TASKQ_ACTIVE) {
-		if ((t = tq->tq_task.tqent_next) == &tq->tq_task) {
-			if (--tq->tq_active == 0)
-				cv_broadcast(&tq->tq_wait_cv);
-			cv_wait(&tq->tq_dispatch_cv, &tq->tq_lock);
-			tq->tq_active++;
+	for (;;) {
+		/* Run our own tasks first, then steal from the others. */
+		t = taskq_dequeue(tqw);
+		for (int i = 1; t == NULL && i < tq->tq_nworkers; i++) {
+			t = taskq_dequeue(&tq->tq_workers[(self + i) %
+			    tq->tq_nworkers]);
+		}
+
+		if (t == NULL) {
+			mutex_enter(&tq->tq_lock);
+			if (!(tq->tq_flags & TASKQ_ACTIVE)) {
+				mutex_exit(&tq->tq_lock);
+				break;
+			}
+			/*
+			 * Raising tq_nidle before looking at the queues
+			 * pairs with taskq_enqueue(): either we see the task
+			 * or the dispatcher sees us idle and signals.
+			 */
+			atomic_inc_32(&tq->tq_nidle);
+			if (!taskq_has_tasks(tq))
+				cv_wait(&tq->tq_dispatch_cv, &tq->tq_lock);
+			atomic_dec_32(&tq->tq_nidle);
+			mutex_exit(&tq->tq_lock);
 			continue;
 		}
-		t->tqent_prev->tqent_next = t->tqent_next;
-		t->tqent_next->tqent_prev = t->tqent_prev;
-		t->tqent_next = NULL;
-		t->tqent_prev = NULL;
-		prealloc = t->tqent_flags & TQENT_FLAG_PREALLOC;
-		mutex_exit(&tq->tq_lock);
 
-		rw_enter(&tq->tq_threadlock, RW_READER);
+		prealloc = t->tqent_flags & TQENT_FLAG_PREALLOC;
 		t->tqent_func(t->tqent_arg);
-		rw_exit(&tq->tq_threadlock);
-
-		mutex_enter(&tq->tq_lock);
 		if (!prealloc)
-			task_free(tq, t);
+			task_free(tq, tqw, t);
+
+		if (atomic_dec_64_nv(&tq->tq_nqueued) == 0) {
+			mutex_enter(&tq->tq_lock);
+			cv_broadcast(&tq->tq_wait_cv);
+			mutex_exit(&tq->tq_lock);
+		}
 	}
+
+	mutex_enter(&tq->tq_lock);
 	tq->tq_nthreads--;
 	cv_broadcast(&tq->tq_wait_cv);
 	mutex_exit(&tq->tq_lock);
@@ -268,32 +405,47 @@ taskq_create(const char *name, int nthreads, pri_t pri,
 		ASSERT3S(nthreads, >=, 1);
 	}
 
-	rw_init(&tq->tq_threadlock, NULL, RW_DEFAULT, NULL);
 	mutex_init(&tq->tq_lock, NULL, MUTEX_DEFAULT, NULL);
 	cv_init(&tq->tq_dispatch_cv, NULL, CV_DEFAULT, NULL);
 	cv_init(&tq->tq_wait_cv, NULL, CV_DEFAULT, NULL);
 	cv_init(&tq->tq_maxalloc_cv, NULL, CV_DEFAULT, NULL);
 	(void) strncpy(tq->tq_name, name, TASKQ_NAMELEN);
 	tq->tq_flags = flags | TASKQ_ACTIVE;
-	tq->tq_active = nthreads;
 	tq->tq_nthreads = nthreads;
-	tq->tq_minalloc = minalloc;
+	tq->tq_nworkers = nthreads;
+	tq->tq_minfree = howmany(MAX(minalloc, 0), nthreads);
 	tq->tq_maxalloc = maxalloc;
-	tq->tq_task.tqent_next = &tq->tq_task;
-	tq->tq_task.tqent_prev = &tq->tq_task;
 	tq->tq_threadlist = kmem_alloc(nthreads * sizeof (kthread_t *),
 	    KM_SLEEP);
+	tq->tq_workers = kmem_zalloc(nthreads * sizeof (taskq_worker_t),
+	    KM_SLEEP);
 
-	if (flags & TASKQ_PREPOPULATE) {
-		mutex_enter(&tq->tq_lock);
-		while (minalloc-- > 0)
-			task_free(tq, task_alloc(tq, KM_SLEEP));
-		mutex_exit(&tq->tq_lock);
+	for (t = 0; t < nthreads; t++) {
+		taskq_worker_t *tqw = &tq->tq_workers[t];
+
+		mutex_init(&tqw->tqw_lock, NULL, MUTEX_DEFAULT, NULL);
+		tqw->tqw_task.tqent_next = &tqw->tqw_task;
+		tqw->tqw_task.tqent_prev = &tqw->tqw_task;
+		tqw->tqw_taskq = tq;
+
+		if (!(flags & TASKQ_PREPOPULATE))
+			continue;
+		while (tqw->tqw_nfree < tq->tq_minfree) {
+			taskq_ent_t *ent = kmem_alloc(sizeof (taskq_ent_t),
+			    KM_SLEEP);
+
+			ent->tqent_flags = 0;
+			ent->tqent_next = tqw->tqw_freelist;
+			tqw->tqw_freelist = ent;
+			tqw->tqw_nfree++;
+			tq->tq_nalloc++;
+		}
 	}
 
 	for (t = 0; t < nthreads; t++)
 		VERIFY((tq->tq_threadlist[t] = thread_create(NULL, 0,
-		    taskq_thread, tq, 0, &p0, TS_RUN, pri)) != NULL);
+		    taskq_thread, &tq->tq_workers[t], 0, &p0, TS_RUN,
+		    pri)) != NULL);
 
 	return (tq);
 }
@@ -301,7 +453,7 @@ taskq_create(const char *name, int nthreads, pri_t pri,
 void
 taskq_destroy(taskq_t *tq)
 {
-	int nthreads = tq->tq_nthreads;
+	int nworkers = tq->tq_nworkers;
 
 	taskq_wait(tq);
 
@@ -313,17 +465,27 @@ taskq_destroy(taskq_t *tq)
 	while (tq->tq_nthreads != 0)
 		cv_wait(&tq->tq_wait_cv, &tq->tq_lock);
 
-	tq->tq_minalloc = 0;
-	while (tq->tq_nalloc != 0) {
-		ASSERT(tq->tq_freelist != NULL);
-		task_free(tq, task_alloc(tq, KM_SLEEP));
+	mutex_exit(&tq->tq_lock);
+
+	for (int t = 0; t < nworkers; t++) {
+		taskq_worker_t *tqw = &tq->tq_workers[t];
+		taskq_ent_t *ent;
+
+		while ((ent = tqw->tqw_freelist) != NULL) {
+			tqw->tqw_freelist = ent->tqent_next;
+			tqw->tqw_nfree--;
+			kmem_free(ent, sizeof (taskq_ent_t));
+			tq->tq_nalloc--;
+		}
+		mutex_destroy(&tqw->tqw_lock);
 	}
 
-	mutex_exit(&tq->tq_lock);
+	ASSERT0(tq->tq_nalloc);
+	ASSERT(!taskq_has_tasks(tq));
 
-	kmem_free(tq->tq_threadlist, nthreads * sizeof (kthread_t *));
+	kmem_free(tq->tq_workers, nworkers * sizeof (taskq_worker_t));
+	kmem_free(tq->tq_threadlist, nworkers * sizeof (kthread_t *));
 
-	rw_destroy(&tq->tq_threadlock);
 	mutex_destroy(&tq->tq_lock);
 	cv_destroy(&tq->tq_dispatch_cv);
 	cv_destroy(&tq->tq_wait_cv);
@@ -340,7 +502,7 @@ taskq_member(taskq_t *tq, kthread_t *t)
 	if (taskq_now)
 		return (1);
 
-	for (i = 0; i < tq->tq_nthreads; i++)
+	for (i = 0; i < tq->tq_nworkers; i++)
 		if (tq->tq_threadlist[i] == t)
 			return (1);
 
@@ -350,7 +512,9 @@ taskq_member(taskq_t *tq, kthread_t *t)
 taskq_t *
 taskq_of_curthread(void)
 {
-	return (pthread_getspecific(taskq_tsd));
+	taskq_worker_t *tqw = pthread_getspecific(taskq_tsd);
+
+	return (tqw != NULL ? tqw->tqw_taskq : NULL);
 }
 
 int
@@ -382,5 +546,5 @@ system_taskq_fini(void)
 int
 EMPTY_TASKQ(taskq_t *tq)
 {
-	return (tq->tq_task.tqent_next == &tq->tq_task || tq->tq_active == 0);
+	return (!taskq_has_tasks(tq));
 }
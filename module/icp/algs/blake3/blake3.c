@@ -0,0 +1,574 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * BLAKE3 tree hashing, derived from the BLAKE3 reference implementation
+ * (public domain / CC0).
+ *
+ * The input is split into 1 KiB chunks which form the leaves of a binary
+ * tree.  Whole subtrees are handed to the selected implementation's
+ * hash_many() so that as many chunks (and later parent nodes) as it has
+ * SIMD lanes are compressed at once; the chaining values of completed
+ * subtrees wait on the context's cv stack until their sibling is done.
+ */
+
+#include <sys/zfs_context.h>
+#include <sys/blake3.h>
+#include "blake3_impl.h"
+
+/*
+ * Largest subtree hashed by one compress_subtree_to_parent_node() call.
+ * Larger inputs are split into subtrees of this size, which bounds the
+ * recursion (and stack usage) of compress_subtree_wide() while still
+ * keeping all lanes of the widest implementation busy.
+ */
+#define	BLAKE3_MAX_SUBTREE_LEN	(4 * BLAKE3_MAX_SIMD_DEGREE * BLAKE3_CHUNK_LEN)
+
+typedef struct {
+	uint32_t	input_cv[8];
+	uint64_t	counter;
+	uint8_t		block[BLAKE3_BLOCK_LEN];
+	uint8_t		block_len;
+	uint8_t		flags;
+} blake3_output_t;
+
+static inline unsigned int
+highest_one(uint64_t x)
+{
+	return (63 - __builtin_clzll(x));
+}
+
+static inline uint64_t
+round_down_to_power_of_2(uint64_t x)
+{
+	return (1ULL << highest_one(x | 1));
+}
+
+static inline void
+chunk_state_init(blake3_chunk_state_t *cs, const uint32_t key[8],
+    uint8_t flags)
+{
+	memcpy(cs->cv, key, BLAKE3_KEY_LEN);
+	cs->chunk_counter = 0;
+	memset(cs->buf, 0, BLAKE3_BLOCK_LEN);
+	cs->buf_len = 0;
+	cs->blocks_compressed = 0;
+	cs->flags = flags;
+}
+
+static inline void
+chunk_state_reset(blake3_chunk_state_t *cs, const uint32_t key[8],
+    uint64_t chunk_counter)
+{
+	memcpy(cs->cv, key, BLAKE3_KEY_LEN);
+	cs->chunk_counter = chunk_counter;
+	cs->blocks_compressed = 0;
+	memset(cs->buf, 0, BLAKE3_BLOCK_LEN);
+	cs->buf_len = 0;
+}
+
+static inline size_t
+chunk_state_len(const blake3_chunk_state_t *cs)
+{
+	return ((BLAKE3_BLOCK_LEN * (size_t)cs->blocks_compressed) +
+	    ((size_t)cs->buf_len));
+}
+
+static inline size_t
+chunk_state_fill_buf(blake3_chunk_state_t *cs, const uint8_t *input,
+    size_t input_len)
+{
+	size_t take = BLAKE3_BLOCK_LEN - ((size_t)cs->buf_len);
+
+	if (take > input_len)
+		take = input_len;
+	memcpy(cs->buf + cs->buf_len, input, take);
+	cs->buf_len += (uint8_t)take;
+	return (take);
+}
+
+static inline uint8_t
+chunk_state_maybe_start_flag(const blake3_chunk_state_t *cs)
+{
+	return (cs->blocks_compressed == 0 ? BLAKE3_CHUNK_START : 0);
+}
+
+static inline blake3_output_t
+make_output(const uint32_t input_cv[8], const uint8_t *block,
+    uint8_t block_len, uint64_t counter, uint8_t flags)
+{
+	blake3_output_t ret;
+
+	memcpy(ret.input_cv, input_cv, 32);
+	memcpy(ret.block, block, BLAKE3_BLOCK_LEN);
+	ret.block_len = block_len;
+	ret.counter = counter;
+	ret.flags = flags;
+	return (ret);
+}
+
+static inline void
+output_chaining_value(const blake3_ops_t *ops, const blake3_output_t *o,
+    uint8_t cv[32])
+{
+	uint32_t cv_words[8];
+
+	memcpy(cv_words, o->input_cv, 32);
+	ops->compress_in_place(cv_words, o->block, o->block_len, o->counter,
+	    o->flags);
+	blake3_store_cv_words(cv, cv_words);
+}
+
+static void
+output_root_bytes(const blake3_ops_t *ops, const blake3_output_t *o,
+    uint64_t seek, uint8_t *out, size_t out_len)
+{
+	uint64_t output_block_counter = seek / 64;
+	size_t offset_within_block = seek % 64;
+	uint8_t wide_buf[64];
+
+	while (out_len > 0) {
+		size_t available, memcpy_len;
+
+		ops->compress_xof(o->input_cv, o->block, o->block_len,
+		    output_block_counter, o->flags | BLAKE3_ROOT, wide_buf);
+		available = 64 - offset_within_block;
+		memcpy_len = MIN(out_len, available);
+		memcpy(out, wide_buf + offset_within_block, memcpy_len);
+		out += memcpy_len;
+		out_len -= memcpy_len;
+		output_block_counter += 1;
+		offset_within_block = 0;
+	}
+}
+
+static void
+chunk_state_update(const blake3_ops_t *ops, blake3_chunk_state_t *cs,
+    const uint8_t *input, size_t input_len)
+{
+	if (cs->buf_len > 0) {
+		size_t take = chunk_state_fill_buf(cs, input, input_len);
+
+		input += take;
+		input_len -= take;
+		if (input_len > 0) {
+			ops->compress_in_place(cs->cv, cs->buf,
+			    BLAKE3_BLOCK_LEN, cs->chunk_counter,
+			    cs->flags | chunk_state_maybe_start_flag(cs));
+			cs->blocks_compressed += 1;
+			cs->buf_len = 0;
+			memset(cs->buf, 0, BLAKE3_BLOCK_LEN);
+		}
+	}
+
+	while (input_len > BLAKE3_BLOCK_LEN) {
+		ops->compress_in_place(cs->cv, input, BLAKE3_BLOCK_LEN,
+		    cs->chunk_counter,
+		    cs->flags | chunk_state_maybe_start_flag(cs));
+		cs->blocks_compressed += 1;
+		input += BLAKE3_BLOCK_LEN;
+		input_len -= BLAKE3_BLOCK_LEN;
+	}
+
+	(void) chunk_state_fill_buf(cs, input, input_len);
+}
+
+static inline blake3_output_t
+chunk_state_output(const blake3_chunk_state_t *cs)
+{
+	uint8_t block_flags =
+	    cs->flags | chunk_state_maybe_start_flag(cs) | BLAKE3_CHUNK_END;
+
+	return (make_output(cs->cv, cs->buf, cs->buf_len, cs->chunk_counter,
+	    block_flags));
+}
+
+static inline blake3_output_t
+parent_output(const uint8_t block[BLAKE3_BLOCK_LEN], const uint32_t key[8],
+    uint8_t flags)
+{
+	return (make_output(key, block, BLAKE3_BLOCK_LEN, 0,
+	    flags | BLAKE3_PARENT));
+}
+
+/*
+ * Given some input larger than one chunk, return the number of bytes that
+ * should go in the left subtree.  This is the largest power-of-2 number of
+ * chunks that leaves at least 1 byte for the right subtree.
+ */
+static inline size_t
+left_len(size_t content_len)
+{
+	size_t full_chunks = (content_len - 1) / BLAKE3_CHUNK_LEN;
+
+	return (round_down_to_power_of_2(full_chunks) * BLAKE3_CHUNK_LEN);
+}
+
+/*
+ * Hash as many whole chunks as the implementation handles at once, plus
+ * at most one partial chunk, and return the number of chaining values
+ * written to out.
+ */
+static size_t
+compress_chunks_parallel(const blake3_ops_t *ops, const uint8_t *input,
+    size_t input_len, const uint32_t key[8], uint64_t chunk_counter,
+    uint8_t flags, uint8_t *out)
+{
+	const uint8_t *chunks_array[BLAKE3_MAX_SIMD_DEGREE];
+	size_t input_position = 0;
+	size_t chunks_array_len = 0;
+
+	while (input_len - input_position >= BLAKE3_CHUNK_LEN) {
+		chunks_array[chunks_array_len] = &input[input_position];
+		input_position += BLAKE3_CHUNK_LEN;
+		chunks_array_len += 1;
+	}
+
+	ops->hash_many(chunks_array, chunks_array_len,
+	    BLAKE3_CHUNK_LEN / BLAKE3_BLOCK_LEN, key, chunk_counter, B_TRUE,
+	    flags, BLAKE3_CHUNK_START, BLAKE3_CHUNK_END, out);
+
+	if (input_len > input_position) {
+		blake3_chunk_state_t chunk_state;
+		blake3_output_t output;
+
+		chunk_state_init(&chunk_state, key, flags);
+		chunk_state.chunk_counter = chunk_counter + chunks_array_len;
+		chunk_state_update(ops, &chunk_state, &input[input_position],
+		    input_len - input_position);
+		output = chunk_state_output(&chunk_state);
+		output_chaining_value(ops, &output,
+		    &out[chunks_array_len * BLAKE3_OUT_LEN]);
+		return (chunks_array_len + 1);
+	}
+
+	return (chunks_array_len);
+}
+
+/*
+ * Combine pairs of chaining values into parents, passing an odd one
+ * through unchanged, and return the number of chaining values written.
+ */
+static size_t
+compress_parents_parallel(const blake3_ops_t *ops,
+    const uint8_t *child_chaining_values, size_t num_chaining_values,
+    const uint32_t key[8], uint8_t flags, uint8_t *out)
+{
+	const uint8_t *parents_array[BLAKE3_MAX_SIMD_DEGREE];
+	size_t parents_array_len = 0;
+
+	while (num_chaining_values - (2 * parents_array_len) >= 2) {
+		parents_array[parents_array_len] = &child_chaining_values[
+		    2 * parents_array_len * BLAKE3_OUT_LEN];
+		parents_array_len += 1;
+	}
+
+	ops->hash_many(parents_array, parents_array_len, 1, key, 0, B_FALSE,
+	    flags | BLAKE3_PARENT, 0, 0, out);
+
+	if (num_chaining_values > 2 * parents_array_len) {
+		memcpy(&out[parents_array_len * BLAKE3_OUT_LEN],
+		    &child_chaining_values[2 * parents_array_len *
+		    BLAKE3_OUT_LEN], BLAKE3_OUT_LEN);
+		return (parents_array_len + 1);
+	}
+
+	return (parents_array_len);
+}
+
+/*
+ * Hash a subtree and return its chaining values, at most ops->degree of
+ * them (but at least 2 if the input is longer than one chunk), without
+ * merging them into the root.  The caller keeps combining them until
+ * only two remain.
+ */
+static size_t
+compress_subtree_wide(const blake3_ops_t *ops, const uint8_t *input,
+    size_t input_len, const uint32_t key[8], uint64_t chunk_counter,
+    uint8_t flags, uint8_t *out)
+{
+	uint8_t cv_array[2 * BLAKE3_MAX_SIMD_DEGREE * BLAKE3_OUT_LEN];
+	size_t left_input_len, right_input_len, left_n, right_n;
+	uint64_t right_chunk_counter;
+	size_t degree = ops->degree;
+
+	if (input_len <= degree * BLAKE3_CHUNK_LEN) {
+		return (compress_chunks_parallel(ops, input, input_len, key,
+		    chunk_counter, flags, out));
+	}
+
+	left_input_len = left_len(input_len);
+	right_input_len = input_len - left_input_len;
+	right_chunk_counter = chunk_counter +
+	    (uint64_t)(left_input_len / BLAKE3_CHUNK_LEN);
+
+	/*
+	 * With a degree of 1 the left subtree would return a single chaining
+	 * value; make room for two so that the result is always a pair.
+	 */
+	if (left_input_len > BLAKE3_CHUNK_LEN && degree == 1)
+		degree = 2;
+
+	left_n = compress_subtree_wide(ops, input, left_input_len, key,
+	    chunk_counter, flags, cv_array);
+	right_n = compress_subtree_wide(ops, &input[left_input_len],
+	    right_input_len, key, right_chunk_counter, flags,
+	    &cv_array[degree * BLAKE3_OUT_LEN]);
+
+	/* Only possible with a degree of 1, return the pair as is. */
+	if (left_n == 1) {
+		memcpy(out, cv_array, 2 * BLAKE3_OUT_LEN);
+		return (2);
+	}
+
+	return (compress_parents_parallel(ops, cv_array, left_n + right_n,
+	    key, flags, out));
+}
+
+/*
+ * Hash a subtree of more than one chunk down to the two chaining values
+ * of its root's children.  The root itself is compressed later, by the
+ * cv stack merge or by finalization if it turns out to be the tree root.
+ */
+static void
+compress_subtree_to_parent_node(const blake3_ops_t *ops,
+    const uint8_t *input, size_t input_len, const uint32_t key[8],
+    uint64_t chunk_counter, uint8_t flags, uint8_t out[2 * BLAKE3_OUT_LEN])
+{
+	uint8_t cv_array[BLAKE3_MAX_SIMD_DEGREE * BLAKE3_OUT_LEN];
+	uint8_t out_array[BLAKE3_MAX_SIMD_DEGREE * BLAKE3_OUT_LEN / 2];
+	size_t num_cvs;
+
+	num_cvs = compress_subtree_wide(ops, input, input_len, key,
+	    chunk_counter, flags, cv_array);
+
+	while (num_cvs > 2) {
+		num_cvs = compress_parents_parallel(ops, cv_array, num_cvs,
+		    key, flags, out_array);
+		memcpy(cv_array, out_array, num_cvs * BLAKE3_OUT_LEN);
+	}
+	memcpy(out, cv_array, 2 * BLAKE3_OUT_LEN);
+}
+
+static void
+hasher_init_base(BLAKE3_CTX *ctx, const uint32_t key[8], uint8_t flags)
+{
+	memcpy(ctx->key, key, BLAKE3_KEY_LEN);
+	chunk_state_init(&ctx->chunk, key, flags);
+	ctx->cv_stack_len = 0;
+	ctx->ops = blake3_impl_get_ops();
+}
+
+/*
+ * Merge completed subtrees on the cv stack.  The number of subtrees that
+ * must remain is the number of 1 bits in the total number of chunks so
+ * far, so pop and compress parents until that is reached.  This is done
+ * lazily, only once more input arrives, since the last pair may turn out
+ * to be the children of the root, which needs the ROOT flag.
+ */
+static void
+hasher_merge_cv_stack(BLAKE3_CTX *ctx, uint64_t total_len)
+{
+	const blake3_ops_t *ops = ctx->ops;
+	size_t post_merge_stack_len = (size_t)__builtin_popcountll(total_len);
+
+	while (ctx->cv_stack_len > post_merge_stack_len) {
+		uint8_t *parent_node =
+		    &ctx->cv_stack[(ctx->cv_stack_len - 2) * BLAKE3_OUT_LEN];
+		blake3_output_t output =
+		    parent_output(parent_node, ctx->key, ctx->chunk.flags);
+
+		output_chaining_value(ops, &output, parent_node);
+		ctx->cv_stack_len -= 1;
+	}
+}
+
+static void
+hasher_push_cv(BLAKE3_CTX *ctx, uint8_t new_cv[BLAKE3_OUT_LEN],
+    uint64_t chunk_counter)
+{
+	hasher_merge_cv_stack(ctx, chunk_counter);
+	memcpy(&ctx->cv_stack[ctx->cv_stack_len * BLAKE3_OUT_LEN], new_cv,
+	    BLAKE3_OUT_LEN);
+	ctx->cv_stack_len += 1;
+}
+
+void
+Blake3_Init(BLAKE3_CTX *ctx)
+{
+	hasher_init_base(ctx, blake3_iv, 0);
+}
+
+void
+Blake3_InitKeyed(BLAKE3_CTX *ctx, const uint8_t key[BLAKE3_KEY_LEN])
+{
+	uint32_t key_words[8];
+
+	for (int i = 0; i < 8; i++)
+		key_words[i] = blake3_load32(&key[4 * i]);
+	hasher_init_base(ctx, key_words, BLAKE3_KEYED_HASH);
+}
+
+void
+Blake3_Update(BLAKE3_CTX *ctx, const void *input, size_t input_len)
+{
+	const blake3_ops_t *ops = ctx->ops;
+	const uint8_t *input_bytes = (const uint8_t *)input;
+
+	if (input_len == 0)
+		return;
+
+	/* Finish the partial chunk left over from the last call, if any. */
+	if (chunk_state_len(&ctx->chunk) > 0) {
+		size_t take = BLAKE3_CHUNK_LEN - chunk_state_len(&ctx->chunk);
+
+		if (take > input_len)
+			take = input_len;
+		chunk_state_update(ops, &ctx->chunk, input_bytes, take);
+		input_bytes += take;
+		input_len -= take;
+
+		/* Only push the chunk once we know it is not the root. */
+		if (input_len == 0)
+			return;
+
+		blake3_output_t output = chunk_state_output(&ctx->chunk);
+		uint8_t chunk_cv[BLAKE3_OUT_LEN];
+
+		output_chaining_value(ops, &output, chunk_cv);
+		hasher_push_cv(ctx, chunk_cv, ctx->chunk.chunk_counter);
+		chunk_state_reset(&ctx->chunk, ctx->key,
+		    ctx->chunk.chunk_counter + 1);
+	}
+
+	/*
+	 * Hash whole subtrees in one go, keeping at least one byte back so
+	 * that the root is never pushed onto the cv stack.  A subtree must be
+	 * a power of 2 chunks long and start at a multiple of its own size.
+	 */
+	while (input_len > BLAKE3_CHUNK_LEN) {
+		uint64_t subtree_len = round_down_to_power_of_2(input_len);
+		uint64_t count_so_far =
+		    ctx->chunk.chunk_counter * BLAKE3_CHUNK_LEN;
+		uint64_t subtree_chunks;
+
+		if (subtree_len > BLAKE3_MAX_SUBTREE_LEN)
+			subtree_len = BLAKE3_MAX_SUBTREE_LEN;
+		while ((((uint64_t)(subtree_len - 1)) & count_so_far) != 0)
+			subtree_len /= 2;
+		subtree_chunks = subtree_len / BLAKE3_CHUNK_LEN;
+
+		if (subtree_len <= BLAKE3_CHUNK_LEN) {
+			blake3_chunk_state_t chunk_state;
+			blake3_output_t output;
+			uint8_t cv[BLAKE3_OUT_LEN];
+
+			chunk_state_init(&chunk_state, ctx->key,
+			    ctx->chunk.flags);
+			chunk_state.chunk_counter = ctx->chunk.chunk_counter;
+			chunk_state_update(ops, &chunk_state, input_bytes,
+			    (size_t)subtree_len);
+			output = chunk_state_output(&chunk_state);
+			output_chaining_value(ops, &output, cv);
+			hasher_push_cv(ctx, cv, chunk_state.chunk_counter);
+		} else {
+			uint8_t cv_pair[2 * BLAKE3_OUT_LEN];
+
+			compress_subtree_to_parent_node(ops, input_bytes,
+			    (size_t)subtree_len, ctx->key,
+			    ctx->chunk.chunk_counter, ctx->chunk.flags,
+			    cv_pair);
+			hasher_push_cv(ctx, cv_pair, ctx->chunk.chunk_counter);
+			hasher_push_cv(ctx, &cv_pair[BLAKE3_OUT_LEN],
+			    ctx->chunk.chunk_counter + (subtree_chunks / 2));
+		}
+		ctx->chunk.chunk_counter += subtree_chunks;
+		input_bytes += subtree_len;
+		input_len -= (size_t)subtree_len;
+	}
+
+	/* What is left (at most one chunk) goes into the chunk state. */
+	if (input_len > 0) {
+		chunk_state_update(ops, &ctx->chunk, input_bytes, input_len);
+		hasher_merge_cv_stack(ctx, ctx->chunk.chunk_counter);
+	}
+}
+
+void
+Blake3_FinalSeek(const BLAKE3_CTX *ctx, uint64_t seek, uint8_t *out,
+    size_t out_len)
+{
+	const blake3_ops_t *ops = ctx->ops;
+	blake3_output_t output;
+	size_t cvs_remaining;
+
+	if (out_len == 0)
+		return;
+
+	/* If the subtree stack is empty, the current chunk is the root. */
+	if (ctx->cv_stack_len == 0) {
+		output = chunk_state_output(&ctx->chunk);
+		output_root_bytes(ops, &output, seek, out, out_len);
+		return;
+	}
+
+	/*
+	 * Otherwise merge the current chunk (if it has any input) and the
+	 * whole cv stack, right to left, with the last merge as the root.
+	 * An empty current chunk only happens when the input was an exact
+	 * multiple of a subtree, so the top two entries make up the root.
+	 */
+	if (chunk_state_len(&ctx->chunk) > 0) {
+		cvs_remaining = ctx->cv_stack_len;
+		output = chunk_state_output(&ctx->chunk);
+	} else {
+		cvs_remaining = ctx->cv_stack_len - 2;
+		output = parent_output(&ctx->cv_stack[cvs_remaining *
+		    BLAKE3_OUT_LEN], ctx->key, ctx->chunk.flags);
+	}
+	while (cvs_remaining > 0) {
+		uint8_t parent_block[BLAKE3_BLOCK_LEN];
+
+		cvs_remaining -= 1;
+		memcpy(parent_block,
+		    &ctx->cv_stack[cvs_remaining * BLAKE3_OUT_LEN],
+		    BLAKE3_OUT_LEN);
+		output_chaining_value(ops, &output,
+		    &parent_block[BLAKE3_OUT_LEN]);
+		output = parent_output(parent_block, ctx->key,
+		    ctx->chunk.flags);
+	}
+	output_root_bytes(ops, &output, seek, out, out_len);
+}
+
+void
+Blake3_Final(const BLAKE3_CTX *ctx, uint8_t *out)
+{
+	Blake3_FinalSeek(ctx, 0, out, BLAKE3_OUT_LEN);
+}
+
+#if defined(_KERNEL)
+EXPORT_SYMBOL(Blake3_Init);
+EXPORT_SYMBOL(Blake3_InitKeyed);
+EXPORT_SYMBOL(Blake3_Update);
+EXPORT_SYMBOL(Blake3_Final);
+EXPORT_SYMBOL(Blake3_FinalSeek);
+#endif
@@ -0,0 +1,184 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Portable BLAKE3 compression function, derived from the portable code of
+ * the BLAKE3 reference implementation (public domain / CC0).  The SIMD
+ * implementations use it for single blocks as well.
+ */
+
+#include <sys/zfs_context.h>
+#include "blake3_impl.h"
+
+const uint32_t blake3_iv[8] = {
+	0x6A09E667UL, 0xBB67AE85UL, 0x3C6EF372UL, 0xA54FF53AUL,
+	0x510E527FUL, 0x9B05688CUL, 0x1F83D9ABUL, 0x5BE0CD19UL
+};
+
+const uint8_t blake3_msg_schedule[7][16] = {
+	{0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+	{2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8},
+	{3, 4, 10, 12, 13, 2, 7, 14, 6, 5, 9, 0, 11, 15, 8, 1},
+	{10, 7, 12, 9, 14, 3, 13, 15, 4, 0, 11, 2, 5, 8, 1, 6},
+	{12, 13, 9, 11, 15, 10, 14, 8, 7, 2, 5, 3, 0, 1, 6, 4},
+	{9, 14, 11, 5, 8, 12, 15, 1, 13, 3, 0, 10, 2, 6, 4, 7},
+	{11, 15, 5, 0, 1, 9, 8, 6, 14, 10, 2, 12, 3, 4, 7, 13},
+};
+
+static inline uint32_t
+rotr32(uint32_t w, uint32_t c)
+{
+	return ((w >> c) | (w << (32 - c)));
+}
+
+static inline void
+g(uint32_t *state, size_t a, size_t b, size_t c, size_t d, uint32_t x,
+    uint32_t y)
+{
+	state[a] = state[a] + state[b] + x;
+	state[d] = rotr32(state[d] ^ state[a], 16);
+	state[c] = state[c] + state[d];
+	state[b] = rotr32(state[b] ^ state[c], 12);
+	state[a] = state[a] + state[b] + y;
+	state[d] = rotr32(state[d] ^ state[a], 8);
+	state[c] = state[c] + state[d];
+	state[b] = rotr32(state[b] ^ state[c], 7);
+}
+
+static inline void
+round_fn(uint32_t state[16], const uint32_t *msg, size_t round)
+{
+	const uint8_t *schedule = blake3_msg_schedule[round];
+
+	/* Mix the columns. */
+	g(state, 0, 4, 8, 12, msg[schedule[0]], msg[schedule[1]]);
+	g(state, 1, 5, 9, 13, msg[schedule[2]], msg[schedule[3]]);
+	g(state, 2, 6, 10, 14, msg[schedule[4]], msg[schedule[5]]);
+	g(state, 3, 7, 11, 15, msg[schedule[6]], msg[schedule[7]]);
+
+	/* Mix the rows. */
+	g(state, 0, 5, 10, 15, msg[schedule[8]], msg[schedule[9]]);
+	g(state, 1, 6, 11, 12, msg[schedule[10]], msg[schedule[11]]);
+	g(state, 2, 7, 8, 13, msg[schedule[12]], msg[schedule[13]]);
+	g(state, 3, 4, 9, 14, msg[schedule[14]], msg[schedule[15]]);
+}
+
+static inline void
+compress_pre(uint32_t state[16], const uint32_t cv[8],
+    const uint8_t block[BLAKE3_BLOCK_LEN], uint8_t block_len,
+    uint64_t counter, uint8_t flags)
+{
+	uint32_t block_words[16];
+
+	for (int i = 0; i < 16; i++)
+		block_words[i] = blake3_load32(block + 4 * i);
+
+	for (int i = 0; i < 8; i++)
+		state[i] = cv[i];
+	for (int i = 0; i < 4; i++)
+		state[8 + i] = blake3_iv[i];
+	state[12] = (uint32_t)counter;
+	state[13] = (uint32_t)(counter >> 32);
+	state[14] = (uint32_t)block_len;
+	state[15] = (uint32_t)flags;
+
+	for (int r = 0; r < 7; r++)
+		round_fn(state, block_words, r);
+}
+
+void
+blake3_generic_compress_in_place(uint32_t cv[8],
+    const uint8_t block[BLAKE3_BLOCK_LEN], uint8_t block_len,
+    uint64_t counter, uint8_t flags)
+{
+	uint32_t state[16];
+
+	compress_pre(state, cv, block, block_len, counter, flags);
+	for (int i = 0; i < 8; i++)
+		cv[i] = state[i] ^ state[i + 8];
+}
+
+void
+blake3_generic_compress_xof(const uint32_t cv[8],
+    const uint8_t block[BLAKE3_BLOCK_LEN], uint8_t block_len,
+    uint64_t counter, uint8_t flags, uint8_t out[64])
+{
+	uint32_t state[16];
+
+	compress_pre(state, cv, block, block_len, counter, flags);
+	for (int i = 0; i < 8; i++) {
+		blake3_store32(&out[4 * i], state[i] ^ state[i + 8]);
+		blake3_store32(&out[4 * (i + 8)], state[i + 8] ^ cv[i]);
+	}
+}
+
+static inline void
+hash_one(const uint8_t *input, size_t blocks, const uint32_t key[8],
+    uint64_t counter, uint8_t flags, uint8_t flags_start, uint8_t flags_end,
+    uint8_t out[BLAKE3_OUT_LEN])
+{
+	uint32_t cv[8];
+	uint8_t block_flags = flags | flags_start;
+
+	memcpy(cv, key, BLAKE3_KEY_LEN);
+	while (blocks > 0) {
+		if (blocks == 1)
+			block_flags |= flags_end;
+		blake3_generic_compress_in_place(cv, input, BLAKE3_BLOCK_LEN,
+		    counter, block_flags);
+		input = &input[BLAKE3_BLOCK_LEN];
+		blocks -= 1;
+		block_flags = flags;
+	}
+	blake3_store_cv_words(out, cv);
+}
+
+void
+blake3_generic_hash_many(const uint8_t * const *inputs, size_t num_inputs,
+    size_t blocks, const uint32_t key[8], uint64_t counter,
+    boolean_t increment_counter, uint8_t flags, uint8_t flags_start,
+    uint8_t flags_end, uint8_t *out)
+{
+	while (num_inputs > 0) {
+		hash_one(inputs[0], blocks, key, counter, flags, flags_start,
+		    flags_end, out);
+		if (increment_counter)
+			counter += 1;
+		inputs += 1;
+		num_inputs -= 1;
+		out = &out[BLAKE3_OUT_LEN];
+	}
+}
+
+static boolean_t
+blake3_generic_is_supported(void)
+{
+	return (B_TRUE);
+}
+
+const blake3_ops_t blake3_generic_impl = {
+	.compress_in_place = blake3_generic_compress_in_place,
+	.compress_xof = blake3_generic_compress_xof,
+	.hash_many = blake3_generic_hash_many,
+	.is_supported = blake3_generic_is_supported,
+	.degree = 1,
+	.name = "generic"
+};
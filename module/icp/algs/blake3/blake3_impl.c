@@ -0,0 +1,473 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+#include <sys/zfs_context.h>
+#include <sys/blake3.h>
+#include <sys/simd.h>
+#include "blake3_impl.h"
+
+/* All compiled in implementations */
+static const blake3_ops_t *const blake3_all_impl[] = {
+	&blake3_generic_impl,
+#if defined(__x86_64)
+#if defined(HAVE_SSE4_1)
+	&blake3_sse41_impl,
+#endif
+#if defined(HAVE_AVX2)
+	&blake3_avx2_impl,
+#endif
+#if defined(HAVE_AVX512F)
+	&blake3_avx512_impl,
+#endif
+#endif
+};
+
+/* Implementation that contains the fastest methods */
+static blake3_ops_t blake3_fastest_impl = {
+	.name = "fastest"
+};
+
+/* Hold all supported implementations */
+static const blake3_ops_t *blake3_supp_impl[ARRAY_SIZE(blake3_all_impl)];
+static uint32_t blake3_supp_impl_cnt = 0;
+
+/* Select blake3 implementation */
+#define	IMPL_FASTEST	(UINT32_MAX)
+#define	IMPL_CYCLE	(UINT32_MAX - 1)
+
+#define	IMPL_READ(i)	(*(volatile uint32_t *) &(i))
+
+static uint32_t blake3_impl_chosen = IMPL_FASTEST;
+static uint32_t blake3_user_sel_impl = IMPL_FASTEST;
+
+static const struct {
+	const char	*name;
+	uint32_t	sel;
+} blake3_impl_opts[] = {
+	{ "cycle",	IMPL_CYCLE },
+	{ "fastest",	IMPL_FASTEST },
+};
+
+/* Indicate that benchmark has been completed */
+static boolean_t blake3_initialized = B_FALSE;
+
+#if defined(_KERNEL)
+static kstat_t *blake3_kstat;
+
+/* Throughput of every supported implementation, then the fastest one */
+static struct blake3_kstat {
+	uint64_t	bw;
+} blake3_stat_data[ARRAY_SIZE(blake3_all_impl) + 1];
+#endif
+
+/*
+ * Returns the implementation to hash with.  When SIMD instructions are
+ * not allowed in the current context fall back to the generic code.
+ */
+const blake3_ops_t *
+blake3_impl_get_ops(void)
+{
+	const blake3_ops_t *ops = NULL;
+	const uint32_t impl = IMPL_READ(blake3_impl_chosen);
+
+	if (!kfpu_allowed())
+		return (&blake3_generic_impl);
+
+	switch (impl) {
+	case IMPL_FASTEST:
+		ASSERT(blake3_initialized);
+		ops = &blake3_fastest_impl;
+		break;
+	case IMPL_CYCLE:
+		/* Cycle through supported implementations */
+		ASSERT(blake3_initialized);
+		ASSERT3U(blake3_supp_impl_cnt, >, 0);
+		static uint32_t cycle_impl_idx = 0;
+		uint32_t idx = (++cycle_impl_idx) % blake3_supp_impl_cnt;
+		ops = blake3_supp_impl[idx];
+		break;
+	default:
+		ASSERT3U(impl, <, blake3_supp_impl_cnt);
+		if (impl < blake3_supp_impl_cnt)
+			ops = blake3_supp_impl[impl];
+		break;
+	}
+
+	ASSERT3P(ops, !=, NULL);
+
+	return (ops);
+}
+
+#if defined(_KERNEL)
+/*
+ * BLAKE3 kstats
+ */
+static int
+blake3_kstat_headers(char *buf, size_t size)
+{
+	ssize_t off = 0;
+
+	off += snprintf(buf + off, size, "%-17s", "implementation");
+	(void) snprintf(buf + off, size - off, "%-15s\n", "bandwidth");
+
+	return (0);
+}
+
+static int
+blake3_kstat_data(char *buf, size_t size, void *data)
+{
+	struct blake3_kstat *fastest_stat =
+	    &blake3_stat_data[blake3_supp_impl_cnt];
+	struct blake3_kstat *curr_stat = (struct blake3_kstat *)data;
+	ssize_t off = 0;
+
+	if (curr_stat == fastest_stat) {
+		off += snprintf(buf + off, size - off, "%-17s", "fastest");
+		(void) snprintf(buf + off, size - off, "%-15s\n",
+		    blake3_supp_impl[fastest_stat->bw]->name);
+	} else {
+		ptrdiff_t id = curr_stat - blake3_stat_data;
+
+		off += snprintf(buf + off, size - off, "%-17s",
+		    blake3_supp_impl[id]->name);
+		(void) snprintf(buf + off, size - off, "%-15llu\n",
+		    (u_longlong_t)curr_stat->bw);
+	}
+
+	return (0);
+}
+
+static void *
+blake3_kstat_addr(kstat_t *ksp, loff_t n)
+{
+	if (n <= blake3_supp_impl_cnt)
+		ksp->ks_private = (void *) (blake3_stat_data + n);
+	else
+		ksp->ks_private = NULL;
+
+	return (ksp->ks_private);
+}
+
+#define	BLAKE3_BENCH_NS		(MSEC2NSEC(1))		/* 1ms */
+
+static void
+blake3_benchmark_impl(const uint8_t *data, size_t data_size)
+{
+	struct blake3_kstat *fastest_stat =
+	    &blake3_stat_data[blake3_supp_impl_cnt];
+	BLAKE3_CTX *ctx = kmem_alloc(sizeof (BLAKE3_CTX), KM_SLEEP);
+	uint8_t digest[BLAKE3_OUT_LEN];
+	uint64_t run_bw, run_time_ns, best_run = 0;
+	uint32_t i, l, sel_save = IMPL_READ(blake3_impl_chosen);
+	hrtime_t start;
+
+	for (i = 0; i < blake3_supp_impl_cnt; i++) {
+		struct blake3_kstat *stat = &blake3_stat_data[i];
+		uint64_t run_count = 0;
+
+		/* temporary set an implementation */
+		blake3_impl_chosen = i;
+
+		kpreempt_disable();
+		start = gethrtime();
+		do {
+			for (l = 0; l < 8; l++, run_count++) {
+				Blake3_Init(ctx);
+				Blake3_Update(ctx, data, data_size);
+				Blake3_Final(ctx, digest);
+			}
+
+			run_time_ns = gethrtime() - start;
+		} while (run_time_ns < BLAKE3_BENCH_NS);
+		kpreempt_enable();
+
+		run_bw = data_size * run_count * NANOSEC;
+		run_bw /= run_time_ns;	/* B/s */
+		stat->bw = run_bw;
+
+		if (run_bw > best_run) {
+			best_run = run_bw;
+			fastest_stat->bw = i;
+			memcpy(&blake3_fastest_impl, blake3_supp_impl[i],
+			    sizeof (blake3_fastest_impl));
+		}
+	}
+	blake3_fastest_impl.name = "fastest";
+
+	/* restore original selection */
+	atomic_swap_32(&blake3_impl_chosen, sel_save);
+	kmem_free(ctx, sizeof (BLAKE3_CTX));
+}
+#endif /* _KERNEL */
+
+/*
+ * Initialize and benchmark all supported implementations.
+ */
+void
+blake3_impl_init(void)
+{
+	const blake3_ops_t *curr_impl;
+	int i, c;
+
+	/* Move supported implementations into blake3_supp_impl */
+	for (i = 0, c = 0; i < ARRAY_SIZE(blake3_all_impl); i++) {
+		curr_impl = blake3_all_impl[i];
+
+		if (curr_impl->is_supported())
+			blake3_supp_impl[c++] = curr_impl;
+	}
+	membar_producer();	/* complete blake3_supp_impl[] init */
+	blake3_supp_impl_cnt = c;
+
+#if defined(_KERNEL)
+	static const size_t data_size = 1 << SPA_OLD_MAXBLOCKSHIFT; /* 128kiB */
+	uint8_t *databuf = vmem_alloc(data_size, KM_SLEEP);
+
+	for (i = 0; i < data_size / sizeof (uint64_t); i++)
+		((uint64_t *)databuf)[i] = (uintptr_t)(databuf+i); /* warm-up */
+
+	blake3_benchmark_impl(databuf, data_size);
+
+	vmem_free(databuf, data_size);
+
+	/* Install kstats for all implementations */
+	blake3_kstat = kstat_create("zfs", 0, "blake3_bench", "misc",
+	    KSTAT_TYPE_RAW, 0, KSTAT_FLAG_VIRTUAL);
+	if (blake3_kstat != NULL) {
+		blake3_kstat->ks_data = NULL;
+		blake3_kstat->ks_ndata = UINT32_MAX;
+		kstat_set_raw_ops(blake3_kstat,
+		    blake3_kstat_headers,
+		    blake3_kstat_data,
+		    blake3_kstat_addr);
+		kstat_install(blake3_kstat);
+	}
+#else
+	/*
+	 * Skip the benchmark in user space to avoid impacting libzpool
+	 * consumers (zdb, zhack, zinject, ztest).  The last implementation
+	 * is assumed to be the fastest and used by default.
+	 */
+	memcpy(&blake3_fastest_impl,
+	    blake3_supp_impl[blake3_supp_impl_cnt - 1],
+	    sizeof (blake3_fastest_impl));
+	blake3_fastest_impl.name = "fastest";
+	membar_producer();
+#endif /* _KERNEL */
+
+	/* Finish initialization */
+	atomic_swap_32(&blake3_impl_chosen, blake3_user_sel_impl);
+	blake3_initialized = B_TRUE;
+}
+
+void
+blake3_impl_fini(void)
+{
+#if defined(_KERNEL)
+	if (blake3_kstat != NULL) {
+		kstat_delete(blake3_kstat);
+		blake3_kstat = NULL;
+	}
+#endif
+}
+
+/*
+ * Function sets desired blake3 implementation.
+ *
+ * If we are called before init(), user preference will be saved in
+ * blake3_user_sel_impl, and applied in later init() call.  This occurs
+ * when module parameter is specified on module load.  Otherwise, directly
+ * update blake3_impl_chosen.
+ *
+ * @val		Name of blake3 implementation to use
+ */
+int
+blake3_impl_set(const char *val)
+{
+	int err = -EINVAL;
+	char req_name[16];
+	uint32_t impl = IMPL_READ(blake3_user_sel_impl);
+	size_t i;
+
+	/* sanitize input */
+	i = strnlen(val, sizeof (req_name));
+	if (i == 0 || i >= sizeof (req_name))
+		return (err);
+
+	strlcpy(req_name, val, sizeof (req_name));
+	while (i > 0 && isspace(req_name[i-1]))
+		i--;
+	req_name[i] = '\0';
+
+	/* Check mandatory options */
+	for (i = 0; i < ARRAY_SIZE(blake3_impl_opts); i++) {
+		if (strcmp(req_name, blake3_impl_opts[i].name) == 0) {
+			impl = blake3_impl_opts[i].sel;
+			err = 0;
+			break;
+		}
+	}
+
+	/* check all supported impl if init() was already called */
+	if (err != 0 && blake3_initialized) {
+		for (i = 0; i < blake3_supp_impl_cnt; i++) {
+			if (strcmp(req_name, blake3_supp_impl[i]->name) == 0) {
+				impl = i;
+				err = 0;
+				break;
+			}
+		}
+	}
+
+	if (err == 0) {
+		if (blake3_initialized)
+			atomic_swap_32(&blake3_impl_chosen, impl);
+		else
+			atomic_swap_32(&blake3_user_sel_impl, impl);
+	}
+
+	return (err);
+}
+
+/*
+ * Number of supported implementations, for blake3_impl_setid().
+ */
+uint32_t
+blake3_impl_getcnt(void)
+{
+	ASSERT(blake3_initialized);
+	return (blake3_supp_impl_cnt);
+}
+
+/*
+ * Select a supported implementation by index, used by the test suite to
+ * cross-check all of them.
+ */
+void
+blake3_impl_setid(uint32_t id)
+{
+	ASSERT(blake3_initialized);
+	ASSERT3U(id, <, blake3_supp_impl_cnt);
+	atomic_swap_32(&blake3_impl_chosen, id);
+}
+
+const char *
+blake3_impl_getname(void)
+{
+	return (blake3_impl_get_ops()->name);
+}
+
+#if defined(_KERNEL)
+
+#define	IMPL_FMT(impl, i)	(((impl) == (i)) ? "[%s] " : "%s ")
+
+#if defined(__linux__)
+
+static int
+blake3_param_get(char *buffer, zfs_kernel_param_t *unused)
+{
+	const uint32_t impl = IMPL_READ(blake3_impl_chosen);
+	char *fmt;
+	int cnt = 0;
+
+	/* list mandatory options */
+	for (uint32_t i = 0; i < ARRAY_SIZE(blake3_impl_opts); i++) {
+		fmt = IMPL_FMT(impl, blake3_impl_opts[i].sel);
+		cnt += sprintf(buffer + cnt, fmt, blake3_impl_opts[i].name);
+	}
+
+	/* list all supported implementations */
+	for (uint32_t i = 0; i < blake3_supp_impl_cnt; ++i) {
+		fmt = IMPL_FMT(impl, i);
+		cnt += sprintf(buffer + cnt, fmt, blake3_supp_impl[i]->name);
+	}
+
+	return (cnt);
+}
+
+static int
+blake3_param_set(const char *val, zfs_kernel_param_t *unused)
+{
+	return (blake3_impl_set(val));
+}
+
+#else
+
+#include <sys/sbuf.h>
+
+static int
+blake3_param(ZFS_MODULE_PARAM_ARGS)
+{
+	int err = 0;
+
+	if (req->newptr == NULL) {
+		const uint32_t impl = IMPL_READ(blake3_impl_chosen);
+		const int init_buflen = 64;
+		const char *fmt;
+		struct sbuf *s;
+
+		s = sbuf_new_for_sysctl(NULL, NULL, init_buflen, req);
+
+		/* list mandatory options */
+		for (uint32_t i = 0; i < ARRAY_SIZE(blake3_impl_opts); i++) {
+			fmt = IMPL_FMT(impl, blake3_impl_opts[i].sel);
+			(void) sbuf_printf(s, fmt, blake3_impl_opts[i].name);
+		}
+
+		/* list all supported implementations */
+		for (uint32_t i = 0; i < blake3_supp_impl_cnt; ++i) {
+			fmt = IMPL_FMT(impl, i);
+			(void) sbuf_printf(s, fmt, blake3_supp_impl[i]->name);
+		}
+
+#ifdef __APPLE__
+		err = SYSCTL_OUT(req, s->s_buf, s->s_len);
+		sbuf_finish(s);
+#else
+		err = sbuf_finish(s);
+#endif
+		sbuf_delete(s);
+		return (err);
+	}
+
+	char buf[16];
+
+	err = sysctl_handle_string(oidp, buf, sizeof (buf), req);
+	if (err)
+		return (err);
+	return (-blake3_impl_set(buf));
+}
+
+#endif
+
+#undef IMPL_FMT
+
+/*
+ * Choose a BLAKE3 implementation in ZFS.
+ * Users can choose "cycle" to exercise all implementations, but this is
+ * for testing purpose therefore it can only be set in user space.
+ */
+/* BEGIN CSTYLED */
+ZFS_MODULE_VIRTUAL_PARAM_CALL(zfs, zfs_, blake3_impl,
+	blake3_param_set, blake3_param_get, ZMOD_RW,
+	"Select BLAKE3 implementation.");
+/* END CSTYLED */
+#endif /* _KERNEL */
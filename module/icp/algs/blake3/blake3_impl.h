@@ -0,0 +1,136 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+#ifndef	_BLAKE3_IMPL_H
+#define	_BLAKE3_IMPL_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include <sys/types.h>
+#include <sys/blake3.h>
+
+/* Domain separation flags, one per compression function call. */
+enum blake3_flags {
+	BLAKE3_CHUNK_START		= 1 << 0,
+	BLAKE3_CHUNK_END		= 1 << 1,
+	BLAKE3_PARENT			= 1 << 2,
+	BLAKE3_ROOT			= 1 << 3,
+	BLAKE3_KEYED_HASH		= 1 << 4,
+	BLAKE3_DERIVE_KEY_CONTEXT	= 1 << 5,
+	BLAKE3_DERIVE_KEY_MATERIAL	= 1 << 6,
+};
+
+/* Most inputs any implementation hashes in parallel. */
+#define	BLAKE3_MAX_SIMD_DEGREE		16
+
+typedef void (*blake3_compress_in_place_f)(uint32_t cv[8],
+    const uint8_t block[BLAKE3_BLOCK_LEN], uint8_t block_len,
+    uint64_t counter, uint8_t flags);
+
+typedef void (*blake3_compress_xof_f)(const uint32_t cv[8],
+    const uint8_t block[BLAKE3_BLOCK_LEN], uint8_t block_len,
+    uint64_t counter, uint8_t flags, uint8_t out[64]);
+
+/*
+ * Hash num_inputs inputs of blocks whole blocks each and store their
+ * chaining values one after the other in out.  Input i uses counter + i
+ * if increment_counter is set, and counter otherwise.
+ */
+typedef void (*blake3_hash_many_f)(const uint8_t * const *inputs,
+    size_t num_inputs, size_t blocks, const uint32_t key[8],
+    uint64_t counter, boolean_t increment_counter, uint8_t flags,
+    uint8_t flags_start, uint8_t flags_end, uint8_t *out);
+
+typedef boolean_t (*blake3_is_supported_f)(void);
+
+typedef struct blake3_ops {
+	blake3_compress_in_place_f	compress_in_place;
+	blake3_compress_xof_f		compress_xof;
+	blake3_hash_many_f		hash_many;
+	blake3_is_supported_f		is_supported;
+	int				degree;
+	const char			*name;
+} blake3_ops_t;
+
+extern const uint32_t blake3_iv[8];
+extern const uint8_t blake3_msg_schedule[7][16];
+
+extern const blake3_ops_t blake3_generic_impl;
+#if defined(__x86_64)
+#if defined(HAVE_SSE4_1)
+extern const blake3_ops_t blake3_sse41_impl;
+#endif
+#if defined(HAVE_AVX2)
+extern const blake3_ops_t blake3_avx2_impl;
+#endif
+#if defined(HAVE_AVX512F)
+extern const blake3_ops_t blake3_avx512_impl;
+#endif
+#endif
+
+extern const blake3_ops_t *blake3_impl_get_ops(void);
+
+extern void blake3_generic_compress_in_place(uint32_t cv[8],
+    const uint8_t block[BLAKE3_BLOCK_LEN], uint8_t block_len,
+    uint64_t counter, uint8_t flags);
+extern void blake3_generic_compress_xof(const uint32_t cv[8],
+    const uint8_t block[BLAKE3_BLOCK_LEN], uint8_t block_len,
+    uint64_t counter, uint8_t flags, uint8_t out[64]);
+extern void blake3_generic_hash_many(const uint8_t * const *inputs,
+    size_t num_inputs, size_t blocks, const uint32_t key[8],
+    uint64_t counter, boolean_t increment_counter, uint8_t flags,
+    uint8_t flags_start, uint8_t flags_end, uint8_t *out);
+
+static inline uint32_t
+blake3_load32(const void *src)
+{
+	const uint8_t *p = (const uint8_t *)src;
+
+	return ((uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+	    ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24));
+}
+
+static inline void
+blake3_store32(void *dst, uint32_t w)
+{
+	uint8_t *p = (uint8_t *)dst;
+
+	p[0] = (uint8_t)w;
+	p[1] = (uint8_t)(w >> 8);
+	p[2] = (uint8_t)(w >> 16);
+	p[3] = (uint8_t)(w >> 24);
+}
+
+static inline void
+blake3_store_cv_words(uint8_t bytes_out[BLAKE3_OUT_LEN],
+    const uint32_t cv_words[8])
+{
+	for (int i = 0; i < 8; i++)
+		blake3_store32(&bytes_out[4 * i], cv_words[i]);
+}
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* _BLAKE3_IMPL_H */
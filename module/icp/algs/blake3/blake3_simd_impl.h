@@ -0,0 +1,179 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Template for the SIMD BLAKE3 implementations.  Each lane of a vector
+ * hashes a different input, so BLAKE3_SIMD_LANES chunks (or parent nodes)
+ * are compressed at once, one 32-bit state word per vector.  Including
+ * files define:
+ *
+ *	BLAKE3_SIMD_LANES	number of 32-bit lanes per vector
+ *	BLAKE3_SIMD_TARGET	target attribute enabling the instruction set
+ *	BLAKE3_SIMD_IMPL	name of the resulting blake3_ops_t
+ *	BLAKE3_SIMD_NAME	implementation name shown to users
+ *	BLAKE3_SIMD_SUPPORTED	expression telling if the CPU supports it
+ *
+ * Single blocks, i.e. the partial chunks and the root, are compressed
+ * with the generic code.
+ */
+
+#ifndef	_BLAKE3_SIMD_IMPL_H
+#define	_BLAKE3_SIMD_IMPL_H
+
+#include <sys/zfs_context.h>
+#include <sys/simd.h>
+#include "blake3_impl.h"
+
+#define	SIMD_FN(fn)		SIMD_FN_(BLAKE3_SIMD_IMPL, fn)
+#define	SIMD_FN_(impl, fn)	SIMD_FN__(impl, fn)
+#define	SIMD_FN__(impl, fn)	impl ## _ ## fn
+
+typedef uint32_t v_t __attribute__((vector_size(4 * BLAKE3_SIMD_LANES)));
+
+#define	V_ROTR(x, c)	(((x) >> (c)) | ((x) << (32 - (c))))
+
+#define	V_G(v, a, b, c, d, x, y)				\
+{								\
+	v[a] = v[a] + v[b] + (x);				\
+	v[d] = V_ROTR(v[d] ^ v[a], 16);				\
+	v[c] = v[c] + v[d];					\
+	v[b] = V_ROTR(v[b] ^ v[c], 12);				\
+	v[a] = v[a] + v[b] + (y);				\
+	v[d] = V_ROTR(v[d] ^ v[a], 8);				\
+	v[c] = v[c] + v[d];					\
+	v[b] = V_ROTR(v[b] ^ v[c], 7);				\
+}
+
+/*
+ * Hash BLAKE3_SIMD_LANES inputs of blocks blocks each, see
+ * blake3_hash_many_f.
+ */
+static void
+BLAKE3_SIMD_TARGET
+SIMD_FN(hash_lanes)(const uint8_t * const *inputs, size_t blocks,
+    const uint32_t key[8], uint64_t counter, boolean_t increment_counter,
+    uint8_t flags, uint8_t flags_start, uint8_t flags_end, uint8_t *out)
+{
+	const v_t zero = { 0 };
+	v_t h[8], m[16], v[16], ctr_lo, ctr_hi;
+	uint8_t block_flags = flags | flags_start;
+
+	for (int i = 0; i < 8; i++)
+		h[i] = zero + key[i];
+
+	for (int l = 0; l < BLAKE3_SIMD_LANES; l++) {
+		uint64_t c = counter + (increment_counter ? l : 0);
+
+		ctr_lo[l] = (uint32_t)c;
+		ctr_hi[l] = (uint32_t)(c >> 32);
+	}
+
+	for (size_t b = 0; b < blocks; b++) {
+		const size_t off = b * BLAKE3_BLOCK_LEN;
+
+		if (b + 1 == blocks)
+			block_flags |= flags_end;
+
+		/* Transpose the next block of every input into m. */
+		for (int l = 0; l < BLAKE3_SIMD_LANES; l++) {
+			const uint8_t *in = inputs[l] + off;
+
+			for (int w = 0; w < 16; w++)
+				m[w][l] = blake3_load32(in + 4 * w);
+		}
+
+		for (int i = 0; i < 8; i++)
+			v[i] = h[i];
+		for (int i = 0; i < 4; i++)
+			v[8 + i] = zero + blake3_iv[i];
+		v[12] = ctr_lo;
+		v[13] = ctr_hi;
+		v[14] = zero + BLAKE3_BLOCK_LEN;
+		v[15] = zero + block_flags;
+
+		for (int r = 0; r < 7; r++) {
+			const uint8_t *s = blake3_msg_schedule[r];
+
+			V_G(v, 0, 4, 8, 12, m[s[0]], m[s[1]]);
+			V_G(v, 1, 5, 9, 13, m[s[2]], m[s[3]]);
+			V_G(v, 2, 6, 10, 14, m[s[4]], m[s[5]]);
+			V_G(v, 3, 7, 11, 15, m[s[6]], m[s[7]]);
+			V_G(v, 0, 5, 10, 15, m[s[8]], m[s[9]]);
+			V_G(v, 1, 6, 11, 12, m[s[10]], m[s[11]]);
+			V_G(v, 2, 7, 8, 13, m[s[12]], m[s[13]]);
+			V_G(v, 3, 4, 9, 14, m[s[14]], m[s[15]]);
+		}
+
+		for (int i = 0; i < 8; i++)
+			h[i] = v[i] ^ v[i + 8];
+		block_flags = flags;
+	}
+
+	for (int l = 0; l < BLAKE3_SIMD_LANES; l++) {
+		for (int i = 0; i < 8; i++) {
+			blake3_store32(&out[l * BLAKE3_OUT_LEN + 4 * i],
+			    h[i][l]);
+		}
+	}
+}
+
+static void
+SIMD_FN(hash_many)(const uint8_t * const *inputs, size_t num_inputs,
+    size_t blocks, const uint32_t key[8], uint64_t counter,
+    boolean_t increment_counter, uint8_t flags, uint8_t flags_start,
+    uint8_t flags_end, uint8_t *out)
+{
+	if (num_inputs >= BLAKE3_SIMD_LANES) {
+		kfpu_begin();
+		do {
+			SIMD_FN(hash_lanes)(inputs, blocks, key, counter,
+			    increment_counter, flags, flags_start, flags_end,
+			    out);
+			if (increment_counter)
+				counter += BLAKE3_SIMD_LANES;
+			inputs += BLAKE3_SIMD_LANES;
+			num_inputs -= BLAKE3_SIMD_LANES;
+			out = &out[BLAKE3_SIMD_LANES * BLAKE3_OUT_LEN];
+		} while (num_inputs >= BLAKE3_SIMD_LANES);
+		kfpu_end();
+	}
+
+	/* Fewer inputs than lanes are left, hash them one at a time. */
+	blake3_generic_hash_many(inputs, num_inputs, blocks, key, counter,
+	    increment_counter, flags, flags_start, flags_end, out);
+}
+
+static boolean_t
+SIMD_FN(is_supported)(void)
+{
+	return (kfpu_allowed() && (BLAKE3_SIMD_SUPPORTED));
+}
+
+const blake3_ops_t BLAKE3_SIMD_IMPL = {
+	.compress_in_place = blake3_generic_compress_in_place,
+	.compress_xof = blake3_generic_compress_xof,
+	.hash_many = SIMD_FN(hash_many),
+	.is_supported = SIMD_FN(is_supported),
+	.degree = BLAKE3_SIMD_LANES,
+	.name = BLAKE3_SIMD_NAME
+};
+
+#endif	/* _BLAKE3_SIMD_IMPL_H */
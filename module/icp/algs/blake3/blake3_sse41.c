@@ -0,0 +1,34 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+#include <sys/isa_defs.h>
+
+#if defined(__x86_64) && defined(HAVE_SSE4_1)
+
+#define	BLAKE3_SIMD_LANES	4
+#define	BLAKE3_SIMD_TARGET	__attribute__((target("sse4.1")))
+#define	BLAKE3_SIMD_IMPL	blake3_sse41_impl
+#define	BLAKE3_SIMD_NAME	"sse41"
+#define	BLAKE3_SIMD_SUPPORTED	zfs_sse4_1_available()
+
+#include "blake3_simd_impl.h"
+
+#endif /* defined(__x86_64) && defined(HAVE_SSE4_1) */
@@ -40,6 +40,7 @@
 #define	_SHA2_IMPL
 #include <sys/sha2.h>
 #include <sha2/sha2_consts.h>
+#include <sha2/sha2_impl.h>
 
 #define	_RESTRICT_KYWD
 
@@ -52,21 +53,74 @@
 static void Encode(uint8_t *, uint32_t *, size_t);
 static void Encode64(uint8_t *, uint64_t *, size_t);
 
-/* userspace only supports the generic version */
-#if	defined(__amd64) && defined(_KERNEL)
-#define	SHA512Transform(ctx, in) SHA512TransformBlocks((ctx), (in), 1)
-#define	SHA256Transform(ctx, in) SHA256TransformBlocks((ctx), (in), 1)
-
-void SHA512TransformBlocks(SHA2_CTX *ctx, const void *in, size_t num);
-void SHA256TransformBlocks(SHA2_CTX *ctx, const void *in, size_t num);
-
-#else
 static void SHA256Transform(SHA2_CTX *, const uint8_t *);
 static void SHA512Transform(SHA2_CTX *, const uint8_t *);
-#endif	/* __amd64 && _KERNEL */
 
 static uint8_t PADDING[128] = { 0x80, /* all zeros */ };
 
+/* Round constants for the implementations in other files */
+const uint32_t sha256_k[64] __attribute__((aligned(16))) = {
+	SHA256_CONST_0, SHA256_CONST_1, SHA256_CONST_2, SHA256_CONST_3,
+	SHA256_CONST_4, SHA256_CONST_5, SHA256_CONST_6, SHA256_CONST_7,
+	SHA256_CONST_8, SHA256_CONST_9, SHA256_CONST_10, SHA256_CONST_11,
+	SHA256_CONST_12, SHA256_CONST_13, SHA256_CONST_14, SHA256_CONST_15,
+	SHA256_CONST_16, SHA256_CONST_17, SHA256_CONST_18, SHA256_CONST_19,
+	SHA256_CONST_20, SHA256_CONST_21, SHA256_CONST_22, SHA256_CONST_23,
+	SHA256_CONST_24, SHA256_CONST_25, SHA256_CONST_26, SHA256_CONST_27,
+	SHA256_CONST_28, SHA256_CONST_29, SHA256_CONST_30, SHA256_CONST_31,
+	SHA256_CONST_32, SHA256_CONST_33, SHA256_CONST_34, SHA256_CONST_35,
+	SHA256_CONST_36, SHA256_CONST_37, SHA256_CONST_38, SHA256_CONST_39,
+	SHA256_CONST_40, SHA256_CONST_41, SHA256_CONST_42, SHA256_CONST_43,
+	SHA256_CONST_44, SHA256_CONST_45, SHA256_CONST_46, SHA256_CONST_47,
+	SHA256_CONST_48, SHA256_CONST_49, SHA256_CONST_50, SHA256_CONST_51,
+	SHA256_CONST_52, SHA256_CONST_53, SHA256_CONST_54, SHA256_CONST_55,
+	SHA256_CONST_56, SHA256_CONST_57, SHA256_CONST_58, SHA256_CONST_59,
+	SHA256_CONST_60, SHA256_CONST_61, SHA256_CONST_62, SHA256_CONST_63
+};
+
+const uint64_t sha512_k[80] __attribute__((aligned(16))) = {
+	SHA512_CONST_0, SHA512_CONST_1,
+	SHA512_CONST_2, SHA512_CONST_3,
+	SHA512_CONST_4, SHA512_CONST_5,
+	SHA512_CONST_6, SHA512_CONST_7,
+	SHA512_CONST_8, SHA512_CONST_9,
+	SHA512_CONST_10, SHA512_CONST_11,
+	SHA512_CONST_12, SHA512_CONST_13,
+	SHA512_CONST_14, SHA512_CONST_15,
+	SHA512_CONST_16, SHA512_CONST_17,
+	SHA512_CONST_18, SHA512_CONST_19,
+	SHA512_CONST_20, SHA512_CONST_21,
+	SHA512_CONST_22, SHA512_CONST_23,
+	SHA512_CONST_24, SHA512_CONST_25,
+	SHA512_CONST_26, SHA512_CONST_27,
+	SHA512_CONST_28, SHA512_CONST_29,
+	SHA512_CONST_30, SHA512_CONST_31,
+	SHA512_CONST_32, SHA512_CONST_33,
+	SHA512_CONST_34, SHA512_CONST_35,
+	SHA512_CONST_36, SHA512_CONST_37,
+	SHA512_CONST_38, SHA512_CONST_39,
+	SHA512_CONST_40, SHA512_CONST_41,
+	SHA512_CONST_42, SHA512_CONST_43,
+	SHA512_CONST_44, SHA512_CONST_45,
+	SHA512_CONST_46, SHA512_CONST_47,
+	SHA512_CONST_48, SHA512_CONST_49,
+	SHA512_CONST_50, SHA512_CONST_51,
+	SHA512_CONST_52, SHA512_CONST_53,
+	SHA512_CONST_54, SHA512_CONST_55,
+	SHA512_CONST_56, SHA512_CONST_57,
+	SHA512_CONST_58, SHA512_CONST_59,
+	SHA512_CONST_60, SHA512_CONST_61,
+	SHA512_CONST_62, SHA512_CONST_63,
+	SHA512_CONST_64, SHA512_CONST_65,
+	SHA512_CONST_66, SHA512_CONST_67,
+	SHA512_CONST_68, SHA512_CONST_69,
+	SHA512_CONST_70, SHA512_CONST_71,
+	SHA512_CONST_72, SHA512_CONST_73,
+	SHA512_CONST_74, SHA512_CONST_75,
+	SHA512_CONST_76, SHA512_CONST_77,
+	SHA512_CONST_78, SHA512_CONST_79
+};
+
 /*
  * The low-level checksum routines use a lot of stack space. On systems where
  * small stacks are enforced (like 32-bit kernel builds), insert compiler memory
@@ -143,7 +197,6 @@ static uint8_t PADDING[128] = { 0x80, /* all zeros */ };
 #endif	/* _BIG_ENDIAN */
 
 
-#if	!defined(__amd64) || !defined(_KERNEL)
 /* SHA256 Transform */
 
 static void
@@ -601,7 +654,46 @@ SHA512Transform(SHA2_CTX *ctx, const uint8_t *blk)
 	ctx->state.s64[7] += h;
 
 }
-#endif	/* !__amd64 || !_KERNEL */
+
+/*
+ * Generic implementations, transforming one block at a time with the
+ * portable code above.
+ */
+static void
+sha256_generic_transform(SHA2_CTX *ctx, const void *in, size_t num)
+{
+	const uint8_t *blk = in;
+
+	for (; num > 0; num--, blk += 64)
+		SHA256Transform(ctx, blk);
+}
+
+static void
+sha512_generic_transform(SHA2_CTX *ctx, const void *in, size_t num)
+{
+	const uint8_t *blk = in;
+
+	for (; num > 0; num--, blk += 128)
+		SHA512Transform(ctx, blk);
+}
+
+static boolean_t
+sha2_generic_will_work(void)
+{
+	return (B_TRUE);
+}
+
+const sha2_impl_ops_t sha256_generic_impl = {
+	.transform = &sha256_generic_transform,
+	.is_supported = &sha2_generic_will_work,
+	.name = "generic"
+};
+
+const sha2_impl_ops_t sha512_generic_impl = {
+	.transform = &sha512_generic_transform,
+	.is_supported = &sha2_generic_will_work,
+	.name = "generic"
+};
 
 
 /*
@@ -782,8 +874,10 @@ void
 SHA2Update(SHA2_CTX *ctx, const void *inptr, size_t input_len)
 {
 	uint32_t	i, buf_index, buf_len, buf_limit;
+	size_t		block_count;
 	const uint8_t	*input = inptr;
 	uint32_t	algotype = ctx->algotype;
+	const sha2_impl_ops_t *ops;
 
 	/* check for noop */
 	if (input_len == 0)
@@ -819,6 +913,7 @@ SHA2Update(SHA2_CTX *ctx, const void *inptr, size_t input_len)
 	/* transform as many times as possible */
 	i = 0;
 	if (input_len >= buf_len) {
+		ops = sha2_impl_get_ops(algotype);
 
 		/*
 		 * general optimization:
@@ -831,43 +926,16 @@ SHA2Update(SHA2_CTX *ctx, const void *inptr, size_t input_len)
 		 */
 		if (buf_index) {
 			bcopy(input, &ctx->buf_un.buf8[buf_index], buf_len);
-			if (algotype <= SHA256_HMAC_GEN_MECH_INFO_TYPE)
-				SHA256Transform(ctx, ctx->buf_un.buf8);
-			else
-				SHA512Transform(ctx, ctx->buf_un.buf8);
+			ops->transform(ctx, ctx->buf_un.buf8, 1);
 
 			i = buf_len;
 		}
 
-#if !defined(__amd64) || !defined(_KERNEL)
-		if (algotype <= SHA256_HMAC_GEN_MECH_INFO_TYPE) {
-			for (; i + buf_limit - 1 < input_len; i += buf_limit) {
-				SHA256Transform(ctx, &input[i]);
-			}
-		} else {
-			for (; i + buf_limit - 1 < input_len; i += buf_limit) {
-				SHA512Transform(ctx, &input[i]);
-			}
-		}
-
-#else
-		uint32_t block_count;
-		if (algotype <= SHA256_HMAC_GEN_MECH_INFO_TYPE) {
-			block_count = (input_len - i) >> 6;
-			if (block_count > 0) {
-				SHA256TransformBlocks(ctx, &input[i],
-				    block_count);
-				i += block_count << 6;
-			}
-		} else {
-			block_count = (input_len - i) >> 7;
-			if (block_count > 0) {
-				SHA512TransformBlocks(ctx, &input[i],
-				    block_count);
-				i += block_count << 7;
-			}
+		block_count = (input_len - i) / buf_limit;
+		if (block_count > 0) {
+			ops->transform(ctx, &input[i], block_count);
+			i += block_count * buf_limit;
 		}
-#endif	/* !__amd64 || !_KERNEL */
 
 		/*
 		 * general optimization:
@@ -0,0 +1,169 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+#if defined(__x86_64) && defined(HAVE_SHA_NI)
+
+#include <sys/zfs_context.h>
+#include <sys/simd.h>
+#define	_SHA2_IMPL
+#include <sys/sha2.h>
+#include <sha2/sha2_impl.h>
+
+/*
+ * SHA-256 using the Intel SHA extensions.  The state is kept in two
+ * registers in the ABEF/CDGH layout sha256rnds2 expects, every
+ * sha256rnds2 does two rounds with the message words plus constants in
+ * %xmm0, and sha256msg1/sha256msg2 compute the message schedule four words
+ * at a time.
+ *
+ * Register use:
+ *	%xmm0		message words plus round constants
+ *	%xmm1, %xmm2	state, ABEF and CDGH
+ *	%xmm3-%xmm6	message schedule, four words each
+ *	%xmm7		temporary
+ *	%xmm8		byte swap mask
+ *	%xmm9, %xmm10	state at the start of the block
+ */
+
+static const uint8_t sha256_shani_bswap[16] __attribute__((aligned(16))) = {
+	3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12
+};
+
+/* Load message words 4 * i to 4 * i + 3 into %xmm<m> */
+#define	SHANI_LOAD(i, m)						\
+	"movdqu " #i "*16(%[in]), %%xmm" #m "\n\t"			\
+	"pshufb %%xmm8, %%xmm" #m "\n\t"
+
+/* Rounds 4 * i to 4 * i + 3 using the message words in %xmm<m> */
+#define	SHANI_ROUNDS(i, m)						\
+	"movdqa %%xmm" #m ", %%xmm0\n\t"				\
+	"paddd " #i "*16(%[k]), %%xmm0\n\t"				\
+	"sha256rnds2 %%xmm1, %%xmm2\n\t"				\
+	"pshufd $0x0e, %%xmm0, %%xmm0\n\t"				\
+	"sha256rnds2 %%xmm2, %%xmm1\n\t"
+
+/* Finish the words in %xmm<n> from %xmm<m> and the preceding %xmm<p> */
+#define	SHANI_MSG2(m, p, n)						\
+	"movdqa %%xmm" #m ", %%xmm7\n\t"				\
+	"palignr $4, %%xmm" #p ", %%xmm7\n\t"				\
+	"paddd %%xmm7, %%xmm" #n "\n\t"					\
+	"sha256msg2 %%xmm" #m ", %%xmm" #n "\n\t"
+
+/* Start the words in %xmm<p> from it and the following %xmm<m> */
+#define	SHANI_MSG1(m, p)						\
+	"sha256msg1 %%xmm" #m ", %%xmm" #p "\n\t"
+
+static void
+sha256_shani_transform(SHA2_CTX *ctx, const void *in, size_t num)
+{
+	kfpu_begin();
+	__asm__ __volatile__(
+	    "movdqu 0*16(%[st]), %%xmm1\n\t"
+	    "movdqu 1*16(%[st]), %%xmm2\n\t"
+	    "movdqa (%[bswap]), %%xmm8\n\t"
+	    "pshufd $0xb1, %%xmm1, %%xmm1\n\t"	/* CDAB */
+	    "pshufd $0x1b, %%xmm2, %%xmm2\n\t"	/* EFGH */
+	    "movdqa %%xmm1, %%xmm7\n\t"
+	    "palignr $8, %%xmm2, %%xmm1\n\t"	/* ABEF */
+	    "pblendw $0xf0, %%xmm7, %%xmm2\n\t"	/* CDGH */
+
+	    "1:\n\t"
+	    "movdqa %%xmm1, %%xmm9\n\t"
+	    "movdqa %%xmm2, %%xmm10\n\t"
+	    SHANI_LOAD(0, 3)
+	    SHANI_ROUNDS(0, 3)
+	    SHANI_LOAD(1, 4)
+	    SHANI_ROUNDS(1, 4)
+	    SHANI_MSG1(4, 3)
+	    SHANI_LOAD(2, 5)
+	    SHANI_ROUNDS(2, 5)
+	    SHANI_MSG1(5, 4)
+	    SHANI_LOAD(3, 6)
+	    SHANI_ROUNDS(3, 6)
+	    SHANI_MSG2(6, 5, 3)
+	    SHANI_MSG1(6, 5)
+	    SHANI_ROUNDS(4, 3)
+	    SHANI_MSG2(3, 6, 4)
+	    SHANI_MSG1(3, 6)
+	    SHANI_ROUNDS(5, 4)
+	    SHANI_MSG2(4, 3, 5)
+	    SHANI_MSG1(4, 3)
+	    SHANI_ROUNDS(6, 5)
+	    SHANI_MSG2(5, 4, 6)
+	    SHANI_MSG1(5, 4)
+	    SHANI_ROUNDS(7, 6)
+	    SHANI_MSG2(6, 5, 3)
+	    SHANI_MSG1(6, 5)
+	    SHANI_ROUNDS(8, 3)
+	    SHANI_MSG2(3, 6, 4)
+	    SHANI_MSG1(3, 6)
+	    SHANI_ROUNDS(9, 4)
+	    SHANI_MSG2(4, 3, 5)
+	    SHANI_MSG1(4, 3)
+	    SHANI_ROUNDS(10, 5)
+	    SHANI_MSG2(5, 4, 6)
+	    SHANI_MSG1(5, 4)
+	    SHANI_ROUNDS(11, 6)
+	    SHANI_MSG2(6, 5, 3)
+	    SHANI_MSG1(6, 5)
+	    SHANI_ROUNDS(12, 3)
+	    SHANI_MSG2(3, 6, 4)
+	    SHANI_MSG1(3, 6)
+	    SHANI_ROUNDS(13, 4)
+	    SHANI_MSG2(4, 3, 5)
+	    SHANI_ROUNDS(14, 5)
+	    SHANI_MSG2(5, 4, 6)
+	    SHANI_ROUNDS(15, 6)
+	    "paddd %%xmm9, %%xmm1\n\t"
+	    "paddd %%xmm10, %%xmm2\n\t"
+	    "add $64, %[in]\n\t"
+	    "dec %[num]\n\t"
+	    "jnz 1b\n\t"
+
+	    "pshufd $0x1b, %%xmm1, %%xmm1\n\t"	/* FEBA */
+	    "pshufd $0xb1, %%xmm2, %%xmm2\n\t"	/* DCHG */
+	    "movdqa %%xmm1, %%xmm7\n\t"
+	    "pblendw $0xf0, %%xmm2, %%xmm1\n\t"	/* DCBA */
+	    "palignr $8, %%xmm7, %%xmm2\n\t"	/* HGFE */
+	    "movdqu %%xmm1, 0*16(%[st])\n\t"
+	    "movdqu %%xmm2, 1*16(%[st])\n\t"
+	    : [in] "+r" (in), [num] "+r" (num)
+	    : [st] "r" (ctx->state.s32), [k] "r" (sha256_k),
+	    [bswap] "r" (sha256_shani_bswap)
+	    : "cc", "memory", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5",
+	    "xmm6", "xmm7", "xmm8", "xmm9", "xmm10");
+	kfpu_end();
+}
+
+static boolean_t
+sha256_shani_will_work(void)
+{
+	return (kfpu_allowed() && zfs_sha_ni_available() &&
+	    zfs_sse4_1_available());
+}
+
+const sha2_impl_ops_t sha256_shani_impl = {
+	.transform = &sha256_shani_transform,
+	.is_supported = &sha256_shani_will_work,
+	.name = "shani"
+};
+
+#endif /* defined(__x86_64) && defined(HAVE_SHA_NI) */
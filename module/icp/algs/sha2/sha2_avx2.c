@@ -0,0 +1,253 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+#if defined(__x86_64) && defined(HAVE_AVX2)
+
+#include <sys/zfs_context.h>
+#include <sys/simd.h>
+#define	_SHA2_IMPL
+#include <sys/sha2.h>
+#include <sha2/sha2_impl.h>
+
+/*
+ * The message schedule of a block only depends on the block itself, so it
+ * is computed with AVX2 for several consecutive blocks at once, one block
+ * per vector lane.  The rounds are inherently serial and run for each
+ * block in turn on general purpose registers, using the BMI2 rotates.
+ * Fewer blocks than lanes are left to the x86_64 assembly.
+ */
+
+#define	SHA2_AVX2_TARGET	__attribute__((target("avx2,bmi2")))
+
+#define	SHA256_AVX2_LANES	8
+#define	SHA512_AVX2_LANES	4
+
+typedef uint32_t v256_t __attribute__((vector_size(4 * SHA256_AVX2_LANES)));
+typedef uint64_t v512_t __attribute__((vector_size(8 * SHA512_AVX2_LANES)));
+
+#define	ROTR32(x, n)	(((x) >> (n)) | ((x) << (32 - (n))))
+#define	ROTR64(x, n)	(((x) >> (n)) | ((x) << (64 - (n))))
+
+#define	CH(e, f, g)	(((e) & (f)) ^ (~(e) & (g)))
+#define	MAJ(a, b, c)	(((a) & (b)) ^ ((a) & (c)) ^ ((b) & (c)))
+
+#define	SIGMA0_256(x)	(ROTR32(x, 7) ^ ROTR32(x, 18) ^ ((x) >> 3))
+#define	SIGMA1_256(x)	(ROTR32(x, 17) ^ ROTR32(x, 19) ^ ((x) >> 10))
+#define	BSIGMA0_256(x)	(ROTR32(x, 2) ^ ROTR32(x, 13) ^ ROTR32(x, 22))
+#define	BSIGMA1_256(x)	(ROTR32(x, 6) ^ ROTR32(x, 11) ^ ROTR32(x, 25))
+
+#define	SIGMA0_512(x)	(ROTR64(x, 1) ^ ROTR64(x, 8) ^ ((x) >> 7))
+#define	SIGMA1_512(x)	(ROTR64(x, 19) ^ ROTR64(x, 61) ^ ((x) >> 6))
+#define	BSIGMA0_512(x)	(ROTR64(x, 28) ^ ROTR64(x, 34) ^ ROTR64(x, 39))
+#define	BSIGMA1_512(x)	(ROTR64(x, 14) ^ ROTR64(x, 18) ^ ROTR64(x, 41))
+
+/* One round, wk being the message word plus the round constant */
+#define	SHA256_ROUND(a, b, c, d, e, f, g, h, wk)			\
+{									\
+	uint32_t t1 = h + BSIGMA1_256(e) + CH(e, f, g) + (wk);		\
+	d += t1;							\
+	h = t1 + BSIGMA0_256(a) + MAJ(a, b, c);				\
+}
+
+#define	SHA512_ROUND(a, b, c, d, e, f, g, h, wk)			\
+{									\
+	uint64_t t1 = h + BSIGMA1_512(e) + CH(e, f, g) + (wk);		\
+	d += t1;							\
+	h = t1 + BSIGMA0_512(a) + MAJ(a, b, c);				\
+}
+
+static inline uint32_t
+load_be32(const uint8_t *p)
+{
+	return (((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+	    ((uint32_t)p[2] << 8) | (uint32_t)p[3]);
+}
+
+static inline uint64_t
+load_be64(const uint8_t *p)
+{
+	return (((uint64_t)load_be32(p) << 32) | load_be32(p + 4));
+}
+
+/*
+ * Message schedules of SHA256_AVX2_LANES blocks, plus the round constants.
+ */
+static void
+SHA2_AVX2_TARGET
+sha256_avx2_schedule(const uint8_t *in, v256_t wk[64])
+{
+	const v256_t zero = { 0 };
+	int t;
+
+	for (int l = 0; l < SHA256_AVX2_LANES; l++) {
+		for (t = 0; t < 16; t++)
+			wk[t][l] = load_be32(in + l * 64 + 4 * t);
+	}
+	for (t = 16; t < 64; t++) {
+		wk[t] = SIGMA1_256(wk[t - 2]) + wk[t - 7] +
+		    SIGMA0_256(wk[t - 15]) + wk[t - 16];
+	}
+	for (t = 0; t < 64; t++)
+		wk[t] += zero + sha256_k[t];
+}
+
+static void
+SHA2_AVX2_TARGET
+sha256_avx2_rounds(uint32_t state[8], const v256_t wk[64], int l)
+{
+	uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+	uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+	for (int t = 0; t < 64; t += 8) {
+		SHA256_ROUND(a, b, c, d, e, f, g, h, wk[t][l]);
+		SHA256_ROUND(h, a, b, c, d, e, f, g, wk[t + 1][l]);
+		SHA256_ROUND(g, h, a, b, c, d, e, f, wk[t + 2][l]);
+		SHA256_ROUND(f, g, h, a, b, c, d, e, wk[t + 3][l]);
+		SHA256_ROUND(e, f, g, h, a, b, c, d, wk[t + 4][l]);
+		SHA256_ROUND(d, e, f, g, h, a, b, c, wk[t + 5][l]);
+		SHA256_ROUND(c, d, e, f, g, h, a, b, wk[t + 6][l]);
+		SHA256_ROUND(b, c, d, e, f, g, h, a, wk[t + 7][l]);
+	}
+
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+	state[4] += e;
+	state[5] += f;
+	state[6] += g;
+	state[7] += h;
+}
+
+static void
+sha256_avx2_transform(SHA2_CTX *ctx, const void *in, size_t num)
+{
+	const uint8_t *blk = in;
+	v256_t wk[64];
+
+	if (num >= SHA256_AVX2_LANES) {
+		kfpu_begin();
+		do {
+			sha256_avx2_schedule(blk, wk);
+			for (int l = 0; l < SHA256_AVX2_LANES; l++)
+				sha256_avx2_rounds(ctx->state.s32, wk, l);
+			blk += SHA256_AVX2_LANES * 64;
+			num -= SHA256_AVX2_LANES;
+		} while (num >= SHA256_AVX2_LANES);
+		kfpu_end();
+	}
+
+	if (num > 0)
+		SHA256TransformBlocks(ctx, blk, num);
+}
+
+/*
+ * Message schedules of SHA512_AVX2_LANES blocks, plus the round constants.
+ */
+static void
+SHA2_AVX2_TARGET
+sha512_avx2_schedule(const uint8_t *in, v512_t wk[80])
+{
+	const v512_t zero = { 0 };
+	int t;
+
+	for (int l = 0; l < SHA512_AVX2_LANES; l++) {
+		for (t = 0; t < 16; t++)
+			wk[t][l] = load_be64(in + l * 128 + 8 * t);
+	}
+	for (t = 16; t < 80; t++) {
+		wk[t] = SIGMA1_512(wk[t - 2]) + wk[t - 7] +
+		    SIGMA0_512(wk[t - 15]) + wk[t - 16];
+	}
+	for (t = 0; t < 80; t++)
+		wk[t] += zero + sha512_k[t];
+}
+
+static void
+SHA2_AVX2_TARGET
+sha512_avx2_rounds(uint64_t state[8], const v512_t wk[80], int l)
+{
+	uint64_t a = state[0], b = state[1], c = state[2], d = state[3];
+	uint64_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+	for (int t = 0; t < 80; t += 8) {
+		SHA512_ROUND(a, b, c, d, e, f, g, h, wk[t][l]);
+		SHA512_ROUND(h, a, b, c, d, e, f, g, wk[t + 1][l]);
+		SHA512_ROUND(g, h, a, b, c, d, e, f, wk[t + 2][l]);
+		SHA512_ROUND(f, g, h, a, b, c, d, e, wk[t + 3][l]);
+		SHA512_ROUND(e, f, g, h, a, b, c, d, wk[t + 4][l]);
+		SHA512_ROUND(d, e, f, g, h, a, b, c, wk[t + 5][l]);
+		SHA512_ROUND(c, d, e, f, g, h, a, b, wk[t + 6][l]);
+		SHA512_ROUND(b, c, d, e, f, g, h, a, wk[t + 7][l]);
+	}
+
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+	state[4] += e;
+	state[5] += f;
+	state[6] += g;
+	state[7] += h;
+}
+
+static void
+sha512_avx2_transform(SHA2_CTX *ctx, const void *in, size_t num)
+{
+	const uint8_t *blk = in;
+	v512_t wk[80];
+
+	if (num >= SHA512_AVX2_LANES) {
+		kfpu_begin();
+		do {
+			sha512_avx2_schedule(blk, wk);
+			for (int l = 0; l < SHA512_AVX2_LANES; l++)
+				sha512_avx2_rounds(ctx->state.s64, wk, l);
+			blk += SHA512_AVX2_LANES * 128;
+			num -= SHA512_AVX2_LANES;
+		} while (num >= SHA512_AVX2_LANES);
+		kfpu_end();
+	}
+
+	if (num > 0)
+		SHA512TransformBlocks(ctx, blk, num);
+}
+
+static boolean_t
+sha2_avx2_will_work(void)
+{
+	return (kfpu_allowed() && zfs_avx2_available() &&
+	    zfs_bmi2_available());
+}
+
+const sha2_impl_ops_t sha256_avx2_impl = {
+	.transform = &sha256_avx2_transform,
+	.is_supported = &sha2_avx2_will_work,
+	.name = "avx2"
+};
+
+const sha2_impl_ops_t sha512_avx2_impl = {
+	.transform = &sha512_avx2_transform,
+	.is_supported = &sha2_avx2_will_work,
+	.name = "avx2"
+};
+
+#endif /* defined(__x86_64) && defined(HAVE_AVX2) */
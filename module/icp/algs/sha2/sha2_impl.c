@@ -0,0 +1,644 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+#include <sys/zfs_context.h>
+#include <sys/simd.h>
+#define	_SHA2_IMPL
+#include <sys/sha2.h>
+#include <sha2/sha2_impl.h>
+
+/*
+ * Runtime selection of the SHA-256 and SHA-512 block transforms.  Both
+ * algorithms are handled the same way, each with its own selection state,
+ * benchmark kstat and module parameter.
+ */
+
+/* All compiled in implementations */
+static const sha2_impl_ops_t *const sha256_all_impl[] = {
+	&sha256_generic_impl,
+#if defined(__x86_64)
+	&sha256_x86_64_impl,
+#endif
+#if defined(__x86_64) && defined(HAVE_AVX2)
+	&sha256_avx2_impl,
+#endif
+#if defined(__x86_64) && defined(HAVE_SHA_NI)
+	&sha256_shani_impl,
+#endif
+};
+
+static const sha2_impl_ops_t *const sha512_all_impl[] = {
+	&sha512_generic_impl,
+#if defined(__x86_64)
+	&sha512_x86_64_impl,
+#endif
+#if defined(__x86_64) && defined(HAVE_AVX2)
+	&sha512_avx2_impl,
+#endif
+};
+
+/*
+ * Used when SIMD instructions are not allowed in the current context, or
+ * before the implementations have been initialized.
+ */
+#if defined(__x86_64)
+#define	SHA256_FALLBACK_IMPL	(&sha256_x86_64_impl)
+#define	SHA512_FALLBACK_IMPL	(&sha512_x86_64_impl)
+#else
+#define	SHA256_FALLBACK_IMPL	(&sha256_generic_impl)
+#define	SHA512_FALLBACK_IMPL	(&sha512_generic_impl)
+#endif
+
+/* Select sha2 implementation */
+#define	IMPL_FASTEST	(UINT32_MAX)
+#define	IMPL_CYCLE	(UINT32_MAX - 1)
+
+#define	IMPL_READ(i)	(*(volatile uint32_t *) &(i))
+
+#if defined(_KERNEL)
+/* Throughput of an implementation, or the index of the fastest one */
+struct sha2_kstat {
+	uint64_t	bw;
+};
+#endif
+
+/* Selection state of one algorithm */
+typedef struct sha2_impl_sel {
+	const char			*sis_name;
+	uint64_t			sis_mech;
+	const sha2_impl_ops_t *const	*sis_all_impl;
+	uint32_t			sis_all_cnt;
+	const sha2_impl_ops_t		*sis_fallback;
+	/* Hold all supported implementations */
+	const sha2_impl_ops_t		**sis_supp_impl;
+	uint32_t			sis_supp_cnt;
+	/* Implementation that contains the fastest methods */
+	sha2_impl_ops_t			sis_fastest_impl;
+	uint32_t			sis_chosen;
+	uint32_t			sis_user_sel;
+	/* Indicate that benchmark has been completed */
+	boolean_t			sis_initialized;
+#if defined(_KERNEL)
+	kstat_t				*sis_kstat;
+	/* Every supported implementation, then the fastest one */
+	struct sha2_kstat		*sis_stat;
+#endif
+} sha2_impl_sel_t;
+
+static const sha2_impl_ops_t *sha256_supp_impl[ARRAY_SIZE(sha256_all_impl)];
+static const sha2_impl_ops_t *sha512_supp_impl[ARRAY_SIZE(sha512_all_impl)];
+
+#if defined(_KERNEL)
+static struct sha2_kstat sha256_stat[ARRAY_SIZE(sha256_all_impl) + 1];
+static struct sha2_kstat sha512_stat[ARRAY_SIZE(sha512_all_impl) + 1];
+#endif
+
+static sha2_impl_sel_t sha256_sel = {
+	.sis_name = "sha256",
+	.sis_mech = SHA256_MECH_INFO_TYPE,
+	.sis_all_impl = sha256_all_impl,
+	.sis_all_cnt = ARRAY_SIZE(sha256_all_impl),
+	.sis_fallback = SHA256_FALLBACK_IMPL,
+	.sis_supp_impl = sha256_supp_impl,
+	.sis_chosen = IMPL_FASTEST,
+	.sis_user_sel = IMPL_FASTEST,
+#if defined(_KERNEL)
+	.sis_stat = sha256_stat,
+#endif
+};
+
+static sha2_impl_sel_t sha512_sel = {
+	.sis_name = "sha512",
+	.sis_mech = SHA512_MECH_INFO_TYPE,
+	.sis_all_impl = sha512_all_impl,
+	.sis_all_cnt = ARRAY_SIZE(sha512_all_impl),
+	.sis_fallback = SHA512_FALLBACK_IMPL,
+	.sis_supp_impl = sha512_supp_impl,
+	.sis_chosen = IMPL_FASTEST,
+	.sis_user_sel = IMPL_FASTEST,
+#if defined(_KERNEL)
+	.sis_stat = sha512_stat,
+#endif
+};
+
+static sha2_impl_sel_t *
+sha2_impl_sel(uint64_t mech)
+{
+	return (mech <= SHA256_HMAC_GEN_MECH_INFO_TYPE ?
+	    &sha256_sel : &sha512_sel);
+}
+
+/*
+ * Returns the block transform for a context of the given algorithm type.
+ * A context does not depend on the implementation, so a different one may
+ * be returned on every call.
+ */
+const sha2_impl_ops_t *
+sha2_impl_get_ops(uint32_t algotype)
+{
+	sha2_impl_sel_t *sel = sha2_impl_sel(algotype);
+	const sha2_impl_ops_t *ops = NULL;
+	const uint32_t impl = IMPL_READ(sel->sis_chosen);
+
+	if (!kfpu_allowed() || !sel->sis_initialized)
+		return (sel->sis_fallback);
+
+	switch (impl) {
+	case IMPL_FASTEST:
+		ops = &sel->sis_fastest_impl;
+		break;
+	case IMPL_CYCLE:
+		/* Cycle through supported implementations */
+		ASSERT3U(sel->sis_supp_cnt, >, 0);
+		static uint32_t cycle_impl_idx = 0;
+		uint32_t idx = (++cycle_impl_idx) % sel->sis_supp_cnt;
+		ops = sel->sis_supp_impl[idx];
+		break;
+	default:
+		ASSERT3U(impl, <, sel->sis_supp_cnt);
+		if (impl < sel->sis_supp_cnt)
+			ops = sel->sis_supp_impl[impl];
+		break;
+	}
+
+	ASSERT3P(ops, !=, NULL);
+
+	return (ops);
+}
+
+#if defined(_KERNEL)
+/*
+ * SHA2 kstats
+ */
+static int
+sha2_kstat_headers(char *buf, size_t size)
+{
+	ssize_t off = 0;
+
+	off += snprintf(buf + off, size, "%-17s", "implementation");
+	(void) snprintf(buf + off, size - off, "%-15s\n", "bandwidth");
+
+	return (0);
+}
+
+static int
+sha2_kstat_data(sha2_impl_sel_t *sel, char *buf, size_t size, void *data)
+{
+	struct sha2_kstat *fastest_stat = &sel->sis_stat[sel->sis_supp_cnt];
+	struct sha2_kstat *curr_stat = (struct sha2_kstat *)data;
+	ssize_t off = 0;
+
+	if (curr_stat == fastest_stat) {
+		off += snprintf(buf + off, size - off, "%-17s", "fastest");
+		(void) snprintf(buf + off, size - off, "%-15s\n",
+		    sel->sis_supp_impl[fastest_stat->bw]->name);
+	} else {
+		ptrdiff_t id = curr_stat - sel->sis_stat;
+
+		off += snprintf(buf + off, size - off, "%-17s",
+		    sel->sis_supp_impl[id]->name);
+		(void) snprintf(buf + off, size - off, "%-15llu\n",
+		    (u_longlong_t)curr_stat->bw);
+	}
+
+	return (0);
+}
+
+static void *
+sha2_kstat_addr(sha2_impl_sel_t *sel, kstat_t *ksp, loff_t n)
+{
+	if (n <= sel->sis_supp_cnt)
+		ksp->ks_private = (void *) (sel->sis_stat + n);
+	else
+		ksp->ks_private = NULL;
+
+	return (ksp->ks_private);
+}
+
+static int
+sha256_kstat_data(char *buf, size_t size, void *data)
+{
+	return (sha2_kstat_data(&sha256_sel, buf, size, data));
+}
+
+static void *
+sha256_kstat_addr(kstat_t *ksp, loff_t n)
+{
+	return (sha2_kstat_addr(&sha256_sel, ksp, n));
+}
+
+static int
+sha512_kstat_data(char *buf, size_t size, void *data)
+{
+	return (sha2_kstat_data(&sha512_sel, buf, size, data));
+}
+
+static void *
+sha512_kstat_addr(kstat_t *ksp, loff_t n)
+{
+	return (sha2_kstat_addr(&sha512_sel, ksp, n));
+}
+
+#define	SHA2_BENCH_NS		(MSEC2NSEC(1))		/* 1ms */
+
+static void
+sha2_benchmark_impl(sha2_impl_sel_t *sel, const uint8_t *data,
+    size_t data_size)
+{
+	struct sha2_kstat *fastest_stat = &sel->sis_stat[sel->sis_supp_cnt];
+	SHA2_CTX *ctx = kmem_alloc(sizeof (SHA2_CTX), KM_SLEEP);
+	uint8_t digest[SHA512_DIGEST_LENGTH];
+	uint64_t run_bw, run_time_ns, best_run = 0;
+	uint32_t i, l, sel_save = IMPL_READ(sel->sis_chosen);
+	hrtime_t start;
+
+	/* get_ops() only honors the selection once initialized */
+	sel->sis_initialized = B_TRUE;
+
+	for (i = 0; i < sel->sis_supp_cnt; i++) {
+		struct sha2_kstat *stat = &sel->sis_stat[i];
+		uint64_t run_count = 0;
+
+		/* temporary set an implementation */
+		sel->sis_chosen = i;
+
+		kpreempt_disable();
+		start = gethrtime();
+		do {
+			for (l = 0; l < 8; l++, run_count++) {
+				SHA2Init(sel->sis_mech, ctx);
+				SHA2Update(ctx, data, data_size);
+				SHA2Final(digest, ctx);
+			}
+
+			run_time_ns = gethrtime() - start;
+		} while (run_time_ns < SHA2_BENCH_NS);
+		kpreempt_enable();
+
+		run_bw = data_size * run_count * NANOSEC;
+		run_bw /= run_time_ns;	/* B/s */
+		stat->bw = run_bw;
+
+		if (run_bw > best_run) {
+			best_run = run_bw;
+			fastest_stat->bw = i;
+			memcpy(&sel->sis_fastest_impl, sel->sis_supp_impl[i],
+			    sizeof (sel->sis_fastest_impl));
+		}
+	}
+
+	/* restore original selection */
+	atomic_swap_32(&sel->sis_chosen, sel_save);
+	kmem_free(ctx, sizeof (SHA2_CTX));
+}
+#endif /* _KERNEL */
+
+/*
+ * Initialize and benchmark all supported implementations of one algorithm.
+ */
+static void
+sha2_impl_sel_init(sha2_impl_sel_t *sel, const uint8_t *databuf,
+    size_t data_size)
+{
+	const sha2_impl_ops_t *curr_impl;
+	int i, c;
+
+	/* Move supported implementations into sis_supp_impl */
+	for (i = 0, c = 0; i < sel->sis_all_cnt; i++) {
+		curr_impl = sel->sis_all_impl[i];
+
+		if (curr_impl->is_supported())
+			sel->sis_supp_impl[c++] = curr_impl;
+	}
+	membar_producer();	/* complete sis_supp_impl[] init */
+	sel->sis_supp_cnt = c;
+
+#if defined(_KERNEL)
+	char name[KSTAT_STRLEN];
+
+	sha2_benchmark_impl(sel, databuf, data_size);
+
+	/* Install kstats for all implementations */
+	(void) snprintf(name, sizeof (name), "%s_bench", sel->sis_name);
+	sel->sis_kstat = kstat_create("zfs", 0, name, "misc",
+	    KSTAT_TYPE_RAW, 0, KSTAT_FLAG_VIRTUAL);
+	if (sel->sis_kstat != NULL) {
+		sel->sis_kstat->ks_data = NULL;
+		sel->sis_kstat->ks_ndata = UINT32_MAX;
+		kstat_set_raw_ops(sel->sis_kstat, sha2_kstat_headers,
+		    sel == &sha256_sel ? sha256_kstat_data : sha512_kstat_data,
+		    sel == &sha256_sel ? sha256_kstat_addr : sha512_kstat_addr);
+		kstat_install(sel->sis_kstat);
+	}
+#else
+	/*
+	 * Skip the benchmark in user space to avoid impacting libzpool
+	 * consumers (zdb, zhack, zinject, ztest).  The last implementation
+	 * is assumed to be the fastest and used by default.
+	 */
+	memcpy(&sel->sis_fastest_impl, sel->sis_supp_impl[c - 1],
+	    sizeof (sel->sis_fastest_impl));
+#endif /* _KERNEL */
+	strlcpy(sel->sis_fastest_impl.name, "fastest", SHA2_IMPL_NAME_MAX);
+	membar_producer();
+
+	/* Finish initialization */
+	atomic_swap_32(&sel->sis_chosen, sel->sis_user_sel);
+	sel->sis_initialized = B_TRUE;
+}
+
+void
+sha2_impl_init(void)
+{
+#if defined(_KERNEL)
+	static const size_t data_size = 1 << SPA_OLD_MAXBLOCKSHIFT; /* 128kiB */
+	uint8_t *databuf = vmem_alloc(data_size, KM_SLEEP);
+
+	for (int i = 0; i < data_size / sizeof (uint64_t); i++)
+		((uint64_t *)databuf)[i] = (uintptr_t)(databuf+i); /* warm-up */
+#else
+	const size_t data_size = 0;
+	uint8_t *databuf = NULL;
+#endif
+
+	sha2_impl_sel_init(&sha256_sel, databuf, data_size);
+	sha2_impl_sel_init(&sha512_sel, databuf, data_size);
+
+#if defined(_KERNEL)
+	vmem_free(databuf, data_size);
+#endif
+}
+
+void
+sha2_impl_fini(void)
+{
+#if defined(_KERNEL)
+	if (sha256_sel.sis_kstat != NULL) {
+		kstat_delete(sha256_sel.sis_kstat);
+		sha256_sel.sis_kstat = NULL;
+	}
+	if (sha512_sel.sis_kstat != NULL) {
+		kstat_delete(sha512_sel.sis_kstat);
+		sha512_sel.sis_kstat = NULL;
+	}
+#endif
+}
+
+/*
+ * Number of supported implementations, for sha2_impl_setid().
+ */
+uint32_t
+sha2_impl_getcnt(uint64_t mech)
+{
+	sha2_impl_sel_t *sel = sha2_impl_sel(mech);
+
+	ASSERT(sel->sis_initialized);
+	return (sel->sis_supp_cnt);
+}
+
+/*
+ * Select a supported implementation by index, used by the test suite to
+ * cross-check all of them.
+ */
+void
+sha2_impl_setid(uint64_t mech, uint32_t id)
+{
+	sha2_impl_sel_t *sel = sha2_impl_sel(mech);
+
+	ASSERT(sel->sis_initialized);
+	ASSERT3U(id, <, sel->sis_supp_cnt);
+	atomic_swap_32(&sel->sis_chosen, id);
+}
+
+const char *
+sha2_impl_getname(uint64_t mech)
+{
+	return (sha2_impl_get_ops(mech)->name);
+}
+
+static const struct {
+	const char	*name;
+	uint32_t	sel;
+} sha2_impl_opts[] = {
+	{ "cycle",	IMPL_CYCLE },
+	{ "fastest",	IMPL_FASTEST },
+};
+
+/*
+ * Function sets desired sha2 implementation.
+ *
+ * If we are called before init(), user preference will be saved in
+ * sis_user_sel, and applied in later init() call.  This occurs when module
+ * parameter is specified on module load.  Otherwise, directly update
+ * sis_chosen.
+ *
+ * @val		Name of sha2 implementation to use
+ */
+static int
+sha2_impl_sel_set(sha2_impl_sel_t *sel, const char *val)
+{
+	int err = -EINVAL;
+	char req_name[SHA2_IMPL_NAME_MAX];
+	uint32_t impl = IMPL_READ(sel->sis_user_sel);
+	size_t i;
+
+	/* sanitize input */
+	i = strnlen(val, sizeof (req_name));
+	if (i == 0 || i >= sizeof (req_name))
+		return (err);
+
+	strlcpy(req_name, val, sizeof (req_name));
+	while (i > 0 && isspace(req_name[i-1]))
+		i--;
+	req_name[i] = '\0';
+
+	/* Check mandatory options */
+	for (i = 0; i < ARRAY_SIZE(sha2_impl_opts); i++) {
+		if (strcmp(req_name, sha2_impl_opts[i].name) == 0) {
+			impl = sha2_impl_opts[i].sel;
+			err = 0;
+			break;
+		}
+	}
+
+	/* check all supported impl if init() was already called */
+	if (err != 0 && sel->sis_initialized) {
+		for (i = 0; i < sel->sis_supp_cnt; i++) {
+			if (strcmp(req_name, sel->sis_supp_impl[i]->name) ==
+			    0) {
+				impl = i;
+				err = 0;
+				break;
+			}
+		}
+	}
+
+	if (err == 0) {
+		if (sel->sis_initialized)
+			atomic_swap_32(&sel->sis_chosen, impl);
+		else
+			atomic_swap_32(&sel->sis_user_sel, impl);
+	}
+
+	return (err);
+}
+
+/*
+ * Select the implementation for the algorithm type mech by name, including
+ * "fastest" and "cycle".
+ */
+int
+sha2_impl_set(uint64_t mech, const char *val)
+{
+	return (sha2_impl_sel_set(sha2_impl_sel(mech), val));
+}
+
+#if defined(_KERNEL)
+
+#define	IMPL_FMT(impl, i)	(((impl) == (i)) ? "[%s] " : "%s ")
+
+#if defined(__linux__)
+
+static int
+sha2_param_get(sha2_impl_sel_t *sel, char *buffer)
+{
+	const uint32_t impl = IMPL_READ(sel->sis_chosen);
+	char *fmt;
+	int cnt = 0;
+
+	/* list mandatory options */
+	for (uint32_t i = 0; i < ARRAY_SIZE(sha2_impl_opts); i++) {
+		fmt = IMPL_FMT(impl, sha2_impl_opts[i].sel);
+		cnt += sprintf(buffer + cnt, fmt, sha2_impl_opts[i].name);
+	}
+
+	/* list all supported implementations */
+	for (uint32_t i = 0; i < sel->sis_supp_cnt; ++i) {
+		fmt = IMPL_FMT(impl, i);
+		cnt += sprintf(buffer + cnt, fmt, sel->sis_supp_impl[i]->name);
+	}
+
+	return (cnt);
+}
+
+static int
+sha256_param_get(char *buffer, zfs_kernel_param_t *unused)
+{
+	return (sha2_param_get(&sha256_sel, buffer));
+}
+
+static int
+sha256_param_set(const char *val, zfs_kernel_param_t *unused)
+{
+	return (sha2_impl_sel_set(&sha256_sel, val));
+}
+
+static int
+sha512_param_get(char *buffer, zfs_kernel_param_t *unused)
+{
+	return (sha2_param_get(&sha512_sel, buffer));
+}
+
+static int
+sha512_param_set(const char *val, zfs_kernel_param_t *unused)
+{
+	return (sha2_impl_sel_set(&sha512_sel, val));
+}
+
+#else
+
+#include <sys/sbuf.h>
+
+static int
+sha2_param(sha2_impl_sel_t *sel, ZFS_MODULE_PARAM_ARGS)
+{
+	int err = 0;
+
+	if (req->newptr == NULL) {
+		const uint32_t impl = IMPL_READ(sel->sis_chosen);
+		const int init_buflen = 64;
+		const char *fmt;
+		struct sbuf *s;
+
+		s = sbuf_new_for_sysctl(NULL, NULL, init_buflen, req);
+
+		/* list mandatory options */
+		for (uint32_t i = 0; i < ARRAY_SIZE(sha2_impl_opts); i++) {
+			fmt = IMPL_FMT(impl, sha2_impl_opts[i].sel);
+			(void) sbuf_printf(s, fmt, sha2_impl_opts[i].name);
+		}
+
+		/* list all supported implementations */
+		for (uint32_t i = 0; i < sel->sis_supp_cnt; ++i) {
+			fmt = IMPL_FMT(impl, i);
+			(void) sbuf_printf(s, fmt,
+			    sel->sis_supp_impl[i]->name);
+		}
+
+#ifdef __APPLE__
+		err = SYSCTL_OUT(req, s->s_buf, s->s_len);
+		sbuf_finish(s);
+#else
+		err = sbuf_finish(s);
+#endif
+		sbuf_delete(s);
+		return (err);
+	}
+
+	char buf[SHA2_IMPL_NAME_MAX];
+
+	err = sysctl_handle_string(oidp, buf, sizeof (buf), req);
+	if (err)
+		return (err);
+	return (-sha2_impl_sel_set(sel, buf));
+}
+
+static int
+sha256_param(ZFS_MODULE_PARAM_ARGS)
+{
+	return (sha2_param(&sha256_sel, oidp, arg1, arg2, req));
+}
+
+static int
+sha512_param(ZFS_MODULE_PARAM_ARGS)
+{
+	return (sha2_param(&sha512_sel, oidp, arg1, arg2, req));
+}
+
+#endif
+
+#undef IMPL_FMT
+
+/*
+ * Choose the SHA-256 and SHA-512 implementations in ZFS.
+ * Users can choose "cycle" to exercise all implementations, but this is
+ * for testing purpose therefore it can only be set in user space.
+ */
+/* BEGIN CSTYLED */
+ZFS_MODULE_VIRTUAL_PARAM_CALL(zfs, zfs_, sha256_impl,
+	sha256_param_set, sha256_param_get, ZMOD_RW,
+	"Select SHA-256 implementation.");
+
+ZFS_MODULE_VIRTUAL_PARAM_CALL(zfs, zfs_, sha512_impl,
+	sha512_param_set, sha512_param_get, ZMOD_RW,
+	"Select SHA-512 implementation.");
+/* END CSTYLED */
+#endif /* _KERNEL */
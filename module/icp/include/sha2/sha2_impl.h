@@ -57,6 +57,52 @@ typedef struct sha2_hmac_ctx {
 	SHA2_CTX		hc_ocontext;	/* outer SHA2 context */
 } sha2_hmac_ctx_t;
 
+/*
+ * Methods used to define a SHA2 block transform implementation
+ *
+ * @sha2_transform_f Function hashing a number of whole blocks into the
+ *                   state of the context
+ * @sha2_will_work_f Function tests whether method will function
+ */
+typedef void		(*sha2_transform_f)(SHA2_CTX *, const void *, size_t);
+typedef boolean_t	(*sha2_will_work_f)(void);
+
+#define	SHA2_IMPL_NAME_MAX (16)
+
+typedef struct sha2_impl_ops {
+	sha2_transform_f transform;
+	sha2_will_work_f is_supported;
+	char name[SHA2_IMPL_NAME_MAX];
+} sha2_impl_ops_t;
+
+/* Round constants, 16 byte aligned */
+extern const uint32_t sha256_k[64];
+extern const uint64_t sha512_k[80];
+
+extern const sha2_impl_ops_t sha256_generic_impl;
+extern const sha2_impl_ops_t sha512_generic_impl;
+#if defined(__x86_64)
+extern const sha2_impl_ops_t sha256_x86_64_impl;
+extern const sha2_impl_ops_t sha512_x86_64_impl;
+
+/* Block transforms of asm-x86_64/sha2, which only use integer registers */
+extern void SHA256TransformBlocks(SHA2_CTX *ctx, const void *in, size_t num);
+extern void SHA512TransformBlocks(SHA2_CTX *ctx, const void *in, size_t num);
+#endif
+#if defined(__x86_64) && defined(HAVE_AVX2)
+extern const sha2_impl_ops_t sha256_avx2_impl;
+extern const sha2_impl_ops_t sha512_avx2_impl;
+#endif
+#if defined(__x86_64) && defined(HAVE_SHA_NI)
+extern const sha2_impl_ops_t sha256_shani_impl;
+#endif
+
+/*
+ * Returns the SHA-256 or SHA-512 implementation to use for a context of
+ * the given algorithm type.
+ */
+const sha2_impl_ops_t *sha2_impl_get_ops(uint32_t algotype);
+
 #ifdef	__cplusplus
 }
 #endif
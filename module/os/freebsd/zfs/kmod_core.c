@@ -29,6 +29,7 @@
 __FBSDID("$FreeBSD$");
 
 #include <sys/param.h>
+#include <sys/blake3.h>
 #include <sys/buf.h>
 #include <sys/cmn_err.h>
 #include <sys/conf.h>
@@ -243,9 +244,12 @@ zfs__init(void)
 	    ZFS_MIN_KSTACK_PAGES);
 #endif
 	zfs_root_token = root_mount_hold("ZFS");
+	/* The ICP, which selects the BLAKE3 implementation, isn't built */
+	blake3_impl_init();
 	if ((error = zfs_kmod_init()) != 0) {
 		printf("ZFS: Failed to Load ZFS Filesystem"
 		    ", rc = %d\n", error);
+		blake3_impl_fini();
 		root_mount_rel(zfs_root_token);
 		return (error);
 	}
@@ -268,6 +272,7 @@ zfs__fini(void)
 		return (EBUSY);
 	}
 	zfs_kmod_fini();
+	blake3_impl_fini();
 	tsd_destroy(&zfs_geom_probe_vdev_key);
 	return (0);
 }
@@ -362,6 +362,53 @@ int zfs_arc_eviction_pct = 200;
  */
 int zfs_arc_evict_batch_limit = 10;
 
+/*
+ * Number of threads used to evict from the sublists of an ARC state in
+ * parallel.  When 0, a value is derived from the number of CPUs; a value
+ * of 1 disables parallel eviction, and it is capped at the CPU count.
+ * An eviction pass only uses as many threads as it has multiples of
+ * zfs_arc_evict_parallel_min bytes to evict, so small deficits are still
+ * handled by the calling thread.
+ */
+int zfs_arc_evict_threads = 0;
+unsigned long zfs_arc_evict_parallel_min = 16 << 20;
+static uint_t arc_evict_threads;
+static taskq_t *arc_evict_taskq;
+
+/*
+ * Track evicted blocks in compact filters rather than keeping their
+ * headers on the ghost lists (see arc_ghost_insert()).
+ */
+int zfs_arc_ghost_compact = 0;
+
+/*
+ * Soft limit on the share of arc_c which a single dataset registered with
+ * arc_dataset_register() may hold, in percent (0 disables the limit).  While
+ * any dataset is over it, each eviction pass first evicts the buffers of the
+ * datasets which are over their share, and only then falls back to evicting
+ * in plain LRU order.
+ */
+int zfs_arc_dataset_limit_percent = 0;
+static avl_tree_t arc_dataset_tree;
+static krwlock_t arc_dataset_lock;
+static uint64_t arc_dataset_nover;
+static uint64_t arc_dataset_limit = UINT64_MAX;
+
+/*
+ * Misses look up the dataset of a block in a small per-CPU cache first, so
+ * that they don't all take arc_dataset_lock.  Each cached entry holds a
+ * reference, dropped when the slot is reused or the dataset unregistered.
+ */
+#define	ARC_DATASET_CACHE_SLOTS	8
+
+typedef struct arc_dataset_cache {
+	kmutex_t	adc_lock;
+	arc_dataset_t	*adc_ad[ARC_DATASET_CACHE_SLOTS];
+} ____cacheline_aligned arc_dataset_cache_t;
+
+static arc_dataset_cache_t *arc_dataset_caches;
+static uint_t arc_dataset_ncaches;
+
 /* number of seconds before growing cache again */
 int arc_grow_retry = 5;
 
@@ -496,6 +543,12 @@ arc_stats_t arc_stats = {
 	{ "evict_l2_eligible_mru",	KSTAT_DATA_UINT64 },
 	{ "evict_l2_ineligible",	KSTAT_DATA_UINT64 },
 	{ "evict_l2_skip",		KSTAT_DATA_UINT64 },
+	{ "evict_parallel",		KSTAT_DATA_UINT64 },
+	{ "evict_tasks",		KSTAT_DATA_UINT64 },
+	{ "evict_task_bytes",		KSTAT_DATA_UINT64 },
+	{ "evict_task_bytes_max",	KSTAT_DATA_UINT64 },
+	{ "evict_datasets_over_limit",	KSTAT_DATA_UINT64 },
+	{ "evict_dataset_limit_bytes",	KSTAT_DATA_UINT64 },
 	{ "hash_elements",		KSTAT_DATA_UINT64 },
 	{ "hash_elements_max",		KSTAT_DATA_UINT64 },
 	{ "hash_collisions",		KSTAT_DATA_UINT64 },
@@ -533,6 +586,14 @@ arc_stats_t arc_stats = {
 	{ "mfu_ghost_size",		KSTAT_DATA_UINT64 },
 	{ "mfu_ghost_evictable_data",	KSTAT_DATA_UINT64 },
 	{ "mfu_ghost_evictable_metadata", KSTAT_DATA_UINT64 },
+	{ "ghost_compact_entries",	KSTAT_DATA_UINT64 },
+	{ "ghost_compact_size",		KSTAT_DATA_UINT64 },
+	{ "ghost_compact_mem",		KSTAT_DATA_UINT64 },
+	{ "ghost_compact_saved",	KSTAT_DATA_UINT64 },
+	{ "ghost_compact_rotations",	KSTAT_DATA_UINT64 },
+	{ "ghost_compact_lookups",	KSTAT_DATA_UINT64 },
+	{ "ghost_compact_hits",		KSTAT_DATA_UINT64 },
+	{ "ghost_compact_fp_ppm",	KSTAT_DATA_UINT64 },
 	{ "l2_hits",			KSTAT_DATA_UINT64 },
 	{ "l2_misses",			KSTAT_DATA_UINT64 },
 	{ "l2_prefetch_asize",		KSTAT_DATA_UINT64 },
@@ -558,6 +619,10 @@ arc_stats_t arc_stats = {
 	{ "l2_size",			KSTAT_DATA_UINT64 },
 	{ "l2_asize",			KSTAT_DATA_UINT64 },
 	{ "l2_hdr_size",		KSTAT_DATA_UINT64 },
+	{ "l2_hdr_saved",		KSTAT_DATA_UINT64 },
+	{ "l2_admit_bytes",		KSTAT_DATA_UINT64 },
+	{ "l2_reject_bytes",		KSTAT_DATA_UINT64 },
+	{ "l2_admit_resets",		KSTAT_DATA_UINT64 },
 	{ "l2_log_blk_writes",		KSTAT_DATA_UINT64 },
 	{ "l2_log_blk_avg_asize",	KSTAT_DATA_UINT64 },
 	{ "l2_log_blk_asize",		KSTAT_DATA_UINT64 },
@@ -765,6 +830,69 @@ taskq_t *arc_prune_taskq;
 #define	HDR_FULL_SIZE ((int64_t)offsetof(arc_buf_hdr_t, b_crypt_hdr))
 #define	HDR_L2ONLY_SIZE ((int64_t)offsetof(arc_buf_hdr_t, b_l1hdr))
 
+/*
+ * Bytes saved in each L2ARC-only header by packing the L2ARC fields, which
+ * used to be a device pointer, the list node, a 64-bit b_daddr, a 32-bit
+ * b_hits and an enum b_arcs_state following the common fields.
+ */
+#define	L2HDR_PACKED_SAVINGS						\
+	((int64_t)(offsetof(arc_buf_hdr_t, b_l2hdr) + sizeof (void *) +	\
+	sizeof (list_node_t) + sizeof (uint64_t) +			\
+	2 * sizeof (uint32_t)) - HDR_L2ONLY_SIZE)
+
+/*
+ * L2ARC devices by l2ad_id, which is what headers store instead of a
+ * pointer.  An entry is set before any header can refer to the device
+ * and cleared once l2arc_remove_vdev() has evicted all of them.
+ */
+#define	L2ARC_DEV_MAX	1024
+static l2arc_dev_t *l2arc_dev_ids[L2ARC_DEV_MAX];
+
+/* Highest address offset, in device sectors, which a header can encode */
+#define	L2ARC_DADDR_MAX	((1ULL << 40) - 1)
+
+static inline l2arc_dev_t *
+l2arc_hdr_dev(const arc_buf_hdr_t *hdr)
+{
+	return (l2arc_dev_ids[hdr->b_l2dev]);
+}
+
+static inline void
+l2arc_hdr_set_dev(arc_buf_hdr_t *hdr, l2arc_dev_t *dev)
+{
+	ASSERT3P(l2arc_dev_ids[dev->l2ad_id], ==, dev);
+	hdr->b_l2dev = dev->l2ad_id;
+}
+
+static inline uint64_t
+l2arc_hdr_daddr(const arc_buf_hdr_t *hdr)
+{
+	l2arc_dev_t *dev = l2arc_hdr_dev(hdr);
+	uint64_t off = ((uint64_t)hdr->b_l2daddr_hi << 32) |
+	    hdr->b_l2hdr.b_daddr_lo;
+
+	return (dev->l2ad_start + (off << dev->l2ad_daddr_shift));
+}
+
+/*
+ * The header's device must be set before its address.  l2arc_add_vdev()
+ * limits the usable size of a device to what can be encoded.
+ */
+static inline void
+l2arc_hdr_set_daddr(arc_buf_hdr_t *hdr, uint64_t daddr)
+{
+	l2arc_dev_t *dev = l2arc_hdr_dev(hdr);
+	uint64_t off = (daddr - dev->l2ad_start) >> dev->l2ad_daddr_shift;
+
+	VERIFY3U(daddr, >=, dev->l2ad_start);
+	ASSERT0(P2PHASE(daddr - dev->l2ad_start,
+	    1ULL << dev->l2ad_daddr_shift));
+	VERIFY3U(off, <=, L2ARC_DADDR_MAX);
+
+	hdr->b_l2hdr.b_daddr_lo = (uint32_t)off;
+	hdr->b_l2daddr_hi = (uint8_t)(off >> 32);
+}
+
 /*
  * Hash table routines
  */
@@ -779,18 +907,27 @@ struct ht_lock {
 #endif
 };
 
-#define	BUF_LOCKS 8192
+/*
+ * The hash table locks are striped over the buckets.  At least BUF_LOCKS
+ * stripes are always used; on larger systems the number of stripes grows
+ * with the CPU count (up to BUF_LOCKS_PER_CPU each, bounded by the number
+ * of buckets) so that concurrent cache hits rarely share a stripe.
+ */
+#define	BUF_LOCKS		8192
+#define	BUF_LOCKS_PER_CPU	512
 typedef struct buf_hash_table {
 	uint64_t ht_mask;
 	arc_buf_hdr_t **ht_table;
-	struct ht_lock ht_locks[BUF_LOCKS];
+	uint64_t ht_lock_mask;
+	struct ht_lock *ht_locks;
 } buf_hash_table_t;
 
 static buf_hash_table_t buf_hash_table;
 
 #define	BUF_HASH_INDEX(spa, dva, birth) \
 	(buf_hash(spa, dva, birth) & buf_hash_table.ht_mask)
-#define	BUF_HASH_LOCK_NTRY(idx) (buf_hash_table.ht_locks[idx & (BUF_LOCKS-1)])
+#define	BUF_HASH_LOCK_NTRY(idx) \
+	(buf_hash_table.ht_locks[(idx) & buf_hash_table.ht_lock_mask])
 #define	BUF_HASH_LOCK(idx)	(&(BUF_HASH_LOCK_NTRY(idx).ht_lock))
 #define	HDR_LOCK(hdr) \
 	(BUF_HASH_LOCK(BUF_HASH_INDEX(hdr->b_spa, &hdr->b_dva, hdr->b_birth)))
@@ -832,6 +969,7 @@ int l2arc_noprefetch = B_TRUE;			/* don't cache prefetch bufs */
 int l2arc_feed_again = B_TRUE;			/* turbo warmup */
 int l2arc_norw = B_FALSE;			/* no reads during writes */
 int l2arc_meta_percent = 33;			/* limit on headers size */
+int l2arc_admit = 0;				/* frequency admission filter */
 
 /*
  * L2ARC Internals
@@ -839,7 +977,7 @@ int l2arc_meta_percent = 33;			/* limit on headers size */
 static list_t L2ARC_dev_list;			/* device list */
 static list_t *l2arc_dev_list;			/* device list pointer */
 static kmutex_t l2arc_dev_mtx;			/* device list mutex */
-static l2arc_dev_t *l2arc_dev_last;		/* last device used */
+static boolean_t l2arc_feed_enabled;		/* start feed threads */
 static list_t L2ARC_free_on_write;		/* free after write buf list */
 static list_t *l2arc_free_on_write;		/* free after write list ptr */
 static kmutex_t l2arc_free_on_write_mtx;	/* mutex for list */
@@ -869,10 +1007,6 @@ typedef enum arc_fill_flags {
 	ARC_FILL_IN_PLACE	= 1 << 4  /* fill in place (special case) */
 } arc_fill_flags_t;
 
-static kmutex_t l2arc_feed_thr_lock;
-static kcondvar_t l2arc_feed_thr_cv;
-static uint8_t l2arc_thread_exit;
-
 static kmutex_t l2arc_rebuild_thr_lock;
 static kcondvar_t l2arc_rebuild_thr_cv;
 
@@ -899,6 +1033,7 @@ static inline void arc_hdr_set_flags(arc_buf_hdr_t *hdr, arc_flags_t flags);
 static inline void arc_hdr_clear_flags(arc_buf_hdr_t *hdr, arc_flags_t flags);
 
 static boolean_t l2arc_write_eligible(uint64_t, arc_buf_hdr_t *);
+static void l2arc_admit_record(uint64_t, const blkptr_t *);
 static void l2arc_read_done(zio_t *);
 static void l2arc_do_free_on_write(void);
 static void l2arc_hdr_arcstats_update(arc_buf_hdr_t *hdr, boolean_t incr,
@@ -1142,8 +1277,15 @@ buf_fini(void)
 	kmem_free(buf_hash_table.ht_table,
 	    (buf_hash_table.ht_mask + 1) * sizeof (void *));
 #endif
-	for (i = 0; i < BUF_LOCKS; i++)
+	for (i = 0; i <= buf_hash_table.ht_lock_mask; i++)
 		mutex_destroy(&buf_hash_table.ht_locks[i].ht_lock);
+#if defined(_KERNEL)
+	vmem_free(buf_hash_table.ht_locks,
+	    (buf_hash_table.ht_lock_mask + 1) * sizeof (struct ht_lock));
+#else
+	kmem_free(buf_hash_table.ht_locks,
+	    (buf_hash_table.ht_lock_mask + 1) * sizeof (struct ht_lock));
+#endif
 	kmem_cache_destroy(hdr_full_cache);
 	kmem_cache_destroy(hdr_full_crypt_cache);
 	kmem_cache_destroy(hdr_l2only_cache);
@@ -1264,6 +1406,7 @@ buf_init(void)
 {
 	uint64_t *ct = NULL;
 	uint64_t hsize = 1ULL << 12;
+	uint64_t nlocks = BUF_LOCKS;
 	int i, j;
 
 	/*
@@ -1308,7 +1451,17 @@ retry:
 		for (ct = zfs_crc64_table + i, *ct = i, j = 8; j > 0; j--)
 			*ct = (*ct >> 1) ^ (-(*ct & 1) & ZFS_CRC64_POLY);
 
-	for (i = 0; i < BUF_LOCKS; i++) {
+	while (nlocks < hsize && nlocks < boot_ncpus * BUF_LOCKS_PER_CPU)
+		nlocks <<= 1;
+	buf_hash_table.ht_lock_mask = nlocks - 1;
+#if defined(_KERNEL)
+	buf_hash_table.ht_locks =
+	    vmem_zalloc(nlocks * sizeof (struct ht_lock), KM_SLEEP);
+#else
+	buf_hash_table.ht_locks =
+	    kmem_zalloc(nlocks * sizeof (struct ht_lock), KM_SLEEP);
+#endif
+	for (i = 0; i < nlocks; i++) {
 		mutex_init(&buf_hash_table.ht_locks[i].ht_lock,
 		    NULL, MUTEX_DEFAULT, NULL);
 	}
@@ -1767,9 +1920,9 @@ arc_buf_alloc_l2only(size_t size, arc_buf_contents_t type, l2arc_dev_t *dev,
 
 	hdr->b_dva = dva;
 
-	hdr->b_l2hdr.b_dev = dev;
-	hdr->b_l2hdr.b_daddr = daddr;
-	hdr->b_l2hdr.b_arcs_state = arcs_state;
+	l2arc_hdr_set_dev(hdr, dev);
+	l2arc_hdr_set_daddr(hdr, daddr);
+	hdr->b_l2arcs_state = arcs_state;
 
 	return (hdr);
 }
@@ -1820,7 +1973,8 @@ arc_hdr_authenticate(arc_buf_hdr_t *hdr, spa_t *spa, uint64_t dsobj)
 		abd = abd_get_from_buf(tmpbuf, lsize);
 		abd_take_ownership_of_buf(abd, B_TRUE);
 		csize = zio_compress_data(HDR_GET_COMPRESS(hdr),
-		    hdr->b_l1hdr.b_pabd, tmpbuf, lsize, hdr->b_complevel);
+		    hdr->b_l1hdr.b_pabd, tmpbuf, lsize, hdr->b_complevel,
+		    B_FALSE);
 		ASSERT3U(csize, <=, psize);
 		abd_zero_off(abd, csize, psize - csize);
 	}
@@ -2407,7 +2561,7 @@ arc_buf_info(arc_buf_t *ab, arc_buf_info_t *abi, int state_index)
 	}
 
 	if (l2hdr) {
-		abi->abi_l2arc_dattr = l2hdr->b_daddr;
+		abi->abi_l2arc_dattr = l2arc_hdr_daddr(hdr);
 		abi->abi_l2arc_hits = l2hdr->b_hits;
 	}
 
@@ -2416,6 +2570,239 @@ arc_buf_info(arc_buf_t *ab, arc_buf_info_t *abi, int state_index)
 	abi->abi_size = arc_hdr_size(hdr);
 }
 
+static int
+arc_dataset_compare(const void *x1, const void *x2)
+{
+	const arc_dataset_t *ad1 = x1;
+	const arc_dataset_t *ad2 = x2;
+
+	int cmp = TREE_CMP(ad1->ad_guid, ad2->ad_guid);
+	if (likely(cmp))
+		return (cmp);
+
+	return (TREE_CMP(ad1->ad_objset, ad2->ad_objset));
+}
+
+static void
+arc_dataset_free(arc_dataset_t *ad)
+{
+	ASSERT0(ad->ad_refcnt);
+	ASSERT0(ad->ad_size);
+	aggsum_fini(&ad->ad_hits);
+	aggsum_fini(&ad->ad_misses);
+	kmem_free(ad, sizeof (*ad));
+}
+
+/*
+ * Start attributing the ARC usage of the given objset to a per-dataset
+ * entry, which the caller reads with arc_dataset_stats() and gives up
+ * with arc_dataset_unregister().
+ */
+arc_dataset_t *
+arc_dataset_register(spa_t *spa, uint64_t objset)
+{
+	arc_dataset_t *ad, *nad;
+	avl_index_t where;
+
+	nad = kmem_zalloc(sizeof (*nad), KM_SLEEP);
+	nad->ad_guid = spa_load_guid(spa);
+	nad->ad_objset = objset;
+	aggsum_init(&nad->ad_hits, 0);
+	aggsum_init(&nad->ad_misses, 0);
+
+	rw_enter(&arc_dataset_lock, RW_WRITER);
+	ad = avl_find(&arc_dataset_tree, nad, &where);
+	if (ad == NULL) {
+		ad = nad;
+		nad = NULL;
+		avl_insert(&arc_dataset_tree, ad, where);
+	}
+	ad->ad_holds++;
+	atomic_inc_64(&ad->ad_refcnt);
+	rw_exit(&arc_dataset_lock);
+
+	if (nad != NULL)
+		arc_dataset_free(nad);
+
+	return (ad);
+}
+
+/*
+ * Drop a reference on a dataset entry.  Only the final reference needs the
+ * tree lock, so that lookups can't find an entry which is being freed.
+ */
+static void
+arc_dataset_rele(arc_dataset_t *ad)
+{
+	uint64_t refcnt;
+
+	do {
+		refcnt = ad->ad_refcnt;
+		ASSERT3U(refcnt, >, 0);
+		if (refcnt == 1) {
+			boolean_t free = B_FALSE;
+
+			rw_enter(&arc_dataset_lock, RW_WRITER);
+			if (atomic_dec_64_nv(&ad->ad_refcnt) == 0) {
+				ASSERT0(ad->ad_holds);
+				avl_remove(&arc_dataset_tree, ad);
+				free = B_TRUE;
+			}
+			rw_exit(&arc_dataset_lock);
+
+			if (free)
+				arc_dataset_free(ad);
+			return;
+		}
+	} while (atomic_cas_64(&ad->ad_refcnt, refcnt, refcnt - 1) != refcnt);
+}
+
+static inline uint_t
+arc_dataset_cache_slot(uint64_t guid, uint64_t objset)
+{
+	return ((guid ^ objset) % ARC_DATASET_CACHE_SLOTS);
+}
+
+void
+arc_dataset_unregister(arc_dataset_t *ad)
+{
+	uint_t slot = arc_dataset_cache_slot(ad->ad_guid, ad->ad_objset);
+	boolean_t last;
+
+	rw_enter(&arc_dataset_lock, RW_WRITER);
+	ASSERT3U(ad->ad_holds, >, 0);
+	last = (--ad->ad_holds == 0);
+	rw_exit(&arc_dataset_lock);
+
+	/* Lookups ignore entries without holds, drop the cached references */
+	for (int c = 0; last && c < arc_dataset_ncaches; c++) {
+		arc_dataset_cache_t *adc = &arc_dataset_caches[c];
+
+		mutex_enter(&adc->adc_lock);
+		if (adc->adc_ad[slot] == ad && ad->ad_holds == 0) {
+			adc->adc_ad[slot] = NULL;
+			arc_dataset_rele(ad);
+		}
+		mutex_exit(&adc->adc_lock);
+	}
+
+	arc_dataset_rele(ad);
+}
+
+void
+arc_dataset_stats(arc_dataset_t *ad, uint64_t *size, uint64_t *hits,
+    uint64_t *misses)
+{
+	*size = ad->ad_size;
+	*hits = aggsum_value(&ad->ad_hits);
+	*misses = aggsum_value(&ad->ad_misses);
+}
+
+/*
+ * Attribute the header to the dataset its block belongs to, if that dataset
+ * is registered.  This is only done while the header isn't charged to any
+ * dataset, i.e. before it enters the MRU or MFU state.
+ */
+static void
+arc_hdr_set_dataset(arc_buf_hdr_t *hdr, uint64_t objset)
+{
+	arc_dataset_cache_t *adc;
+	arc_dataset_t search, *ad, *old = NULL;
+	uint_t slot;
+
+	ASSERT(HDR_HAS_L1HDR(hdr));
+	ASSERT(hdr->b_l1hdr.b_state != arc_mru &&
+	    hdr->b_l1hdr.b_state != arc_mfu);
+
+	if (hdr->b_l1hdr.b_dataset != NULL || objset == 0 ||
+	    avl_is_empty(&arc_dataset_tree))
+		return;
+
+	adc = &arc_dataset_caches[CPU_SEQID_UNSTABLE % arc_dataset_ncaches];
+	slot = arc_dataset_cache_slot(hdr->b_spa, objset);
+
+	mutex_enter(&adc->adc_lock);
+	ad = adc->adc_ad[slot];
+	if (ad == NULL || ad->ad_guid != hdr->b_spa ||
+	    ad->ad_objset != objset || ad->ad_holds == 0) {
+		search.ad_guid = hdr->b_spa;
+		search.ad_objset = objset;
+
+		rw_enter(&arc_dataset_lock, RW_READER);
+		ad = avl_find(&arc_dataset_tree, &search, NULL);
+		if (ad != NULL && ad->ad_holds > 0) {
+			/* One reference for the cache */
+			atomic_inc_64(&ad->ad_refcnt);
+			old = adc->adc_ad[slot];
+			adc->adc_ad[slot] = ad;
+		} else {
+			ad = NULL;
+		}
+		rw_exit(&arc_dataset_lock);
+	}
+	if (ad != NULL) {
+		atomic_inc_64(&ad->ad_refcnt);
+		hdr->b_l1hdr.b_dataset = ad;
+	}
+	mutex_exit(&adc->adc_lock);
+
+	if (old != NULL)
+		arc_dataset_rele(old);
+}
+
+static void
+arc_hdr_clear_dataset(arc_buf_hdr_t *hdr)
+{
+	arc_dataset_t *ad = hdr->b_l1hdr.b_dataset;
+
+	ASSERT(hdr->b_l1hdr.b_state != arc_mru &&
+	    hdr->b_l1hdr.b_state != arc_mfu);
+
+	if (ad != NULL) {
+		hdr->b_l1hdr.b_dataset = NULL;
+		arc_dataset_rele(ad);
+	}
+}
+
+/*
+ * Set the share of arc_c which a dataset may hold, and return how many
+ * datasets hold more than that.
+ */
+static uint64_t
+arc_dataset_update_limit(void)
+{
+	uint64_t nover = 0;
+
+	if (zfs_arc_dataset_limit_percent == 0 ||
+	    avl_is_empty(&arc_dataset_tree)) {
+		arc_dataset_limit = UINT64_MAX;
+		return (0);
+	}
+
+	arc_dataset_limit = arc_c / 100 *
+	    MIN(zfs_arc_dataset_limit_percent, 100);
+
+	rw_enter(&arc_dataset_lock, RW_READER);
+	for (arc_dataset_t *ad = avl_first(&arc_dataset_tree); ad != NULL;
+	    ad = AVL_NEXT(&arc_dataset_tree, ad)) {
+		if (ad->ad_size > arc_dataset_limit)
+			nover++;
+	}
+	rw_exit(&arc_dataset_lock);
+
+	return (nover);
+}
+
+/*
+ * Checked for every header on a dataset limit pass, so that the pass stops
+ * evicting a dataset's buffers as soon as it is back within its share.
+ */
+static inline boolean_t
+arc_dataset_over_limit(const arc_dataset_t *ad)
+{
+	return (ad != NULL && ad->ad_size > arc_dataset_limit);
+}
+
 /*
  * Move the supplied buffer to the indicated state. The hash lock
  * for the buffer must be held by the caller.
@@ -2456,6 +2843,20 @@ arc_change_state(arc_state_t *new_state, arc_buf_hdr_t *hdr,
 	ASSERT(!GHOST_STATE(new_state) || bufcnt == 0);
 	ASSERT(old_state != arc_anon || bufcnt <= 1);
 
+	/* charge the header's dataset while it is in the MRU or MFU */
+	if (HDR_HAS_L1HDR(hdr) && hdr->b_l1hdr.b_dataset != NULL) {
+		int64_t delta = 0;
+
+		if (old_state == arc_mru || old_state == arc_mfu)
+			delta -= HDR_GET_LSIZE(hdr);
+		if (new_state == arc_mru || new_state == arc_mfu)
+			delta += HDR_GET_LSIZE(hdr);
+		if (delta != 0) {
+			atomic_add_64(&hdr->b_l1hdr.b_dataset->ad_size,
+			    delta);
+		}
+	}
+
 	/*
 	 * If this buffer is evictable, transfer it from the
 	 * old state list to the new state list.
@@ -2623,7 +3024,7 @@ arc_change_state(arc_state_t *new_state, arc_buf_hdr_t *hdr,
 
 		if (HDR_HAS_L2HDR(hdr) && new_state != arc_l2c_only) {
 			l2arc_hdr_arcstats_decrement_state(hdr);
-			hdr->b_l2hdr.b_arcs_state = new_state->arcs_state;
+			hdr->b_l2arcs_state = new_state->arcs_state;
 			l2arc_hdr_arcstats_increment_state(hdr);
 		}
 	}
@@ -3357,7 +3758,7 @@ arc_hdr_realloc(arc_buf_hdr_t *hdr, kmem_cache_t *old, kmem_cache_t *new)
 	ASSERT(HDR_HAS_L2HDR(hdr));
 
 	arc_buf_hdr_t *nhdr;
-	l2arc_dev_t *dev = hdr->b_l2hdr.b_dev;
+	l2arc_dev_t *dev = l2arc_hdr_dev(hdr);
 
 	ASSERT((old == hdr_full_cache && new == hdr_l2only_cache) ||
 	    (old == hdr_l2only_cache && new == hdr_full_cache));
@@ -3415,6 +3816,7 @@ arc_hdr_realloc(arc_buf_hdr_t *hdr, kmem_cache_t *old, kmem_cache_t *new)
 		VERIFY3P(hdr->b_l1hdr.b_pabd, ==, NULL);
 		ASSERT(!HDR_HAS_RABD(hdr));
 
+		arc_hdr_clear_dataset(hdr);
 		arc_hdr_clear_flags(nhdr, ARC_FLAG_HAS_L1HDR);
 	}
 	/*
@@ -3521,6 +3923,7 @@ arc_hdr_realloc_crypt(arc_buf_hdr_t *hdr, boolean_t need_crypt)
 	nhdr->b_l1hdr.b_l2_hits = hdr->b_l1hdr.b_l2_hits;
 	nhdr->b_l1hdr.b_acb = hdr->b_l1hdr.b_acb;
 	nhdr->b_l1hdr.b_pabd = hdr->b_l1hdr.b_pabd;
+	nhdr->b_l1hdr.b_dataset = hdr->b_l1hdr.b_dataset;
 
 	/*
 	 * This zfs_refcount_add() exists only to ensure that the individual
@@ -3566,6 +3969,7 @@ arc_hdr_realloc_crypt(arc_buf_hdr_t *hdr, boolean_t need_crypt)
 	hdr->b_l1hdr.b_l2_hits = 0;
 	hdr->b_l1hdr.b_acb = NULL;
 	hdr->b_l1hdr.b_pabd = NULL;
+	hdr->b_l1hdr.b_dataset = NULL;
 
 	if (ocache == hdr_full_crypt_cache) {
 		ASSERT(!HDR_HAS_RABD(hdr));
@@ -3718,8 +4122,7 @@ static void
 l2arc_hdr_arcstats_update(arc_buf_hdr_t *hdr, boolean_t incr,
     boolean_t state_only)
 {
-	l2arc_buf_hdr_t *l2hdr = &hdr->b_l2hdr;
-	l2arc_dev_t *dev = l2hdr->b_dev;
+	l2arc_dev_t *dev = l2arc_hdr_dev(hdr);
 	uint64_t lsize = HDR_GET_LSIZE(hdr);
 	uint64_t psize = HDR_GET_PSIZE(hdr);
 	uint64_t asize = vdev_psize_to_asize(dev->l2ad_vdev, psize);
@@ -3751,7 +4154,7 @@ l2arc_hdr_arcstats_update(arc_buf_hdr_t *hdr, boolean_t incr,
 		 * possibly absent L1 header (apparent in buffers restored
 		 * from persistent L2ARC).
 		 */
-		switch (hdr->b_l2hdr.b_arcs_state) {
+		switch (hdr->b_l2arcs_state) {
 			case ARC_STATE_MRU_GHOST:
 			case ARC_STATE_MRU:
 				ARCSTAT_INCR(arcstat_l2_mru_asize, asize_s);
@@ -3787,8 +4190,7 @@ l2arc_hdr_arcstats_update(arc_buf_hdr_t *hdr, boolean_t incr,
 static void
 arc_hdr_l2hdr_destroy(arc_buf_hdr_t *hdr)
 {
-	l2arc_buf_hdr_t *l2hdr = &hdr->b_l2hdr;
-	l2arc_dev_t *dev = l2hdr->b_dev;
+	l2arc_dev_t *dev = l2arc_hdr_dev(hdr);
 	uint64_t psize = HDR_GET_PSIZE(hdr);
 	uint64_t asize = vdev_psize_to_asize(dev->l2ad_vdev, psize);
 
@@ -3818,7 +4220,7 @@ arc_hdr_destroy(arc_buf_hdr_t *hdr)
 	ASSERT(!HDR_IN_HASH_TABLE(hdr));
 
 	if (HDR_HAS_L2HDR(hdr)) {
-		l2arc_dev_t *dev = hdr->b_l2hdr.b_dev;
+		l2arc_dev_t *dev = l2arc_hdr_dev(hdr);
 		boolean_t buflist_held = MUTEX_HELD(&dev->l2ad_mtx);
 
 		if (!buflist_held)
@@ -3860,6 +4262,8 @@ arc_hdr_destroy(arc_buf_hdr_t *hdr)
 
 		if (HDR_HAS_RABD(hdr))
 			arc_hdr_free_abd(hdr, B_TRUE);
+
+		arc_hdr_clear_dataset(hdr);
 	}
 
 	ASSERT3P(hdr->b_hash_next, ==, NULL);
@@ -3904,6 +4308,310 @@ arc_buf_destroy(arc_buf_t *buf, void* tag)
 	mutex_exit(hash_lock);
 }
 
+/*
+ * Compact ghost tracking.
+ *
+ * Normally a header evicted from arc_mru or arc_mfu stays around in the
+ * matching ghost state, holding an arc_buf_hdr_t and a hash table slot,
+ * only so that a later miss on the block can be recognized as a ghost hit
+ * by arc_access() and fed into arc_adapt().  When zfs_arc_ghost_compact is
+ * set, headers without an L2ARC copy are instead destroyed on eviction and
+ * their identity (spa, DVA, birth) is recorded in a Bloom filter, one per
+ * ghost state.  A read miss which matches a filter is treated as a ghost
+ * hit on that state.
+ *
+ * Entries cannot be removed from a Bloom filter, so each filter is split
+ * into two generations.  New entries go into the current generation; once
+ * it covers half of arc_c (roughly the size of a real ghost list) or is
+ * full enough that its false positive rate would climb, the older
+ * generation is cleared and becomes the current one.  This ages the ghost
+ * history much as trimming the ghost lists in arc_evict() does.
+ *
+ * Lookups and inserts don't lock the filter, bits are set with atomics
+ * and read one word at a time.  Only rotating the generations takes
+ * agf_lock.  A lookup racing with a rotation may miss an entry of the
+ * generation being cleared, which costs no more than a lost ghost hit.
+ */
+#define	ARC_GHOST_HASHES	4	/* bits set per entry */
+#define	ARC_GHOST_BITS_PER_ENTRY 8	/* ~2% false positives when full */
+#define	ARC_GHOST_MIN_SHIFT	16
+
+typedef struct arc_ghost_gen {
+	uint64_t	agg_bytes;	/* logical bytes recorded */
+	uint64_t	agg_entries;	/* entries recorded */
+	uint64_t	agg_bits;	/* bits set in agg_map */
+	uint64_t	*agg_map;
+} arc_ghost_gen_t;
+
+typedef struct arc_ghost_filter {
+	kmutex_t	agf_lock;	/* serialises rotations */
+	volatile uint_t	agf_cur;	/* index of the current generation */
+	arc_ghost_gen_t	agf_gen[2];
+} arc_ghost_filter_t;
+
+/* Filters for arc_mru_ghost and arc_mfu_ghost, NULL when disabled. */
+static arc_ghost_filter_t *arc_ghost_filters;
+static uint64_t arc_ghost_mask;		/* bits per generation, minus one */
+
+#define	ARC_GHOST_FILTER(state)	\
+	(&arc_ghost_filters[(state) == arc_mfu_ghost ? 1 : 0])
+#define	ARC_GHOST_MAP_SIZE	((arc_ghost_mask + 1) / NBBY)
+
+static inline uint64_t
+arc_ghost_bit(uint64_t h1, uint64_t h2, int i)
+{
+	return ((h1 + i * h2) & arc_ghost_mask);
+}
+
+static boolean_t
+arc_ghost_gen_test(arc_ghost_gen_t *agg, uint64_t h1, uint64_t h2)
+{
+	for (int i = 0; i < ARC_GHOST_HASHES; i++) {
+		uint64_t bit = arc_ghost_bit(h1, h2, i);
+		volatile uint64_t *word = &agg->agg_map[bit >> 6];
+
+		if ((*word & (1ULL << (bit & 63))) == 0)
+			return (B_FALSE);
+	}
+	return (B_TRUE);
+}
+
+static void
+arc_ghost_gen_set(arc_ghost_gen_t *agg, uint64_t h1, uint64_t h2)
+{
+	for (int i = 0; i < ARC_GHOST_HASHES; i++) {
+		uint64_t bit = arc_ghost_bit(h1, h2, i);
+		volatile uint64_t *word = &agg->agg_map[bit >> 6];
+		uint64_t mask = 1ULL << (bit & 63);
+		uint64_t old;
+
+		do {
+			old = *word;
+			if (old & mask)
+				break;
+		} while (atomic_cas_64(word, old, old | mask) != old);
+
+		if ((old & mask) == 0)
+			atomic_inc_64(&agg->agg_bits);
+	}
+}
+
+static boolean_t
+arc_ghost_gen_full(arc_ghost_gen_t *agg)
+{
+	return (agg->agg_bytes >= arc_c / 2 || agg->agg_entries >=
+	    (arc_ghost_mask + 1) / ARC_GHOST_BITS_PER_ENTRY);
+}
+
+/*
+ * Derive the two hashes used for double hashing from the block identity.
+ */
+static void
+arc_ghost_hash(arc_buf_hdr_t *hdr, uint64_t *h1, uint64_t *h2)
+{
+	uint64_t h = buf_hash(hdr->b_spa, &hdr->b_dva, hdr->b_birth);
+
+	*h1 = h;
+	*h2 = ((h >> 32) | (h << 32)) * 0x9E3779B97F4A7C15ULL | 1;
+}
+
+/*
+ * Clear the older generation and make it current, if the current one is
+ * still over its limits once we hold agf_lock.  Callers may hold hash and
+ * sublist locks, so never wait for the filter here; whoever records the
+ * next entry will try again.
+ */
+static void
+arc_ghost_rotate(arc_ghost_filter_t *agf)
+{
+	if (!mutex_tryenter(&agf->agf_lock))
+		return;
+
+	arc_ghost_gen_t *cur = &agf->agf_gen[agf->agf_cur];
+	if (arc_ghost_gen_full(cur)) {
+		uint_t next = agf->agf_cur ^ 1;
+		arc_ghost_gen_t *old = &agf->agf_gen[next];
+
+		bzero(old->agg_map, ARC_GHOST_MAP_SIZE);
+		old->agg_bytes = 0;
+		old->agg_entries = 0;
+		old->agg_bits = 0;
+		membar_producer();
+		agf->agf_cur = next;
+		ARCSTAT_BUMP(arcstat_ghost_compact_rotations);
+	}
+	mutex_exit(&agf->agf_lock);
+}
+
+/*
+ * Record that the header, which is about to be destroyed, would otherwise
+ * have been moved to the given ghost state.
+ */
+static void
+arc_ghost_insert(arc_state_t *state, arc_buf_hdr_t *hdr)
+{
+	arc_ghost_filter_t *agf = ARC_GHOST_FILTER(state);
+	uint64_t h1, h2, lsize = HDR_GET_LSIZE(hdr);
+
+	ASSERT(GHOST_STATE(state));
+	arc_ghost_hash(hdr, &h1, &h2);
+
+	arc_ghost_gen_t *cur = &agf->agf_gen[agf->agf_cur];
+	arc_ghost_gen_set(cur, h1, h2);
+	atomic_add_64(&cur->agg_bytes, lsize);
+	atomic_inc_64(&cur->agg_entries);
+
+	if (arc_ghost_gen_full(cur))
+		arc_ghost_rotate(agf);
+}
+
+/*
+ * Return the ghost state whose filter matches the header, or NULL.  The
+ * MFU filter is checked first since a block found in both was most
+ * recently evicted from arc_mfu.
+ */
+static arc_state_t *
+arc_ghost_lookup(arc_buf_hdr_t *hdr)
+{
+	arc_state_t *states[] = { arc_mfu_ghost, arc_mru_ghost };
+	uint64_t h1, h2;
+
+	ARCSTAT_BUMP(arcstat_ghost_compact_lookups);
+	arc_ghost_hash(hdr, &h1, &h2);
+
+	for (int s = 0; s < 2; s++) {
+		arc_ghost_filter_t *agf = ARC_GHOST_FILTER(states[s]);
+
+		if (arc_ghost_gen_test(&agf->agf_gen[0], h1, h2) ||
+		    arc_ghost_gen_test(&agf->agf_gen[1], h1, h2)) {
+			ARCSTAT_BUMP(arcstat_ghost_compact_hits);
+			return (states[s]);
+		}
+	}
+	return (NULL);
+}
+
+/*
+ * Logical bytes recorded in the filter for a ghost state, which stand in
+ * for that ghost state's size in arc_adapt().
+ */
+static uint64_t
+arc_ghost_size(arc_state_t *state)
+{
+	arc_ghost_filter_t *agf;
+
+	if (arc_ghost_filters == NULL)
+		return (0);
+	agf = ARC_GHOST_FILTER(state);
+	return (agf->agf_gen[0].agg_bytes + agf->agf_gen[1].agg_bytes);
+}
+
+/*
+ * Entries recorded in both filters, for the arcstats.
+ */
+static uint64_t
+arc_ghost_entries(void)
+{
+	uint64_t entries = 0;
+
+	if (arc_ghost_filters == NULL)
+		return (0);
+
+	for (int s = 0; s < 2; s++) {
+		for (int g = 0; g < 2; g++)
+			entries += arc_ghost_filters[s].agf_gen[g].agg_entries;
+	}
+	return (entries);
+}
+
+/*
+ * Estimated probability, in parts per million, that a lookup of a block
+ * which was never recorded matches one of the filters.  With k hashes and
+ * a fraction f of the bits set, a single generation matches with
+ * probability f^k.
+ */
+static uint64_t
+arc_ghost_fp_ppm(void)
+{
+	uint64_t miss = 1000000;
+
+	if (arc_ghost_filters == NULL)
+		return (0);
+
+	for (int s = 0; s < 2; s++) {
+		for (int g = 0; g < 2; g++) {
+			arc_ghost_gen_t *agg = &arc_ghost_filters[s].agf_gen[g];
+			uint64_t f = agg->agg_bits * 1000000 /
+			    (arc_ghost_mask + 1);
+			uint64_t p = 1000000;
+
+			for (int i = 0; i < ARC_GHOST_HASHES; i++)
+				p = p * f / 1000000;
+			miss = miss * (1000000 - p) / 1000000;
+		}
+	}
+	return (1000000 - miss);
+}
+
+static void
+arc_ghost_init(void)
+{
+	uint64_t entries;
+	int shift;
+
+	if (!zfs_arc_ghost_compact)
+		return;
+
+	/*
+	 * Size each generation to hold half of arc_c_max worth of
+	 * average-sized (8k) blocks.
+	 */
+	entries = arc_c_max / 2 / (SPA_MINBLOCKSIZE << 4);
+	shift = MAX(ARC_GHOST_MIN_SHIFT,
+	    highbit64(entries * ARC_GHOST_BITS_PER_ENTRY - 1));
+	arc_ghost_mask = (1ULL << shift) - 1;
+
+	arc_ghost_filters = kmem_zalloc(2 * sizeof (arc_ghost_filter_t),
+	    KM_SLEEP);
+	for (int s = 0; s < 2; s++) {
+		arc_ghost_filter_t *agf = &arc_ghost_filters[s];
+
+		mutex_init(&agf->agf_lock, NULL, MUTEX_DEFAULT, NULL);
+		for (int g = 0; g < 2; g++) {
+#if defined(_KERNEL)
+			agf->agf_gen[g].agg_map =
+			    vmem_zalloc(ARC_GHOST_MAP_SIZE, KM_SLEEP);
+#else
+			agf->agf_gen[g].agg_map =
+			    kmem_zalloc(ARC_GHOST_MAP_SIZE, KM_SLEEP);
+#endif
+		}
+	}
+	ARCSTAT_INCR(arcstat_ghost_compact_mem, 4 * ARC_GHOST_MAP_SIZE);
+}
+
+static void
+arc_ghost_fini(void)
+{
+	if (arc_ghost_filters == NULL)
+		return;
+
+	for (int s = 0; s < 2; s++) {
+		arc_ghost_filter_t *agf = &arc_ghost_filters[s];
+
+		for (int g = 0; g < 2; g++) {
+#if defined(_KERNEL)
+			vmem_free(agf->agf_gen[g].agg_map, ARC_GHOST_MAP_SIZE);
+#else
+			kmem_free(agf->agf_gen[g].agg_map, ARC_GHOST_MAP_SIZE);
+#endif
+		}
+		mutex_destroy(&agf->agf_lock);
+	}
+	kmem_free(arc_ghost_filters, 2 * sizeof (arc_ghost_filter_t));
+	arc_ghost_filters = NULL;
+}
+
 /*
  * Evict the arc_buf_hdr that is provided as a parameter. The resultant
  * state of the header is dependent on its state prior to entering this
@@ -3911,6 +4619,8 @@ arc_buf_destroy(arc_buf_t *buf, void* tag)
  *
  *    - arc_mru -> arc_mru_ghost
  *    - arc_mfu -> arc_mfu_ghost
+ *    - arc_mru -> deleted (compact ghost tracking)
+ *    - arc_mfu -> deleted (compact ghost tracking)
  *    - arc_mru_ghost -> arc_l2c_only
  *    - arc_mru_ghost -> deleted
  *    - arc_mfu_ghost -> arc_l2c_only
@@ -4039,6 +4749,19 @@ arc_evict_hdr(arc_buf_hdr_t *hdr, kmutex_t *hash_lock)
 		if (HDR_HAS_RABD(hdr))
 			arc_hdr_free_abd(hdr, B_TRUE);
 
+		/*
+		 * Headers with an L2ARC copy must stay discoverable, so
+		 * they always take the ghost list route to arc_l2c_only.
+		 */
+		if (arc_ghost_filters != NULL && !HDR_HAS_L2HDR(hdr)) {
+			arc_ghost_insert(evicted_state, hdr);
+			ARCSTAT_BUMP(arcstat_deleted);
+			DTRACE_PROBE1(arc__delete, arc_buf_hdr_t *, hdr);
+			arc_change_state(arc_anon, hdr, hash_lock);
+			arc_hdr_destroy(hdr);
+			return (bytes_evicted);
+		}
+
 		arc_change_state(evicted_state, hdr, hash_lock);
 		ASSERT(HDR_IN_HASH_TABLE(hdr));
 		arc_hdr_set_flags(hdr, ARC_FLAG_IN_HASH_TABLE);
@@ -4064,7 +4787,7 @@ arc_set_need_free(void)
 
 static uint64_t
 arc_evict_state_impl(multilist_t *ml, int idx, arc_buf_hdr_t *marker,
-    uint64_t spa, int64_t bytes)
+    uint64_t spa, int64_t bytes, boolean_t over_limit)
 {
 	multilist_sublist_t *mls;
 	uint64_t bytes_evicted = 0;
@@ -4114,6 +4837,19 @@ arc_evict_state_impl(multilist_t *ml, int idx, arc_buf_hdr_t *marker,
 			continue;
 		}
 
+		/*
+		 * On a dataset limit pass, only evict buffers of datasets
+		 * which are over their share of the ARC.  The dataset can't
+		 * change while the header is on the sublist.  Skipped
+		 * headers count towards the batch, so the sublist lock is
+		 * only held for a bounded scan.
+		 */
+		if (over_limit &&
+		    !arc_dataset_over_limit(hdr->b_l1hdr.b_dataset)) {
+			evict_count++;
+			continue;
+		}
+
 		hash_lock = HDR_LOCK(hdr);
 
 		/*
@@ -4171,19 +4907,205 @@ arc_evict_state_impl(multilist_t *ml, int idx, arc_buf_hdr_t *marker,
 			cv_broadcast(&aw->aew_cv);
 		}
 	}
-	arc_set_need_free();
-	mutex_exit(&arc_evict_lock);
+	arc_set_need_free();
+	mutex_exit(&arc_evict_lock);
+
+	/*
+	 * If the ARC size is reduced from arc_c_max to arc_c_min (especially
+	 * if the average cached block is small), eviction can be on-CPU for
+	 * many seconds.  To ensure that other threads that may be bound to
+	 * this CPU are able to make progress, make a voluntary preemption
+	 * call here.
+	 */
+	cond_resched();
+
+	return (bytes_evicted);
+}
+
+/*
+ * Make one pass over the sublists [start, end) of ml, beginning with a
+ * random one, and evict up to the given number of bytes from them.  A
+ * dataset limit pass keeps taking batches from a sublist for as long as
+ * they evict something.
+ */
+static uint64_t
+arc_evict_sublists(multilist_t *ml, arc_buf_hdr_t **markers, int start,
+    int end, uint64_t spa, int64_t bytes, boolean_t over_limit)
+{
+	int num_sublists = end - start;
+	int sublist_idx = start;
+	uint64_t total_evicted = 0;
+
+	/*
+	 * Start eviction using a randomly selected sublist,
+	 * this is to try and evenly balance eviction across all
+	 * sublists. Always starting at the same sublist
+	 * (e.g. index 0) would cause evictions to favor certain
+	 * sublists over others.
+	 */
+	if (num_sublists > 1)
+		sublist_idx += spa_get_random(num_sublists);
+
+	for (int i = 0; i < num_sublists; i++) {
+		uint64_t bytes_remaining, evicted;
+
+		do {
+			if (bytes == ARC_EVICT_ALL)
+				bytes_remaining = ARC_EVICT_ALL;
+			else if (total_evicted < bytes)
+				bytes_remaining = bytes - total_evicted;
+			else
+				return (total_evicted);
+
+			evicted = arc_evict_state_impl(ml, sublist_idx,
+			    markers[sublist_idx], spa, bytes_remaining,
+			    over_limit);
+			total_evicted += evicted;
+		} while (over_limit && evicted != 0);
+
+		/* we've reached the end, wrap to the beginning */
+		if (++sublist_idx >= end)
+			sublist_idx = start;
+	}
+
+	return (total_evicted);
+}
+
+typedef struct arc_evict_arg {
+	taskq_ent_t	eva_tqent;
+	multilist_t	*eva_ml;
+	arc_buf_hdr_t	**eva_markers;
+	int		eva_start;
+	int		eva_end;
+	uint64_t	eva_spa;
+	int64_t		eva_bytes;
+	uint64_t	eva_evicted;
+} arc_evict_arg_t;
+
+/*
+ * The task arguments are allocated with the taskq, so that eviction does
+ * not allocate, and are used by one parallel pass at a time.  A pass
+ * which finds them busy evicts on its own thread instead.
+ */
+static arc_evict_arg_t *arc_evict_args;
+static kmutex_t arc_evict_args_lock;
+static kcondvar_t arc_evict_args_cv;
+static boolean_t arc_evict_args_busy;
+static int arc_evict_args_pending;
+
+/*
+ * Parallel eviction task.  Each task owns a disjoint range of sublists
+ * and keeps making passes over it until it has evicted its share, or a
+ * pass makes no progress.
+ */
+static void
+arc_evict_task(void *arg)
+{
+	arc_evict_arg_t *eva = arg;
+	uint64_t scan_evicted;
+
+	do {
+		int64_t bytes = eva->eva_bytes;
+
+		if (bytes != ARC_EVICT_ALL) {
+			if (eva->eva_evicted >= bytes)
+				break;
+			bytes -= eva->eva_evicted;
+		}
+		scan_evicted = arc_evict_sublists(eva->eva_ml,
+		    eva->eva_markers, eva->eva_start, eva->eva_end,
+		    eva->eva_spa, bytes, B_FALSE);
+		eva->eva_evicted += scan_evicted;
+	} while (scan_evicted != 0);
+
+	mutex_enter(&arc_evict_args_lock);
+	if (--arc_evict_args_pending == 0)
+		cv_broadcast(&arc_evict_args_cv);
+	mutex_exit(&arc_evict_args_lock);
+}
+
+/*
+ * Number of tasks to split the eviction of the given number of bytes
+ * across, or 1 if it should be done by the calling thread.
+ */
+static int
+arc_evict_nworkers(multilist_t *ml, int64_t bytes)
+{
+	uint64_t nworkers;
+
+	if (arc_evict_taskq == NULL)
+		return (1);
+
+	if (bytes == ARC_EVICT_ALL)
+		nworkers = arc_evict_threads;
+	else
+		nworkers = bytes / MAX(zfs_arc_evict_parallel_min, 1);
+
+	return (MAX(1, MIN(MIN(nworkers, arc_evict_threads),
+	    multilist_get_num_sublists(ml))));
+}
+
+/*
+ * Split one eviction pass over nworkers tasks on arc_evict_taskq, each
+ * evicting an even share of the bytes from its own range of sublists.
+ * Waits for its own tasks only, not for those of other passes.
+ */
+static uint64_t
+arc_evict_parallel(multilist_t *ml, arc_buf_hdr_t **markers, int nworkers,
+    uint64_t spa, int64_t bytes)
+{
+	int num_sublists = multilist_get_num_sublists(ml);
+	arc_evict_arg_t *eva = arc_evict_args;
+	uint64_t total_evicted = 0;
+
+	ASSERT3S(nworkers, <=, arc_evict_threads);
+
+	mutex_enter(&arc_evict_args_lock);
+	if (arc_evict_args_busy) {
+		mutex_exit(&arc_evict_args_lock);
+		return (arc_evict_sublists(ml, markers, 0, num_sublists,
+		    spa, bytes, B_FALSE));
+	}
+	arc_evict_args_busy = B_TRUE;
+	arc_evict_args_pending = nworkers;
+	mutex_exit(&arc_evict_args_lock);
+
+	for (int w = 0; w < nworkers; w++) {
+		eva[w].eva_ml = ml;
+		eva[w].eva_markers = markers;
+		eva[w].eva_start = w * num_sublists / nworkers;
+		eva[w].eva_end = (w + 1) * num_sublists / nworkers;
+		eva[w].eva_spa = spa;
+		if (bytes == ARC_EVICT_ALL) {
+			eva[w].eva_bytes = ARC_EVICT_ALL;
+		} else {
+			eva[w].eva_bytes = bytes / nworkers +
+			    (w == 0 ? bytes % nworkers : 0);
+		}
+		eva[w].eva_evicted = 0;
+		taskq_init_ent(&eva[w].eva_tqent);
+		taskq_dispatch_ent(arc_evict_taskq, arc_evict_task, &eva[w],
+		    0, &eva[w].eva_tqent);
+	}
 
-	/*
-	 * If the ARC size is reduced from arc_c_max to arc_c_min (especially
-	 * if the average cached block is small), eviction can be on-CPU for
-	 * many seconds.  To ensure that other threads that may be bound to
-	 * this CPU are able to make progress, make a voluntary preemption
-	 * call here.
-	 */
-	cond_resched();
+	mutex_enter(&arc_evict_args_lock);
+	while (arc_evict_args_pending != 0)
+		cv_wait(&arc_evict_args_cv, &arc_evict_args_lock);
+	mutex_exit(&arc_evict_args_lock);
 
-	return (bytes_evicted);
+	ARCSTAT_BUMP(arcstat_evict_parallel);
+	for (int w = 0; w < nworkers; w++) {
+		ARCSTAT_BUMP(arcstat_evict_tasks);
+		ARCSTAT_INCR(arcstat_evict_task_bytes, eva[w].eva_evicted);
+		ARCSTAT_MAX(arcstat_evict_task_bytes_max, eva[w].eva_evicted);
+		total_evicted += eva[w].eva_evicted;
+	}
+
+	mutex_enter(&arc_evict_args_lock);
+	arc_evict_args_busy = B_FALSE;
+	mutex_exit(&arc_evict_args_lock);
+
+	return (total_evicted);
 }
 
 /*
@@ -4237,13 +5159,39 @@ arc_evict_state(arc_state_t *state, uint64_t spa, int64_t bytes,
 		multilist_sublist_unlock(mls);
 	}
 
+	/*
+	 * If some datasets hold more than their share of the ARC, first
+	 * make a single pass which only evicts their buffers.  Then move
+	 * the markers back to the tail, so that the regular passes below
+	 * start from the oldest buffers again.
+	 */
+	if (arc_dataset_nover != 0 && bytes != ARC_EVICT_ALL &&
+	    !GHOST_STATE(state)) {
+		total_evicted = arc_evict_sublists(ml, markers, 0,
+		    num_sublists, spa, bytes, B_TRUE);
+		ARCSTAT_INCR(arcstat_evict_dataset_limit_bytes,
+		    total_evicted);
+
+		for (int i = 0; total_evicted < bytes && i < num_sublists;
+		    i++) {
+			multilist_sublist_t *mls;
+
+			mls = multilist_sublist_lock(ml, i);
+			multilist_sublist_remove(mls, markers[i]);
+			multilist_sublist_insert_tail(mls, markers[i]);
+			multilist_sublist_unlock(mls);
+		}
+	}
+
 	/*
 	 * While we haven't hit our target number of bytes to evict, or
 	 * we're evicting all available buffers.
 	 */
 	while (total_evicted < bytes || bytes == ARC_EVICT_ALL) {
-		int sublist_idx = multilist_get_random_index(ml);
-		uint64_t scan_evicted = 0;
+		int64_t bytes_remaining = (bytes == ARC_EVICT_ALL) ?
+		    ARC_EVICT_ALL : bytes - total_evicted;
+		int nworkers = arc_evict_nworkers(ml, bytes_remaining);
+		uint64_t scan_evicted;
 
 		/*
 		 * Try to reduce pinned dnodes with a floor of arc_dnode_limit.
@@ -4257,34 +5205,14 @@ arc_evict_state(arc_state_t *state, uint64_t spa, int64_t bytes,
 			    zfs_arc_dnode_reduce_percent);
 		}
 
-		/*
-		 * Start eviction using a randomly selected sublist,
-		 * this is to try and evenly balance eviction across all
-		 * sublists. Always starting at the same sublist
-		 * (e.g. index 0) would cause evictions to favor certain
-		 * sublists over others.
-		 */
-		for (int i = 0; i < num_sublists; i++) {
-			uint64_t bytes_remaining;
-			uint64_t bytes_evicted;
-
-			if (bytes == ARC_EVICT_ALL)
-				bytes_remaining = ARC_EVICT_ALL;
-			else if (total_evicted < bytes)
-				bytes_remaining = bytes - total_evicted;
-			else
-				break;
-
-			bytes_evicted = arc_evict_state_impl(ml, sublist_idx,
-			    markers[sublist_idx], spa, bytes_remaining);
-
-			scan_evicted += bytes_evicted;
-			total_evicted += bytes_evicted;
-
-			/* we've reached the end, wrap to the beginning */
-			if (++sublist_idx >= num_sublists)
-				sublist_idx = 0;
+		if (nworkers > 1) {
+			scan_evicted = arc_evict_parallel(ml, markers,
+			    nworkers, spa, bytes_remaining);
+		} else {
+			scan_evicted = arc_evict_sublists(ml, markers, 0,
+			    num_sublists, spa, bytes_remaining, B_FALSE);
 		}
+		total_evicted += scan_evicted;
 
 		/*
 		 * If we didn't evict anything during this scan, we have
@@ -4614,6 +5542,9 @@ arc_evict(void)
 	uint64_t asize = aggsum_value(&arc_size);
 	uint64_t ameta = aggsum_value(&arc_meta_used);
 
+	arc_dataset_nover = arc_dataset_update_limit();
+	ARCSTAT(arcstat_evict_datasets_over_limit) = arc_dataset_nover;
+
 	/*
 	 * If we're over arc_meta_limit, we want to correct that before
 	 * potentially evicting data buffers below.
@@ -4876,6 +5807,7 @@ arc_kmem_reap_soon(void)
 	kmem_cache_reap_now(hdr_l2only_cache);
 	kmem_cache_reap_now(zfs_btree_leaf_cache);
 	abd_cache_reap_now();
+	zfs_zstd_cache_reap_now(B_TRUE);
 }
 
 /* ARGSUSED */
@@ -4997,7 +5929,7 @@ arc_reap_cb_check(void *arg, zthr_t *zthr)
 	 * here to avoid the need for an independent thread.
 	 */
 	if (!((reap_cb_check_counter++) % 60))
-		zfs_zstd_cache_reap_now();
+		zfs_zstd_cache_reap_now(B_FALSE);
 
 	return (B_FALSE);
 }
@@ -5108,8 +6040,10 @@ arc_adapt(int bytes, arc_state_t *state)
 {
 	int mult;
 	uint64_t arc_p_min = (arc_c >> arc_p_min_shift);
-	int64_t mrug_size = zfs_refcount_count(&arc_mru_ghost->arcs_size);
-	int64_t mfug_size = zfs_refcount_count(&arc_mfu_ghost->arcs_size);
+	int64_t mrug_size = zfs_refcount_count(&arc_mru_ghost->arcs_size) +
+	    arc_ghost_size(arc_mru_ghost);
+	int64_t mfug_size = zfs_refcount_count(&arc_mfu_ghost->arcs_size) +
+	    arc_ghost_size(arc_mfu_ghost);
 
 	ASSERT(bytes > 0);
 	/*
@@ -5429,14 +6363,47 @@ arc_access(arc_buf_hdr_t *hdr, kmutex_t *hash_lock)
 	ASSERT(HDR_HAS_L1HDR(hdr));
 
 	if (hdr->b_l1hdr.b_state == arc_anon) {
+		arc_state_t	*ghost = NULL;
+
 		/*
-		 * This buffer is not in the cache, and does not
-		 * appear in our "ghost" list.  Add the new buffer
-		 * to the MRU state.
+		 * With compact ghost tracking an evicted block leaves no
+		 * header behind, so a read miss (the only anonymous access
+		 * with I/O still in progress) has to consult the filters
+		 * to find out whether it is really a ghost hit.  Handle
+		 * that the same way as a hit on a ghost header below.
 		 */
+		if (arc_ghost_filters != NULL && HDR_IO_IN_PROGRESS(hdr))
+			ghost = arc_ghost_lookup(hdr);
 
 		ASSERT0(hdr->b_l1hdr.b_arc_access);
 		hdr->b_l1hdr.b_arc_access = ddi_get_lbolt();
+
+		if (ghost != NULL) {
+			arc_adapt(arc_hdr_size(hdr), ghost);
+			if (HDR_PREFETCH(hdr) || HDR_PRESCIENT_PREFETCH(hdr)) {
+				DTRACE_PROBE1(new_state__mru,
+				    arc_buf_hdr_t *, hdr);
+				arc_change_state(arc_mru, hdr, hash_lock);
+			} else {
+				DTRACE_PROBE1(new_state__mfu,
+				    arc_buf_hdr_t *, hdr);
+				arc_change_state(arc_mfu, hdr, hash_lock);
+			}
+			if (ghost == arc_mru_ghost) {
+				atomic_inc_32(&hdr->b_l1hdr.b_mru_ghost_hits);
+				ARCSTAT_BUMP(arcstat_mru_ghost_hits);
+			} else {
+				atomic_inc_32(&hdr->b_l1hdr.b_mfu_ghost_hits);
+				ARCSTAT_BUMP(arcstat_mfu_ghost_hits);
+			}
+			return;
+		}
+
+		/*
+		 * This buffer is not in the cache, and does not
+		 * appear in our "ghost" list.  Add the new buffer
+		 * to the MRU state.
+		 */
 		DTRACE_PROBE1(new_state__mru, arc_buf_hdr_t *, hdr);
 		arc_change_state(arc_mru, hdr, hash_lock);
 
@@ -5908,10 +6875,15 @@ arc_read_done(zio_t *zio)
  * arc_read_done() will invoke all the requested "done" functions
  * for readers of this block.
  */
-int
-arc_read(zio_t *pio, spa_t *spa, const blkptr_t *bp,
+/*
+ * If rziop is non-NULL the read zio of an ARC_FLAG_NOWAIT miss is returned
+ * there instead of being issued, and the caller must zio_nowait() it.
+ */
+static int
+arc_read_impl(zio_t *pio, spa_t *spa, const blkptr_t *bp,
     arc_read_done_func_t *done, void *private, zio_priority_t priority,
-    int zio_flags, arc_flags_t *arc_flags, const zbookmark_phys_t *zb)
+    int zio_flags, arc_flags_t *arc_flags, const zbookmark_phys_t *zb,
+    zio_t **rziop)
 {
 	arc_buf_hdr_t *hdr = NULL;
 	kmutex_t *hash_lock = NULL;
@@ -5942,6 +6914,15 @@ arc_read(zio_t *pio, spa_t *spa, const blkptr_t *bp,
 	 * on the hash_lock always set and clear the bit.
 	 */
 	fstrans_cookie_t cookie = spl_fstrans_mark();
+
+	/*
+	 * Only demand reads count towards the L2ARC admission frequency of
+	 * a block, so that a single streaming pass is not made to look
+	 * popular by its own prefetches.
+	 */
+	if (!embedded_bp && !(*arc_flags & (ARC_FLAG_PREFETCH |
+	    ARC_FLAG_PRESCIENT_PREFETCH)))
+		l2arc_admit_record(guid, bp);
 top:
 	if (!embedded_bp) {
 		/*
@@ -6093,6 +7074,8 @@ top:
 			arc_hdr_set_flags(hdr, ARC_FLAG_PRESCIENT_PREFETCH);
 		if (*arc_flags & ARC_FLAG_L2CACHE)
 			arc_hdr_set_flags(hdr, ARC_FLAG_L2CACHE);
+		if (hdr->b_l1hdr.b_dataset != NULL)
+			aggsum_add(&hdr->b_l1hdr.b_dataset->ad_hits, 1);
 		mutex_exit(hash_lock);
 		ARCSTAT_BUMP(arcstat_hits);
 		ARCSTAT_CONDSTAT(!HDR_PREFETCH(hdr),
@@ -6153,6 +7136,8 @@ top:
 				arc_hdr_destroy(hdr);
 				goto top; /* restart the IO request */
 			}
+			if (!embedded_bp)
+				arc_hdr_set_dataset(hdr, zb->zb_objset);
 		} else {
 			/*
 			 * This block is in the ghost cache or encrypted data
@@ -6198,6 +7183,9 @@ top:
 			 * do this after we've called arc_access() to
 			 * avoid hitting an assert in remove_reference().
 			 */
+			if (GHOST_STATE(hdr->b_l1hdr.b_state) ||
+			    hdr->b_l1hdr.b_state == arc_l2c_only)
+				arc_hdr_set_dataset(hdr, zb->zb_objset);
 			arc_adapt(arc_hdr_size(hdr), hdr->b_l1hdr.b_state);
 			arc_access(hdr, hash_lock);
 			arc_hdr_alloc_abd(hdr, alloc_flags);
@@ -6261,9 +7249,9 @@ top:
 		arc_hdr_set_flags(hdr, ARC_FLAG_IO_IN_PROGRESS);
 
 		if (HDR_HAS_L2HDR(hdr) &&
-		    (vd = hdr->b_l2hdr.b_dev->l2ad_vdev) != NULL) {
-			devw = hdr->b_l2hdr.b_dev->l2ad_writing;
-			addr = hdr->b_l2hdr.b_daddr;
+		    (vd = l2arc_hdr_dev(hdr)->l2ad_vdev) != NULL) {
+			devw = l2arc_hdr_dev(hdr)->l2ad_writing;
+			addr = l2arc_hdr_daddr(hdr);
 			/*
 			 * Lock out L2ARC device removal.
 			 */
@@ -6302,6 +7290,10 @@ top:
 			ARCSTAT_CONDSTAT(!HDR_PREFETCH(hdr),
 			    demand, prefetch, !HDR_ISTYPE_METADATA(hdr), data,
 			    metadata, misses);
+			if (hdr->b_l1hdr.b_dataset != NULL) {
+				aggsum_add(&hdr->b_l1hdr.b_dataset->ad_misses,
+				    1);
+			}
 			zfs_racct_read(size, 1);
 		}
 
@@ -6388,7 +7380,10 @@ top:
 				    HDR_GET_PSIZE(hdr));
 
 				if (*arc_flags & ARC_FLAG_NOWAIT) {
-					zio_nowait(rzio);
+					if (rziop != NULL)
+						*rziop = rzio;
+					else
+						zio_nowait(rzio);
 					goto out;
 				}
 
@@ -6444,7 +7439,10 @@ top:
 		}
 
 		ASSERT(*arc_flags & ARC_FLAG_NOWAIT);
-		zio_nowait(rzio);
+		if (rziop != NULL)
+			*rziop = rzio;
+		else
+			zio_nowait(rzio);
 	}
 
 out:
@@ -6455,6 +7453,57 @@ out:
 	return (rc);
 }
 
+int
+arc_read(zio_t *pio, spa_t *spa, const blkptr_t *bp,
+    arc_read_done_func_t *done, void *private, zio_priority_t priority,
+    int zio_flags, arc_flags_t *arc_flags, const zbookmark_phys_t *zb)
+{
+	return (arc_read_impl(pio, spa, bp, done, private, priority,
+	    zio_flags, arc_flags, zb, NULL));
+}
+
+/*
+ * Read a batch of blocks through the cache.  This behaves as if
+ * arc_read() had been called with ARC_FLAG_NOWAIT on each entry in turn,
+ * except that the reads for the blocks which missed are only issued once
+ * every entry has been looked up.  The hash lookups and header setup for
+ * the whole batch thus run back to back, and the vdev queue is handed the
+ * misses together, giving it the best chance to aggregate them.
+ *
+ * The result of each lookup is left in arb_error and arb_flags (which
+ * will have ARC_FLAG_CACHED set on a hit).  The done callbacks of hits run
+ * before this returns, as with arc_read(); misses complete as children of
+ * pio.  The caller must not hold any lock which the done callbacks, or
+ * other readers of the same blocks, may need, since the headers of the
+ * batch stay in the IO_IN_PROGRESS state until the batch is issued.
+ */
+void
+arc_read_batch(zio_t *pio, spa_t *spa, arc_read_batch_ent_t *arb, int n,
+    zio_priority_t priority)
+{
+	int misses = 0;
+
+	for (int i = 0; i < n; i++) {
+		ASSERT0(arb[i].arb_flags & ARC_FLAG_WAIT);
+		arb[i].arb_flags |= ARC_FLAG_NOWAIT;
+		arb[i].arb_zio = NULL;
+		arb[i].arb_error = arc_read_impl(pio, spa, &arb[i].arb_bp,
+		    arb[i].arb_done, arb[i].arb_private, priority,
+		    arb[i].arb_zio_flags, &arb[i].arb_flags, &arb[i].arb_zb,
+		    &arb[i].arb_zio);
+		if (arb[i].arb_zio != NULL)
+			misses++;
+	}
+
+	for (int i = 0; i < n && misses > 0; i++) {
+		if (arb[i].arb_zio != NULL) {
+			zio_nowait(arb[i].arb_zio);
+			arb[i].arb_zio = NULL;
+			misses--;
+		}
+	}
+}
+
 arc_prune_t *
 arc_add_prune_callback(arc_prune_func_t *func, void *private)
 {
@@ -6606,7 +7655,7 @@ arc_release(arc_buf_t *buf, void *tag)
 	ASSERT3S(zfs_refcount_count(&hdr->b_l1hdr.b_refcnt), >, 0);
 
 	if (HDR_HAS_L2HDR(hdr)) {
-		mutex_enter(&hdr->b_l2hdr.b_dev->l2ad_mtx);
+		mutex_enter(&l2arc_hdr_dev(hdr)->l2ad_mtx);
 
 		/*
 		 * We have to recheck this conditional again now that
@@ -6619,7 +7668,7 @@ arc_release(arc_buf_t *buf, void *tag)
 		if (HDR_HAS_L2HDR(hdr))
 			arc_hdr_l2hdr_destroy(hdr);
 
-		mutex_exit(&hdr->b_l2hdr.b_dev->l2ad_mtx);
+		mutex_exit(&l2arc_hdr_dev(hdr)->l2ad_mtx);
 	}
 
 	/*
@@ -7073,6 +8122,7 @@ arc_write(zio_t *pio, spa_t *spa, uint64_t txg,
 	ASSERT3U(hdr->b_l1hdr.b_bufcnt, >, 0);
 	if (l2arc)
 		arc_hdr_set_flags(hdr, ARC_FLAG_L2CACHE);
+	arc_hdr_set_dataset(hdr, zb->zb_objset);
 
 	if (ARC_BUF_ENCRYPTED(buf)) {
 		ASSERT(ARC_BUF_COMPRESSED(buf));
@@ -7272,6 +8322,13 @@ arc_kstat_update(kstat_t *ksp, int rw)
 		    &as->arcstat_mfu_ghost_size,
 		    &as->arcstat_mfu_ghost_evictable_data,
 		    &as->arcstat_mfu_ghost_evictable_metadata);
+		ARCSTAT(arcstat_ghost_compact_entries) = arc_ghost_entries();
+		ARCSTAT(arcstat_ghost_compact_size) =
+		    arc_ghost_size(arc_mru_ghost) +
+		    arc_ghost_size(arc_mfu_ghost);
+		ARCSTAT(arcstat_ghost_compact_saved) =
+		    ARCSTAT(arcstat_ghost_compact_entries) * HDR_FULL_SIZE;
+		ARCSTAT(arcstat_ghost_compact_fp_ppm) = arc_ghost_fp_ppm();
 
 		ARCSTAT(arcstat_size) = aggsum_value(&arc_size);
 		ARCSTAT(arcstat_meta_used) = aggsum_value(&arc_meta_used);
@@ -7280,6 +8337,8 @@ arc_kstat_update(kstat_t *ksp, int rw)
 		    aggsum_value(&astat_metadata_size);
 		ARCSTAT(arcstat_hdr_size) = aggsum_value(&astat_hdr_size);
 		ARCSTAT(arcstat_l2_hdr_size) = aggsum_value(&astat_l2_hdr_size);
+		ARCSTAT(arcstat_l2_hdr_saved) = ARCSTAT(arcstat_l2_hdr_size) /
+		    HDR_L2ONLY_SIZE * L2HDR_PACKED_SAVINGS;
 		ARCSTAT(arcstat_dbuf_size) = aggsum_value(&astat_dbuf_size);
 #if defined(COMPAT_FREEBSD11)
 		ARCSTAT(arcstat_other_size) = aggsum_value(&astat_bonus_size) +
@@ -7657,6 +8716,18 @@ arc_init(void)
 	arc_state_init();
 
 	buf_init();
+	arc_ghost_init();
+
+	avl_create(&arc_dataset_tree, arc_dataset_compare,
+	    sizeof (arc_dataset_t), offsetof(arc_dataset_t, ad_node));
+	rw_init(&arc_dataset_lock, NULL, RW_DEFAULT, NULL);
+	arc_dataset_ncaches = boot_ncpus;
+	arc_dataset_caches = kmem_zalloc(sizeof (arc_dataset_cache_t) *
+	    arc_dataset_ncaches, KM_SLEEP);
+	for (int c = 0; c < arc_dataset_ncaches; c++) {
+		mutex_init(&arc_dataset_caches[c].adc_lock, NULL,
+		    MUTEX_DEFAULT, NULL);
+	}
 
 	list_create(&arc_prune_list, sizeof (arc_prune_t),
 	    offsetof(arc_prune_t, p_node));
@@ -7685,6 +8756,23 @@ arc_init(void)
 		kstat_install(arc_ksp);
 	}
 
+	if (zfs_arc_evict_threads > 0) {
+		arc_evict_threads = MIN(zfs_arc_evict_threads, boot_ncpus);
+	} else {
+		/* Roughly log2 of the CPU count, none below 6 CPUs. */
+		arc_evict_threads = boot_ncpus < 6 ? 1 :
+		    MIN(16, highbit64(boot_ncpus) - 1);
+	}
+	if (arc_evict_threads > 1) {
+		arc_evict_taskq = taskq_create("arc_evict", arc_evict_threads,
+		    defclsyspri, arc_evict_threads, INT_MAX,
+		    TASKQ_PREPOPULATE);
+		arc_evict_args = kmem_zalloc(sizeof (arc_evict_arg_t) *
+		    arc_evict_threads, KM_SLEEP);
+		mutex_init(&arc_evict_args_lock, NULL, MUTEX_DEFAULT, NULL);
+		cv_init(&arc_evict_args_cv, NULL, CV_DEFAULT, NULL);
+	}
+
 	arc_evict_zthr = zthr_create("arc_evict",
 	    arc_evict_cb_check, arc_evict_cb, NULL);
 	arc_reap_zthr = zthr_create_timer("arc_reap",
@@ -7769,8 +8857,17 @@ arc_fini(void)
 	 * arc_space_return() which accesses aggsums freed in act_state_fini().
 	 */
 	buf_fini();
+	arc_ghost_fini();
 	arc_state_fini();
 
+	for (int c = 0; c < arc_dataset_ncaches; c++)
+		mutex_destroy(&arc_dataset_caches[c].adc_lock);
+	kmem_free(arc_dataset_caches, sizeof (arc_dataset_cache_t) *
+	    arc_dataset_ncaches);
+	ASSERT(avl_is_empty(&arc_dataset_tree));
+	avl_destroy(&arc_dataset_tree);
+	rw_destroy(&arc_dataset_lock);
+
 	arc_unregister_hotplug();
 
 	/*
@@ -7781,6 +8878,16 @@ arc_fini(void)
 	zthr_destroy(arc_evict_zthr);
 	zthr_destroy(arc_reap_zthr);
 
+	if (arc_evict_taskq != NULL) {
+		taskq_destroy(arc_evict_taskq);
+		arc_evict_taskq = NULL;
+		kmem_free(arc_evict_args, sizeof (arc_evict_arg_t) *
+		    arc_evict_threads);
+		arc_evict_args = NULL;
+		mutex_destroy(&arc_evict_args_lock);
+		cv_destroy(&arc_evict_args_cv);
+	}
+
 	ASSERT0(arc_loaned_bytes);
 }
 
@@ -7894,7 +9001,8 @@ arc_fini(void)
  * 6. Writes to the L2ARC devices are grouped and sent in-sequence, so that
  * the vdev queue can aggregate them into larger and fewer writes.  Each
  * device is written to in a rotor fashion, sweeping writes through
- * available space then repeating.
+ * available space then repeating.  Every device has its own feed thread,
+ * so multiple devices are filled in parallel.
  *
  * 7. The L2ARC does not store dirty content.  It never needs to flush
  * write buffers back to disk based storage.
@@ -8026,6 +9134,211 @@ arc_fini(void)
  * into account when restoring buffers.
  */
 
+/*
+ * L2ARC admission filter.
+ *
+ * Without it any eligible buffer near the tail of arc_mru and arc_mfu is
+ * written, so one-time reads from backups or scans spend the write
+ * endurance of the cache devices on data that is never read again.  When
+ * l2arc_admit is set a buffer is only written if its recent demand read
+ * frequency beats both a single access and the frequency of the buffer it
+ * is about to displace on the device (TinyLFU).
+ *
+ * Frequencies are estimated with a count-min sketch of four rows of 8-bit
+ * saturating counters, indexed by double hashing of the block identity
+ * (spa, DVA, birth) and updated from arc_read().  Only the counters of a
+ * block which hold its current estimate, the smallest of them, are
+ * incremented (conservative update), so most reads of a popular block
+ * write at most one counter.  Counter updates are not atomic; a lost
+ * increment, or one racing with the halving below, only makes a single
+ * estimate slightly off.  The recorded reads are counted per CPU, and
+ * once their sum reaches L2ARC_ADMIT_SAMPLES times the row width all
+ * counters are halved, so old popularity fades away.
+ *
+ * The sketch is allocated by the first feed after the filter is enabled
+ * and is only freed in l2arc_fini(), so readers never see it go away.
+ */
+#define	L2ARC_ADMIT_ROWS	4
+#define	L2ARC_ADMIT_MIN_SHIFT	12
+#define	L2ARC_ADMIT_MAX_SHIFT	24
+#define	L2ARC_ADMIT_SAMPLES	10
+
+typedef struct l2arc_admit_cpu {
+	uint64_t	lac_samples;	/* reads recorded since last aging */
+} ____cacheline_aligned l2arc_admit_cpu_t;
+
+typedef struct l2arc_admit_sketch {
+	uint64_t	las_mask;	/* counters per row - 1 */
+	uint64_t	las_size;	/* bytes of las_counts */
+	uint8_t		*las_counts;	/* L2ARC_ADMIT_ROWS rows */
+	uint_t		las_ncpus;
+	l2arc_admit_cpu_t *las_cpu;
+} l2arc_admit_sketch_t;
+
+static l2arc_admit_sketch_t *l2arc_admit_sketch;
+static kmutex_t l2arc_admit_lock;	/* sketch allocation and aging */
+
+static inline uint8_t *
+l2arc_admit_counter(l2arc_admit_sketch_t *las, uint64_t h1, uint64_t h2,
+    int row)
+{
+	return (&las->las_counts[row * (las->las_mask + 1) +
+	    ((h1 + row * h2) & las->las_mask)]);
+}
+
+static void
+l2arc_admit_hash(uint64_t spa, const dva_t *dva, uint64_t birth,
+    uint64_t *h1, uint64_t *h2)
+{
+	uint64_t h = buf_hash(spa, dva, birth);
+
+	*h1 = h;
+	*h2 = ((h >> 32) | (h << 32)) * 0x9E3779B97F4A7C15ULL | 1;
+}
+
+static void
+l2arc_admit_record(uint64_t spa, const blkptr_t *bp)
+{
+	l2arc_admit_sketch_t *las = l2arc_admit_sketch;
+	uint8_t *c[L2ARC_ADMIT_ROWS];
+	uint8_t freq = UINT8_MAX;
+	uint64_t h1, h2;
+
+	if (las == NULL || !l2arc_admit)
+		return;
+
+	l2arc_admit_hash(spa, BP_IDENTITY(bp), BP_PHYSICAL_BIRTH(bp),
+	    &h1, &h2);
+	for (int row = 0; row < L2ARC_ADMIT_ROWS; row++) {
+		c[row] = l2arc_admit_counter(las, h1, h2, row);
+		freq = MIN(freq, *c[row]);
+	}
+	if (freq < UINT8_MAX) {
+		for (int row = 0; row < L2ARC_ADMIT_ROWS; row++) {
+			if (*c[row] == freq)
+				*c[row] = freq + 1;
+		}
+	}
+	atomic_inc_64(&las->las_cpu[CPU_SEQID_UNSTABLE %
+	    las->las_ncpus].lac_samples);
+}
+
+static uint64_t
+l2arc_admit_estimate(l2arc_admit_sketch_t *las, arc_buf_hdr_t *hdr)
+{
+	uint64_t h1, h2, freq = UINT8_MAX;
+
+	l2arc_admit_hash(hdr->b_spa, &hdr->b_dva, hdr->b_birth, &h1, &h2);
+	for (int row = 0; row < L2ARC_ADMIT_ROWS; row++)
+		freq = MIN(freq, *l2arc_admit_counter(las, h1, h2, row));
+	return (freq);
+}
+
+/*
+ * Allocate the sketch if the filter was just enabled and age it if enough
+ * reads were recorded.  Called by the feed threads, which may run
+ * concurrently; aging is skipped if another thread is already at it.
+ */
+static l2arc_admit_sketch_t *
+l2arc_admit_prepare(void)
+{
+	l2arc_admit_sketch_t *las = l2arc_admit_sketch;
+	uint64_t samples = 0;
+
+	if (!l2arc_admit)
+		return (NULL);
+
+	if (las == NULL) {
+		mutex_enter(&l2arc_admit_lock);
+		if ((las = l2arc_admit_sketch) == NULL) {
+			/*
+			 * One counter per row for every average-sized (8k)
+			 * block that fits in arc_c_max.
+			 */
+			int shift = highbit64(arc_c_max /
+			    (SPA_MINBLOCKSIZE << 4));
+			shift = MIN(MAX(shift, L2ARC_ADMIT_MIN_SHIFT),
+			    L2ARC_ADMIT_MAX_SHIFT);
+
+			las = kmem_zalloc(sizeof (*las), KM_SLEEP);
+			las->las_mask = (1ULL << shift) - 1;
+			las->las_size = L2ARC_ADMIT_ROWS << shift;
+#if defined(_KERNEL)
+			las->las_counts = vmem_zalloc(las->las_size, KM_SLEEP);
+#else
+			las->las_counts = kmem_zalloc(las->las_size, KM_SLEEP);
+#endif
+			las->las_ncpus = boot_ncpus;
+			las->las_cpu = kmem_zalloc(las->las_ncpus *
+			    sizeof (l2arc_admit_cpu_t), KM_SLEEP);
+			membar_producer();
+			l2arc_admit_sketch = las;
+		}
+		mutex_exit(&l2arc_admit_lock);
+	}
+
+	for (uint_t i = 0; i < las->las_ncpus; i++)
+		samples += las->las_cpu[i].lac_samples;
+
+	if (samples >= (las->las_mask + 1) * L2ARC_ADMIT_SAMPLES &&
+	    mutex_tryenter(&l2arc_admit_lock)) {
+		uint64_t *words = (uint64_t *)las->las_counts;
+
+		for (uint64_t i = 0; i < las->las_size / sizeof (uint64_t); i++)
+			words[i] = (words[i] >> 1) & 0x7F7F7F7F7F7F7F7FULL;
+		/* Increments racing with the reset are kept */
+		for (uint_t i = 0; i < las->las_ncpus; i++) {
+			l2arc_admit_cpu_t *lac = &las->las_cpu[i];
+
+			atomic_add_64(&lac->lac_samples,
+			    -(int64_t)lac->lac_samples);
+		}
+		ARCSTAT_BUMP(arcstat_l2_admit_resets);
+		mutex_exit(&l2arc_admit_lock);
+	}
+
+	return (las);
+}
+
+/*
+ * Estimated frequency of the buffer which the next write to the device
+ * will displace: the oldest buffer on it, once the device has been filled.
+ */
+static uint64_t
+l2arc_admit_victim(l2arc_admit_sketch_t *las, l2arc_dev_t *dev)
+{
+	arc_buf_hdr_t *hdr;
+	uint64_t freq = 0;
+
+	mutex_enter(&dev->l2ad_mtx);
+	if (!dev->l2ad_first) {
+		hdr = list_tail(&dev->l2ad_buflist);
+		if (hdr != NULL && !HDR_L2_WRITE_HEAD(hdr))
+			freq = l2arc_admit_estimate(las, hdr);
+	}
+	mutex_exit(&dev->l2ad_mtx);
+
+	return (freq);
+}
+
+static void
+l2arc_admit_fini(void)
+{
+	l2arc_admit_sketch_t *las = l2arc_admit_sketch;
+
+	if (las == NULL)
+		return;
+
+#if defined(_KERNEL)
+	vmem_free(las->las_counts, las->las_size);
+#else
+	kmem_free(las->las_counts, las->las_size);
+#endif
+	kmem_free(las->las_cpu, las->las_ncpus * sizeof (l2arc_admit_cpu_t));
+	kmem_free(las, sizeof (*las));
+	l2arc_admit_sketch = NULL;
+}
+
 static boolean_t
 l2arc_write_eligible(uint64_t spa_guid, arc_buf_hdr_t *hdr)
 {
@@ -8113,69 +9426,6 @@ l2arc_write_interval(clock_t began, uint64_t wanted, uint64_t wrote)
 	return (next);
 }
 
-/*
- * Cycle through L2ARC devices.  This is how L2ARC load balances.
- * If a device is returned, this also returns holding the spa config lock.
- */
-static l2arc_dev_t *
-l2arc_dev_get_next(void)
-{
-	l2arc_dev_t *first, *next = NULL;
-
-	/*
-	 * Lock out the removal of spas (spa_namespace_lock), then removal
-	 * of cache devices (l2arc_dev_mtx).  Once a device has been selected,
-	 * both locks will be dropped and a spa config lock held instead.
-	 */
-	mutex_enter(&spa_namespace_lock);
-	mutex_enter(&l2arc_dev_mtx);
-
-	/* if there are no vdevs, there is nothing to do */
-	if (l2arc_ndev == 0)
-		goto out;
-
-	first = NULL;
-	next = l2arc_dev_last;
-	do {
-		/* loop around the list looking for a non-faulted vdev */
-		if (next == NULL) {
-			next = list_head(l2arc_dev_list);
-		} else {
-			next = list_next(l2arc_dev_list, next);
-			if (next == NULL)
-				next = list_head(l2arc_dev_list);
-		}
-
-		/* if we have come back to the start, bail out */
-		if (first == NULL)
-			first = next;
-		else if (next == first)
-			break;
-
-	} while (vdev_is_dead(next->l2ad_vdev) || next->l2ad_rebuild ||
-	    next->l2ad_trim_all);
-
-	/* if we were unable to find any usable vdevs, return NULL */
-	if (vdev_is_dead(next->l2ad_vdev) || next->l2ad_rebuild ||
-	    next->l2ad_trim_all)
-		next = NULL;
-
-	l2arc_dev_last = next;
-
-out:
-	mutex_exit(&l2arc_dev_mtx);
-
-	/*
-	 * Grab the config lock to prevent the 'next' device from being
-	 * removed while we are writing to it.
-	 */
-	if (next != NULL)
-		spa_config_enter(next->l2ad_spa, SCL_L2ARC, next, RW_READER);
-	mutex_exit(&spa_namespace_lock);
-
-	return (next);
-}
-
 /*
  * Free buffers that were tagged for destruction.
  */
@@ -8852,8 +10102,8 @@ retry:
 		ASSERT(!HDR_L2_WRITING(hdr));
 		ASSERT(!HDR_L2_WRITE_HEAD(hdr));
 
-		if (!all && (hdr->b_l2hdr.b_daddr >= dev->l2ad_evict ||
-		    hdr->b_l2hdr.b_daddr < dev->l2ad_hand)) {
+		if (!all && (l2arc_hdr_daddr(hdr) >= dev->l2ad_evict ||
+		    l2arc_hdr_daddr(hdr) < dev->l2ad_hand)) {
 			/*
 			 * We've evicted to the target address,
 			 * or the end of the device.
@@ -8973,7 +10223,7 @@ l2arc_apply_transforms(spa_t *spa, arc_buf_hdr_t *hdr, uint64_t asize,
 		tmp = abd_borrow_buf(cabd, asize);
 
 		psize = zio_compress_data(compress, to_write, tmp, size,
-		    hdr->b_complevel);
+		    hdr->b_complevel, B_FALSE);
 
 		if (psize >= size) {
 			abd_return_buf(cabd, tmp, asize);
@@ -9080,9 +10330,15 @@ l2arc_write_buffers(spa_t *spa, l2arc_dev_t *dev, uint64_t target_sz)
 	zio_t 			*pio, *wzio;
 	uint64_t 		guid = spa_load_guid(spa);
 	l2arc_dev_hdr_phys_t	*l2dhdr = dev->l2ad_dev_hdr;
+	l2arc_admit_sketch_t	*las;
+	uint64_t		admit_freq = 0;
 
 	ASSERT3P(dev->l2ad_vdev, !=, NULL);
 
+	las = l2arc_admit_prepare();
+	if (las != NULL)
+		admit_freq = MAX(l2arc_admit_victim(las, dev), 1) + 1;
+
 	pio = NULL;
 	write_lsize = write_asize = write_psize = 0;
 	full = B_FALSE;
@@ -9153,6 +10409,14 @@ l2arc_write_buffers(spa_t *spa, l2arc_dev_t *dev, uint64_t target_sz)
 				continue;
 			}
 
+			if (las != NULL &&
+			    l2arc_admit_estimate(las, hdr) < admit_freq) {
+				ARCSTAT_INCR(arcstat_l2_reject_bytes,
+				    HDR_GET_LSIZE(hdr));
+				mutex_exit(hash_lock);
+				continue;
+			}
+
 			/*
 			 * We rely on the L1 portion of the header below, so
 			 * it's invalid for this header to have been evicted out
@@ -9175,6 +10439,11 @@ l2arc_write_buffers(spa_t *spa, l2arc_dev_t *dev, uint64_t target_sz)
 				break;
 			}
 
+			if (las != NULL) {
+				ARCSTAT_INCR(arcstat_l2_admit_bytes,
+				    HDR_GET_LSIZE(hdr));
+			}
+
 			/*
 			 * We rely on the L1 portion of the header below, so
 			 * it's invalid for this header to have been evicted out
@@ -9251,11 +10520,11 @@ l2arc_write_buffers(spa_t *spa, l2arc_dev_t *dev, uint64_t target_sz)
 				    ZIO_FLAG_CANFAIL);
 			}
 
-			hdr->b_l2hdr.b_dev = dev;
+			l2arc_hdr_set_dev(hdr, dev);
 			hdr->b_l2hdr.b_hits = 0;
 
-			hdr->b_l2hdr.b_daddr = dev->l2ad_hand;
-			hdr->b_l2hdr.b_arcs_state =
+			l2arc_hdr_set_daddr(hdr, dev->l2ad_hand);
+			hdr->b_l2arcs_state =
 			    hdr->b_l1hdr.b_state->arcs_state;
 			arc_hdr_set_flags(hdr, ARC_FLAG_HAS_L2HDR);
 
@@ -9267,7 +10536,7 @@ l2arc_write_buffers(spa_t *spa, l2arc_dev_t *dev, uint64_t target_sz)
 			    arc_hdr_size(hdr), hdr);
 
 			wzio = zio_write_phys(pio, dev->l2ad_vdev,
-			    hdr->b_l2hdr.b_daddr, asize, to_write,
+			    dev->l2ad_hand, asize, to_write,
 			    ZIO_CHECKSUM_OFF, NULL, hdr,
 			    ZIO_PRIORITY_ASYNC_WRITE,
 			    ZIO_FLAG_CANFAIL, B_FALSE);
@@ -9349,57 +10618,57 @@ l2arc_hdr_limit_reached(void)
 
 /*
  * This thread feeds the L2ARC at regular intervals.  This is the beating
- * heart of the L2ARC.
+ * heart of the L2ARC.  Each cache device has its own feed thread, so that
+ * devices are filled in parallel, each with its own write size and
+ * interval accounting.
  */
-/* ARGSUSED */
 static void
-l2arc_feed_thread(void *unused)
+l2arc_feed_thread(void *arg)
 {
+	l2arc_dev_t *dev = arg;
+	l2arc_dev_stats_t *ds = &dev->l2ad_feed_stats;
+	spa_t *spa = dev->l2ad_spa;
 	callb_cpr_t cpr;
-	l2arc_dev_t *dev;
-	spa_t *spa;
 	uint64_t size, wrote;
 	clock_t begin, next = ddi_get_lbolt();
 	fstrans_cookie_t cookie;
 
-	CALLB_CPR_INIT(&cpr, &l2arc_feed_thr_lock, callb_generic_cpr, FTAG);
+	ASSERT3P(spa, !=, NULL);
+
+	CALLB_CPR_INIT(&cpr, &dev->l2ad_feed_lock, callb_generic_cpr, FTAG);
 
-	mutex_enter(&l2arc_feed_thr_lock);
+	mutex_enter(&dev->l2ad_feed_lock);
 
 	cookie = spl_fstrans_mark();
-	while (l2arc_thread_exit == 0) {
+	while (!dev->l2ad_feed_exit) {
 		CALLB_CPR_SAFE_BEGIN(&cpr);
-		(void) cv_timedwait_idle(&l2arc_feed_thr_cv,
-		    &l2arc_feed_thr_lock, next);
-		CALLB_CPR_SAFE_END(&cpr, &l2arc_feed_thr_lock);
+		(void) cv_timedwait_idle(&dev->l2ad_feed_cv,
+		    &dev->l2ad_feed_lock, next);
+		CALLB_CPR_SAFE_END(&cpr, &dev->l2ad_feed_lock);
 		next = ddi_get_lbolt() + hz;
 
+		if (dev->l2ad_feed_exit)
+			break;
+
 		/*
-		 * Quick check for L2ARC devices.
+		 * Skip the device while it is faulted, being rebuilt or
+		 * being trimmed.
 		 */
-		mutex_enter(&l2arc_dev_mtx);
-		if (l2arc_ndev == 0) {
-			mutex_exit(&l2arc_dev_mtx);
+		if (vdev_is_dead(dev->l2ad_vdev) || dev->l2ad_rebuild ||
+		    dev->l2ad_trim_all)
 			continue;
-		}
-		mutex_exit(&l2arc_dev_mtx);
-		begin = ddi_get_lbolt();
 
 		/*
-		 * This selects the next l2arc device to write to, and in
-		 * doing so the next spa to feed from: dev->l2ad_spa.   This
-		 * will return NULL if there are now no l2arc devices or if
-		 * they are all faulted.
-		 *
-		 * If a device is returned, its spa's config lock is also
-		 * held to prevent device removal.  l2arc_dev_get_next()
-		 * will grab and release l2arc_dev_mtx.
+		 * Hold the config lock to prevent the device from being
+		 * removed while we are writing to it.  Never wait for it,
+		 * since l2arc_remove_vdev() may hold it while waiting for
+		 * this thread to exit.
 		 */
-		if ((dev = l2arc_dev_get_next()) == NULL)
+		if (!spa_config_tryenter(spa, SCL_L2ARC, dev, RW_READER)) {
+			ds->l2ds_feed_busy.value.ui64++;
 			continue;
-
-		spa = dev->l2ad_spa;
-		ASSERT3P(spa, !=, NULL);
+		}
+		begin = ddi_get_lbolt();
 
 		/*
 		 * If the pool is read-only then force the feed thread to
@@ -9416,11 +10685,13 @@ l2arc_feed_thread(void *unused)
 		 */
 		if (l2arc_hdr_limit_reached()) {
 			ARCSTAT_BUMP(arcstat_l2_abort_lowmem);
+			ds->l2ds_abort_lowmem.value.ui64++;
 			spa_config_exit(spa, SCL_L2ARC, dev);
 			continue;
 		}
 
 		ARCSTAT_BUMP(arcstat_l2_feeds);
+		ds->l2ds_feeds.value.ui64++;
 
 		size = l2arc_write_size(dev);
 
@@ -9433,21 +10704,77 @@ l2arc_feed_thread(void *unused)
 		 * Write ARC buffers.
 		 */
 		wrote = l2arc_write_buffers(spa, dev, size);
+		ds->l2ds_write_target.value.ui64 += size;
+		ds->l2ds_write_bytes.value.ui64 += wrote;
 
 		/*
 		 * Calculate interval between writes.
 		 */
 		next = l2arc_write_interval(begin, size, wrote);
+		ds->l2ds_feed_interval_ms.value.ui64 =
+		    (uint64_t)(next - begin) * MILLISEC / hz;
 		spa_config_exit(spa, SCL_L2ARC, dev);
 	}
 	spl_fstrans_unmark(cookie);
 
-	l2arc_thread_exit = 0;
-	cv_broadcast(&l2arc_feed_thr_cv);
-	CALLB_CPR_EXIT(&cpr);		/* drops l2arc_feed_thr_lock */
+	dev->l2ad_feed_thread = NULL;
+	cv_broadcast(&dev->l2ad_feed_cv);
+	CALLB_CPR_EXIT(&cpr);		/* drops l2ad_feed_lock */
 	thread_exit();
 }
 
+static void
+l2arc_feed_start(l2arc_dev_t *dev)
+{
+	ASSERT(MUTEX_HELD(&l2arc_dev_mtx));
+	ASSERT3P(dev->l2ad_feed_thread, ==, NULL);
+
+	dev->l2ad_feed_exit = B_FALSE;
+	dev->l2ad_feed_thread = thread_create(NULL, 0, l2arc_feed_thread,
+	    dev, 0, &p0, TS_RUN, defclsyspri);
+}
+
+static void
+l2arc_feed_stop(l2arc_dev_t *dev)
+{
+	mutex_enter(&dev->l2ad_feed_lock);
+	dev->l2ad_feed_exit = B_TRUE;
+	cv_signal(&dev->l2ad_feed_cv);	/* kick thread out of its wait */
+	while (dev->l2ad_feed_thread != NULL)
+		cv_wait(&dev->l2ad_feed_cv, &dev->l2ad_feed_lock);
+	mutex_exit(&dev->l2ad_feed_lock);
+}
+
+static const l2arc_dev_stats_t l2arc_dev_stats_template = {
+	{ "feeds",			KSTAT_DATA_UINT64 },
+	{ "feed_busy",			KSTAT_DATA_UINT64 },
+	{ "abort_lowmem",		KSTAT_DATA_UINT64 },
+	{ "write_target",		KSTAT_DATA_UINT64 },
+	{ "write_bytes",		KSTAT_DATA_UINT64 },
+	{ "feed_interval_ms",		KSTAT_DATA_UINT64 },
+};
+
+static void
+l2arc_dev_kstat_init(l2arc_dev_t *dev)
+{
+	char *module = kmem_asprintf("zfs/%s", spa_name(dev->l2ad_spa));
+	char *name = kmem_asprintf("l2arc-%llu",
+	    (u_longlong_t)dev->l2ad_vdev->vdev_guid);
+
+	bcopy(&l2arc_dev_stats_template, &dev->l2ad_feed_stats,
+	    sizeof (l2arc_dev_stats_t));
+	dev->l2ad_feed_ksp = kstat_create(module, 0, name, "misc",
+	    KSTAT_TYPE_NAMED, sizeof (l2arc_dev_stats_t) /
+	    sizeof (kstat_named_t), KSTAT_FLAG_VIRTUAL);
+	if (dev->l2ad_feed_ksp != NULL) {
+		dev->l2ad_feed_ksp->ks_data = &dev->l2ad_feed_stats;
+		kstat_install(dev->l2ad_feed_ksp);
+	}
+
+	kmem_strfree(name);
+	kmem_strfree(module);
+}
+
 boolean_t
 l2arc_vdev_present(vdev_t *vd)
 {
@@ -9483,6 +10810,7 @@ l2arc_add_vdev(spa_t *spa, vdev_t *vd)
 {
 	l2arc_dev_t		*adddev;
 	uint64_t		l2dhdr_asize;
+	uint_t			id;
 
 	ASSERT(!l2arc_vdev_present(vd));
 
@@ -9490,6 +10818,24 @@ l2arc_add_vdev(spa_t *spa, vdev_t *vd)
 	 * Create a new l2arc device entry.
 	 */
 	adddev = vmem_zalloc(sizeof (l2arc_dev_t), KM_SLEEP);
+
+	/*
+	 * Headers refer to the device by its index in l2arc_dev_ids, so it
+	 * can only be used while there is a free one.
+	 */
+	mutex_enter(&l2arc_dev_mtx);
+	for (id = 0; id < L2ARC_DEV_MAX && l2arc_dev_ids[id] != NULL; id++)
+		;
+	if (id < L2ARC_DEV_MAX)
+		l2arc_dev_ids[id] = adddev;
+	mutex_exit(&l2arc_dev_mtx);
+	if (id == L2ARC_DEV_MAX) {
+		zfs_dbgmsg("L2ARC: more than %d cache devices, not using %s",
+		    L2ARC_DEV_MAX, vd->vdev_path ? vd->vdev_path : "?");
+		vmem_free(adddev, sizeof (l2arc_dev_t));
+		return;
+	}
+	adddev->l2ad_id = id;
 	adddev->l2ad_spa = spa;
 	adddev->l2ad_vdev = vd;
 	/* leave extra size for an l2arc device header */
@@ -9498,6 +10844,10 @@ l2arc_add_vdev(spa_t *spa, vdev_t *vd)
 	adddev->l2ad_start = VDEV_LABEL_START_SIZE + l2dhdr_asize;
 	adddev->l2ad_end = VDEV_LABEL_START_SIZE + vdev_get_min_asize(vd);
 	ASSERT3U(adddev->l2ad_start, <, adddev->l2ad_end);
+	adddev->l2ad_daddr_shift = vd->vdev_ashift;
+	/* Only use as much of the device as headers can address */
+	adddev->l2ad_end = MIN(adddev->l2ad_end, adddev->l2ad_start +
+	    (L2ARC_DADDR_MAX << adddev->l2ad_daddr_shift));
 	adddev->l2ad_hand = adddev->l2ad_start;
 	adddev->l2ad_evict = adddev->l2ad_start;
 	adddev->l2ad_first = B_TRUE;
@@ -9507,6 +10857,9 @@ l2arc_add_vdev(spa_t *spa, vdev_t *vd)
 	adddev->l2ad_dev_hdr = kmem_zalloc(l2dhdr_asize, KM_SLEEP);
 
 	mutex_init(&adddev->l2ad_mtx, NULL, MUTEX_DEFAULT, NULL);
+	mutex_init(&adddev->l2ad_feed_lock, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&adddev->l2ad_feed_cv, NULL, CV_DEFAULT, NULL);
+	l2arc_dev_kstat_init(adddev);
 	/*
 	 * This is a list of all ARC buffers that are still valid on the
 	 * device.
@@ -9532,6 +10885,8 @@ l2arc_add_vdev(spa_t *spa, vdev_t *vd)
 	mutex_enter(&l2arc_dev_mtx);
 	list_insert_head(l2arc_dev_list, adddev);
 	atomic_inc_64(&l2arc_ndev);
+	if (l2arc_feed_enabled)
+		l2arc_feed_start(adddev);
 	mutex_exit(&l2arc_dev_mtx);
 
 	/*
@@ -9651,18 +11006,31 @@ l2arc_remove_vdev(vdev_t *vd)
 	 */
 	mutex_enter(&l2arc_dev_mtx);
 	list_remove(l2arc_dev_list, remdev);
-	l2arc_dev_last = NULL;		/* may have been invalidated */
 	atomic_dec_64(&l2arc_ndev);
 	mutex_exit(&l2arc_dev_mtx);
 
+	/*
+	 * Stop feeding the device.
+	 */
+	if (remdev->l2ad_feed_thread != NULL)
+		l2arc_feed_stop(remdev);
+	if (remdev->l2ad_feed_ksp != NULL)
+		kstat_delete(remdev->l2ad_feed_ksp);
+
 	/*
 	 * Clear all buflists and ARC references.  L2ARC device flush.
 	 */
 	l2arc_evict(remdev, 0, B_TRUE);
+	mutex_enter(&l2arc_dev_mtx);
+	ASSERT3P(l2arc_dev_ids[remdev->l2ad_id], ==, remdev);
+	l2arc_dev_ids[remdev->l2ad_id] = NULL;
+	mutex_exit(&l2arc_dev_mtx);
 	list_destroy(&remdev->l2ad_buflist);
 	ASSERT(list_is_empty(&remdev->l2ad_lbptr_list));
 	list_destroy(&remdev->l2ad_lbptr_list);
 	mutex_destroy(&remdev->l2ad_mtx);
+	mutex_destroy(&remdev->l2ad_feed_lock);
+	cv_destroy(&remdev->l2ad_feed_cv);
 	zfs_refcount_destroy(&remdev->l2ad_alloc);
 	zfs_refcount_destroy(&remdev->l2ad_lb_asize);
 	zfs_refcount_destroy(&remdev->l2ad_lb_count);
@@ -9673,17 +11041,16 @@ l2arc_remove_vdev(vdev_t *vd)
 void
 l2arc_init(void)
 {
-	l2arc_thread_exit = 0;
+	l2arc_feed_enabled = B_FALSE;
 	l2arc_ndev = 0;
 	l2arc_writes_sent = 0;
 	l2arc_writes_done = 0;
 
-	mutex_init(&l2arc_feed_thr_lock, NULL, MUTEX_DEFAULT, NULL);
-	cv_init(&l2arc_feed_thr_cv, NULL, CV_DEFAULT, NULL);
 	mutex_init(&l2arc_rebuild_thr_lock, NULL, MUTEX_DEFAULT, NULL);
 	cv_init(&l2arc_rebuild_thr_cv, NULL, CV_DEFAULT, NULL);
 	mutex_init(&l2arc_dev_mtx, NULL, MUTEX_DEFAULT, NULL);
 	mutex_init(&l2arc_free_on_write_mtx, NULL, MUTEX_DEFAULT, NULL);
+	mutex_init(&l2arc_admit_lock, NULL, MUTEX_DEFAULT, NULL);
 
 	l2arc_dev_list = &L2ARC_dev_list;
 	l2arc_free_on_write = &L2ARC_free_on_write;
@@ -9696,25 +11063,35 @@ l2arc_init(void)
 void
 l2arc_fini(void)
 {
-	mutex_destroy(&l2arc_feed_thr_lock);
-	cv_destroy(&l2arc_feed_thr_cv);
 	mutex_destroy(&l2arc_rebuild_thr_lock);
 	cv_destroy(&l2arc_rebuild_thr_cv);
 	mutex_destroy(&l2arc_dev_mtx);
 	mutex_destroy(&l2arc_free_on_write_mtx);
+	l2arc_admit_fini();
+	mutex_destroy(&l2arc_admit_lock);
 
 	list_destroy(l2arc_dev_list);
 	list_destroy(l2arc_free_on_write);
 }
 
+/*
+ * Enable the per-device feed threads, which are started as cache devices
+ * are added (see l2arc_add_vdev()).
+ */
 void
 l2arc_start(void)
 {
 	if (!(spa_mode_global & SPA_MODE_WRITE))
 		return;
 
-	(void) thread_create(NULL, 0, l2arc_feed_thread, NULL, 0, &p0,
-	    TS_RUN, defclsyspri);
+	mutex_enter(&l2arc_dev_mtx);
+	l2arc_feed_enabled = B_TRUE;
+	for (l2arc_dev_t *dev = list_head(l2arc_dev_list); dev != NULL;
+	    dev = list_next(l2arc_dev_list, dev)) {
+		if (dev->l2ad_feed_thread == NULL)
+			l2arc_feed_start(dev);
+	}
+	mutex_exit(&l2arc_dev_mtx);
 }
 
 void
@@ -9723,12 +11100,14 @@ l2arc_stop(void)
 	if (!(spa_mode_global & SPA_MODE_WRITE))
 		return;
 
-	mutex_enter(&l2arc_feed_thr_lock);
-	cv_signal(&l2arc_feed_thr_cv);	/* kick thread out of startup */
-	l2arc_thread_exit = 1;
-	while (l2arc_thread_exit != 0)
-		cv_wait(&l2arc_feed_thr_cv, &l2arc_feed_thr_lock);
-	mutex_exit(&l2arc_feed_thr_lock);
+	mutex_enter(&l2arc_dev_mtx);
+	l2arc_feed_enabled = B_FALSE;
+	for (l2arc_dev_t *dev = list_head(l2arc_dev_list); dev != NULL;
+	    dev = list_next(l2arc_dev_list, dev)) {
+		if (dev->l2ad_feed_thread != NULL)
+			l2arc_feed_stop(dev);
+	}
+	mutex_exit(&l2arc_dev_mtx);
 }
 
 /*
@@ -10297,9 +11676,9 @@ l2arc_hdr_restore(const l2arc_log_ent_phys_t *le, l2arc_dev_t *dev)
 		 */
 		if (!HDR_HAS_L2HDR(exists)) {
 			arc_hdr_set_flags(exists, ARC_FLAG_HAS_L2HDR);
-			exists->b_l2hdr.b_dev = dev;
-			exists->b_l2hdr.b_daddr = le->le_daddr;
-			exists->b_l2hdr.b_arcs_state =
+			l2arc_hdr_set_dev(exists, dev);
+			l2arc_hdr_set_daddr(exists, le->le_daddr);
+			exists->b_l2arcs_state =
 			    L2BLK_GET_STATE((le)->le_prop);
 			mutex_enter(&dev->l2ad_mtx);
 			list_insert_tail(&dev->l2ad_buflist, exists);
@@ -10442,7 +11821,7 @@ l2arc_log_blk_commit(l2arc_dev_t *dev, zio_t *pio, l2arc_write_callback_t *cb)
 
 	/* try to compress the buffer */
 	psize = zio_compress_data(ZIO_COMPRESS_LZ4,
-	    abd_buf->abd, tmpbuf, sizeof (*lb), 0);
+	    abd_buf->abd, tmpbuf, sizeof (*lb), 0, B_FALSE);
 
 	/* a log block is never entirely zero */
 	ASSERT(psize != 0);
@@ -10593,7 +11972,7 @@ l2arc_log_blk_insert(l2arc_dev_t *dev, const arc_buf_hdr_t *hdr)
 	bzero(le, sizeof (*le));
 	le->le_dva = hdr->b_dva;
 	le->le_birth = hdr->b_birth;
-	le->le_daddr = hdr->b_l2hdr.b_daddr;
+	le->le_daddr = l2arc_hdr_daddr(hdr);
 	if (index == 0)
 		dev->l2ad_log_blk_payload_start = le->le_daddr;
 	L2BLK_SET_LSIZE((le)->le_prop, HDR_GET_LSIZE(hdr));
@@ -10755,6 +12134,9 @@ ZFS_MODULE_PARAM(zfs_l2arc, l2arc_, rebuild_blocks_min_l2size, ULONG, ZMOD_RW,
 ZFS_MODULE_PARAM(zfs_l2arc, l2arc_, mfuonly, INT, ZMOD_RW,
 	"Cache only MFU data from ARC into L2ARC");
 
+ZFS_MODULE_PARAM(zfs_l2arc, l2arc_, admit, INT, ZMOD_RW,
+	"Only cache buffers read more often than the ones they replace");
+
 ZFS_MODULE_PARAM_CALL(zfs_arc, zfs_arc_, lotsfree_percent, param_set_arc_int,
 	param_get_int, ZMOD_RW, "System free memory I/O throttle in bytes");
 
@@ -10776,4 +12158,16 @@ ZFS_MODULE_PARAM(zfs_arc, zfs_arc_, eviction_pct, INT, ZMOD_RW,
 
 ZFS_MODULE_PARAM(zfs_arc, zfs_arc_, evict_batch_limit, INT, ZMOD_RW,
 	"The number of headers to evict per sublist before moving to the next");
+
+ZFS_MODULE_PARAM(zfs_arc, zfs_arc_, evict_threads, INT, ZMOD_RD,
+	"Number of threads to use for parallel ARC eviction (0 = auto)");
+
+ZFS_MODULE_PARAM(zfs_arc, zfs_arc_, evict_parallel_min, ULONG, ZMOD_RW,
+	"Minimum bytes to evict per additional parallel eviction thread");
+
+ZFS_MODULE_PARAM(zfs_arc, zfs_arc_, ghost_compact, INT, ZMOD_RD,
+	"Track ghost list entries in compact filters instead of headers");
+
+ZFS_MODULE_PARAM(zfs_arc, zfs_arc_, dataset_limit_percent, INT, ZMOD_RW,
+	"Percent of arc_c a single dataset may hold before it is evicted first");
 /* END CSTYLED */
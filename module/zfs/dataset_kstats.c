@@ -24,6 +24,7 @@
  * Copyright (c) 2018 Datto Inc.
  */
 
+#include <sys/arc.h>
 #include <sys/dataset_kstats.h>
 #include <sys/dmu_objset.h>
 #include <sys/dsl_dataset.h>
@@ -37,6 +38,9 @@ static dataset_kstat_values_t empty_dataset_kstats = {
 	{ "nread",	KSTAT_DATA_UINT64 },
 	{ "nunlinks",	KSTAT_DATA_UINT64 },
 	{ "nunlinked",	KSTAT_DATA_UINT64 },
+	{ "arc_size",	KSTAT_DATA_UINT64 },
+	{ "arc_hits",	KSTAT_DATA_UINT64 },
+	{ "arc_misses",	KSTAT_DATA_UINT64 },
 };
 
 static int
@@ -61,6 +65,8 @@ dataset_kstats_update(kstat_t *ksp, int rw)
 	    aggsum_value(&dk->dk_aggsums.das_nunlinks);
 	dkv->dkv_nunlinked.value.ui64 =
 	    aggsum_value(&dk->dk_aggsums.das_nunlinked);
+	arc_dataset_stats(dk->dk_arc, &dkv->dkv_arc_size.value.ui64,
+	    &dkv->dkv_arc_hits.value.ui64, &dkv->dkv_arc_misses.value.ui64);
 
 	return (0);
 }
@@ -137,6 +143,9 @@ dataset_kstats_create(dataset_kstats_t *dk, objset_t *objset)
 	kstat->ks_private = dk;
 	kstat->ks_data_size += ZFS_MAX_DATASET_NAME_LEN;
 
+	dk->dk_arc = arc_dataset_register(dmu_objset_spa(objset),
+	    dmu_objset_id(objset));
+
 	kstat_install(kstat);
 	dk->dk_kstats = kstat;
 
@@ -162,6 +171,9 @@ dataset_kstats_destroy(dataset_kstats_t *dk)
 	kstat_delete(dk->dk_kstats);
 	dk->dk_kstats = NULL;
 
+	arc_dataset_unregister(dk->dk_arc);
+	dk->dk_arc = NULL;
+
 	aggsum_fini(&dk->dk_aggsums.das_writes);
 	aggsum_fini(&dk->dk_aggsums.das_nwritten);
 	aggsum_fini(&dk->dk_aggsums.das_reads);
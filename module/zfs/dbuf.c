@@ -97,6 +97,19 @@ typedef struct dbuf_stats {
 	 * already created and in the dbuf hash table.
 	 */
 	kstat_named_t hash_insert_race;
+	/*
+	 * Number of buckets in the dbuf hash table, and the number of times
+	 * it has been grown because its chains were getting too long.
+	 */
+	kstat_named_t hash_table_size;
+	kstat_named_t hash_resizes;
+	/*
+	 * Number of lookups which found a dbuf to be absent without taking
+	 * the hash mutex, and of those which raced with a writer and had to
+	 * search the chain under the mutex after all.
+	 */
+	kstat_named_t hash_lockless_miss;
+	kstat_named_t hash_lockless_retry;
 	/*
 	 * Statistics about the size of the metadata dbuf cache.
 	 */
@@ -129,6 +142,10 @@ dbuf_stats_t dbuf_stats = {
 	{ "hash_chains",			KSTAT_DATA_UINT64 },
 	{ "hash_chain_max",			KSTAT_DATA_UINT64 },
 	{ "hash_insert_race",			KSTAT_DATA_UINT64 },
+	{ "hash_table_size",			KSTAT_DATA_UINT64 },
+	{ "hash_resizes",			KSTAT_DATA_UINT64 },
+	{ "hash_lockless_miss",			KSTAT_DATA_UINT64 },
+	{ "hash_lockless_retry",		KSTAT_DATA_UINT64 },
 	{ "metadata_cache_count",		KSTAT_DATA_UINT64 },
 	{ "metadata_cache_size_bytes",		KSTAT_DATA_UINT64 },
 	{ "metadata_cache_size_bytes_max",	KSTAT_DATA_UINT64 },
@@ -216,6 +233,9 @@ unsigned long dbuf_metadata_cache_max_bytes = ULONG_MAX;
 int dbuf_cache_shift = 5;
 int dbuf_metadata_cache_shift = 6;
 
+/* Maximum number of blocks dbuf_read_array() hands to arc_read_batch() */
+int dbuf_read_batch = 32;
+
 static unsigned long dbuf_cache_target_bytes(void);
 static unsigned long dbuf_metadata_cache_target_bytes(void);
 
@@ -294,10 +314,45 @@ dbuf_dest(void *vdb, void *unused)
 
 /*
  * dbuf hash table routines
+ *
+ * The table is doubled by the dbuf eviction thread whenever it holds more
+ * than DBUF_HASH_LOAD dbufs per bucket.  dbuf_hash_grow() publishes a new
+ * dbuf_hash_table_t referring to both the old and the new table, moves the
+ * chains over one old bucket at a time, and then publishes the new table on
+ * its own.  DBUF_MUTEXES divides the size of every table, so a dbuf maps to
+ * the same hash mutex in all of them, and holding that mutex keeps the
+ * dbuf's bucket (as found by dbuf_hash_head()) stable.
+ *
+ * A lookup which lands on an empty chain is answered without taking the
+ * hash mutex: writers bump the mutex's sequence count around every change
+ * to the chains it covers, and a reader which sees the same even count
+ * before and after checking the chain knows the dbuf was absent.  Such a
+ * reader may still be looking at a table which has since been replaced, so
+ * it counts itself in dbuf_hash_readers for the current epoch while it
+ * looks.  Once the grow is done, dbuf_hash_retire() starts a new epoch,
+ * waits for the readers of the previous one to leave, and then frees the
+ * replaced tables.
  */
-static dbuf_hash_table_t dbuf_hash_table;
+#define	DBUF_HASH_LOAD	2
 
+static dbuf_hash_table_t *volatile dbuf_hash_table;
+dbuf_hash_mutex_t dbuf_hash_mutexes[DBUF_MUTEXES];
+
+/*
+ * Lockless readers of dbuf_hash_table, per CPU and per epoch.  The value
+ * returning atomics are used for their full barriers.
+ */
+typedef struct dbuf_hash_readers {
+	volatile uint64_t hr_count[2];
+} ____cacheline_aligned dbuf_hash_readers_t;
+
+static dbuf_hash_readers_t *dbuf_hash_readers;
+static uint_t dbuf_hash_nreaders;
+static volatile uint64_t dbuf_hash_epoch;
+
+static uint64_t dbuf_hash_buckets;
 static uint64_t dbuf_hash_count;
+static hrtime_t dbuf_hash_grow_retry;
 
 /*
  * We use Cityhash for this. It's fast, and has good hash properties without
@@ -319,32 +374,191 @@ dbuf_hash(void *os, uint64_t obj, uint8_t lvl, uint64_t blkid)
 	(dbuf)->db_level == (level) &&			\
 	(dbuf)->db_blkid == (blkid))
 
+/*
+ * Return the head of the chain for hash value hv.  The caller must hold
+ * the hash mutex for hv, or check its sequence count.
+ */
+static dmu_buf_impl_t **
+dbuf_hash_head(dbuf_hash_table_t *h, uint64_t hv)
+{
+	if (h->hash_old != NULL &&
+	    (hv & h->hash_old_mask) >= h->hash_migrated)
+		return (&h->hash_old[hv & h->hash_old_mask]);
+	return (&h->hash_table[hv & h->hash_table_mask]);
+}
+
+static void
+dbuf_hash_write_begin(dbuf_hash_mutex_t *hm)
+{
+	ASSERT(MUTEX_HELD(&hm->hm_lock));
+	ASSERT0(hm->hm_seq & 1);
+
+	hm->hm_seq++;
+	membar_producer();
+}
+
+static void
+dbuf_hash_write_end(dbuf_hash_mutex_t *hm)
+{
+	ASSERT(MUTEX_HELD(&hm->hm_lock));
+	ASSERT(hm->hm_seq & 1);
+
+	membar_producer();
+	hm->hm_seq++;
+}
+
+/*
+ * Optimistically determine, without taking the hash mutex, that there is
+ * no dbuf with hash value hv.  This only succeeds when the chain is empty
+ * and no writer was active on the chain's mutex while it was being checked.
+ */
+static boolean_t
+dbuf_hash_lockless_miss(uint64_t hv)
+{
+	dbuf_hash_mutex_t *hm = DBUF_HASH_MUTEX(hv);
+	dbuf_hash_readers_t *hr =
+	    &dbuf_hash_readers[CPU_SEQID_UNSTABLE % dbuf_hash_nreaders];
+	uint64_t epoch, seq;
+	boolean_t empty = B_FALSE;
+
+	/*
+	 * Count ourselves in the current epoch, and check that it is still
+	 * current afterwards.  Otherwise a retire may already have waited
+	 * for this epoch's readers, and we would not hold off the next one.
+	 */
+	for (;;) {
+		epoch = dbuf_hash_epoch & 1;
+		(void) atomic_inc_64_nv(&hr->hr_count[epoch]);
+		if ((dbuf_hash_epoch & 1) == epoch)
+			break;
+		(void) atomic_dec_64_nv(&hr->hr_count[epoch]);
+	}
+	seq = hm->hm_seq;
+	if (!(seq & 1)) {
+		membar_consumer();
+		empty = (*dbuf_hash_head(dbuf_hash_table, hv) == NULL);
+		membar_consumer();
+	}
+	(void) atomic_dec_64_nv(&hr->hr_count[epoch]);
+
+	if ((seq & 1) || hm->hm_seq != seq) {
+		DBUF_STAT_BUMP(hash_lockless_retry);
+		return (B_FALSE);
+	}
+	if (!empty)
+		return (B_FALSE);
+
+	DBUF_STAT_BUMP(hash_lockless_miss);
+	return (B_TRUE);
+}
+
 dmu_buf_impl_t *
 dbuf_find(objset_t *os, uint64_t obj, uint8_t level, uint64_t blkid)
 {
-	dbuf_hash_table_t *h = &dbuf_hash_table;
+	dbuf_hash_mutex_t *hm;
 	uint64_t hv;
-	uint64_t idx;
 	dmu_buf_impl_t *db;
 
 	hv = dbuf_hash(os, obj, level, blkid);
-	idx = hv & h->hash_table_mask;
+	if (dbuf_hash_lockless_miss(hv))
+		return (NULL);
 
-	mutex_enter(DBUF_HASH_MUTEX(h, idx));
-	for (db = h->hash_table[idx]; db != NULL; db = db->db_hash_next) {
+	hm = DBUF_HASH_MUTEX(hv);
+	mutex_enter(&hm->hm_lock);
+	for (db = *dbuf_hash_head(dbuf_hash_table, hv); db != NULL;
+	    db = db->db_hash_next) {
 		if (DBUF_EQUAL(db, os, obj, level, blkid)) {
 			mutex_enter(&db->db_mtx);
 			if (db->db_state != DB_EVICTING) {
-				mutex_exit(DBUF_HASH_MUTEX(h, idx));
+				mutex_exit(&hm->hm_lock);
 				return (db);
 			}
 			mutex_exit(&db->db_mtx);
 		}
 	}
-	mutex_exit(DBUF_HASH_MUTEX(h, idx));
+	mutex_exit(&hm->hm_lock);
 	return (NULL);
 }
 
+/*
+ * Call func on every dbuf in bucket idx of the hash table, with the
+ * bucket's hash mutex held, and stop at the first non-zero return value,
+ * which is passed back.  While the table is being grown an old bucket which
+ * has not been moved yet is visited as the lower of the two buckets it will
+ * be split into.  Returns ENOENT once idx is past the end of the table.
+ */
+int
+dbuf_hash_walk(uint64_t idx, dbuf_hash_walk_fn func, void *arg)
+{
+	dbuf_hash_mutex_t *hm = DBUF_HASH_MUTEX(idx);
+	dbuf_hash_table_t *h;
+	dmu_buf_impl_t *db;
+	int err = 0;
+
+	mutex_enter(&hm->hm_lock);
+	h = dbuf_hash_table;
+	if (idx > h->hash_table_mask) {
+		db = NULL;
+		err = SET_ERROR(ENOENT);
+	} else if (h->hash_old != NULL &&
+	    (idx & h->hash_old_mask) >= h->hash_migrated) {
+		db = (idx <= h->hash_old_mask) ? h->hash_old[idx] : NULL;
+	} else {
+		db = h->hash_table[idx];
+	}
+	for (; db != NULL && err == 0; db = db->db_hash_next)
+		err = func(db, arg);
+	mutex_exit(&hm->hm_lock);
+
+	return (err);
+}
+
+/*
+ * Return the number of buckets in the hash table.
+ */
+uint64_t
+dbuf_hash_size(void)
+{
+	return (dbuf_hash_buckets);
+}
+
+typedef struct dbuf_walk_cached_arg {
+	spa_t		*dwc_spa;
+	dbuf_walk_fn	dwc_func;
+	void		*dwc_arg;
+} dbuf_walk_cached_arg_t;
+
+static int
+dbuf_walk_cached_cb(dmu_buf_impl_t *db, void *arg)
+{
+	dbuf_walk_cached_arg_t *dwc = arg;
+
+	if (db->db_objset->os_spa != dwc->dwc_spa)
+		return (0);
+	mutex_enter(&db->db_mtx);
+	if (db->db_state == DB_CACHED)
+		dwc->dwc_func(db, dwc->dwc_arg);
+	mutex_exit(&db->db_mtx);
+
+	return (0);
+}
+
+/*
+ * Call func on every cached dbuf of the pool, with its db_mtx held.  The
+ * hash table is walked one bucket at a time, so dbufs created or evicted
+ * during the walk may or may not be seen, and if the table grows during
+ * the walk some dbufs may be seen twice.
+ */
+void
+dbuf_walk_cached(spa_t *spa, dbuf_walk_fn func, void *arg)
+{
+	dbuf_walk_cached_arg_t dwc = { spa, func, arg };
+
+	for (uint64_t idx = 0;
+	    dbuf_hash_walk(idx, dbuf_walk_cached_cb, &dwc) != ENOENT; idx++)
+		continue;
+}
+
 static dmu_buf_impl_t *
 dbuf_find_bonus(objset_t *os, uint64_t object)
 {
@@ -372,25 +586,26 @@ dbuf_find_bonus(objset_t *os, uint64_t object)
 static dmu_buf_impl_t *
 dbuf_hash_insert(dmu_buf_impl_t *db)
 {
-	dbuf_hash_table_t *h = &dbuf_hash_table;
 	objset_t *os = db->db_objset;
 	uint64_t obj = db->db.db_object;
 	int level = db->db_level;
-	uint64_t blkid, hv, idx;
-	dmu_buf_impl_t *dbf;
+	uint64_t blkid, hv, count;
+	dbuf_hash_mutex_t *hm;
+	dmu_buf_impl_t *dbf, **dbp;
 	uint32_t i;
 
 	blkid = db->db_blkid;
 	hv = dbuf_hash(os, obj, level, blkid);
-	idx = hv & h->hash_table_mask;
+	hm = DBUF_HASH_MUTEX(hv);
 
-	mutex_enter(DBUF_HASH_MUTEX(h, idx));
-	for (dbf = h->hash_table[idx], i = 0; dbf != NULL;
+	mutex_enter(&hm->hm_lock);
+	dbp = dbuf_hash_head(dbuf_hash_table, hv);
+	for (dbf = *dbp, i = 0; dbf != NULL;
 	    dbf = dbf->db_hash_next, i++) {
 		if (DBUF_EQUAL(dbf, os, obj, level, blkid)) {
 			mutex_enter(&dbf->db_mtx);
 			if (dbf->db_state != DB_EVICTING) {
-				mutex_exit(DBUF_HASH_MUTEX(h, idx));
+				mutex_exit(&hm->hm_lock);
 				return (dbf);
 			}
 			mutex_exit(&dbf->db_mtx);
@@ -406,11 +621,17 @@ dbuf_hash_insert(dmu_buf_impl_t *db)
 	}
 
 	mutex_enter(&db->db_mtx);
-	db->db_hash_next = h->hash_table[idx];
-	h->hash_table[idx] = db;
-	mutex_exit(DBUF_HASH_MUTEX(h, idx));
-	atomic_inc_64(&dbuf_hash_count);
-	DBUF_STAT_MAX(hash_elements_max, dbuf_hash_count);
+	dbuf_hash_write_begin(hm);
+	db->db_hash_next = *dbp;
+	*dbp = db;
+	dbuf_hash_write_end(hm);
+	mutex_exit(&hm->hm_lock);
+	count = atomic_inc_64_nv(&dbuf_hash_count);
+	DBUF_STAT_MAX(hash_elements_max, count);
+
+	/* Have the eviction thread grow the table. */
+	if (count == DBUF_HASH_LOAD * dbuf_hash_size() + 1)
+		cv_signal(&dbuf_evict_cv);
 
 	return (NULL);
 }
@@ -455,13 +676,13 @@ dbuf_include_in_metadata_cache(dmu_buf_impl_t *db)
 static void
 dbuf_hash_remove(dmu_buf_impl_t *db)
 {
-	dbuf_hash_table_t *h = &dbuf_hash_table;
-	uint64_t hv, idx;
-	dmu_buf_impl_t *dbf, **dbp;
+	dbuf_hash_mutex_t *hm;
+	uint64_t hv;
+	dmu_buf_impl_t *dbf, **dbp, **head;
 
 	hv = dbuf_hash(db->db_objset, db->db.db_object,
 	    db->db_level, db->db_blkid);
-	idx = hv & h->hash_table_mask;
+	hm = DBUF_HASH_MUTEX(hv);
 
 	/*
 	 * We mustn't hold db_mtx to maintain lock ordering:
@@ -471,21 +692,178 @@ dbuf_hash_remove(dmu_buf_impl_t *db)
 	ASSERT(db->db_state == DB_EVICTING);
 	ASSERT(!MUTEX_HELD(&db->db_mtx));
 
-	mutex_enter(DBUF_HASH_MUTEX(h, idx));
-	dbp = &h->hash_table[idx];
+	mutex_enter(&hm->hm_lock);
+	head = dbp = dbuf_hash_head(dbuf_hash_table, hv);
 	while ((dbf = *dbp) != db) {
 		dbp = &dbf->db_hash_next;
 		ASSERT(dbf != NULL);
 	}
+	dbuf_hash_write_begin(hm);
 	*dbp = db->db_hash_next;
+	dbuf_hash_write_end(hm);
 	db->db_hash_next = NULL;
-	if (h->hash_table[idx] &&
-	    h->hash_table[idx]->db_hash_next == NULL)
+	if (*head && (*head)->db_hash_next == NULL)
 		DBUF_STAT_BUMPDOWN(hash_chains);
-	mutex_exit(DBUF_HASH_MUTEX(h, idx));
+	mutex_exit(&hm->hm_lock);
 	atomic_dec_64(&dbuf_hash_count);
 }
 
+static dmu_buf_impl_t **
+dbuf_hash_table_alloc(uint64_t hsize, int kmflags)
+{
+#if defined(_KERNEL)
+	/*
+	 * Large allocations which do not require contiguous pages
+	 * should be using vmem_alloc() in the linux kernel
+	 */
+	return (vmem_zalloc(hsize * sizeof (void *), kmflags));
+#else
+	return (kmem_zalloc(hsize * sizeof (void *), kmflags));
+#endif
+}
+
+static void
+dbuf_hash_table_free(dmu_buf_impl_t **table, uint64_t hsize)
+{
+#if defined(_KERNEL)
+	vmem_free(table, hsize * sizeof (void *));
+#else
+	kmem_free(table, hsize * sizeof (void *));
+#endif
+}
+
+static boolean_t
+dbuf_hash_grow_needed(void)
+{
+	return (dbuf_hash_count > DBUF_HASH_LOAD * dbuf_hash_size() &&
+	    gethrtime() >= dbuf_hash_grow_retry);
+}
+
+static uint64_t
+dbuf_hash_chain_len(dmu_buf_impl_t *db)
+{
+	uint64_t len = 0;
+
+	for (; db != NULL; db = db->db_hash_next)
+		len++;
+	return (len);
+}
+
+/*
+ * Move the chain of bucket b of the old table over to the new one, where
+ * it is split between buckets b and b + old size.
+ */
+static void
+dbuf_hash_split(dbuf_hash_table_t *h, uint64_t b)
+{
+	dmu_buf_impl_t *db, *next;
+	uint64_t len;
+
+	if (dbuf_hash_chain_len(h->hash_old[b]) > 1)
+		DBUF_STAT_BUMPDOWN(hash_chains);
+
+	for (db = h->hash_old[b]; db != NULL; db = next) {
+		uint64_t hv = dbuf_hash(db->db_objset, db->db.db_object,
+		    db->db_level, db->db_blkid);
+		dmu_buf_impl_t **dbp = &h->hash_table[hv & h->hash_table_mask];
+
+		ASSERT3U(hv & h->hash_old_mask, ==, b);
+		next = db->db_hash_next;
+		db->db_hash_next = *dbp;
+		*dbp = db;
+	}
+	h->hash_old[b] = NULL;
+
+	for (int i = 0; i < 2; i++) {
+		len = dbuf_hash_chain_len(
+		    h->hash_table[b + i * (h->hash_old_mask + 1)]);
+		if (len > 1) {
+			DBUF_STAT_BUMP(hash_chains);
+			DBUF_STAT_MAX(hash_chain_max, len - 1);
+		}
+	}
+}
+
+/*
+ * Free the tables replaced by a grow once nothing looks at them any more.
+ * Lockless readers which may have seen them are counted in the previous
+ * epoch, so wait for that count to drop to zero.  A reader which counts
+ * itself in the previous epoch after the wait has passed sees the epoch
+ * change and backs out (see dbuf_hash_lockless_miss()).  All other
+ * readers find the table with a hash mutex held, so cycling the mutexes
+ * waits for them.
+ */
+static void
+dbuf_hash_retire(dbuf_hash_table_t *oh, dbuf_hash_table_t *h)
+{
+	uint64_t epoch = atomic_inc_64_nv(&dbuf_hash_epoch) - 1;
+
+	for (uint_t i = 0; i < dbuf_hash_nreaders; i++) {
+		while (dbuf_hash_readers[i].hr_count[epoch & 1] != 0)
+			delay(1);
+	}
+	for (int i = 0; i < DBUF_MUTEXES; i++) {
+		mutex_enter(&dbuf_hash_mutexes[i].hm_lock);
+		mutex_exit(&dbuf_hash_mutexes[i].hm_lock);
+	}
+
+	dbuf_hash_table_free(oh->hash_table, oh->hash_table_mask + 1);
+	kmem_free(oh, sizeof (dbuf_hash_table_t));
+	kmem_free(h, sizeof (dbuf_hash_table_t));
+}
+
+/*
+ * Double the size of the hash table.  Only the dbuf eviction thread grows
+ * the table, and lookups are only ever held up by the splitting of one
+ * chain.
+ */
+static void
+dbuf_hash_grow(void)
+{
+	dbuf_hash_table_t *oh = dbuf_hash_table, *h, *nh;
+	uint64_t osize = oh->hash_table_mask + 1;
+	dmu_buf_impl_t **table;
+
+	ASSERT3P(oh->hash_old, ==, NULL);
+
+	table = dbuf_hash_table_alloc(2 * osize, KM_NOSLEEP);
+	if (table == NULL) {
+		dbuf_hash_grow_retry = gethrtime() + SEC2NSEC(1);
+		return;
+	}
+
+	h = kmem_zalloc(sizeof (dbuf_hash_table_t), KM_SLEEP);
+	h->hash_table_mask = 2 * osize - 1;
+	h->hash_table = table;
+	h->hash_old_mask = oh->hash_table_mask;
+	h->hash_old = oh->hash_table;
+	h->hash_migrated = 0;
+	membar_producer();
+	dbuf_hash_table = h;
+
+	dbuf_stats.hash_chain_max.value.ui64 = 0;
+	for (uint64_t b = 0; b < osize; b++) {
+		dbuf_hash_mutex_t *hm = DBUF_HASH_MUTEX(b);
+
+		mutex_enter(&hm->hm_lock);
+		dbuf_hash_write_begin(hm);
+		dbuf_hash_split(h, b);
+		h->hash_migrated = b + 1;
+		dbuf_hash_write_end(hm);
+		mutex_exit(&hm->hm_lock);
+	}
+
+	nh = kmem_zalloc(sizeof (dbuf_hash_table_t), KM_SLEEP);
+	nh->hash_table_mask = h->hash_table_mask;
+	nh->hash_table = table;
+	membar_producer();
+	dbuf_hash_table = nh;
+	dbuf_hash_buckets = nh->hash_table_mask + 1;
+
+	dbuf_hash_retire(oh, h);
+	DBUF_STAT_BUMP(hash_resizes);
+}
+
 typedef enum {
 	DBVU_EVICTING,
 	DBVU_NOT_EVICTING
@@ -705,6 +1083,7 @@ dbuf_evict_one(void)
  * and destroyed. The eviction thread will continue running until the size
  * of the dbuf cache is at or below the maximum size. Once the dbuf is aged
  * out of the cache it is destroyed and becomes eligible for arc eviction.
+ * It also grows the dbuf hash table when its chains get too long.
  */
 /* ARGSUSED */
 static void
@@ -716,7 +1095,8 @@ dbuf_evict_thread(void *unused)
 
 	mutex_enter(&dbuf_evict_lock);
 	while (!dbuf_evict_thread_exit) {
-		while (!dbuf_cache_above_lowater() && !dbuf_evict_thread_exit) {
+		while (!dbuf_cache_above_lowater() &&
+		    !dbuf_hash_grow_needed() && !dbuf_evict_thread_exit) {
 			CALLB_CPR_SAFE_BEGIN(&cpr);
 			(void) cv_timedwait_idle_hires(&dbuf_evict_cv,
 			    &dbuf_evict_lock, SEC2NSEC(1), MSEC2NSEC(1), 0);
@@ -724,6 +1104,9 @@ dbuf_evict_thread(void *unused)
 		}
 		mutex_exit(&dbuf_evict_lock);
 
+		if (dbuf_hash_grow_needed() && !dbuf_evict_thread_exit)
+			dbuf_hash_grow();
+
 		/*
 		 * Keep evicting as long as we're above the low water mark
 		 * for the cache. We do this without holding the locks to
@@ -778,6 +1161,7 @@ dbuf_kstat_update(kstat_t *ksp, int rw)
 		ds->cache_hiwater_bytes.value.ui64 = dbuf_cache_hiwater_bytes();
 		ds->cache_lowater_bytes.value.ui64 = dbuf_cache_lowater_bytes();
 		ds->hash_elements.value.ui64 = dbuf_hash_count;
+		ds->hash_table_size.value.ui64 = dbuf_hash_size();
 	}
 
 	return (0);
@@ -787,7 +1171,7 @@ void
 dbuf_init(void)
 {
 	uint64_t hsize = 1ULL << 16;
-	dbuf_hash_table_t *h = &dbuf_hash_table;
+	dbuf_hash_table_t *h;
 	int i;
 
 	/*
@@ -799,32 +1183,38 @@ dbuf_init(void)
 	while (hsize * zfs_arc_average_blocksize < physmem * PAGESIZE)
 		hsize <<= 1;
 
+	h = kmem_zalloc(sizeof (dbuf_hash_table_t), KM_SLEEP);
 retry:
 	h->hash_table_mask = hsize - 1;
 #if defined(_KERNEL)
-	/*
-	 * Large allocations which do not require contiguous pages
-	 * should be using vmem_alloc() in the linux kernel
-	 */
-	h->hash_table = vmem_zalloc(hsize * sizeof (void *), KM_SLEEP);
+	h->hash_table = dbuf_hash_table_alloc(hsize, KM_SLEEP);
 #else
-	h->hash_table = kmem_zalloc(hsize * sizeof (void *), KM_NOSLEEP);
+	h->hash_table = dbuf_hash_table_alloc(hsize, KM_NOSLEEP);
 #endif
 	if (h->hash_table == NULL) {
 		/* XXX - we should really return an error instead of assert */
-		ASSERT(hsize > (1ULL << 10));
+		ASSERT(hsize > DBUF_MUTEXES);
 		hsize >>= 1;
 		goto retry;
 	}
+	dbuf_hash_table = h;
+	dbuf_hash_buckets = hsize;
+	dbuf_hash_grow_retry = 0;
+	dbuf_hash_nreaders = boot_ncpus;
+	dbuf_hash_readers = kmem_zalloc(dbuf_hash_nreaders *
+	    sizeof (dbuf_hash_readers_t), KM_SLEEP);
 
 	dbuf_kmem_cache = kmem_cache_create("dmu_buf_impl_t",
 	    sizeof (dmu_buf_impl_t),
 	    0, dbuf_cons, dbuf_dest, NULL, NULL, NULL, 0);
 
-	for (i = 0; i < DBUF_MUTEXES; i++)
-		mutex_init(&h->hash_mutexes[i], NULL, MUTEX_DEFAULT, NULL);
+	for (i = 0; i < DBUF_MUTEXES; i++) {
+		mutex_init(&dbuf_hash_mutexes[i].hm_lock, NULL,
+		    MUTEX_DEFAULT, NULL);
+		dbuf_hash_mutexes[i].hm_seq = 0;
+	}
 
-	dbuf_stats_init(h);
+	dbuf_stats_init();
 
 	/*
 	 * All entries are queued via taskq_dispatch_ent(), so min/maxalloc
@@ -869,25 +1259,12 @@ retry:
 void
 dbuf_fini(void)
 {
-	dbuf_hash_table_t *h = &dbuf_hash_table;
+	dbuf_hash_table_t *h;
 	int i;
 
 	dbuf_stats_destroy();
 
-	for (i = 0; i < DBUF_MUTEXES; i++)
-		mutex_destroy(&h->hash_mutexes[i]);
-#if defined(_KERNEL)
-	/*
-	 * Large allocations which do not require contiguous pages
-	 * should be using vmem_free() in the linux kernel
-	 */
-	vmem_free(h->hash_table, (h->hash_table_mask + 1) * sizeof (void *));
-#else
-	kmem_free(h->hash_table, (h->hash_table_mask + 1) * sizeof (void *));
-#endif
-	kmem_cache_destroy(dbuf_kmem_cache);
-	taskq_destroy(dbu_evict_taskq);
-
+	/* Stop the eviction thread first, it may be growing the table. */
 	mutex_enter(&dbuf_evict_lock);
 	dbuf_evict_thread_exit = B_TRUE;
 	while (dbuf_evict_thread_exit) {
@@ -899,6 +1276,21 @@ dbuf_fini(void)
 	mutex_destroy(&dbuf_evict_lock);
 	cv_destroy(&dbuf_evict_cv);
 
+	for (i = 0; i < DBUF_MUTEXES; i++)
+		mutex_destroy(&dbuf_hash_mutexes[i].hm_lock);
+
+	h = dbuf_hash_table;
+	ASSERT3P(h->hash_old, ==, NULL);
+	dbuf_hash_table_free(h->hash_table, h->hash_table_mask + 1);
+	kmem_free(h, sizeof (dbuf_hash_table_t));
+	dbuf_hash_table = NULL;
+	kmem_free(dbuf_hash_readers, dbuf_hash_nreaders *
+	    sizeof (dbuf_hash_readers_t));
+	dbuf_hash_readers = NULL;
+
+	kmem_cache_destroy(dbuf_kmem_cache);
+	taskq_destroy(dbu_evict_taskq);
+
 	for (dbuf_cached_state_t dcs = 0; dcs < DB_CACHE_MAX; dcs++) {
 		zfs_refcount_destroy(&dbuf_caches[dcs].size);
 		multilist_destroy(dbuf_caches[dcs].cache);
@@ -1436,7 +1828,7 @@ dbuf_read_verify_dnode_crypt(dmu_buf_impl_t *db, uint32_t flags)
  */
 static int
 dbuf_read_impl(dmu_buf_impl_t *db, zio_t *zio, uint32_t flags,
-    db_lock_type_t dblt, void *tag)
+    db_lock_type_t dblt, void *tag, arc_read_batch_ent_t *arb)
 {
 	dnode_t *dn;
 	zbookmark_phys_t zb;
@@ -1521,6 +1913,16 @@ dbuf_read_impl(dmu_buf_impl_t *db, zio_t *zio, uint32_t flags,
 	 */
 	blkptr_t bp = *db->db_blkptr;
 	dmu_buf_unlock_parent(db, dblt, tag);
+	if (arb != NULL) {
+		/* The caller will issue the read with arc_read_batch(). */
+		arb->arb_bp = bp;
+		arb->arb_zb = zb;
+		arb->arb_done = dbuf_read_done;
+		arb->arb_private = db;
+		arb->arb_zio_flags = zio_flags;
+		arb->arb_flags = aflags;
+		return (err);
+	}
 	(void) arc_read(zio, db->db_objset->os_spa, &bp,
 	    dbuf_read_done, db, ZIO_PRIORITY_SYNC_READ, zio_flags,
 	    &aflags, &zb);
@@ -1655,7 +2057,7 @@ dbuf_read(dmu_buf_impl_t *db, zio_t *zio, uint32_t flags)
 			zio = zio_root(spa, NULL, NULL, ZIO_FLAG_CANFAIL);
 			need_wait = B_TRUE;
 		}
-		err = dbuf_read_impl(db, zio, flags, dblt, FTAG);
+		err = dbuf_read_impl(db, zio, flags, dblt, FTAG, NULL);
 		/*
 		 * dbuf_read_impl has dropped db_mtx and our parent's rwlock
 		 * for us
@@ -1717,6 +2119,66 @@ dbuf_read(dmu_buf_impl_t *db, zio_t *zio, uint32_t flags)
 	return (err);
 }
 
+/*
+ * Start reading an array of held level 0 dbufs of one dnode as children of
+ * zio.  This is equivalent to calling dbuf_read() on each of them, except
+ * that the dbufs which have to be read from the ARC are handed to
+ * arc_read_batch() in groups of up to dbuf_read_batch, which saves a good
+ * part of the per-block cost of large reads of small blocks.  The caller
+ * must pass DB_RF_NEVERWAIT and DB_RF_NOPREFETCH, and waits for zio and
+ * then for the dbufs itself.
+ */
+void
+dbuf_read_array(dmu_buf_impl_t **dbs, int n, zio_t *zio, uint32_t flags)
+{
+	arc_read_batch_ent_t *arb;
+	int batch = MIN(n, dbuf_read_batch);
+	int narb = 0;
+	spa_t *spa;
+
+	ASSERT3P(zio, !=, NULL);
+	ASSERT(flags & DB_RF_NEVERWAIT);
+	ASSERT(flags & DB_RF_NOPREFETCH);
+
+	if (batch <= 1) {
+		for (int i = 0; i < n; i++)
+			(void) dbuf_read(dbs[i], zio, flags);
+		return;
+	}
+
+	spa = dbs[0]->db_objset->os_spa;
+	arb = kmem_alloc(batch * sizeof (arc_read_batch_ent_t), KM_SLEEP);
+	for (int i = 0; i < n; i++) {
+		dmu_buf_impl_t *db = dbs[i];
+		db_lock_type_t dblt;
+
+		ASSERT3U(db->db_level, ==, 0);
+		ASSERT3P(db->db_objset->os_spa, ==, spa);
+
+		mutex_enter(&db->db_mtx);
+		if (db->db_state != DB_UNCACHED) {
+			mutex_exit(&db->db_mtx);
+			(void) dbuf_read(db, zio, flags);
+			continue;
+		}
+
+		dblt = dmu_buf_lock_parent(db, RW_READER, FTAG);
+		arb[narb].arb_private = NULL;
+		(void) dbuf_read_impl(db, zio, flags, dblt, FTAG, &arb[narb]);
+		DBUF_STAT_BUMP(hash_misses);
+
+		/* Holes, errors and the like were dealt with in place. */
+		if (arb[narb].arb_private != NULL && ++narb == batch) {
+			arc_read_batch(zio, spa, arb, narb,
+			    ZIO_PRIORITY_SYNC_READ);
+			narb = 0;
+		}
+	}
+	if (narb > 0)
+		arc_read_batch(zio, spa, arb, narb, ZIO_PRIORITY_SYNC_READ);
+	kmem_free(arb, batch * sizeof (arc_read_batch_ent_t));
+}
+
 static void
 dbuf_noread(dmu_buf_impl_t *db)
 {
@@ -2830,17 +3292,18 @@ dbuf_destroy(dmu_buf_impl_t *db)
 	ASSERT3U(db->db_caching_status, ==, DB_NO_CACHE);
 	ASSERT(!multilist_link_active(&db->db_cache_link));
 
-	kmem_cache_free(dbuf_kmem_cache, db);
-	arc_space_return(sizeof (dmu_buf_impl_t), ARC_SPACE_DBUF);
-
 	/*
 	 * If this dbuf is referenced from an indirect dbuf,
-	 * decrement the ref count on the indirect dbuf.
+	 * decrement the ref count on the indirect dbuf.  db is the tag of
+	 * that hold, so this is done before db is freed.
 	 */
 	if (parent && parent != dndb) {
 		mutex_enter(&parent->db_mtx);
 		dbuf_rele_and_unlock(parent, db, B_TRUE);
 	}
+
+	kmem_cache_free(dbuf_kmem_cache, db);
+	arc_space_return(sizeof (dmu_buf_impl_t), ARC_SPACE_DBUF);
 }
 
 /*
@@ -3069,13 +3532,17 @@ typedef struct dbuf_prefetch_arg {
 	arc_flags_t dpa_aflags; /* Flags to pass to the final prefetch. */
 	dbuf_prefetch_fn dpa_cb; /* prefetch completion callback */
 	void *dpa_arg; /* prefetch completion arg */
+	hrtime_t dpa_start; /* time the prefetch was started */
 } dbuf_prefetch_arg_t;
 
 static void
 dbuf_prefetch_fini(dbuf_prefetch_arg_t *dpa, boolean_t io_done)
 {
-	if (dpa->dpa_cb != NULL)
-		dpa->dpa_cb(dpa->dpa_arg, io_done);
+	if (dpa->dpa_cb != NULL) {
+		dpa->dpa_cb(dpa->dpa_arg, dpa->dpa_zb.zb_level,
+		    dpa->dpa_zb.zb_blkid,
+		    io_done ? MAX(gethrtime() - dpa->dpa_start, 1) : 0);
+	}
 	kmem_free(dpa, sizeof (*dpa));
 }
 
@@ -3085,7 +3552,8 @@ dbuf_issue_final_prefetch_done(zio_t *zio, const zbookmark_phys_t *zb,
 {
 	dbuf_prefetch_arg_t *dpa = private;
 
-	dbuf_prefetch_fini(dpa, B_TRUE);
+	/* A NULL zio means the block was already cached. */
+	dbuf_prefetch_fini(dpa, zio != NULL);
 	if (abuf != NULL)
 		arc_buf_destroy(abuf, private);
 }
@@ -3316,6 +3784,8 @@ dbuf_prefetch_impl(dnode_t *dn, int64_t level, uint64_t blkid,
 	dpa->dpa_zio = pio;
 	dpa->dpa_cb = cb;
 	dpa->dpa_arg = arg;
+	if (cb != NULL)
+		dpa->dpa_start = gethrtime();
 
 	/* flag if L2ARC eligible, l2arc_noprefetch then decides */
 	if (DNODE_LEVEL_IS_L2CACHEABLE(dn, level))
@@ -3354,7 +3824,7 @@ dbuf_prefetch_impl(dnode_t *dn, int64_t level, uint64_t blkid,
 	return (1);
 no_issue:
 	if (cb != NULL)
-		cb(arg, B_FALSE);
+		cb(arg, level, blkid, 0);
 	return (0);
 }
 
@@ -4905,6 +5375,7 @@ EXPORT_SYMBOL(dbuf_destroy);
 EXPORT_SYMBOL(dbuf_loan_arcbuf);
 EXPORT_SYMBOL(dbuf_whichblock);
 EXPORT_SYMBOL(dbuf_read);
+EXPORT_SYMBOL(dbuf_read_array);
 EXPORT_SYMBOL(dbuf_unoverride);
 EXPORT_SYMBOL(dbuf_free_range);
 EXPORT_SYMBOL(dbuf_new_size);
@@ -4956,4 +5427,7 @@ ZFS_MODULE_PARAM(zfs_dbuf, dbuf_, cache_shift, INT, ZMOD_RW,
 ZFS_MODULE_PARAM(zfs_dbuf, dbuf_, metadata_cache_shift, INT, ZMOD_RW,
 	"Set the size of the dbuf metadata cache to a log2 fraction of arc "
 	"size.");
+
+ZFS_MODULE_PARAM(zfs_dbuf, dbuf_, read_batch, INT, ZMOD_RW,
+	"Maximum number of blocks read from the ARC as one batch.");
 /* END CSTYLED */
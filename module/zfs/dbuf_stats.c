@@ -36,10 +36,14 @@ int zfs_dbuf_state_index = 0;
 typedef struct dbuf_stats_t {
 	kmutex_t		lock;
 	kstat_t			*kstat;
-	dbuf_hash_table_t	*hash;
-	int			idx;
+	uint64_t		idx;
 } dbuf_stats_t;
 
+typedef struct dbuf_stats_buf {
+	char			*dsb_buf;
+	size_t			dsb_size;
+} dbuf_stats_buf_t;
+
 static dbuf_stats_t dbuf_stats_hash_table;
 
 static int
@@ -124,43 +128,47 @@ __dbuf_stats_hash_table_data(char *buf, size_t size, dmu_buf_impl_t *db)
 	return (nwritten + 1);
 }
 
+static int
+dbuf_stats_hash_table_cb(dmu_buf_impl_t *db, void *arg)
+{
+	dbuf_stats_buf_t *dsb = arg;
+	int length;
+
+	/*
+	 * Returning ENOMEM will cause the data and header functions
+	 * to be called with a larger scratch buffers.
+	 */
+	if (dsb->dsb_size < 512)
+		return (SET_ERROR(ENOMEM));
+
+	mutex_enter(&db->db_mtx);
+
+	if (db->db_state != DB_EVICTING) {
+		length = __dbuf_stats_hash_table_data(dsb->dsb_buf,
+		    dsb->dsb_size, db);
+		dsb->dsb_buf += length;
+		dsb->dsb_size -= length;
+	}
+
+	mutex_exit(&db->db_mtx);
+
+	return (0);
+}
+
 static int
 dbuf_stats_hash_table_data(char *buf, size_t size, void *data)
 {
 	dbuf_stats_t *dsh = (dbuf_stats_t *)data;
-	dbuf_hash_table_t *h = dsh->hash;
-	dmu_buf_impl_t *db;
-	int length, error = 0;
+	dbuf_stats_buf_t dsb = { buf, size };
+	int error;
 
-	ASSERT3S(dsh->idx, >=, 0);
-	ASSERT3S(dsh->idx, <=, h->hash_table_mask);
 	if (size)
 		buf[0] = 0;
 
-	mutex_enter(DBUF_HASH_MUTEX(h, dsh->idx));
-	for (db = h->hash_table[dsh->idx]; db != NULL; db = db->db_hash_next) {
-		/*
-		 * Returning ENOMEM will cause the data and header functions
-		 * to be called with a larger scratch buffers.
-		 */
-		if (size < 512) {
-			error = SET_ERROR(ENOMEM);
-			break;
-		}
-
-		mutex_enter(&db->db_mtx);
-
-		if (db->db_state != DB_EVICTING) {
-			length = __dbuf_stats_hash_table_data(buf, size, db);
-			buf += length;
-			size -= length;
-		}
-
-		mutex_exit(&db->db_mtx);
-	}
-	mutex_exit(DBUF_HASH_MUTEX(h, dsh->idx));
+	error = dbuf_hash_walk(dsh->idx, dbuf_stats_hash_table_cb, &dsb);
 
-	return (error);
+	/* The table may have been grown since the index was checked. */
+	return (error == ENOENT ? 0 : error);
 }
 
 static void *
@@ -170,7 +178,7 @@ dbuf_stats_hash_table_addr(kstat_t *ksp, loff_t n)
 
 	ASSERT(MUTEX_HELD(&dsh->lock));
 
-	if (n <= dsh->hash->hash_table_mask) {
+	if (n < dbuf_hash_size()) {
 		dsh->idx = n;
 		return (dsh);
 	}
@@ -179,13 +187,12 @@ dbuf_stats_hash_table_addr(kstat_t *ksp, loff_t n)
 }
 
 static void
-dbuf_stats_hash_table_init(dbuf_hash_table_t *hash)
+dbuf_stats_hash_table_init(void)
 {
 	dbuf_stats_t *dsh = &dbuf_stats_hash_table;
 	kstat_t *ksp;
 
 	mutex_init(&dsh->lock, NULL, MUTEX_DEFAULT, NULL);
-	dsh->hash = hash;
 
 	ksp = kstat_create("zfs", 0, "dbufs", "misc",
 	    KSTAT_TYPE_RAW, 0, KSTAT_FLAG_VIRTUAL);
@@ -215,9 +222,9 @@ dbuf_stats_hash_table_destroy(void)
 }
 
 void
-dbuf_stats_init(dbuf_hash_table_t *hash)
+dbuf_stats_init(void)
 {
-	dbuf_stats_hash_table_init(hash);
+	dbuf_stats_hash_table_init();
 }
 
 void
@@ -560,24 +560,27 @@ dmu_buf_hold_array_by_dnode(dnode_t *dn, uint64_t offset, uint64_t length,
 			return (SET_ERROR(EIO));
 		}
 
-		/*
-		 * Initiate async demand data read.
-		 * We check the db_state after calling dbuf_read() because
-		 * (1) dbuf_read() may change the state to CACHED due to a
-		 * hit in the ARC, and (2) on a cache miss, a child will
-		 * have been added to "zio" but not yet completed, so the
-		 * state will not yet be CACHED.
-		 */
-		if (read) {
-			(void) dbuf_read(db, zio, dbuf_flags);
-			if (db->db_state != DB_CACHED)
-				missed = B_TRUE;
-		}
 		dbp[i] = &db->db;
 	}
 
-	if (!read)
+	/*
+	 * Initiate async demand data reads, in batches.
+	 * We check the db_state after calling dbuf_read_array() because
+	 * (1) the read may change the state to CACHED due to a hit in
+	 * the ARC, and (2) on a cache miss, a child will have been added
+	 * to "zio" but not yet completed, so the state will not yet be
+	 * CACHED.
+	 */
+	if (read) {
+		dbuf_read_array((dmu_buf_impl_t **)dbp, nblks, zio,
+		    dbuf_flags);
+		for (i = 0; i < nblks && !missed; i++) {
+			if (((dmu_buf_impl_t *)dbp[i])->db_state != DB_CACHED)
+				missed = B_TRUE;
+		}
+	} else {
 		zfs_racct_write(length, nblks);
+	}
 
 	if (zs)
 		dmu_zfetch_run(zs, missed, B_TRUE);
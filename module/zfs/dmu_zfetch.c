@@ -34,6 +34,7 @@
 #include <sys/dmu.h>
 #include <sys/dbuf.h>
 #include <sys/kstat.h>
+#include <sys/arc_impl.h>
 
 /*
  * This tunable disables predictive prefetch.  Note that it leaves "prescient"
@@ -48,18 +49,31 @@ int zfs_prefetch_disable = B_FALSE;
 unsigned int	zfetch_max_streams = 8;
 /* min time before stream reclaim */
 unsigned int	zfetch_min_sec_reap = 2;
+/* min bytes to prefetch per stream (default 4MB) */
+unsigned int	zfetch_min_distance = 4 * 1024 * 1024;
 /* max bytes to prefetch per stream (default 8MB) */
 unsigned int	zfetch_max_distance = 8 * 1024 * 1024;
 /* max bytes to prefetch indirects for per stream (default 64MB) */
 unsigned int	zfetch_max_idistance = 64 * 1024 * 1024;
 /* max number of bytes in an array_read in which we allow prefetching (1MB) */
 unsigned long	zfetch_array_rd_sz = 1024 * 1024;
+/* detect constant-stride and backward streams */
+int		zfetch_detect_stride = B_TRUE;
 
 typedef struct zfetch_stats {
 	kstat_named_t zfetchstat_hits;
 	kstat_named_t zfetchstat_misses;
 	kstat_named_t zfetchstat_max_streams;
 	kstat_named_t zfetchstat_io_issued;
+	kstat_named_t zfetchstat_stride_detected;
+	kstat_named_t zfetchstat_stride_hits;
+	kstat_named_t zfetchstat_backward_hits;
+	kstat_named_t zfetchstat_streams;
+	kstat_named_t zfetchstat_distance;
+	kstat_named_t zfetchstat_distance_grown;
+	kstat_named_t zfetchstat_distance_shrunk;
+	kstat_named_t zfetchstat_distance_arc_capped;
+	kstat_named_t zfetchstat_catchups;
 } zfetch_stats_t;
 
 static zfetch_stats_t zfetch_stats = {
@@ -67,10 +81,21 @@ static zfetch_stats_t zfetch_stats = {
 	{ "misses",			KSTAT_DATA_UINT64 },
 	{ "max_streams",		KSTAT_DATA_UINT64 },
 	{ "io_issued",		KSTAT_DATA_UINT64 },
+	{ "stride_detected",		KSTAT_DATA_UINT64 },
+	{ "stride_hits",		KSTAT_DATA_UINT64 },
+	{ "backward_hits",		KSTAT_DATA_UINT64 },
+	{ "streams",			KSTAT_DATA_UINT64 },
+	{ "distance_bytes",		KSTAT_DATA_UINT64 },
+	{ "distance_grown",		KSTAT_DATA_UINT64 },
+	{ "distance_shrunk",		KSTAT_DATA_UINT64 },
+	{ "distance_arc_capped",	KSTAT_DATA_UINT64 },
+	{ "catchups",			KSTAT_DATA_UINT64 },
 };
 
 #define	ZFETCHSTAT_BUMP(stat) \
 	atomic_inc_64(&zfetch_stats.stat.value.ui64)
+#define	ZFETCHSTAT_BUMPDOWN(stat) \
+	atomic_dec_64(&zfetch_stats.stat.value.ui64)
 #define	ZFETCHSTAT_ADD(stat, val)				\
 	atomic_add_64(&zfetch_stats.stat.value.ui64, val)
 #define	ZFETCHSTAT_SET(stat, val)				\
@@ -137,6 +162,8 @@ dmu_zfetch_stream_remove(zfetch_t *zf, zstream_t *zs)
 	ASSERT(MUTEX_HELD(&zf->zf_lock));
 	list_remove(&zf->zf_stream, zs);
 	zf->zf_numstreams--;
+	ZFETCHSTAT_BUMPDOWN(zfetchstat_streams);
+	ZFETCHSTAT_ADD(zfetchstat_distance, -(int64_t)zs->zs_distance);
 	membar_producer();
 	if (zfs_refcount_remove(&zs->zs_refs, NULL) == 0)
 		dmu_zfetch_stream_fini(zs);
@@ -162,13 +189,14 @@ dmu_zfetch_fini(zfetch_t *zf)
 }
 
 /*
- * If there aren't too many streams already, create a new stream.
- * The "blkid" argument is the next block that we expect this stream to access.
+ * If there aren't too many streams already, create a new stream for an
+ * access of nblks blocks starting at blkid.  The stream expects the next
+ * access at blkid + nblks.
  * While we're here, clean up old streams (which haven't been
  * accessed for at least zfetch_min_sec_reap seconds).
  */
 static void
-dmu_zfetch_stream_create(zfetch_t *zf, uint64_t blkid)
+dmu_zfetch_stream_create(zfetch_t *zf, uint64_t blkid, uint64_t nblks)
 {
 	zstream_t *zs_next;
 	hrtime_t now = gethrtime();
@@ -194,25 +222,29 @@ dmu_zfetch_stream_create(zfetch_t *zf, uint64_t blkid)
 	/*
 	 * The maximum number of streams is normally zfetch_max_streams,
 	 * but for small files we lower it such that it's at least possible
-	 * for all the streams to be non-overlapping.
+	 * for all the streams to be non-overlapping at their minimum
+	 * prefetch distance.
 	 *
 	 * If we are already at the maximum number of streams for this file,
 	 * even after removing old streams, then don't create this stream.
 	 */
 	uint32_t max_streams = MAX(1, MIN(zfetch_max_streams,
 	    zf->zf_dnode->dn_maxblkid * zf->zf_dnode->dn_datablksz /
-	    zfetch_max_distance));
+	    MAX(1, MIN(zfetch_min_distance, zfetch_max_distance))));
 	if (zf->zf_numstreams >= max_streams) {
 		ZFETCHSTAT_BUMP(zfetchstat_max_streams);
 		return;
 	}
 
 	zstream_t *zs = kmem_zalloc(sizeof (*zs), KM_SLEEP);
-	zs->zs_blkid = blkid;
-	zs->zs_pf_blkid1 = blkid;
-	zs->zs_pf_blkid = blkid;
-	zs->zs_ipf_blkid1 = blkid;
-	zs->zs_ipf_blkid = blkid;
+	zs->zs_blkid = blkid + nblks;
+	zs->zs_pf_blkid1 = blkid + nblks;
+	zs->zs_pf_blkid = blkid + nblks;
+	zs->zs_ipf_blkid1 = blkid + nblks;
+	zs->zs_ipf_blkid = blkid + nblks;
+	zs->zs_last_blkid = blkid;
+	zs->zs_nblks = nblks;
+	zs->zs_distance = MIN(zfetch_min_distance, zfetch_max_distance);
 	zs->zs_atime = now;
 	zs->zs_fetch = zf;
 	zs->zs_missed = B_FALSE;
@@ -222,17 +254,215 @@ dmu_zfetch_stream_create(zfetch_t *zf, uint64_t blkid)
 	zfs_refcount_add(&zs->zs_refs, NULL);
 	zf->zf_numstreams++;
 	list_insert_head(&zf->zf_stream, zs);
+	ZFETCHSTAT_BUMP(zfetchstat_streams);
+	ZFETCHSTAT_ADD(zfetchstat_distance, zs->zs_distance);
 }
 
 static void
-dmu_zfetch_stream_done(void *arg, boolean_t io_issued)
+dmu_zfetch_stream_done(void *arg, uint64_t level, uint64_t blkid,
+    hrtime_t io_time)
 {
 	zstream_t *zs = arg;
 
+	/*
+	 * Sample the latency of data prefetches which had to be read, and
+	 * note when the reader got to the block before its prefetch did.
+	 * Completions do not hold zf_lock, so both are updated atomically.
+	 * zs_blkid may be stale here, which only shifts a catchup to the
+	 * next access.
+	 */
+	if (level == 0 && io_time > 0) {
+		uint64_t lat, nlat;
+
+		do {
+			lat = zs->zs_lat;
+			nlat = (lat == 0) ? io_time :
+			    lat - lat / 8 + io_time / 8;
+		} while (atomic_cas_64(&zs->zs_lat, lat, nlat) != lat);
+		if (zs->zs_stride >= 0 ? blkid < zs->zs_blkid :
+		    blkid >= zs->zs_blkid + zs->zs_nblks) {
+			(void) atomic_swap_32(&zs->zs_catchup, B_TRUE);
+			ZFETCHSTAT_BUMP(zfetchstat_catchups);
+		}
+	}
+
 	if (zfs_refcount_remove(&zs->zs_refs, NULL) == 0)
 		dmu_zfetch_stream_fini(zs);
 }
 
+/*
+ * Resize the prefetch window of a stream for an access of nbytes which hit
+ * it.  The window should cover what the reader consumes while a prefetch
+ * is in flight, i.e. its read rate times the prefetch latency, twice over
+ * to absorb variation.  If the reader caught up with an in-flight prefetch
+ * since the last access, the window grows by at least a quarter.  It only
+ * shrinks by an eighth per access, and stays between zfetch_min_distance
+ * and zfetch_max_distance.  While the ARC is overflowing the window is
+ * halved on each access instead, down to zfetch_min_distance, so that
+ * prefetch does not evict data faster than it is read.
+ */
+static void
+dmu_zfetch_adapt(zstream_t *zs, uint64_t nbytes, hrtime_t now)
+{
+	uint64_t min_dist = MIN(zfetch_min_distance, zfetch_max_distance);
+	uint64_t dist = zs->zs_distance;
+	uint64_t lat = zs->zs_lat;
+	hrtime_t delta = now - zs->zs_atime;
+	uint64_t target;
+
+	if (delta > 0) {
+		uint64_t rate = nbytes * NANOSEC / delta;
+
+		zs->zs_rate = (zs->zs_rate == 0) ? rate :
+		    zs->zs_rate - zs->zs_rate / 8 + rate / 8;
+	}
+
+	if (lat != 0)
+		target = 2 * zs->zs_rate * NSEC2USEC(lat) / MICROSEC;
+	else
+		target = dist;
+	if (atomic_swap_32(&zs->zs_catchup, B_FALSE)) {
+		target = MAX(target, dist + dist / 4);
+	}
+	target = MAX(target, dist - dist / 8);
+	if (arc_is_overflowing()) {
+		target = MIN(target, dist / 2);
+		ZFETCHSTAT_BUMP(zfetchstat_distance_arc_capped);
+	}
+	target = MIN(MAX(target, min_dist), zfetch_max_distance);
+
+	if (target > dist)
+		ZFETCHSTAT_BUMP(zfetchstat_distance_grown);
+	else if (target < dist)
+		ZFETCHSTAT_BUMP(zfetchstat_distance_shrunk);
+	ZFETCHSTAT_ADD(zfetchstat_distance, (int64_t)(target - dist));
+	zs->zs_distance = target;
+}
+
+/*
+ * Called for an access which no stream expects.  Streams which were never
+ * hit stand for the accesses which created them.  If this access is the
+ * same distance away from the last access of such a stream as that access
+ * was from the one before, the stream is turned into a strided one and
+ * returned.  Otherwise the distance is remembered as the candidate stride
+ * of the most recent stream without one, so that the following access can
+ * confirm it.  The sequential expectation of the stream is left alone, so
+ * that interleaved sequential readers are still told apart.
+ */
+static zstream_t *
+dmu_zfetch_stride_detect(zfetch_t *zf, uint64_t blkid, uint64_t nblks)
+{
+	int64_t max_dist_blks;
+	zstream_t *zs, *cand = NULL;
+
+	ASSERT(MUTEX_HELD(&zf->zf_lock));
+
+	if (!zfetch_detect_stride)
+		return (NULL);
+
+	max_dist_blks = zfetch_max_distance >> zf->zf_dnode->dn_datablkshift;
+	for (zs = list_head(&zf->zf_stream); zs != NULL;
+	    zs = list_next(&zf->zf_stream, zs)) {
+		int64_t dist = (int64_t)(blkid - zs->zs_last_blkid);
+
+		if (zs->zs_stride != 0 || zs->zs_hits != 0 ||
+		    zfs_refcount_count(&zs->zs_refs) != 1)
+			continue;
+		if (dist == 0 || ABS(dist) > max_dist_blks)
+			continue;
+
+		if (dist == zs->zs_stride_cand) {
+			zs->zs_stride = dist;
+			zs->zs_nblks = MAX(zs->zs_nblks, nblks);
+			zs->zs_pf_blkid1 = blkid;
+			zs->zs_pf_blkid = blkid;
+			ZFETCHSTAT_BUMP(zfetchstat_stride_detected);
+			return (zs);
+		}
+		if (cand == NULL && zs->zs_stride_cand == 0)
+			cand = zs;
+	}
+
+	if (cand != NULL) {
+		cand->zs_stride_cand = (int64_t)(blkid - cand->zs_last_blkid);
+		cand->zs_last_blkid = blkid;
+		cand->zs_nblks = nblks;
+	}
+
+	return (NULL);
+}
+
+/*
+ * Strided counterpart of the stream update in dmu_zfetch_prepare(): move
+ * the stream past this access and extend its prefetch along the stride.
+ * Returns NULL if the stream runs off the object and has been removed.
+ */
+static zstream_t *
+dmu_zfetch_prepare_stride(zfetch_t *zf, zstream_t *zs, uint64_t blkid,
+    uint64_t nblks, boolean_t fetch_data)
+{
+	int64_t stride = zs->zs_stride;
+	int64_t maxblkid = zf->zf_dnode->dn_maxblkid;
+	int64_t next = (int64_t)blkid + stride;
+	int64_t ahead, max_ahead, pf_naccesses;
+	hrtime_t now = gethrtime();
+
+	ASSERT(MUTEX_HELD(&zf->zf_lock));
+
+	zs->zs_nblks = MAX(zs->zs_nblks, nblks);
+	if (next < 0 || next + (int64_t)zs->zs_nblks > maxblkid + 1) {
+		dmu_zfetch_stream_remove(zf, zs);
+		return (NULL);
+	}
+	dmu_zfetch_adapt(zs, nblks << zf->zf_dnode->dn_datablkshift, now);
+
+	/*
+	 * zs_pf_blkid1 and zs_pf_blkid are a whole number of strides away
+	 * from the next access; skip whatever the reader has overtaken.
+	 */
+	if (((int64_t)zs->zs_pf_blkid1 - next) / stride < 0)
+		zs->zs_pf_blkid1 = next;
+	ahead = ((int64_t)zs->zs_pf_blkid - next) / stride;
+	if (ahead < 0) {
+		zs->zs_pf_blkid = next;
+		ahead = 0;
+	}
+
+	/*
+	 * As for sequential streams, double the number of accesses we are
+	 * ahead by, but don't prefetch more than the stream's distance
+	 * ahead or past either end of the object.
+	 */
+	max_ahead = MAX(1, (zs->zs_distance >>
+	    zf->zf_dnode->dn_datablkshift) / zs->zs_nblks);
+	if (stride > 0) {
+		max_ahead = MIN(max_ahead,
+		    (maxblkid + 1 - (int64_t)zs->zs_nblks - next) / stride + 1);
+	} else {
+		max_ahead = MIN(max_ahead, next / -stride + 1);
+	}
+	if (fetch_data)
+		pf_naccesses = MAX(0, MIN(ahead + 1, max_ahead - ahead));
+	else
+		pf_naccesses = 0;
+	zs->zs_pf_blkid = next + (ahead + pf_naccesses) * stride;
+
+	zs->zs_last_blkid = blkid;
+	zs->zs_blkid = next;
+	zs->zs_hits++;
+	/* Protect the stream from reclamation. */
+	zs->zs_atime = now;
+	zfs_refcount_add(&zs->zs_refs, NULL);
+	/* Count concurrent callers. */
+	zfs_refcount_add(&zs->zs_callers, NULL);
+
+	if (stride > 0)
+		ZFETCHSTAT_BUMP(zfetchstat_stride_hits);
+	else
+		ZFETCHSTAT_BUMP(zfetchstat_backward_hits);
+	return (zs);
+}
+
 /*
  * This is the predictive prefetch entry point.  dmu_zfetch_prepare()
  * associates dnode access specified with blkid and nblks arguments with
@@ -254,6 +484,7 @@ dmu_zfetch_prepare(zfetch_t *zf, uint64_t blkid, uint64_t nblks,
 	int64_t pf_ahead_blks, max_blks;
 	int max_dist_blks, pf_nblks, ipf_nblks;
 	uint64_t end_of_access_blkid, maxblkid;
+	hrtime_t now = 0;
 	end_of_access_blkid = blkid + nblks;
 	spa_t *spa = zf->zf_dnode->dn_objset->os_spa;
 
@@ -300,20 +531,39 @@ dmu_zfetch_prepare(zfetch_t *zf, uint64_t blkid, uint64_t nblks,
 	    zs = list_next(&zf->zf_stream, zs)) {
 		if (blkid == zs->zs_blkid) {
 			break;
-		} else if (blkid + 1 == zs->zs_blkid) {
+		} else if (zs->zs_stride == 0 && blkid + 1 == zs->zs_blkid) {
 			blkid++;
 			nblks--;
 			break;
 		}
 	}
 
+	/*
+	 * An access no stream expects may still be the next one of a
+	 * strided or backward pattern.  Those streams do their own end of
+	 * file handling.
+	 */
+	if (zs == NULL)
+		zs = dmu_zfetch_stride_detect(zf, blkid, nblks);
+	if (zs != NULL && zs->zs_stride != 0) {
+		zs = dmu_zfetch_prepare_stride(zf, zs, blkid, nblks,
+		    fetch_data);
+		mutex_exit(&zf->zf_lock);
+		if (!have_lock)
+			rw_exit(&zf->zf_dnode->dn_struct_rwlock);
+		return (zs);
+	}
+
 	/*
 	 * If the file is ending, remove the matching stream if found.
-	 * If not found then it is too late to create a new one now.
+	 * If not found then it is too late to create a new sequential one,
+	 * but a stream may still pick up a backward pattern from here.
 	 */
 	if (end_of_access_blkid >= maxblkid) {
 		if (zs != NULL)
 			dmu_zfetch_stream_remove(zf, zs);
+		else if (zfetch_detect_stride)
+			dmu_zfetch_stream_create(zf, blkid, nblks);
 		mutex_exit(&zf->zf_lock);
 		if (!have_lock)
 			rw_exit(&zf->zf_dnode->dn_struct_rwlock);
@@ -333,7 +583,7 @@ dmu_zfetch_prepare(zfetch_t *zf, uint64_t blkid, uint64_t nblks,
 		 * This access is not part of any existing stream.  Create
 		 * a new stream for it.
 		 */
-		dmu_zfetch_stream_create(zf, end_of_access_blkid);
+		dmu_zfetch_stream_create(zf, blkid, nblks);
 		mutex_exit(&zf->zf_lock);
 		if (!have_lock)
 			rw_exit(&zf->zf_dnode->dn_struct_rwlock);
@@ -359,11 +609,15 @@ dmu_zfetch_prepare(zfetch_t *zf, uint64_t blkid, uint64_t nblks,
 
 	/*
 	 * Double our amount of prefetched data, but don't let the
-	 * prefetch get further ahead than zfetch_max_distance.
+	 * prefetch get further ahead than the stream's distance, which is
+	 * adapted to how quickly its prefetches complete.
 	 */
 	if (fetch_data) {
+		now = gethrtime();
+		dmu_zfetch_adapt(zs,
+		    nblks << zf->zf_dnode->dn_datablkshift, now);
 		max_dist_blks =
-		    zfetch_max_distance >> zf->zf_dnode->dn_datablkshift;
+		    zs->zs_distance >> zf->zf_dnode->dn_datablkshift;
 		/*
 		 * Previously, we were (zs_pf_blkid - blkid) ahead.  We
 		 * want to now be double that, so read that amount again,
@@ -372,7 +626,8 @@ dmu_zfetch_prepare(zfetch_t *zf, uint64_t blkid, uint64_t nblks,
 		 */
 		pf_ahead_blks = zs->zs_pf_blkid - blkid + nblks;
 		max_blks = max_dist_blks - (pf_start - end_of_access_blkid);
-		pf_nblks = MIN(pf_ahead_blks, max_blks);
+		/* We may already be further ahead if the distance shrank. */
+		pf_nblks = MAX(0, MIN(pf_ahead_blks, max_blks));
 	} else {
 		pf_nblks = 0;
 	}
@@ -399,8 +654,9 @@ dmu_zfetch_prepare(zfetch_t *zf, uint64_t blkid, uint64_t nblks,
 	zs->zs_ipf_blkid = ipf_start + ipf_nblks;
 
 	zs->zs_blkid = end_of_access_blkid;
+	zs->zs_hits++;
 	/* Protect the stream from reclamation. */
-	zs->zs_atime = gethrtime();
+	zs->zs_atime = (now != 0) ? now : gethrtime();
 	zfs_refcount_add(&zs->zs_refs, NULL);
 	/* Count concurrent callers. */
 	zfs_refcount_add(&zs->zs_callers, NULL);
@@ -413,6 +669,65 @@ dmu_zfetch_prepare(zfetch_t *zf, uint64_t blkid, uint64_t nblks,
 	return (zs);
 }
 
+/*
+ * Strided counterpart of dmu_zfetch_run(): prefetch the data blocks of the
+ * accesses predicted by dmu_zfetch_prepare_stride().  The indirect blocks
+ * are read by dbuf_prefetch_impl() as needed.
+ */
+static void
+dmu_zfetch_run_stride(zstream_t *zs, boolean_t have_lock)
+{
+	zfetch_t *zf = zs->zs_fetch;
+	int64_t stride = zs->zs_stride;
+	int64_t pf_start, pf_end, naccesses;
+	uint64_t nblks;
+	int issued;
+
+	mutex_enter(&zf->zf_lock);
+	nblks = zs->zs_nblks;
+	if (zs->zs_missed) {
+		pf_start = zs->zs_pf_blkid1;
+		pf_end = zs->zs_pf_blkid1 = zs->zs_pf_blkid;
+	} else {
+		pf_start = pf_end = 0;
+	}
+	mutex_exit(&zf->zf_lock);
+
+	naccesses = (pf_end - pf_start) / stride;
+	ASSERT3S(naccesses, >=, 0);
+	issued = naccesses * nblks;
+	if (issued > 1) {
+		/* More references on top of taken in dmu_zfetch_prepare(). */
+		zfs_refcount_add_many(&zs->zs_refs, issued - 1, NULL);
+	} else if (issued == 0) {
+		/* Some other thread has done our work, so drop the ref. */
+		if (zfs_refcount_remove(&zs->zs_refs, NULL) == 0)
+			dmu_zfetch_stream_fini(zs);
+		return;
+	}
+
+	if (!have_lock)
+		rw_enter(&zf->zf_dnode->dn_struct_rwlock, RW_READER);
+
+	issued = 0;
+	for (int64_t i = 0; i < naccesses; i++) {
+		uint64_t blk = pf_start + i * stride;
+
+		for (uint64_t b = 0; b < nblks; b++) {
+			issued += dbuf_prefetch_impl(zf->zf_dnode, 0, blk + b,
+			    ZIO_PRIORITY_ASYNC_READ,
+			    ARC_FLAG_PREDICTIVE_PREFETCH,
+			    dmu_zfetch_stream_done, zs);
+		}
+	}
+
+	if (!have_lock)
+		rw_exit(&zf->zf_dnode->dn_struct_rwlock);
+
+	if (issued)
+		ZFETCHSTAT_ADD(zfetchstat_io_issued, issued);
+}
+
 void
 dmu_zfetch_run(zstream_t *zs, boolean_t missed, boolean_t have_lock)
 {
@@ -435,6 +750,11 @@ dmu_zfetch_run(zstream_t *zs, boolean_t missed, boolean_t have_lock)
 		return;
 	}
 
+	if (zs->zs_stride != 0) {
+		dmu_zfetch_run_stride(zs, have_lock);
+		return;
+	}
+
 	mutex_enter(&zf->zf_lock);
 	if (zs->zs_missed) {
 		pf_start = zs->zs_pf_blkid1;
@@ -506,6 +826,9 @@ ZFS_MODULE_PARAM(zfs_prefetch, zfetch_, max_streams, UINT, ZMOD_RW,
 ZFS_MODULE_PARAM(zfs_prefetch, zfetch_, min_sec_reap, UINT, ZMOD_RW,
 	"Min time before stream reclaim");
 
+ZFS_MODULE_PARAM(zfs_prefetch, zfetch_, min_distance, UINT, ZMOD_RW,
+	"Min bytes to prefetch per stream");
+
 ZFS_MODULE_PARAM(zfs_prefetch, zfetch_, max_distance, UINT, ZMOD_RW,
 	"Max bytes to prefetch per stream");
 
@@ -514,4 +837,7 @@ ZFS_MODULE_PARAM(zfs_prefetch, zfetch_, max_idistance, UINT, ZMOD_RW,
 
 ZFS_MODULE_PARAM(zfs_prefetch, zfetch_, array_rd_sz, ULONG, ZMOD_RW,
 	"Number of bytes in a array_read");
+
+ZFS_MODULE_PARAM(zfs_prefetch, zfetch_, detect_stride, INT, ZMOD_RW,
+	"Detect constant-stride and backward streams");
 /* END CSTYLED */
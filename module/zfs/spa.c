@@ -82,6 +82,7 @@
 #include <sys/callb.h>
 #include <sys/systeminfo.h>
 #include <sys/spa_boot.h>
+#include <sys/spa_warmset.h>
 #include <sys/zfs_ioctl.h>
 #include <sys/dsl_scan.h>
 #include <sys/zfeature.h>
@@ -1602,6 +1603,10 @@ spa_destroy_aux_threads(spa_t *spa)
 		zthr_destroy(spa->spa_livelist_condense_zthr);
 		spa->spa_livelist_condense_zthr = NULL;
 	}
+	if (spa->spa_warmset_zthr != NULL) {
+		zthr_destroy(spa->spa_warmset_zthr);
+		spa->spa_warmset_zthr = NULL;
+	}
 }
 
 /*
@@ -2865,6 +2870,12 @@ spa_spawn_aux_threads(spa_t *spa)
 	    zthr_create("z_checkpoint_discard",
 	    spa_checkpoint_discard_thread_check,
 	    spa_checkpoint_discard_thread, spa);
+
+	ASSERT3P(spa->spa_warmset_zthr, ==, NULL);
+	spa->spa_warmset_saved = gethrtime();
+	spa->spa_warmset_zthr =
+	    zthr_create_timer("z_warmset", spa_warmset_thread_check,
+	    spa_warmset_thread, spa, SEC2NSEC(5));
 }
 
 /*
@@ -4135,6 +4146,16 @@ spa_ld_get_props(spa_t *spa)
 	if (error != 0 && error != ENOENT)
 		return (spa_vdev_err(rvd, VDEV_AUX_CORRUPT_DATA, EIO));
 
+	/*
+	 * Load the ARC warm set, which is prefetched once the pool is up.
+	 * If it was never recorded, this will not be present.
+	 */
+	error = spa_dir_prop(spa, DMU_POOL_ARC_WARMSET,
+	    &spa->spa_warmset_object, B_FALSE);
+	if (error != 0 && error != ENOENT)
+		return (spa_vdev_err(rvd, VDEV_AUX_CORRUPT_DATA, EIO));
+	spa->spa_warmset_restore = (spa->spa_warmset_object != 0);
+
 	/*
 	 * Load the livelist deletion field. If a livelist is queued for
 	 * deletion, indicate that in the spa
@@ -8298,6 +8319,10 @@ spa_async_suspend(spa_t *spa)
 	zthr_t *ll_condense_thread = spa->spa_livelist_condense_zthr;
 	if (ll_condense_thread != NULL)
 		zthr_cancel(ll_condense_thread);
+
+	zthr_t *warmset_thread = spa->spa_warmset_zthr;
+	if (warmset_thread != NULL)
+		zthr_cancel(warmset_thread);
 }
 
 void
@@ -8324,6 +8349,10 @@ spa_async_resume(spa_t *spa)
 	zthr_t *ll_condense_thread = spa->spa_livelist_condense_zthr;
 	if (ll_condense_thread != NULL)
 		zthr_resume(ll_condense_thread);
+
+	zthr_t *warmset_thread = spa->spa_warmset_zthr;
+	if (warmset_thread != NULL)
+		zthr_resume(warmset_thread);
 }
 
 static boolean_t
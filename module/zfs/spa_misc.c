@@ -2419,6 +2419,7 @@ spa_init(spa_mode_t mode)
 	zil_init();
 	vdev_cache_stat_init();
 	vdev_mirror_stat_init();
+	vdev_hedge_stat_init();
 	vdev_raidz_math_init();
 	vdev_file_init();
 	zfs_prop_init();
@@ -2440,6 +2441,7 @@ spa_fini(void)
 
 	vdev_file_fini();
 	vdev_cache_stat_fini();
+	vdev_hedge_stat_fini();
 	vdev_mirror_stat_fini();
 	vdev_raidz_math_fini();
 	zil_fini();
@@ -23,6 +23,7 @@
 #include <sys/spa_impl.h>
 #include <sys/vdev_impl.h>
 #include <sys/spa.h>
+#include <sys/zio_impl.h>
 #include <zfs_comutil.h>
 
 /*
@@ -45,6 +46,11 @@ int zfs_txg_history = 100;
  */
 int zfs_multihost_history = 0;
 
+/*
+ * Record per-stage zio pipeline latency histograms, disabled by default.
+ */
+int zfs_zio_stage_histograms = 0;
+
 /*
  * ==========================================================================
  * SPA Read History Routines
@@ -990,6 +996,367 @@ spa_iostats_destroy(spa_t *spa)
 	mutex_destroy(&shk->lock);
 }
 
+/*
+ * ==========================================================================
+ * SPA zio Stage Latency Routines
+ * ==========================================================================
+ */
+
+/*
+ * zio pipeline statistics - log2 histograms of the time each zio spends in
+ * each pipeline stage, by zio type and priority.  The time of a stage runs
+ * from when the stage starts until the next stage starts, so it includes
+ * waiting for child zios, the vdev queue and the device, and for taskq
+ * threads.  The histograms take a fair amount of memory, so they are only
+ * allocated once zfs_zio_stage_histograms is set and the first sample is
+ * recorded.  The kstat lists the (type, priority, stage) rows which have
+ * samples, bucket N counting latencies of 2^N to 2^(N+1)-1 nanoseconds.
+ */
+#define	SPA_ZIO_STAGE_PRIOS	(ZIO_PRIORITY_NUM_QUEUEABLE + 1)
+
+typedef struct spa_zio_stage_row {
+	uint8_t		type;
+	uint8_t		priority;
+	uint8_t		stage;
+	uint64_t	histo[VDEV_L_HISTO_BUCKETS];
+} spa_zio_stage_row_t;
+
+typedef struct spa_zio_stages {
+	spa_zio_stage_row_t rows[ZIO_TYPES][SPA_ZIO_STAGE_PRIOS][ZIO_STAGES];
+} spa_zio_stages_t;
+
+#define	SPA_ZIO_STAGE_ROWS	(ZIO_TYPES * SPA_ZIO_STAGE_PRIOS * ZIO_STAGES)
+
+static const char *spa_zio_type_names[ZIO_TYPES] = {
+	"null", "read", "write", "free", "claim", "ioctl", "trim"
+};
+
+static const char *spa_zio_priority_names[SPA_ZIO_STAGE_PRIOS] = {
+	"sync_read", "sync_write", "async_read", "async_write", "scrub",
+	"removal", "initializing", "trim", "rebuild", "now"
+};
+
+static int
+spa_zio_stages_headers(char *buf, size_t size)
+{
+	int n;
+
+	n = snprintf(buf, size, "%-6s %-13s %-18s", "type", "priority",
+	    "stage");
+	for (int b = 0; b < VDEV_L_HISTO_BUCKETS && n < size; b++)
+		n += snprintf(buf + n, size - n, " %u", b);
+	if (n < size)
+		(void) snprintf(buf + n, size - n, "\n");
+
+	return (0);
+}
+
+static int
+spa_zio_stages_data(char *buf, size_t size, void *data)
+{
+	spa_zio_stage_row_t *row = data;
+	int n;
+
+	n = snprintf(buf, size, "%-6s %-13s %-18s",
+	    spa_zio_type_names[row->type],
+	    spa_zio_priority_names[row->priority],
+	    zio_stage_names[row->stage]);
+	for (int b = 0; b < VDEV_L_HISTO_BUCKETS && n < size; b++) {
+		n += snprintf(buf + n, size - n, " %llu",
+		    (u_longlong_t)row->histo[b]);
+	}
+	if (n < size)
+		(void) snprintf(buf + n, size - n, "\n");
+
+	return (0);
+}
+
+static boolean_t
+spa_zio_stage_row_empty(const spa_zio_stage_row_t *row)
+{
+	for (int b = 0; b < VDEV_L_HISTO_BUCKETS; b++) {
+		if (row->histo[b] != 0)
+			return (B_FALSE);
+	}
+	return (B_TRUE);
+}
+
+/*
+ * Return the n-th row which has samples.  Rows are read in order, so
+ * continue from the previous row where possible: shk->count holds the
+ * index of the last row returned and shk->size its position in the table.
+ */
+static void *
+spa_zio_stages_addr(kstat_t *ksp, loff_t n)
+{
+	spa_t *spa = ksp->ks_private;
+	spa_history_kstat_t *shk = &spa->spa_stats.zio_stages;
+	spa_zio_stages_t *szs = shk->priv;
+	spa_zio_stage_row_t *rows;
+	uint64_t i = 0;
+	loff_t found = 0;
+
+	if (szs == NULL)
+		return (NULL);
+
+	rows = &szs->rows[0][0][0];
+	if (n > 0 && shk->count == n - 1) {
+		i = shk->size + 1;
+		found = n;
+	}
+	for (; i < SPA_ZIO_STAGE_ROWS; i++) {
+		if (spa_zio_stage_row_empty(&rows[i]))
+			continue;
+		if (found++ == n) {
+			shk->count = n;
+			shk->size = i;
+			return (&rows[i]);
+		}
+	}
+
+	return (NULL);
+}
+
+static spa_zio_stages_t *
+spa_zio_stages_alloc(spa_t *spa)
+{
+	spa_history_kstat_t *shk = &spa->spa_stats.zio_stages;
+	spa_zio_stages_t *szs;
+
+	szs = vmem_zalloc(sizeof (spa_zio_stages_t), KM_NOSLEEP);
+	if (szs == NULL)
+		return (NULL);
+
+	for (int t = 0; t < ZIO_TYPES; t++) {
+		for (int p = 0; p < SPA_ZIO_STAGE_PRIOS; p++) {
+			for (int s = 0; s < ZIO_STAGES; s++) {
+				spa_zio_stage_row_t *row = &szs->rows[t][p][s];
+
+				row->type = t;
+				row->priority = p;
+				row->stage = s;
+			}
+		}
+	}
+
+	if (atomic_cas_ptr(&shk->priv, NULL, szs) != NULL) {
+		vmem_free(szs, sizeof (spa_zio_stages_t));
+		szs = shk->priv;
+	}
+
+	return (szs);
+}
+
+/*
+ * Record the time a zio of the given type and priority spent in a pipeline
+ * stage, identified by its index (highbit64(ZIO_STAGE_*) - 1).
+ */
+void
+spa_zio_stage_add(spa_t *spa, zio_type_t type, zio_priority_t priority,
+    int stage, hrtime_t delta)
+{
+	spa_zio_stages_t *szs = spa->spa_stats.zio_stages.priv;
+
+	if (szs == NULL && (szs = spa_zio_stages_alloc(spa)) == NULL)
+		return;
+
+	ASSERT3U(type, <, ZIO_TYPES);
+	ASSERT3U(stage, <, ZIO_STAGES);
+	if (priority >= ZIO_PRIORITY_NUM_QUEUEABLE)
+		priority = ZIO_PRIORITY_NUM_QUEUEABLE;
+
+	atomic_inc_64(&szs->rows[type][priority][stage].histo[L_HISTO(delta)]);
+}
+
+/*
+ * Sum the latency histograms of a stage for all priorities of a zio type
+ * into histo, which has VDEV_L_HISTO_BUCKETS entries.
+ */
+void
+spa_zio_stage_histo(spa_t *spa, zio_type_t type, int stage, uint64_t *histo)
+{
+	spa_zio_stages_t *szs = spa->spa_stats.zio_stages.priv;
+
+	bzero(histo, VDEV_L_HISTO_BUCKETS * sizeof (uint64_t));
+	if (szs == NULL)
+		return;
+
+	for (int p = 0; p < SPA_ZIO_STAGE_PRIOS; p++) {
+		for (int b = 0; b < VDEV_L_HISTO_BUCKETS; b++)
+			histo[b] += szs->rows[type][p][stage].histo[b];
+	}
+}
+
+static void
+spa_zio_stages_init(spa_t *spa)
+{
+	spa_history_kstat_t *shk = &spa->spa_stats.zio_stages;
+	char *name;
+	kstat_t *ksp;
+
+	mutex_init(&shk->lock, NULL, MUTEX_DEFAULT, NULL);
+	shk->priv = NULL;
+
+	name = kmem_asprintf("zfs/%s", spa_name(spa));
+	ksp = kstat_create(name, 0, "zio_stages", "misc",
+	    KSTAT_TYPE_RAW, 0, KSTAT_FLAG_VIRTUAL);
+
+	shk->kstat = ksp;
+	if (ksp) {
+		ksp->ks_lock = &shk->lock;
+		ksp->ks_data = NULL;
+		ksp->ks_ndata = UINT32_MAX;
+		ksp->ks_private = spa;
+		kstat_set_raw_ops(ksp, spa_zio_stages_headers,
+		    spa_zio_stages_data, spa_zio_stages_addr);
+		kstat_install(ksp);
+	}
+
+	kmem_strfree(name);
+}
+
+static void
+spa_zio_stages_destroy(spa_t *spa)
+{
+	spa_history_kstat_t *shk = &spa->spa_stats.zio_stages;
+
+	if (shk->kstat)
+		kstat_delete(shk->kstat);
+	if (shk->priv != NULL)
+		vmem_free(shk->priv, sizeof (spa_zio_stages_t));
+	shk->priv = NULL;
+
+	mutex_destroy(&shk->lock);
+}
+
+/*
+ * ==========================================================================
+ * SPA Mirror Child Latency Routines
+ * ==========================================================================
+ */
+
+/*
+ * The read latency estimates vdev_mirror_load() uses, one row for every
+ * child of a mirror, replacing or spare vdev.  The vdev tree may change
+ * between rows, so each row is copied out under the config lock.
+ */
+typedef struct spa_mirror_latency_row {
+	uint64_t	guid;
+	uint64_t	latency;	/* ns, see vdev_mirror_latency() */
+	uint64_t	reads;
+	char		name[MAXNAMELEN];
+} spa_mirror_latency_row_t;
+
+static int
+spa_mirror_latency_headers(char *buf, size_t size)
+{
+	(void) snprintf(buf, size, "%-20s %-14s %-12s %s\n", "guid",
+	    "latency_ns", "reads", "vdev");
+
+	return (0);
+}
+
+static int
+spa_mirror_latency_data(char *buf, size_t size, void *data)
+{
+	spa_mirror_latency_row_t *row = data;
+
+	(void) snprintf(buf, size, "%-20llu %-14llu %-12llu %s\n",
+	    (u_longlong_t)row->guid, (u_longlong_t)row->latency,
+	    (u_longlong_t)row->reads, row->name);
+
+	return (0);
+}
+
+static vdev_t *
+spa_mirror_latency_child(vdev_t *vd, loff_t *n)
+{
+	boolean_t mirror = (vd->vdev_ops == &vdev_mirror_ops ||
+	    vd->vdev_ops == &vdev_replacing_ops ||
+	    vd->vdev_ops == &vdev_spare_ops);
+	vdev_t *found;
+
+	for (int c = 0; c < vd->vdev_children; c++) {
+		vdev_t *cvd = vd->vdev_child[c];
+
+		if (mirror && (*n)-- == 0)
+			return (cvd);
+		if ((found = spa_mirror_latency_child(cvd, n)) != NULL)
+			return (found);
+	}
+
+	return (NULL);
+}
+
+static void *
+spa_mirror_latency_addr(kstat_t *ksp, loff_t n)
+{
+	spa_t *spa = ksp->ks_private;
+	spa_mirror_latency_row_t *row = spa->spa_stats.mirror_latency.priv;
+	vdev_t *vd = NULL;
+
+	spa_config_enter(spa, SCL_VDEV, FTAG, RW_READER);
+	if (spa->spa_root_vdev != NULL)
+		vd = spa_mirror_latency_child(spa->spa_root_vdev, &n);
+	if (vd != NULL) {
+		row->guid = vd->vdev_guid;
+		row->latency = vdev_mirror_latency(vd);
+		row->reads = vd->vdev_mirror_reads;
+		if (vd->vdev_path != NULL) {
+			(void) strlcpy(row->name, vd->vdev_path,
+			    sizeof (row->name));
+		} else {
+			(void) snprintf(row->name, sizeof (row->name),
+			    "%s-%llu", vd->vdev_ops->vdev_op_type,
+			    (u_longlong_t)vd->vdev_id);
+		}
+	}
+	spa_config_exit(spa, SCL_VDEV, FTAG);
+
+	return (vd != NULL ? row : NULL);
+}
+
+static void
+spa_mirror_latency_init(spa_t *spa)
+{
+	spa_history_kstat_t *shk = &spa->spa_stats.mirror_latency;
+	char *name;
+	kstat_t *ksp;
+
+	mutex_init(&shk->lock, NULL, MUTEX_DEFAULT, NULL);
+	shk->priv = kmem_zalloc(sizeof (spa_mirror_latency_row_t), KM_SLEEP);
+
+	name = kmem_asprintf("zfs/%s", spa_name(spa));
+	ksp = kstat_create(name, 0, "mirror_latency", "misc",
+	    KSTAT_TYPE_RAW, 0, KSTAT_FLAG_VIRTUAL);
+
+	shk->kstat = ksp;
+	if (ksp) {
+		ksp->ks_lock = &shk->lock;
+		ksp->ks_data = NULL;
+		ksp->ks_ndata = UINT32_MAX;
+		ksp->ks_private = spa;
+		kstat_set_raw_ops(ksp, spa_mirror_latency_headers,
+		    spa_mirror_latency_data, spa_mirror_latency_addr);
+		kstat_install(ksp);
+	}
+
+	kmem_strfree(name);
+}
+
+static void
+spa_mirror_latency_destroy(spa_t *spa)
+{
+	spa_history_kstat_t *shk = &spa->spa_stats.mirror_latency;
+
+	if (shk->kstat)
+		kstat_delete(shk->kstat);
+	kmem_free(shk->priv, sizeof (spa_mirror_latency_row_t));
+	shk->priv = NULL;
+
+	mutex_destroy(&shk->lock);
+}
+
 void
 spa_stats_init(spa_t *spa)
 {
@@ -1000,11 +1367,15 @@ spa_stats_init(spa_t *spa)
 	spa_mmp_history_init(spa);
 	spa_state_init(spa);
 	spa_iostats_init(spa);
+	spa_zio_stages_init(spa);
+	spa_mirror_latency_init(spa);
 }
 
 void
 spa_stats_destroy(spa_t *spa)
 {
+	spa_mirror_latency_destroy(spa);
+	spa_zio_stages_destroy(spa);
 	spa_iostats_destroy(spa);
 	spa_health_destroy(spa);
 	spa_tx_assign_destroy(spa);
@@ -1026,4 +1397,7 @@ ZFS_MODULE_PARAM(zfs_txg, zfs_txg_, history, INT, ZMOD_RW,
 
 ZFS_MODULE_PARAM(zfs_multihost, zfs_multihost_, history, INT, ZMOD_RW,
     "Historical statistics for last N multihost writes");
+
+ZFS_MODULE_PARAM(zfs, zfs_, zio_stage_histograms, INT, ZMOD_RW,
+    "Record per-stage zio pipeline latency histograms");
 /* END CSTYLED */
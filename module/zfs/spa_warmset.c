@@ -0,0 +1,424 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * ARC Warm Set
+ *
+ * After a reboot or a failover it can take hours of normal operation until
+ * the ARC holds the working set of a pool again.  To shorten that, a pool
+ * can periodically record which of its blocks are cached, and prefetch
+ * them in the background when it is imported again.  This does for main
+ * memory what the persistent L2ARC (see l2arc_rebuild()) does for cache
+ * devices.
+ *
+ * Recording
+ *
+ * ARC headers do not carry the checksum of their block, so the block
+ * pointers are taken from the dbufs that reference them (see
+ * dbuf_walk_cached()).  All cached indirect and dnode blocks are recorded
+ * first, since everything else is found through them, followed by level 0
+ * blocks whose ARC buffer is in the MFU state.  Blocks of the MOS and
+ * blocks born after the last synced txg are skipped.
+ *
+ * The snapshot is an array of spa_warmset_ent_t stored in a MOS object,
+ * which is referenced by the DMU_POOL_ARC_WARMSET entry of the pool
+ * directory.  It is rewritten by the z_warmset zthr every
+ * zfs_warmset_interval seconds, and holds at most zfs_warmset_max blocks.
+ * Setting zfs_warmset_max to 0 (the default) disables recording and
+ * removes an existing snapshot.
+ *
+ * No feature flag guards the snapshot.  Software which does not know
+ * DMU_POOL_ARC_WARMSET never looks it up, and the object is an ordinary
+ * DMU_OTN_UINT64_METADATA MOS object whose blocks are referenced and
+ * accounted like any other, so such software imports, scrubs and writes
+ * the pool as usual and merely leaves the snapshot stale.  The DMU_OTN
+ * types need SPA_VERSION_FEATURES, so pools of older versions record
+ * nothing.
+ *
+ * Restoring
+ *
+ * On import the blocks are read with arc_read() as speculative prefetches,
+ * in the order in which they were recorded, with at most
+ * SPA_WARMSET_INFLIGHT reads outstanding.  The restore stops once as many
+ * bytes as the ARC target size have been read.  The snapshot may be stale
+ * or damaged, so entries which fail zfs_blkptr_verify() or were born
+ * after the last synced txg (e.g. after a rewind) are skipped rather than
+ * handed to zio_read(), which would halt on them.  A recorded block may
+ * also have been freed in the meantime; its read then fails its checksum,
+ * which is not reported for speculative reads.  Set zfs_warmset_restore
+ * to 0 to skip the restore.
+ */
+
+#include <sys/arc.h>
+#include <sys/dbuf.h>
+#include <sys/dmu_objset.h>
+#include <sys/dmu_tx.h>
+#include <sys/dsl_pool.h>
+#include <sys/dsl_synctask.h>
+#include <sys/spa.h>
+#include <sys/spa_impl.h>
+#include <sys/spa_warmset.h>
+#include <sys/zap.h>
+#include <sys/zio.h>
+
+/*
+ * Maximum number of blocks recorded in the warm set; 0 disables it.
+ */
+unsigned long zfs_warmset_max = 0;
+
+/*
+ * Seconds between updates of the warm set.
+ */
+int zfs_warmset_interval = 600;
+
+/*
+ * Prefetch the warm set when the pool is imported.
+ */
+int zfs_warmset_restore = 1;
+
+#define	SPA_WARMSET_MAX_BLOCKS	(1ULL << 20)	/* hard cap */
+#define	SPA_WARMSET_INFLIGHT	16		/* restore reads in flight */
+#define	SPA_WARMSET_CHUNK	512		/* entries per dmu_read() */
+
+typedef struct spa_warmset_collect {
+	spa_t			*swc_spa;
+	uint64_t		swc_max_txg;
+	uint64_t		swc_max;	/* entries in swc_ents */
+	uint64_t		swc_nmeta;	/* filled from the front */
+	uint64_t		swc_ndata;	/* filled from the back */
+	spa_warmset_ent_t	*swc_ents;
+} spa_warmset_collect_t;
+
+typedef struct spa_warmset_restore {
+	kmutex_t	swr_lock;
+	kcondvar_t	swr_cv;
+	uint64_t	swr_inflight;
+} spa_warmset_restore_t;
+
+static void *
+spa_warmset_alloc(size_t size)
+{
+#if defined(_KERNEL)
+	return (vmem_alloc(size, KM_SLEEP));
+#else
+	return (kmem_alloc(size, KM_SLEEP));
+#endif
+}
+
+static void
+spa_warmset_free(void *buf, size_t size)
+{
+#if defined(_KERNEL)
+	vmem_free(buf, size);
+#else
+	kmem_free(buf, size);
+#endif
+}
+
+static void
+spa_warmset_collect_cb(dmu_buf_impl_t *db, void *arg)
+{
+	spa_warmset_collect_t *swc = arg;
+	dmu_buf_impl_t *parent = db->db_parent;
+	spa_warmset_ent_t *swe;
+	blkptr_t bp;
+
+	ASSERT(MUTEX_HELD(&db->db_mtx));
+
+	if (swc->swc_nmeta + swc->swc_ndata >= swc->swc_max)
+		return;
+
+	if (db->db_blkid == DMU_BONUS_BLKID || db->db_blkptr == NULL ||
+	    db->db_objset == spa_meta_objset(swc->swc_spa))
+		return;
+
+	/*
+	 * Syncing context rewrites *db_blkptr under the parent's db_rwlock
+	 * (see dbuf_write_ready()), not under db_mtx.  That lock is taken
+	 * before db_mtx, so only try it and skip the block if it is busy.
+	 * The top-level blocks of a meta-dnode have no parent dbuf; their
+	 * block pointers are in the objset_phys_t and are skipped as well.
+	 */
+	if (parent == NULL || !rw_tryenter(&parent->db_rwlock, RW_READER))
+		return;
+	bp = *db->db_blkptr;
+	rw_exit(&parent->db_rwlock);
+
+	if (BP_IS_HOLE(&bp) || BP_IS_EMBEDDED(&bp) || BP_IS_REDACTED(&bp) ||
+	    BP_PHYSICAL_BIRTH(&bp) > swc->swc_max_txg)
+		return;
+
+	if (db->db_level > 0 || db->db.db_object == DMU_META_DNODE_OBJECT) {
+		swe = &swc->swc_ents[swc->swc_nmeta++];
+	} else {
+		arc_buf_info_t abi;
+
+		if (db->db_buf == NULL)
+			return;
+		arc_buf_info(db->db_buf, &abi, 0);
+		if (abi.abi_state_type != ARC_STATE_MFU)
+			return;
+		swe = &swc->swc_ents[swc->swc_max - ++swc->swc_ndata];
+	}
+
+	swe->swe_bp = bp;
+	SET_BOOKMARK(&swe->swe_zb, dmu_objset_id(db->db_objset),
+	    db->db.db_object, db->db_level, db->db_blkid);
+}
+
+static void
+spa_warmset_save_sync(void *arg, dmu_tx_t *tx)
+{
+	spa_warmset_collect_t *swc = arg;
+	spa_t *spa = dmu_tx_pool(tx)->dp_spa;
+	objset_t *mos = spa->spa_meta_objset;
+	uint64_t obj = spa->spa_warmset_object;
+	uint64_t count = swc->swc_nmeta + swc->swc_ndata;
+	uint64_t size = count * sizeof (spa_warmset_ent_t);
+	spa_warmset_phys_t *swp;
+	dmu_buf_t *db;
+
+	if (count == 0) {
+		if (obj != 0) {
+			VERIFY0(dmu_object_free(mos, obj, tx));
+			VERIFY0(zap_remove(mos, DMU_POOL_DIRECTORY_OBJECT,
+			    DMU_POOL_ARC_WARMSET, tx));
+			spa->spa_warmset_object = 0;
+		}
+		return;
+	}
+
+	if (obj == 0) {
+		obj = dmu_object_alloc(mos, DMU_OTN_UINT64_METADATA,
+		    SPA_OLD_MAXBLOCKSIZE, DMU_OTN_UINT64_METADATA,
+		    sizeof (spa_warmset_phys_t), tx);
+		VERIFY0(zap_add(mos, DMU_POOL_DIRECTORY_OBJECT,
+		    DMU_POOL_ARC_WARMSET, sizeof (uint64_t), 1, &obj, tx));
+		spa->spa_warmset_object = obj;
+	}
+
+	dmu_write(mos, obj, 0, size, swc->swc_ents, tx);
+	VERIFY0(dmu_free_range(mos, obj, size, DMU_OBJECT_END, tx));
+
+	VERIFY0(dmu_bonus_hold(mos, obj, FTAG, &db));
+	dmu_buf_will_dirty(db, tx);
+	swp = db->db_data;
+	swp->swp_count = count;
+	swp->swp_nmeta = swc->swc_nmeta;
+	swp->swp_txg = swc->swc_max_txg;
+	swp->swp_timestamp = gethrestime_sec();
+	dmu_buf_rele(db, FTAG);
+}
+
+/*
+ * Take a new snapshot of the warm set, or remove the existing one if
+ * recording has been disabled.
+ */
+static void
+spa_warmset_save(spa_t *spa)
+{
+	spa_warmset_collect_t swc = { 0 };
+	size_t size;
+
+	swc.swc_spa = spa;
+	swc.swc_max = MIN(zfs_warmset_max, SPA_WARMSET_MAX_BLOCKS);
+	swc.swc_max_txg = spa_last_synced_txg(spa);
+	size = MAX(swc.swc_max, 1) * sizeof (spa_warmset_ent_t);
+	swc.swc_ents = spa_warmset_alloc(size);
+
+	if (swc.swc_max != 0) {
+		dbuf_walk_cached(spa, spa_warmset_collect_cb, &swc);
+		memmove(&swc.swc_ents[swc.swc_nmeta],
+		    &swc.swc_ents[swc.swc_max - swc.swc_ndata],
+		    swc.swc_ndata * sizeof (spa_warmset_ent_t));
+	}
+
+	/*
+	 * Blocks which were only prefetched by a restore have no dbufs, so
+	 * an idle pool finds nothing to record.  Keep the previous snapshot
+	 * rather than replacing it with an empty one.
+	 */
+	if (swc.swc_max == 0 || swc.swc_nmeta + swc.swc_ndata != 0) {
+		(void) dsl_sync_task(spa_name(spa), NULL,
+		    spa_warmset_save_sync, &swc, 0,
+		    ZFS_SPACE_CHECK_EXTRA_RESERVED);
+
+		zfs_dbgmsg("spa=%s recorded ARC warm set of %llu blocks "
+		    "(%llu metadata)", spa_name(spa),
+		    (u_longlong_t)(swc.swc_nmeta + swc.swc_ndata),
+		    (u_longlong_t)swc.swc_nmeta);
+	}
+
+	spa_warmset_free(swc.swc_ents, size);
+}
+
+static void
+spa_warmset_read_done(zio_t *zio, const zbookmark_phys_t *zb,
+    const blkptr_t *bp, arc_buf_t *abuf, void *arg)
+{
+	spa_warmset_restore_t *swr = arg;
+
+	if (abuf != NULL)
+		arc_buf_destroy(abuf, arg);
+
+	mutex_enter(&swr->swr_lock);
+	swr->swr_inflight--;
+	cv_signal(&swr->swr_cv);
+	mutex_exit(&swr->swr_lock);
+}
+
+static void
+spa_warmset_restore(spa_t *spa, zthr_t *zthr)
+{
+	objset_t *mos = spa->spa_meta_objset;
+	uint64_t obj = spa->spa_warmset_object;
+	uint64_t count, nmeta, issued = 0, skipped = 0, bytes = 0;
+	uint64_t limit = arc_target_bytes();
+	uint64_t last_txg = spa_last_synced_txg(spa);
+	spa_warmset_restore_t swr;
+	spa_warmset_ent_t *ents;
+	dmu_buf_t *db;
+
+	if (obj == 0 || dmu_bonus_hold(mos, obj, FTAG, &db) != 0)
+		return;
+	count = ((spa_warmset_phys_t *)db->db_data)->swp_count;
+	nmeta = ((spa_warmset_phys_t *)db->db_data)->swp_nmeta;
+	dmu_buf_rele(db, FTAG);
+
+	mutex_init(&swr.swr_lock, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&swr.swr_cv, NULL, CV_DEFAULT, NULL);
+	swr.swr_inflight = 0;
+	ents = kmem_alloc(SPA_WARMSET_CHUNK * sizeof (spa_warmset_ent_t),
+	    KM_SLEEP);
+
+	for (uint64_t off = 0; off < count && bytes < limit &&
+	    !zthr_iscancelled(zthr); off += SPA_WARMSET_CHUNK) {
+		uint64_t n = MIN(count - off, SPA_WARMSET_CHUNK);
+
+		if (dmu_read(mos, obj, off * sizeof (spa_warmset_ent_t),
+		    n * sizeof (spa_warmset_ent_t), ents,
+		    DMU_READ_PREFETCH) != 0)
+			break;
+
+		for (uint64_t i = 0; i < n && bytes < limit; i++) {
+			blkptr_t *bp = &ents[i].swe_bp;
+			int zio_flags = ZIO_FLAG_CANFAIL | ZIO_FLAG_SPECULATIVE;
+			arc_flags_t aflags = ARC_FLAG_NOWAIT |
+			    ARC_FLAG_PREFETCH | ARC_FLAG_NO_BUF;
+
+			/*
+			 * zio_read() halts on a malformed block pointer, so
+			 * check each entry first and skip the bad ones.
+			 */
+			if (BP_IS_HOLE(bp) || BP_IS_EMBEDDED(bp) ||
+			    BP_PHYSICAL_BIRTH(bp) > last_txg ||
+			    !zfs_blkptr_verify(spa, bp, B_FALSE,
+			    BLK_VERIFY_LOG)) {
+				skipped++;
+				continue;
+			}
+
+			/* dnodes are always read as raw and then converted */
+			if (BP_GET_TYPE(bp) == DMU_OT_DNODE &&
+			    BP_IS_PROTECTED(bp) && BP_GET_LEVEL(bp) == 0)
+				zio_flags |= ZIO_FLAG_RAW;
+
+			mutex_enter(&swr.swr_lock);
+			while (swr.swr_inflight >= SPA_WARMSET_INFLIGHT)
+				cv_wait(&swr.swr_cv, &swr.swr_lock);
+			swr.swr_inflight++;
+			mutex_exit(&swr.swr_lock);
+
+			if (arc_read(NULL, spa, bp, spa_warmset_read_done,
+			    &swr, ZIO_PRIORITY_ASYNC_READ, zio_flags, &aflags,
+			    &ents[i].swe_zb) != 0) {
+				mutex_enter(&swr.swr_lock);
+				swr.swr_inflight--;
+				mutex_exit(&swr.swr_lock);
+			}
+			issued++;
+			bytes += BP_GET_LSIZE(bp);
+		}
+	}
+
+	mutex_enter(&swr.swr_lock);
+	while (swr.swr_inflight != 0)
+		cv_wait(&swr.swr_cv, &swr.swr_lock);
+	mutex_exit(&swr.swr_lock);
+
+	kmem_free(ents, SPA_WARMSET_CHUNK * sizeof (spa_warmset_ent_t));
+	cv_destroy(&swr.swr_cv);
+	mutex_destroy(&swr.swr_lock);
+
+	zfs_dbgmsg("spa=%s restored ARC warm set: %llu of %llu blocks "
+	    "(%llu metadata, %llu invalid), %llu bytes", spa_name(spa),
+	    (u_longlong_t)issued, (u_longlong_t)count, (u_longlong_t)nmeta,
+	    (u_longlong_t)skipped, (u_longlong_t)bytes);
+}
+
+boolean_t
+spa_warmset_thread_check(void *arg, zthr_t *zthr)
+{
+	spa_t *spa = arg;
+
+	if (spa_suspended(spa))
+		return (B_FALSE);
+
+	if (spa->spa_warmset_restore)
+		return (B_TRUE);
+
+	/* the snapshot object is a DMU_OTN type, see above */
+	if ((zfs_warmset_max == 0 ||
+	    spa_version(spa) < SPA_VERSION_FEATURES) &&
+	    spa->spa_warmset_object == 0)
+		return (B_FALSE);
+
+	return (gethrtime() - spa->spa_warmset_saved >=
+	    SEC2NSEC(MAX(zfs_warmset_interval, 1)));
+}
+
+void
+spa_warmset_thread(void *arg, zthr_t *zthr)
+{
+	spa_t *spa = arg;
+
+	if (spa->spa_warmset_restore) {
+		if (zfs_warmset_restore)
+			spa_warmset_restore(spa, zthr);
+		spa->spa_warmset_restore = B_FALSE;
+		spa->spa_warmset_saved = gethrtime();
+		return;
+	}
+
+	spa_warmset_save(spa);
+	spa->spa_warmset_saved = gethrtime();
+}
+
+/* BEGIN CSTYLED */
+ZFS_MODULE_PARAM(zfs, zfs_, warmset_max, ULONG, ZMOD_RW,
+	"Max number of blocks recorded in the ARC warm set of a pool");
+
+ZFS_MODULE_PARAM(zfs, zfs_, warmset_interval, INT, ZMOD_RW,
+	"Seconds between updates of the ARC warm set");
+
+ZFS_MODULE_PARAM(zfs, zfs_, warmset_restore, INT, ZMOD_RW,
+	"Prefetch the ARC warm set when a pool is imported");
+/* END CSTYLED */
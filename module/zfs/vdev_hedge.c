@@ -0,0 +1,462 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+#include <sys/zfs_context.h>
+#include <sys/spa.h>
+#include <sys/spa_impl.h>
+#include <sys/vdev_impl.h>
+#include <sys/vdev_hedge.h>
+#include <sys/zio.h>
+#include <sys/kstat.h>
+#include <sys/abd.h>
+
+/*
+ * Hedged reads
+ *
+ * A single slow disk stalls every read of a mirror or raidz vdev which
+ * needs it.  When zfs_vdev_hedge is set, synchronous reads of these vdevs
+ * which have somewhere else to get their data from are hedged: if a child
+ * read has not completed after the zfs_vdev_hedge_percentile of the child
+ * read latencies of the vdev, the data is also requested elsewhere, from
+ * another mirror child or from the parity of a raidz, and the read
+ * completes with whichever arrives first.
+ *
+ * The child reads of a zio cannot be abandoned, its vdev_op_io_done only
+ * runs once all of them are done.  So the child reads of a hedged read
+ * are instead issued into private buffers as children of a separate root
+ * zio, and the read itself is left in its VDEV_IO_START stage, just like a
+ * leaf vdev zio waiting for its device.  The owner's vho_update callback
+ * is told about every completed child read, and once it has copied enough
+ * data into the read it is resumed with zio_interrupt().  Reads which are
+ * still in flight then only complete the root.  Until the read resumes the
+ * SCL_ZIO hold of its logical parent keeps the vdevs around; when reads
+ * are still in flight at that point the root takes a hold of its own,
+ * and if a config change is waiting for SCL_ZIO the read is only resumed
+ * once they are done.  So a read which never needed hedging, the usual
+ * case, takes no config lock.  Its first child read still goes into a
+ * private buffer: it cannot be stopped, and a late read into the buffer
+ * of the zio could overwrite the data after the zio completed with the
+ * data of the hedge.  The cost is a copy of the data of every hedged read,
+ * which is why this is not enabled by default.
+ *
+ * Every child keeps a log2 histogram of the latency of its reads, which is
+ * halved every VDEV_HEDGE_WINDOW samples so that it follows the current
+ * behaviour of the device.  The threshold for a read of a child is the
+ * percentile of the histograms of its siblings, so a slow child doesn't
+ * raise its own threshold however many of the reads it serves: in a 2-way
+ * mirror it serves about half of them.  When several children are read,
+ * as the columns of a raidz are, the lowest of their thresholds is used.
+ */
+int zfs_vdev_hedge = 0;
+static int zfs_vdev_hedge_percentile = 95;
+static int zfs_vdev_hedge_min_us = 1000;
+
+#define	VDEV_HEDGE_WINDOW	1024
+#define	VDEV_HEDGE_MIN_SAMPLES	64
+
+/*
+ * Vdev hedge kstats
+ */
+static kstat_t *hedge_ksp = NULL;
+
+typedef struct hedge_stats {
+	kstat_named_t vdev_hedge_stat_issued[VDEV_HEDGE_TYPES];
+	kstat_named_t vdev_hedge_stat_won[VDEV_HEDGE_TYPES];
+} hedge_stats_t;
+
+static hedge_stats_t hedge_stats = {
+	/* The timer issued reads elsewhere */
+	{
+		{ "mirror_issued",		KSTAT_DATA_UINT64 },
+		{ "raidz_issued",		KSTAT_DATA_UINT64 },
+	},
+	/* The read completed before the child it waited for */
+	{
+		{ "mirror_won",			KSTAT_DATA_UINT64 },
+		{ "raidz_won",			KSTAT_DATA_UINT64 },
+	},
+};
+
+#define	HEDGE_BUMP(stat, type)	\
+	atomic_inc_64(&hedge_stats.stat[type].value.ui64)
+
+void
+vdev_hedge_stat_init(void)
+{
+	hedge_ksp = kstat_create("zfs", 0, "vdev_hedge_stats",
+	    "misc", KSTAT_TYPE_NAMED,
+	    sizeof (hedge_stats) / sizeof (kstat_named_t), KSTAT_FLAG_VIRTUAL);
+	if (hedge_ksp != NULL) {
+		hedge_ksp->ks_data = &hedge_stats;
+		kstat_install(hedge_ksp);
+	}
+}
+
+void
+vdev_hedge_stat_fini(void)
+{
+	if (hedge_ksp != NULL) {
+		kstat_delete(hedge_ksp);
+		hedge_ksp = NULL;
+	}
+}
+
+static void
+vdev_hedge_sample(vdev_t *vd, hrtime_t lat)
+{
+	int b = MIN(highbit64(NSEC2USEC(lat)), VDEV_HEDGE_BUCKETS - 1);
+
+	atomic_inc_32(&vd->vdev_hedge_histo[b]);
+	if (atomic_inc_32_nv(&vd->vdev_hedge_samples) %
+	    VDEV_HEDGE_WINDOW == 0) {
+		for (b = 0; b < VDEV_HEDGE_BUCKETS; b++)
+			vd->vdev_hedge_histo[b] >>= 1;
+	}
+}
+
+/*
+ * Returns the upper bound of the histogram bucket holding the percentile
+ * in nanoseconds, or 0 if too few reads have been seen yet.
+ */
+static hrtime_t
+vdev_hedge_percentile(const uint64_t *histo)
+{
+	uint64_t total = 0, target, sum = 0;
+	int pct = MIN(MAX(zfs_vdev_hedge_percentile, 1), 100);
+	int b;
+
+	for (b = 0; b < VDEV_HEDGE_BUCKETS; b++)
+		total += histo[b];
+	if (total < VDEV_HEDGE_MIN_SAMPLES)
+		return (0);
+
+	target = howmany(total * pct, 100);
+	for (b = 0; b < VDEV_HEDGE_BUCKETS - 1; b++) {
+		sum += histo[b];
+		if (sum >= target)
+			break;
+	}
+
+	return (USEC2NSEC(MAX(1ULL << b, (uint64_t)zfs_vdev_hedge_min_us)));
+}
+
+/*
+ * Returns how long to wait for the reads issued so far before hedging
+ * them in nanoseconds, or 0 if it is not known yet.  The histograms are
+ * read without synchronization, a sample more or less doesn't matter.
+ */
+static hrtime_t
+vdev_hedge_threshold(vdev_hedge_t *vh)
+{
+	vdev_t *vd = vh->vh_vd;
+	uint64_t all[VDEV_HEDGE_BUCKETS] = { 0 };
+	uint64_t others[VDEV_HEDGE_BUCKETS];
+	hrtime_t threshold = 0;
+
+	for (uint64_t c = 0; c < vd->vdev_children; c++) {
+		vdev_t *cvd = vd->vdev_child[c];
+
+		for (int b = 0; b < VDEV_HEDGE_BUCKETS; b++)
+			all[b] += cvd->vdev_hedge_histo[b];
+	}
+
+	for (int i = 0; i < vh->vh_nreads; i++) {
+		vdev_hedge_read_t *vhr = &vh->vh_reads[i];
+		hrtime_t t;
+
+		if (vhr->vhr_state != VDEV_HEDGE_ISSUED)
+			continue;
+		ASSERT3P(vhr->vhr_vd->vdev_parent, ==, vd);
+		for (int b = 0; b < VDEV_HEDGE_BUCKETS; b++) {
+			uint64_t own = vhr->vhr_vd->vdev_hedge_histo[b];
+
+			others[b] = all[b] > own ? all[b] - own : 0;
+		}
+		t = vdev_hedge_percentile(others);
+		if (t != 0 && (threshold == 0 || t < threshold))
+			threshold = t;
+	}
+
+	return (threshold);
+}
+
+boolean_t
+vdev_hedge_enabled(zio_t *zio)
+{
+	return (zfs_vdev_hedge && zio->io_type == ZIO_TYPE_READ &&
+	    zio->io_priority == ZIO_PRIORITY_SYNC_READ && zio->io_vd != NULL &&
+	    !(zio->io_flags & (ZIO_FLAG_SCRUB | ZIO_FLAG_RESILVER |
+	    ZIO_FLAG_IO_REPAIR | ZIO_FLAG_CONFIG_WRITER | ZIO_FLAG_PROBE |
+	    ZIO_FLAG_NODATA)));
+}
+
+static void
+vdev_hedge_rele(vdev_hedge_t *vh)
+{
+	if (atomic_dec_32_nv(&vh->vh_refs) != 0)
+		return;
+
+	for (int i = 0; i < vh->vh_nreads; i++) {
+		vdev_hedge_read_t *vhr = &vh->vh_reads[i];
+
+		ASSERT3P(vhr->vhr_zio, ==, NULL);
+		if (vhr->vhr_abd != NULL)
+			abd_free(vhr->vhr_abd);
+	}
+	mutex_destroy(&vh->vh_lock);
+	kmem_free(vh, offsetof(vdev_hedge_t, vh_reads[vh->vh_nreads]));
+}
+
+static void
+vdev_hedge_root_done(zio_t *zio)
+{
+	vdev_hedge_t *vh = zio->io_private;
+
+	ASSERT3P(vh->vh_zio, ==, NULL);
+	if (vh->vh_held)
+		spa_config_exit(zio->io_spa, SCL_ZIO, vh);
+	vdev_hedge_rele(vh);
+}
+
+vdev_hedge_t *
+vdev_hedge_alloc(zio_t *zio, int nreads, const vdev_hedge_ops_t *ops)
+{
+	vdev_hedge_t *vh;
+
+	vh = kmem_zalloc(offsetof(vdev_hedge_t, vh_reads[nreads]), KM_SLEEP);
+	mutex_init(&vh->vh_lock, NULL, MUTEX_DEFAULT, NULL);
+	vh->vh_zio = zio;
+	vh->vh_vd = zio->io_vd;
+	vh->vh_ops = ops;
+	vh->vh_nreads = nreads;
+	vh->vh_refs = 2;	/* vh_root and vdev_hedge_start() */
+	for (int i = 0; i < nreads; i++)
+		vh->vh_reads[i].vhr_hedge = vh;
+
+	vh->vh_root = zio_root(zio->io_spa, vdev_hedge_root_done, vh,
+	    (zio->io_flags & ZIO_FLAG_VDEV_INHERIT) | ZIO_FLAG_CANFAIL);
+	vh->vh_root->io_bookmark = zio->io_bookmark;
+	vh->vh_root->io_txg = zio->io_txg;
+
+	/* As for zio_vdev_child_io(), the children verify the checksum */
+	if (ops->vho_verify && zio->io_bp != NULL)
+		zio->io_pipeline &= ~ZIO_STAGE_CHECKSUM_VERIFY;
+
+	return (vh);
+}
+
+static void
+vdev_hedge_read_done(zio_t *zio);
+
+/*
+ * Creates child read i into its own buffer.  It is issued once vh_lock
+ * has been dropped.  Must be called before vdev_hedge_start(), or from
+ * vho_update.
+ */
+void
+vdev_hedge_issue(vdev_hedge_t *vh, int i, vdev_t *vd, uint64_t offset,
+    uint64_t size)
+{
+	vdev_hedge_read_t *vhr = &vh->vh_reads[i];
+	zio_t *zio = vh->vh_zio;
+
+	ASSERT(!vh->vh_sealed);
+	ASSERT3U(vhr->vhr_state, ==, VDEV_HEDGE_IDLE);
+
+	vhr->vhr_vd = vd;
+	vhr->vhr_size = size;
+	vhr->vhr_abd = abd_alloc_sametype(zio->io_abd, size);
+	vhr->vhr_state = VDEV_HEDGE_ISSUED;
+	vhr->vhr_timestamp = gethrtime();
+	vhr->vhr_late = vh->vh_fired;
+	if (vh->vh_fired)
+		vh->vh_hedged = B_TRUE;
+
+	vhr->vhr_zio = zio_vdev_child_io(vh->vh_root,
+	    vh->vh_ops->vho_verify ? zio->io_bp : NULL, vd, offset,
+	    vhr->vhr_abd, size, ZIO_TYPE_READ, zio->io_priority, 0,
+	    vdev_hedge_read_done, vhr);
+}
+
+static void
+vdev_hedge_dispatch(vdev_hedge_t *vh)
+{
+	for (int i = 0; i < vh->vh_nreads; i++) {
+		vdev_hedge_read_t *vhr = &vh->vh_reads[i];
+		zio_t *cio = vhr->vhr_zio;
+
+		if (cio != NULL &&
+		    atomic_cas_ptr(&vhr->vhr_zio, cio, NULL) == cio)
+			zio_nowait(cio);
+	}
+}
+
+/*
+ * Returns B_TRUE if the paused read may resume: either none of its child
+ * reads are still in flight, or SCL_ZIO is held for them by vh_root.
+ */
+static boolean_t
+vdev_hedge_hold(vdev_hedge_t *vh)
+{
+	ASSERT(MUTEX_HELD(&vh->vh_lock));
+
+	if (vh->vh_held)
+		return (B_TRUE);
+
+	for (int i = 0; i < vh->vh_nreads; i++) {
+		if (vh->vh_reads[i].vhr_state == VDEV_HEDGE_ISSUED) {
+			vh->vh_held = spa_config_tryenter(vh->vh_vd->vdev_spa,
+			    SCL_ZIO, vh, RW_READER);
+			return (vh->vh_held);
+		}
+	}
+
+	return (B_TRUE);
+}
+
+/*
+ * Let the owner look at a completed read, or at the expired timer when
+ * vhr is NULL, and resume the read once it says so.  vh_root is issued
+ * once no more children will be added to it, either because the read
+ * resumed or because the timer, the only thing which hedges, has expired.
+ * The caller holds a reference on vh.
+ */
+static void
+vdev_hedge_process(vdev_hedge_t *vh, vdev_hedge_read_t *vhr)
+{
+	taskqid_t timer = TASKQID_INVALID;
+	zio_t *zio, *root = NULL;
+
+	mutex_enter(&vh->vh_lock);
+	if (vhr != NULL)
+		vhr->vhr_state = VDEV_HEDGE_DONE;
+	else
+		vh->vh_fired = B_TRUE;
+
+	zio = vh->vh_zio;
+	if (zio != NULL && !vh->vh_ready)
+		vh->vh_ready = vh->vh_ops->vho_update(vh, vhr);
+	if (zio != NULL && (!vh->vh_ready || !vdev_hedge_hold(vh)))
+		zio = NULL;
+	if (zio != NULL) {
+		vh->vh_zio = NULL;
+		if (!vh->vh_fired)
+			timer = vh->vh_timer;
+	}
+	if (vhr == NULL && vh->vh_hedged)
+		HEDGE_BUMP(vdev_hedge_stat_issued, vh->vh_ops->vho_type);
+
+	if (!vh->vh_sealed && (vh->vh_zio == NULL || vh->vh_fired)) {
+		vh->vh_sealed = B_TRUE;
+		root = vh->vh_root;
+	}
+	mutex_exit(&vh->vh_lock);
+
+	vdev_hedge_dispatch(vh);
+
+	/* The timer drops its own reference unless it is cancelled */
+	if (timer != TASKQID_INVALID &&
+	    taskq_cancel_id(system_delay_taskq, timer) == 0)
+		vdev_hedge_rele(vh);
+
+	if (zio != NULL)
+		zio_interrupt(zio);
+	if (root != NULL)
+		zio_nowait(root);
+}
+
+static void
+vdev_hedge_read_done(zio_t *zio)
+{
+	vdev_hedge_read_t *vhr = zio->io_private;
+	vdev_hedge_t *vh = vhr->vhr_hedge;
+	hrtime_t now = gethrtime();
+
+	vhr->vhr_error = zio->io_error;
+	if (zio->io_error == 0) {
+		vdev_hedge_sample(vhr->vhr_vd, now - vhr->vhr_timestamp);
+		if (vh->vh_ops->vho_done != NULL)
+			vh->vh_ops->vho_done(vhr, zio);
+	}
+
+	/* vh_root, and so vh, stays around until this returns */
+	vdev_hedge_process(vh, vhr);
+}
+
+static void
+vdev_hedge_fire(void *arg)
+{
+	vdev_hedge_t *vh = arg;
+
+	vdev_hedge_process(vh, NULL);
+	vdev_hedge_rele(vh);
+}
+
+/*
+ * Issue the reads created by vdev_hedge_issue() and arm the hedge timer.
+ * vh may be freed once this returns.
+ */
+void
+vdev_hedge_start(vdev_hedge_t *vh)
+{
+	hrtime_t threshold = vdev_hedge_threshold(vh);
+
+	if (threshold != 0) {
+		taskqid_t id;
+
+		atomic_inc_32(&vh->vh_refs);
+		id = taskq_dispatch_delay(system_delay_taskq, vdev_hedge_fire,
+		    vh, TQ_NOSLEEP, ddi_get_lbolt() +
+		    MAX(NSEC_TO_TICK(threshold), 1));
+		if (id == TASKQID_INVALID) {
+			vdev_hedge_rele(vh);
+		} else {
+			mutex_enter(&vh->vh_lock);
+			vh->vh_timer = id;
+			mutex_exit(&vh->vh_lock);
+		}
+	}
+
+	vdev_hedge_dispatch(vh);
+	vdev_hedge_rele(vh);
+}
+
+/*
+ * Called from vho_update when the read completes without the child read
+ * it was hedging.
+ */
+void
+vdev_hedge_won(vdev_hedge_t *vh)
+{
+	ASSERT(MUTEX_HELD(&vh->vh_lock));
+	HEDGE_BUMP(vdev_hedge_stat_won, vh->vh_ops->vho_type);
+}
+
+/* BEGIN CSTYLED */
+ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, hedge, INT, ZMOD_RW,
+	"Hedge slow mirror and raidz child reads");
+
+ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, hedge_percentile, INT, ZMOD_RW,
+	"Percentile of the child read latency after which reads are hedged");
+
+ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, hedge_min_us, INT, ZMOD_RW,
+	"Minimum time in microseconds before a read is hedged");
+/* END CSTYLED */
@@ -147,6 +147,7 @@
 #include <sys/metaslab.h>
 #include <sys/metaslab_impl.h>
 #include <sys/zio.h>
+#include <sys/zio_impl.h>
 #include <sys/dsl_scan.h>
 #include <sys/abd.h>
 #include <sys/fs/zfs.h>
@@ -213,6 +214,41 @@ vdev_label_write(zio_t *zio, vdev_t *vd, int l, abd_t *buf, uint64_t offset,
 	    ZIO_PRIORITY_SYNC_WRITE, flags, B_TRUE));
 }
 
+/*
+ * The pipeline stage latency histograms reported with the root vdev's
+ * extended stats, see spa_zio_stage_add().
+ */
+static const struct {
+	const char	*name;
+	zio_type_t	type;
+	enum zio_stage	stage;
+} vdev_stage_histos[] = {
+	{ ZPOOL_CONFIG_VDEV_STAGE_W_ISSUE_HISTO, ZIO_TYPE_WRITE,
+	    ZIO_STAGE_ISSUE_ASYNC },
+	{ ZPOOL_CONFIG_VDEV_STAGE_W_COMPRESS_HISTO, ZIO_TYPE_WRITE,
+	    ZIO_STAGE_WRITE_COMPRESS },
+	{ ZPOOL_CONFIG_VDEV_STAGE_W_ENCRYPT_HISTO, ZIO_TYPE_WRITE,
+	    ZIO_STAGE_ENCRYPT },
+	{ ZPOOL_CONFIG_VDEV_STAGE_W_CKSUM_HISTO, ZIO_TYPE_WRITE,
+	    ZIO_STAGE_CHECKSUM_GENERATE },
+	{ ZPOOL_CONFIG_VDEV_STAGE_W_ALLOC_HISTO, ZIO_TYPE_WRITE,
+	    ZIO_STAGE_DVA_ALLOCATE },
+	{ ZPOOL_CONFIG_VDEV_STAGE_W_READY_HISTO, ZIO_TYPE_WRITE,
+	    ZIO_STAGE_READY },
+	{ ZPOOL_CONFIG_VDEV_STAGE_W_IO_START_HISTO, ZIO_TYPE_WRITE,
+	    ZIO_STAGE_VDEV_IO_START },
+	{ ZPOOL_CONFIG_VDEV_STAGE_W_IO_DONE_HISTO, ZIO_TYPE_WRITE,
+	    ZIO_STAGE_VDEV_IO_DONE },
+	{ ZPOOL_CONFIG_VDEV_STAGE_R_IO_START_HISTO, ZIO_TYPE_READ,
+	    ZIO_STAGE_VDEV_IO_START },
+	{ ZPOOL_CONFIG_VDEV_STAGE_R_IO_DONE_HISTO, ZIO_TYPE_READ,
+	    ZIO_STAGE_VDEV_IO_DONE },
+	{ ZPOOL_CONFIG_VDEV_STAGE_R_ASSESS_HISTO, ZIO_TYPE_READ,
+	    ZIO_STAGE_VDEV_IO_ASSESS },
+	{ ZPOOL_CONFIG_VDEV_STAGE_R_CKSUM_HISTO, ZIO_TYPE_READ,
+	    ZIO_STAGE_CHECKSUM_VERIFY },
+};
+
 /*
  * Generate the nvlist representing this vdev's stats
  */
@@ -368,6 +404,19 @@ vdev_config_generate_stats(vdev_t *vd, nvlist_t *nv)
 	/* IO delays */
 	fnvlist_add_uint64(nvx, ZPOOL_CONFIG_VDEV_SLOW_IOS, vs->vs_slow_ios);
 
+	/* Pipeline stage latencies, for the whole pool */
+	if (vd == vd->vdev_spa->spa_root_vdev) {
+		uint64_t histo[VDEV_L_HISTO_BUCKETS];
+
+		for (int i = 0; i < ARRAY_SIZE(vdev_stage_histos); i++) {
+			spa_zio_stage_histo(vd->vdev_spa,
+			    vdev_stage_histos[i].type,
+			    highbit64(vdev_stage_histos[i].stage) - 1, histo);
+			fnvlist_add_uint64_array(nvx, vdev_stage_histos[i].name,
+			    histo, VDEV_L_HISTO_BUCKETS);
+		}
+	}
+
 	/* Add extended stats nvlist to main nvlist */
 	fnvlist_add_nvlist(nv, ZPOOL_CONFIG_VDEV_STATS_EX, nvx);
 
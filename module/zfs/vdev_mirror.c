@@ -34,6 +34,7 @@
 #include <sys/dsl_scan.h>
 #include <sys/vdev_impl.h>
 #include <sys/vdev_draid.h>
+#include <sys/vdev_hedge.h>
 #include <sys/zio.h>
 #include <sys/abd.h>
 #include <sys/fs/zfs.h>
@@ -52,6 +53,7 @@ typedef struct mirror_stats {
 
 	kstat_named_t vdev_mirror_stat_preferred_found;
 	kstat_named_t vdev_mirror_stat_preferred_not_found;
+	kstat_named_t vdev_mirror_stat_latency;
 } mirror_stats_t;
 
 static mirror_stats_t mirror_stats = {
@@ -69,7 +71,8 @@ static mirror_stats_t mirror_stats = {
 	{ "preferred_found",			KSTAT_DATA_UINT64 },
 	/* Preferred child vdev not found or equal load  */
 	{ "preferred_not_found",		KSTAT_DATA_UINT64 },
-
+	/* Load from the expected latency, see zfs_vdev_mirror_latency */
+	{ "latency",				KSTAT_DATA_UINT64 },
 };
 
 #define	MIRROR_STAT(stat)		(mirror_stats.stat.value.ui64)
@@ -109,6 +112,7 @@ typedef struct mirror_child {
 	uint8_t		mc_skipped;
 	uint8_t		mc_speculative;
 	uint8_t		mc_rebuilding;
+	hrtime_t	mc_timestamp;	/* read issued, when sampled */
 } mirror_child_t;
 
 typedef struct mirror_map {
@@ -142,6 +146,25 @@ static int zfs_vdev_mirror_rotating_seek_offset = 1 * 1024 * 1024;
 static int zfs_vdev_mirror_non_rotating_inc = 0;
 static int zfs_vdev_mirror_non_rotating_seek_inc = 1;
 
+/*
+ * When zfs_vdev_mirror_latency is set, the read latency of every mirror
+ * child, the time its reads spend on the device, is tracked as an
+ * exponentially weighted moving average, each read moving it
+ * 1/2^VDEV_MIRROR_LAT_SHIFT of the way to its own latency.  Reads then go
+ * to the child with the lowest expected service time, the average latency
+ * times the number of I/Os it has to wait for, rather than using the
+ * increments above.  This steers reads away from a slow or degraded side
+ * of a mirror, while queueing still spreads them over children of similar
+ * speed.  A child which gets no reads is not known to have become faster
+ * again, so its average is halved every zfs_vdev_mirror_latency_decay_ms
+ * until it is tried again.  Reads are not sampled while it is clear, so
+ * they don't pay for the timestamps and the shared counters.
+ */
+static int zfs_vdev_mirror_latency = 0;
+static int zfs_vdev_mirror_latency_decay_ms = 1000;
+
+#define	VDEV_MIRROR_LAT_SHIFT	3
+
 static inline size_t
 vdev_mirror_map_size(int children)
 {
@@ -199,6 +222,15 @@ vdev_mirror_load(mirror_map_t *mm, vdev_t *vd, uint64_t zio_offset)
 
 	/* Standard load based on pending queue length. */
 	load = vdev_queue_length(vd);
+
+	/* Expected service time in microseconds */
+	if (zfs_vdev_mirror_latency) {
+		uint64_t lat = vdev_mirror_latency(vd) * (load + 1);
+
+		MIRROR_BUMP(vdev_mirror_stat_latency);
+		return (MIN(NSEC2USEC(lat), INT_MAX - 1));
+	}
+
 	last_offset = vdev_queue_last_offset(vd);
 
 	if (vd->vdev_nonrot) {
@@ -240,6 +272,67 @@ vdev_mirror_load(mirror_map_t *mm, vdev_t *vd, uint64_t zio_offset)
 	return (load + zfs_vdev_mirror_rotating_seek_inc);
 }
 
+/*
+ * Returns the average read latency of a mirror child in nanoseconds, decayed
+ * if it has not been read from recently, or 0 if it is unknown.
+ */
+uint64_t
+vdev_mirror_latency(vdev_t *vd)
+{
+	uint64_t lat = vd->vdev_mirror_lat;
+	hrtime_t age = gethrtime() - vd->vdev_mirror_lat_ts;
+	hrtime_t decay = MSEC2NSEC(MAX(zfs_vdev_mirror_latency_decay_ms, 1));
+
+	if (age > decay)
+		lat >>= MIN(age / decay, 63);
+
+	return (lat);
+}
+
+/*
+ * Fold the latency of a read into the average of the child.  Concurrent
+ * updates may lose a sample, which does not matter for an estimate.
+ */
+static void
+vdev_mirror_latency_update(vdev_t *vd, int64_t lat)
+{
+	hrtime_t now = gethrtime();
+	int64_t avg = vd->vdev_mirror_lat;
+
+	if (avg == 0)
+		avg = lat;
+	else
+		avg += (lat - avg) / (1 << VDEV_MIRROR_LAT_SHIFT);
+
+	vd->vdev_mirror_lat = MAX(avg, 1);
+	vd->vdev_mirror_lat_ts = now;
+	atomic_inc_64(&vd->vdev_mirror_reads);
+}
+
+/*
+ * Sample a successful read by a child.  A leaf counts only the time the read
+ * spent on the device, since vdev_mirror_load() already multiplies by the
+ * number of I/Os active on it; reads served by the vdev cache or as part of
+ * an aggregate carry no time of their own and are skipped.  Interior
+ * children have no queue, their reads count from when they were issued.
+ */
+static void
+vdev_mirror_latency_sample(vdev_t *vd, zio_t *zio, hrtime_t issued)
+{
+	hrtime_t lat = 0;
+
+	if (zio->io_error != 0)
+		return;
+
+	if (vd->vdev_ops->vdev_op_leaf)
+		lat = zio->io_delay;
+	else if (issued != 0)
+		lat = gethrtime() - issued;
+
+	if (lat > 0)
+		vdev_mirror_latency_update(vd, lat);
+}
+
 static boolean_t
 vdev_mirror_rebuilding(vdev_t *vd)
 {
@@ -434,6 +527,9 @@ vdev_mirror_child_done(zio_t *zio)
 {
 	mirror_child_t *mc = zio->io_private;
 
+	if (mc->mc_timestamp != 0)
+		vdev_mirror_latency_sample(mc->mc_vd, zio, mc->mc_timestamp);
+
 	mc->mc_error = zio->io_error;
 	mc->mc_tried = 1;
 	mc->mc_skipped = 0;
@@ -618,6 +714,94 @@ vdev_mirror_child_select(zio_t *zio)
 	return (-1);
 }
 
+static boolean_t
+vdev_mirror_hedgeable(mirror_child_t *mc)
+{
+	return (mc->mc_vd->vdev_ops->vdev_op_leaf &&
+	    mc->mc_vd->vdev_ops != &vdev_draid_spare_ops);
+}
+
+/*
+ * Hedged mirror reads, see vdev_hedge.c.  The first child read to return
+ * good data completes the read, the others are left untried.
+ */
+static boolean_t
+vdev_mirror_hedge_update(vdev_hedge_t *vh, vdev_hedge_read_t *vhr)
+{
+	zio_t *zio = vh->vh_zio;
+	mirror_map_t *mm = zio->io_vsd;
+	mirror_child_t *mc;
+	int c, pending = 0;
+
+	if (vhr == NULL) {
+		/* Too slow, also read from the next best child */
+		c = vdev_mirror_child_select(zio);
+		if (c >= 0 && vdev_mirror_hedgeable(&mm->mm_child[c])) {
+			mc = &mm->mm_child[c];
+			mc->mc_tried = 1;
+			vdev_hedge_issue(vh, c, mc->mc_vd, mc->mc_offset,
+			    zio->io_size);
+		}
+		return (B_FALSE);
+	}
+
+	c = vhr - vh->vh_reads;
+	mc = &mm->mm_child[c];
+	mc->mc_error = vhr->vhr_error;
+
+	for (int i = 0; i < vh->vh_nreads; i++) {
+		if (vh->vh_reads[i].vhr_state == VDEV_HEDGE_ISSUED)
+			pending++;
+	}
+
+	if (vhr->vhr_error == 0) {
+		abd_copy(zio->io_abd, vhr->vhr_abd, zio->io_size);
+		for (int i = 0; i < vh->vh_nreads; i++) {
+			if (vh->vh_reads[i].vhr_state == VDEV_HEDGE_ISSUED)
+				mm->mm_child[i].mc_tried = 0;
+		}
+		if (vhr->vhr_late)
+			vdev_hedge_won(vh);
+		return (B_TRUE);
+	}
+
+	/* vdev_mirror_io_done() retries once every read has failed */
+	return (pending == 0);
+}
+
+static void
+vdev_mirror_hedge_done(vdev_hedge_read_t *vhr, zio_t *zio)
+{
+	if (zfs_vdev_mirror_latency)
+		vdev_mirror_latency_sample(vhr->vhr_vd, zio,
+		    vhr->vhr_timestamp);
+}
+
+static const vdev_hedge_ops_t vdev_mirror_hedge_ops = {
+	.vho_update = vdev_mirror_hedge_update,
+	.vho_done = vdev_mirror_hedge_done,
+	.vho_type = VDEV_HEDGE_MIRROR,
+	.vho_verify = B_TRUE,
+};
+
+static boolean_t
+vdev_mirror_hedge(zio_t *zio, mirror_map_t *mm, int c)
+{
+	mirror_child_t *mc = &mm->mm_child[c];
+	vdev_hedge_t *vh;
+
+	if (mm->mm_root || mm->mm_children < 2 ||
+	    !vdev_mirror_hedgeable(mc) || !vdev_hedge_enabled(zio))
+		return (B_FALSE);
+
+	vh = vdev_hedge_alloc(zio, mm->mm_children, &vdev_mirror_hedge_ops);
+	mc->mc_tried = 1;
+	vdev_hedge_issue(vh, c, mc->mc_vd, mc->mc_offset, zio->io_size);
+	vdev_hedge_start(vh);
+
+	return (B_TRUE);
+}
+
 static void
 vdev_mirror_io_start(zio_t *zio)
 {
@@ -673,6 +857,10 @@ vdev_mirror_io_start(zio_t *zio)
 		 */
 		c = vdev_mirror_child_select(zio);
 		children = (c >= 0);
+		if (children && vdev_mirror_hedge(zio, mm, c))
+			return;
+		if (children && !mm->mm_root && zfs_vdev_mirror_latency)
+			mm->mm_child[c].mc_timestamp = gethrtime();
 	} else {
 		ASSERT(zio->io_type == ZIO_TYPE_WRITE);
 
@@ -786,6 +974,8 @@ vdev_mirror_io_done(zio_t *zio)
 	if (good_copies == 0 && (c = vdev_mirror_child_select(zio)) != -1) {
 		ASSERT(c >= 0 && c < mm->mm_children);
 		mc = &mm->mm_child[c];
+		if (!mm->mm_root && zfs_vdev_mirror_latency)
+			mc->mc_timestamp = gethrtime();
 		zio_vdev_io_redone(zio);
 		zio_nowait(zio_vdev_child_io(zio, zio->io_bp,
 		    mc->mc_vd, mc->mc_offset, zio->io_abd, zio->io_size,
@@ -977,4 +1167,10 @@ ZFS_MODULE_PARAM(zfs_vdev_mirror, zfs_vdev_mirror_, non_rotating_inc, INT, ZMOD_
 
 ZFS_MODULE_PARAM(zfs_vdev_mirror, zfs_vdev_mirror_, non_rotating_seek_inc, INT, ZMOD_RW,
 	"Non-rotating media load increment for seeking I/O's");
+
+ZFS_MODULE_PARAM(zfs_vdev_mirror, zfs_vdev_mirror_, latency, INT, ZMOD_RW,
+	"Read from the mirror child with the lowest expected latency");
+
+ZFS_MODULE_PARAM(zfs_vdev_mirror, zfs_vdev_mirror_, latency_decay_ms, INT, ZMOD_RW,
+	"Halve the latency estimate of unused mirror children this often");
 /* END CSTYLED */
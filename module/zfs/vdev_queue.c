@@ -117,6 +117,21 @@
  * maximum percentage, this indicates that the rate of incoming data is
  * greater than the rate that the backend storage can handle. In this case, we
  * must further throttle incoming writes (see dmu_tx_delay() for details).
+ *
+ * Submission
+ *
+ * On a fast device vq_lock, which every queued and completed i/o takes, is
+ * the bottleneck.  So vdev_queue_io() pushes new i/os onto the lock-free
+ * vqc_submitted list of their class and only issues them itself when it
+ * gets vq_lock without waiting.  Otherwise the holder moves the whole batch
+ * into the sorted trees the next time it picks an i/o to issue, so the
+ * class scheduling above sees every queued i/o.  Holders which issue i/os
+ * set vq_issuing and check the lists once more after clearing it, see
+ * vdev_queue_exit(); a submitter which finds vq_lock held by anyone else
+ * waits for it instead.  The holder runs the zio pipeline of the i/os it
+ * issues for others in its own thread, up to vdev_queue_issue_max of them.
+ * With zfs_vdev_lockless_submit cleared i/os are added to the trees under
+ * vq_lock directly.
  */
 
 /*
@@ -237,6 +252,18 @@ int zfs_vdev_def_queue_depth = 32;
  */
 int zfs_vdev_aggregate_trim = 0;
 
+/*
+ * Leave i/os queued while vq_lock is held to its holder rather than waiting
+ * for it, see "Submission" above.
+ */
+int zfs_vdev_lockless_submit = B_TRUE;
+
+/*
+ * The most i/os vdev_queue_exit() issues before dropping vq_lock, see
+ * there.
+ */
+static int vdev_queue_issue_max = 32;
+
 static int
 vdev_queue_offset_compare(const void *x1, const void *x2)
 {
@@ -503,8 +530,10 @@ vdev_queue_fini(vdev_t *vd)
 {
 	vdev_queue_t *vq = &vd->vdev_queue;
 
-	for (zio_priority_t p = 0; p < ZIO_PRIORITY_NUM_QUEUEABLE; p++)
+	for (zio_priority_t p = 0; p < ZIO_PRIORITY_NUM_QUEUEABLE; p++) {
+		ASSERT3P(vq->vq_class[p].vqc_submitted, ==, NULL);
 		avl_destroy(vdev_queue_class_tree(vq, p));
+	}
 	avl_destroy(&vq->vq_active_tree);
 	avl_destroy(vdev_queue_type_tree(vq, ZIO_TYPE_READ));
 	avl_destroy(vdev_queue_type_tree(vq, ZIO_TYPE_WRITE));
@@ -547,6 +576,58 @@ vdev_queue_io_remove(vdev_queue_t *vq, zio_t *zio)
 	}
 }
 
+static void
+vdev_queue_submit(vdev_queue_t *vq, zio_t *zio)
+{
+	vdev_queue_class_t *vqc = &vq->vq_class[zio->io_priority];
+	zio_t *head;
+
+	ASSERT3U(zio->io_priority, <, ZIO_PRIORITY_NUM_QUEUEABLE);
+	do {
+		head = vqc->vqc_submitted;
+		zio->io_queue_next = head;
+	} while (atomic_cas_ptr(&vqc->vqc_submitted, head, zio) != head);
+}
+
+static boolean_t
+vdev_queue_submitted(vdev_queue_t *vq)
+{
+	for (zio_priority_t p = 0; p < ZIO_PRIORITY_NUM_QUEUEABLE; p++) {
+		if (vq->vq_class[p].vqc_submitted != NULL)
+			return (B_TRUE);
+	}
+	return (B_FALSE);
+}
+
+/*
+ * Move the submitted i/os into the queues.  Their order does not matter,
+ * the FIFO queues are sorted by the timestamp taken at submission.  An i/o
+ * whose priority changed since is added with its new priority.
+ */
+static void
+vdev_queue_drain(vdev_queue_t *vq)
+{
+	ASSERT(MUTEX_HELD(&vq->vq_lock));
+
+	for (zio_priority_t p = 0; p < ZIO_PRIORITY_NUM_QUEUEABLE; p++) {
+		vdev_queue_class_t *vqc = &vq->vq_class[p];
+		zio_t *zio;
+
+		do {
+			zio = vqc->vqc_submitted;
+		} while (zio != NULL &&
+		    atomic_cas_ptr(&vqc->vqc_submitted, zio, NULL) != zio);
+
+		while (zio != NULL) {
+			zio_t *next = zio->io_queue_next;
+
+			zio->io_queue_next = NULL;
+			vdev_queue_io_add(vq, zio);
+			zio = next;
+		}
+	}
+}
+
 static boolean_t
 vdev_queue_is_interactive(zio_priority_t p)
 {
@@ -871,6 +952,7 @@ vdev_queue_io_to_issue(vdev_queue_t *vq)
 again:
 	ASSERT(MUTEX_HELD(&vq->vq_lock));
 
+	vdev_queue_drain(vq);
 	p = vdev_queue_class_to_issue(vq);
 
 	if (p == ZIO_PRIORITY_NUM_QUEUEABLE) {
@@ -919,6 +1001,58 @@ again:
 	return (zio);
 }
 
+static void
+vdev_queue_issue(zio_t *nio)
+{
+	if (nio->io_done == vdev_queue_agg_io_done) {
+		zio_nowait(nio);
+	} else {
+		zio_vdev_io_reissue(nio);
+		zio_execute(nio);
+	}
+}
+
+/*
+ * Issue what we can, including whatever was submitted while we held
+ * vq_lock, and drop it.  Clearing vq_issuing before looking at the
+ * submission lists for the last time means that a submitter which failed
+ * to get vq_lock either sees vq_issuing set, in which case its i/o is
+ * found here, or waits for vq_lock and issues it itself.
+ *
+ * The i/os are issued from this thread, so zio_execute() runs their
+ * pipelines on behalf of whoever submitted them.  To bound the time a
+ * thread spends on other threads' i/os at most vdev_queue_issue_max are
+ * issued per call.  Whatever is left stays queued and is issued by the
+ * next holder; one always comes, as every i/o issued here takes vq_lock
+ * again when it completes.
+ */
+static void
+vdev_queue_exit(vdev_queue_t *vq)
+{
+	zio_t *nio;
+	int issued = 0;
+
+	ASSERT(MUTEX_HELD(&vq->vq_lock));
+
+	for (;;) {
+		vq->vq_issuing = B_TRUE;
+		while (issued < vdev_queue_issue_max &&
+		    (nio = vdev_queue_io_to_issue(vq)) != NULL) {
+			mutex_exit(&vq->vq_lock);
+			vdev_queue_issue(nio);
+			issued++;
+			mutex_enter(&vq->vq_lock);
+			vq->vq_issuing = B_TRUE;
+		}
+		(void) atomic_cas_32(&vq->vq_issuing, B_TRUE, B_FALSE);
+		if (issued >= vdev_queue_issue_max ||
+		    !vdev_queue_submitted(vq))
+			break;
+	}
+
+	mutex_exit(&vq->vq_lock);
+}
+
 zio_t *
 vdev_queue_io(zio_t *zio)
 {
@@ -960,19 +1094,41 @@ vdev_queue_io(zio_t *zio)
 
 	zio->io_flags |= ZIO_FLAG_DONT_CACHE | ZIO_FLAG_DONT_QUEUE;
 
-	mutex_enter(&vq->vq_lock);
-	zio->io_timestamp = gethrtime();
-	vdev_queue_io_add(vq, zio);
-	nio = vdev_queue_io_to_issue(vq);
-	mutex_exit(&vq->vq_lock);
+	if (!zfs_vdev_lockless_submit) {
+		mutex_enter(&vq->vq_lock);
+		zio->io_timestamp = gethrtime();
+		vdev_queue_io_add(vq, zio);
+		nio = vdev_queue_io_to_issue(vq);
+		mutex_exit(&vq->vq_lock);
 
-	if (nio == NULL)
-		return (NULL);
+		if (nio == NULL)
+			return (NULL);
 
-	if (nio->io_done == vdev_queue_agg_io_done) {
+		if (nio->io_done == vdev_queue_agg_io_done) {
+			zio_nowait(nio);
+			return (NULL);
+		}
+
+		return (nio);
+	}
+
+	zio->io_timestamp = gethrtime();
+	vdev_queue_submit(vq, zio);
+	if (!mutex_tryenter(&vq->vq_lock)) {
+		/* The atomic orders this after the push, as in exit */
+		if (atomic_cas_32(&vq->vq_issuing, B_TRUE, B_TRUE))
+			return (NULL);
+		mutex_enter(&vq->vq_lock);
+	}
+
+	nio = vdev_queue_io_to_issue(vq);
+	if (nio != NULL && nio->io_done == vdev_queue_agg_io_done) {
+		mutex_exit(&vq->vq_lock);
 		zio_nowait(nio);
-		return (NULL);
+		mutex_enter(&vq->vq_lock);
+		nio = NULL;
 	}
+	vdev_queue_exit(vq);
 
 	return (nio);
 }
@@ -981,7 +1137,6 @@ void
 vdev_queue_io_done(zio_t *zio)
 {
 	vdev_queue_t *vq = &zio->io_vd->vdev_queue;
-	zio_t *nio;
 
 	mutex_enter(&vq->vq_lock);
 
@@ -991,18 +1146,7 @@ vdev_queue_io_done(zio_t *zio)
 	vq->vq_io_complete_ts = gethrtime();
 	vq->vq_io_delta_ts = vq->vq_io_complete_ts - zio->io_timestamp;
 
-	while ((nio = vdev_queue_io_to_issue(vq)) != NULL) {
-		mutex_exit(&vq->vq_lock);
-		if (nio->io_done == vdev_queue_agg_io_done) {
-			zio_nowait(nio);
-		} else {
-			zio_vdev_io_reissue(nio);
-			zio_execute(nio);
-		}
-		mutex_enter(&vq->vq_lock);
-	}
-
-	mutex_exit(&vq->vq_lock);
+	vdev_queue_exit(vq);
 }
 
 void
@@ -1161,4 +1305,7 @@ ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, nia_delay, INT, ZMOD_RW,
 
 ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, queue_depth_pct, INT, ZMOD_RW,
 	"Queue depth percentage for each top-level vdev");
+
+ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, lockless_submit, INT, ZMOD_RW,
+	"Queue I/Os without waiting for the vdev queue lock");
 /* END CSTYLED */
@@ -36,6 +36,7 @@
 #include <sys/vdev_raidz.h>
 #include <sys/vdev_raidz_impl.h>
 #include <sys/vdev_draid.h>
+#include <sys/vdev_hedge.h>
 
 #ifdef ZFS_DEBUG
 #include <sys/vdev.h>	/* For vdev_xlate() in vdev_raidz_io_verify() */
@@ -1562,10 +1563,121 @@ vdev_raidz_io_start_write(zio_t *zio, raidz_row_t *rr, uint64_t ashift)
 	}
 }
 
-static void
+/*
+ * Hedged raidz reads, see vdev_hedge.c.  The vh_reads are the columns of
+ * the only row.  When the data columns are slow all of the parity is read
+ * too, and the read completes as soon as the missing data columns can be
+ * reconstructed, with the columns still in flight treated as skipped.
+ */
+static boolean_t
+vdev_raidz_hedge_update(vdev_hedge_t *vh, vdev_hedge_read_t *vhr)
+{
+	zio_t *zio = vh->vh_zio;
+	raidz_map_t *rm = zio->io_vsd;
+	raidz_row_t *rr = rm->rm_row[0];
+	vdev_t *vd = zio->io_vd;
+	int dpending = 0, dbad = 0, ppending = 0, pgood = 0, punread = 0;
+	boolean_t won = B_FALSE;
+	int c;
+
+	for (c = 0; c < rr->rr_cols; c++) {
+		raidz_col_t *rc = &rr->rr_col[c];
+		vdev_hedge_read_t *r = &vh->vh_reads[c];
+		boolean_t parity = (c < rr->rr_firstdatacol);
+
+		if (rc->rc_size == 0)
+			continue;
+
+		switch (r->vhr_state) {
+		case VDEV_HEDGE_IDLE:
+			if (!parity)
+				dbad++;
+			else if (!rc->rc_skipped)
+				punread++;
+			break;
+		case VDEV_HEDGE_ISSUED:
+			if (parity)
+				ppending++;
+			else
+				dpending++;
+			break;
+		case VDEV_HEDGE_DONE:
+			if (r->vhr_error != 0 && !parity)
+				dbad++;
+			else if (r->vhr_error == 0 && parity)
+				pgood++;
+			break;
+		}
+	}
+
+	if (vhr == NULL) {
+		/*
+		 * Read all of the parity, vdev_raidz_io_done() expects
+		 * either all or none of it to have been tried.
+		 */
+		if (dpending == 0 || punread == 0 ||
+		    dpending + dbad > punread + pgood + ppending)
+			return (B_FALSE);
+
+		for (c = 0; c < rr->rr_firstdatacol; c++) {
+			raidz_col_t *rc = &rr->rr_col[c];
+
+			if (vh->vh_reads[c].vhr_state == VDEV_HEDGE_IDLE &&
+			    !rc->rc_skipped) {
+				vdev_hedge_issue(vh, c,
+				    vd->vdev_child[rc->rc_devidx],
+				    rc->rc_offset, rc->rc_size);
+			}
+		}
+		return (B_FALSE);
+	}
+
+	if (!(dpending == 0 && (dbad == 0 || ppending == 0)) &&
+	    dpending + dbad > pgood)
+		return (B_FALSE);
+
+	for (c = 0; c < rr->rr_cols; c++) {
+		raidz_col_t *rc = &rr->rr_col[c];
+		vdev_hedge_read_t *r = &vh->vh_reads[c];
+
+		if (r->vhr_state == VDEV_HEDGE_DONE) {
+			if (r->vhr_error == 0)
+				abd_copy(rc->rc_abd, r->vhr_abd, rc->rc_size);
+			rc->rc_error = r->vhr_error;
+			rc->rc_tried = 1;
+			rc->rc_skipped = 0;
+		} else if (r->vhr_state == VDEV_HEDGE_ISSUED) {
+			/* Left behind, don't bother the slow child with it */
+			rc->rc_error = SET_ERROR(ESTALE);
+			rc->rc_skipped = 1;
+			rc->rc_allow_repair = 0;
+			if (c >= rr->rr_firstdatacol)
+				won = B_TRUE;
+		}
+	}
+	if (won)
+		vdev_hedge_won(vh);
+
+	return (B_TRUE);
+}
+
+static const vdev_hedge_ops_t vdev_raidz_hedge_ops = {
+	.vho_update = vdev_raidz_hedge_update,
+	.vho_done = NULL,
+	.vho_type = VDEV_HEDGE_RAIDZ,
+	.vho_verify = B_FALSE,
+};
+
+/*
+ * Returns B_TRUE if the reads were hedged, in which case the zio resumes
+ * once enough of them have completed.
+ */
+static boolean_t
 vdev_raidz_io_start_read(zio_t *zio, raidz_row_t *rr)
 {
 	vdev_t *vd = zio->io_vd;
+	raidz_map_t *rm = zio->io_vsd;
+	vdev_hedge_t *vh = NULL;
 
 	/*
 	 * Iterate over the columns in reverse order so that we hit the parity
@@ -1595,14 +1707,40 @@ vdev_raidz_io_start_read(zio_t *zio, raidz_row_t *rr)
 			rc->rc_skipped = 1;
 			continue;
 		}
+	}
+
+	/*
+	 * With data missing the parity is read anyway, there is nothing
+	 * left to hedge with.
+	 */
+	if (rm->rm_nrows == 1 && rr->rr_missingdata == 0 &&
+	    vd->vdev_ops == &vdev_raidz_ops && vdev_hedge_enabled(zio))
+		vh = vdev_hedge_alloc(zio, rr->rr_cols, &vdev_raidz_hedge_ops);
+
+	for (int c = rr->rr_cols - 1; c >= 0; c--) {
+		raidz_col_t *rc = &rr->rr_col[c];
+		if (rc->rc_size == 0 || rc->rc_skipped)
+			continue;
+		vdev_t *cvd = vd->vdev_child[rc->rc_devidx];
 		if (c >= rr->rr_firstdatacol || rr->rr_missingdata > 0 ||
 		    (zio->io_flags & (ZIO_FLAG_SCRUB | ZIO_FLAG_RESILVER))) {
+			if (vh != NULL) {
+				vdev_hedge_issue(vh, c, cvd, rc->rc_offset,
+				    rc->rc_size);
+				continue;
+			}
 			zio_nowait(zio_vdev_child_io(zio, NULL, cvd,
 			    rc->rc_offset, rc->rc_abd, rc->rc_size,
 			    zio->io_type, zio->io_priority, 0,
 			    vdev_raidz_child_done, rc));
 		}
 	}
+
+	if (vh == NULL)
+		return (B_FALSE);
+
+	vdev_hedge_start(vh);
+	return (B_TRUE);
 }
 
 /*
@@ -1645,7 +1783,8 @@ vdev_raidz_io_start(zio_t *zio)
 		vdev_raidz_io_start_write(zio, rr, tvd->vdev_ashift);
 	} else {
 		ASSERT(zio->io_type == ZIO_TYPE_READ);
-		vdev_raidz_io_start_read(zio, rr);
+		if (vdev_raidz_io_start_read(zio, rr))
+			return;
 	}
 
 	zio_execute(zio);
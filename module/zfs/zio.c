@@ -68,6 +68,21 @@ const char *zio_type_name[ZIO_TYPES] = {
 int zio_dva_throttle_enabled = B_TRUE;
 int zio_deadman_log_all = B_FALSE;
 
+/*
+ * Writes whose compression and checksum stages are estimated to cost less
+ * than this many bytes of fletcher_4 work skip the hand-off to an issue
+ * taskq and run those stages on the calling thread, see zio_issue_cost().
+ * Zero always hands off.
+ */
+unsigned int zio_inline_threshold = 32768;
+
+/*
+ * Count how often each pipeline stage runs inline and how often it is
+ * dispatched, see the zio_stage_stats kstat.  Off by default since every
+ * stage then updates a shared counter.
+ */
+int zio_stage_stats_enabled = B_FALSE;
+
 /*
  * ==========================================================================
  * I/O kmem caches
@@ -141,6 +156,105 @@ static inline void __zio_execute(zio_t *zio);
 
 static void zio_taskq_dispatch(zio_t *, zio_taskq_type_t, boolean_t);
 
+/*
+ * Per-stage counts of pipeline stages run on the thread which ran the
+ * previous stage (inline) and of hand-offs to a taskq ahead of a stage
+ * (dispatch), kept per CPU and summed by the zio_stage_stats kstat.
+ */
+const char *zio_stage_names[ZIO_STAGES] = {
+	"open", "read_bp_init", "write_bp_init", "free_bp_init",
+	"issue_async", "write_compress", "encrypt", "checksum_generate",
+	"nop_write", "ddt_read_start", "ddt_read_done", "ddt_write",
+	"ddt_free", "gang_assemble", "gang_issue", "dva_throttle",
+	"dva_allocate", "dva_free", "dva_claim", "ready", "vdev_io_start",
+	"vdev_io_done", "vdev_io_assess", "checksum_verify", "done"
+};
+
+typedef struct zio_stage_counts {
+	uint64_t	zsc_inline[ZIO_STAGES];
+	uint64_t	zsc_dispatch[ZIO_STAGES];
+} ____cacheline_aligned zio_stage_counts_t;
+
+static zio_stage_counts_t *zio_stage_counts;
+static uint_t zio_nstage_counts;
+static kstat_t *zio_stage_ksp;
+
+#define	ZIO_STAGE_BUMP(which, stage)					\
+	do {								\
+		if (zio_stage_stats_enabled) {				\
+			atomic_inc_64(&zio_stage_counts[		\
+			    CPU_SEQID_UNSTABLE % zio_nstage_counts].	\
+			    zsc_ ## which[highbit64(stage) - 1]);	\
+		}							\
+	} while (0)
+
+static int
+zio_stage_kstat_headers(char *buf, size_t size)
+{
+	(void) snprintf(buf, size, "%-20s %-16s %-16s\n", "stage", "inline",
+	    "dispatch");
+	return (0);
+}
+
+static int
+zio_stage_kstat_data(char *buf, size_t size, void *data)
+{
+	int s = (const char **)data - zio_stage_names;
+	uint64_t ninline = 0, ndispatch = 0;
+
+	for (uint_t c = 0; c < zio_nstage_counts; c++) {
+		ninline += zio_stage_counts[c].zsc_inline[s];
+		ndispatch += zio_stage_counts[c].zsc_dispatch[s];
+	}
+	(void) snprintf(buf, size, "%-20s %-16llu %-16llu\n",
+	    zio_stage_names[s], (u_longlong_t)ninline,
+	    (u_longlong_t)ndispatch);
+	return (0);
+}
+
+static void *
+zio_stage_kstat_addr(kstat_t *ksp, loff_t n)
+{
+	if (n < ZIO_STAGES)
+		ksp->ks_private = (void *)&zio_stage_names[n];
+	else
+		ksp->ks_private = NULL;
+
+	return (ksp->ks_private);
+}
+
+static void
+zio_stage_stats_init(void)
+{
+	ASSERT3U(highbit64(ZIO_STAGE_DONE), ==, ZIO_STAGES);
+	zio_nstage_counts = boot_ncpus;
+	zio_stage_counts = kmem_zalloc(zio_nstage_counts *
+	    sizeof (zio_stage_counts_t), KM_SLEEP);
+
+	zio_stage_ksp = kstat_create("zfs", 0, "zio_stage_stats", "misc",
+	    KSTAT_TYPE_RAW, 0, KSTAT_FLAG_VIRTUAL);
+	if (zio_stage_ksp != NULL) {
+		zio_stage_ksp->ks_data = NULL;
+		zio_stage_ksp->ks_ndata = UINT32_MAX;
+		kstat_set_raw_ops(zio_stage_ksp, zio_stage_kstat_headers,
+		    zio_stage_kstat_data, zio_stage_kstat_addr);
+		kstat_install(zio_stage_ksp);
+	}
+}
+
+static void
+zio_stage_stats_fini(void)
+{
+	if (zio_stage_ksp != NULL) {
+		kstat_delete(zio_stage_ksp);
+		zio_stage_ksp = NULL;
+	}
+	kmem_free(zio_stage_counts, zio_nstage_counts *
+	    sizeof (zio_stage_counts_t));
+	zio_stage_counts = NULL;
+	zio_nstage_counts = 0;
+}
+
 void
 zio_init(void)
 {
@@ -150,6 +264,7 @@ zio_init(void)
 	    sizeof (zio_t), 0, NULL, NULL, NULL, NULL, NULL, 0);
 	zio_link_cache = kmem_cache_create("zio_link_cache",
 	    sizeof (zio_link_t), 0, NULL, NULL, NULL, NULL, NULL, 0);
+	zio_stage_stats_init();
 
 	/*
 	 * For small buffers, we want a cache for each multiple of
@@ -243,6 +358,7 @@ zio_init(void)
 	zio_inject_init();
 
 	lz4_init();
+	zio_compress_init();
 }
 
 void
@@ -294,11 +410,13 @@ zio_fini(void)
 		VERIFY3P(zio_data_buf_cache[i], ==, NULL);
 	}
 
+	zio_stage_stats_fini();
 	kmem_cache_destroy(zio_link_cache);
 	kmem_cache_destroy(zio_cache);
 
 	zio_inject_fini();
 
+	zio_compress_fini();
 	lz4_fini();
 }
 
@@ -1709,7 +1827,7 @@ zio_write_compress(zio_t *zio)
 	    !(zio->io_flags & ZIO_FLAG_RAW_COMPRESS)) {
 		void *cbuf = zio_buf_alloc(lsize);
 		psize = zio_compress_data(compress, zio->io_abd, cbuf, lsize,
-		    zp->zp_complevel);
+		    zp->zp_complevel, B_TRUE);
 		if (psize == 0 || psize >= lsize) {
 			compress = ZIO_COMPRESS_OFF;
 			zio_buf_free(cbuf, lsize);
@@ -1772,7 +1890,7 @@ zio_write_compress(zio_t *zio)
 		 * to a hole.
 		 */
 		psize = zio_compress_data(ZIO_COMPRESS_EMPTY,
-		    zio->io_abd, NULL, lsize, zp->zp_complevel);
+		    zio->io_abd, NULL, lsize, zp->zp_complevel, B_FALSE);
 		if (psize == 0 || psize >= lsize)
 			compress = ZIO_COMPRESS_OFF;
 	} else {
@@ -2078,6 +2196,97 @@ zio_deadman(zio_t *pio, char *tag)
 	}
 }
 
+/*
+ * Rough cost of the work a stage does, relative to fletcher_4 on the same
+ * number of bytes, used by zio_issue_cost().
+ */
+#define	ZIO_COST_FLETCHER	1	/* fletcher_2, fletcher_4, zilog */
+#define	ZIO_COST_CRYPTO_CKSUM	16	/* secure ones, e.g. sha256 */
+#define	ZIO_COST_FAST_COMPRESS	4	/* lz4, zle */
+
+/*
+ * Estimate the cost of the stages that ZIO_STAGE_ISSUE_ASYNC would move to
+ * an issue taskq, up to the next blocking stage, in bytes of fletcher_4
+ * work.  Only plain writes are considered: dedup, encryption and slow
+ * compressors are never cheap, and frees and trims take the hand-off for
+ * other reasons.  A write which the compression stage turns into an
+ * embedded block costs no more than its compression.
+ */
+static uint64_t
+zio_issue_cost(zio_t *zio)
+{
+	const zio_prop_t *zp = &zio->io_prop;
+	enum zio_stage pipeline = zio->io_pipeline;
+	uint64_t size = zio->io_size;
+	uint64_t cost = 0;
+
+	if (zio->io_type != ZIO_TYPE_WRITE || zp->zp_dedup ||
+	    zp->zp_encrypt || (pipeline & ZIO_STAGE_DDT_WRITE))
+		return (UINT64_MAX);
+
+	if ((pipeline & ZIO_STAGE_WRITE_COMPRESS) &&
+	    !(zio->io_flags & ZIO_FLAG_RAW_COMPRESS)) {
+		switch (zp->zp_compress) {
+		case ZIO_COMPRESS_OFF:
+		case ZIO_COMPRESS_EMPTY:
+			break;
+		case ZIO_COMPRESS_LZ4:
+		case ZIO_COMPRESS_ZLE:
+			cost += size * ZIO_COST_FAST_COMPRESS;
+			break;
+		default:
+			return (UINT64_MAX);
+		}
+	}
+
+	if (pipeline & ZIO_STAGE_CHECKSUM_GENERATE) {
+		switch (zp->zp_checksum) {
+		case ZIO_CHECKSUM_OFF:
+			break;
+		case ZIO_CHECKSUM_FLETCHER_2:
+		case ZIO_CHECKSUM_FLETCHER_4:
+		case ZIO_CHECKSUM_ZILOG:
+		case ZIO_CHECKSUM_ZILOG2:
+			cost += size * ZIO_COST_FLETCHER;
+			break;
+		default:
+			cost += size * ZIO_COST_CRYPTO_CKSUM;
+			break;
+		}
+	}
+
+	return (cost);
+}
+
+/*
+ * Decide whether ZIO_STAGE_ISSUE_ASYNC can be skipped.  A write which
+ * allocates then also runs the allocation and its ready callback on the
+ * calling thread.  That is fine for callers such as dmu_sync(), which may
+ * block there just as zil_lwb_write_issue() does in zio_alloc_zil().  It
+ * is not for the sync thread, whose writes are spread over the issue
+ * taskq, nor for writes subject to the allocation throttle, which may
+ * hand this thread a different zio to allocate.
+ */
+static boolean_t
+zio_issue_inline(zio_t *zio)
+{
+	if (zio_issue_cost(zio) >= zio_inline_threshold)
+		return (B_FALSE);
+
+	if (zio->io_pipeline & ZIO_STAGE_DVA_ALLOCATE) {
+		spa_t *spa = zio->io_spa;
+		dsl_pool_t *dp = spa_get_dsl(spa);
+
+		if (dp != NULL && curthread == dp->dp_tx.tx_sync_thread)
+			return (B_FALSE);
+		if (zio->io_priority != ZIO_PRIORITY_SYNC_WRITE &&
+		    spa_normal_class(spa)->mc_alloc_throttle_enabled)
+			return (B_FALSE);
+	}
+
+	return (B_TRUE);
+}
+
 /*
  * Execute the I/O pipeline until one of the following occurs:
  * (1) the I/O completes; (2) the pipeline stalls waiting for
@@ -2136,6 +2345,30 @@ zio_execute_stack_check(zio_t *zio)
 	return (B_FALSE);
 }
 
+/*
+ * Account the time since the previous stage started to that stage, see
+ * spa_zio_stage_add().  A stage which is resumed after waiting for its
+ * children keeps its original start time, so that the wait is counted
+ * once, as part of the stage.
+ */
+static void
+zio_stage_time(zio_t *zio, enum zio_stage stage)
+{
+	hrtime_t now;
+
+	if (stage == zio->io_stage_timed)
+		return;
+
+	now = gethrtime();
+	if (zio->io_stage_timed != 0 && zio->io_spa != NULL) {
+		spa_zio_stage_add(zio->io_spa, zio->io_type, zio->io_priority,
+		    highbit64(zio->io_stage_timed) - 1,
+		    now - zio->io_stage_start);
+	}
+	zio->io_stage_timed = stage;
+	zio->io_stage_start = now;
+}
+
 __attribute__((always_inline))
 static inline void
 __zio_execute(zio_t *zio)
@@ -2171,6 +2404,7 @@ __zio_execute(zio_t *zio)
 		    zio_taskq_member(zio, ZIO_TASKQ_INTERRUPT)) {
 			boolean_t cut = (stage == ZIO_STAGE_VDEV_IO_START) ?
 			    zio_requeue_io_start_cut_in_line : B_FALSE;
+			ZIO_STAGE_BUMP(dispatch, stage);
 			zio_taskq_dispatch(zio, ZIO_TASKQ_ISSUE, cut);
 			return;
 		}
@@ -2182,13 +2416,33 @@ __zio_execute(zio_t *zio)
 		if (zio_execute_stack_check(zio)) {
 			boolean_t cut = (stage == ZIO_STAGE_VDEV_IO_START) ?
 			    zio_requeue_io_start_cut_in_line : B_FALSE;
+			ZIO_STAGE_BUMP(dispatch, stage);
 			zio_taskq_dispatch(zio, ZIO_TASKQ_ISSUE, cut);
 			return;
 		}
 
+		if (zfs_zio_stage_histograms)
+			zio_stage_time(zio, stage);
+
 		zio->io_stage = stage;
 		zio->io_pipeline_trace |= zio->io_stage;
 
+		/*
+		 * ZIO_STAGE_ISSUE_ASYNC hands the zio off to an issue taskq
+		 * so that compression and checksumming run in parallel.
+		 * When that work is cheap, the hand-off costs more than it
+		 * saves, so skip the stage and carry on here.
+		 */
+		if (stage == ZIO_STAGE_ISSUE_ASYNC) {
+			if (zio_issue_inline(zio)) {
+				ZIO_STAGE_BUMP(inline, stage);
+				continue;
+			}
+			ZIO_STAGE_BUMP(dispatch, stage);
+		} else {
+			ZIO_STAGE_BUMP(inline, stage);
+		}
+
 		/*
 		 * The zio pipeline stage returns the next zio to execute
 		 * (typically the same as this one), or NULL if we should
@@ -2306,6 +2560,7 @@ zio_reexecute(zio_t *pio)
 	pio->io_reexecute = 0;
 	pio->io_flags |= ZIO_FLAG_REEXECUTED;
 	pio->io_pipeline_trace = 0;
+	pio->io_stage_timed = 0;
 	pio->io_error = 0;
 	for (int w = 0; w < ZIO_WAIT_TYPES; w++)
 		pio->io_state[w] = 0;
@@ -5035,4 +5290,10 @@ ZFS_MODULE_PARAM(zfs_zio, zio_, dva_throttle_enabled, INT, ZMOD_RW,
 
 ZFS_MODULE_PARAM(zfs_zio, zio_, deadman_log_all, INT, ZMOD_RW,
 	"Log all slow ZIOs, not just those with vdevs");
+
+ZFS_MODULE_PARAM(zfs_zio, zio_, stage_stats_enabled, INT, ZMOD_RW,
+	"Count inline and dispatched zio pipeline stages");
+
+ZFS_MODULE_PARAM(zfs_zio, zio_, inline_threshold, UINT, ZMOD_RW,
+	"Max estimated cost of write stages run without a taskq hand-off");
 /* END CSTYLED */
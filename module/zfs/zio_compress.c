@@ -46,6 +46,20 @@
  */
 unsigned long zio_decompress_fail_fraction = 0;
 
+/*
+ * Before running one of the slow compressors (gzip, or zstd at level 10 and
+ * above) on a block of at least zio_compress_earlyabort_size bytes, check
+ * whether the block looks compressible at all.  A block which neither LZ4
+ * nor zstd-1 can shrink by the required 12.5% is almost never shrunk that
+ * much by the slow compressor either, so it is written uncompressed
+ * without trying.  Both passes are much cheaper than the compressor they
+ * stand in for, and LZ4 alone already accepts most compressible blocks.
+ * At the default zstd level and below 10 the passes cost compressible
+ * blocks more than they save on incompressible ones.
+ */
+int zio_compress_earlyabort = 1;
+unsigned int zio_compress_earlyabort_size = 128 * 1024;
+
 /*
  * Compression vectors.
  */
@@ -110,6 +124,106 @@ zio_compress_select(spa_t *spa, enum zio_compress child,
 	return (result);
 }
 
+/*
+ * Bytes handed to each compressor (attempted) and bytes stored
+ * uncompressed without running it because the early abort check found
+ * them incompressible (skipped), kept per CPU and summed by the
+ * zio_compress_stats kstat.
+ */
+typedef struct zio_compress_counts {
+	uint64_t	zcc_attempted[ZIO_COMPRESS_FUNCTIONS];
+	uint64_t	zcc_skipped[ZIO_COMPRESS_FUNCTIONS];
+} ____cacheline_aligned zio_compress_counts_t;
+
+static zio_compress_counts_t *zio_compress_counts;
+static uint_t zio_ncompress_counts;
+static kstat_t *zio_compress_ksp;
+
+/* Compression functions with a compressor, the rows of the kstat */
+static enum zio_compress zio_compress_kstat_rows[ZIO_COMPRESS_FUNCTIONS];
+static uint_t zio_compress_kstat_nrows;
+
+#define	ZIO_COMPRESS_STAT_ADD(which, c, bytes)				\
+	do {								\
+		if (zio_compress_counts != NULL) {			\
+			atomic_add_64(&zio_compress_counts[		\
+			    CPU_SEQID_UNSTABLE % zio_ncompress_counts].	\
+			    zcc_ ## which[c], bytes);			\
+		}							\
+	} while (0)
+
+static int
+zio_compress_kstat_headers(char *buf, size_t size)
+{
+	(void) snprintf(buf, size, "%-16s %-20s %-20s\n", "compress",
+	    "attempted_bytes", "skipped_bytes");
+	return (0);
+}
+
+static int
+zio_compress_kstat_data(char *buf, size_t size, void *data)
+{
+	enum zio_compress c = *(enum zio_compress *)data;
+	uint64_t attempted = 0, skipped = 0;
+
+	for (uint_t i = 0; i < zio_ncompress_counts; i++) {
+		attempted += zio_compress_counts[i].zcc_attempted[c];
+		skipped += zio_compress_counts[i].zcc_skipped[c];
+	}
+	(void) snprintf(buf, size, "%-16s %-20llu %-20llu\n",
+	    zio_compress_table[c].ci_name, (u_longlong_t)attempted,
+	    (u_longlong_t)skipped);
+	return (0);
+}
+
+static void *
+zio_compress_kstat_addr(kstat_t *ksp, loff_t n)
+{
+	if (n < zio_compress_kstat_nrows)
+		ksp->ks_private = &zio_compress_kstat_rows[n];
+	else
+		ksp->ks_private = NULL;
+
+	return (ksp->ks_private);
+}
+
+void
+zio_compress_init(void)
+{
+	zio_ncompress_counts = boot_ncpus;
+	zio_compress_counts = kmem_zalloc(zio_ncompress_counts *
+	    sizeof (zio_compress_counts_t), KM_SLEEP);
+
+	zio_compress_kstat_nrows = 0;
+	for (enum zio_compress c = 0; c < ZIO_COMPRESS_FUNCTIONS; c++) {
+		if (zio_compress_table[c].ci_compress != NULL)
+			zio_compress_kstat_rows[zio_compress_kstat_nrows++] = c;
+	}
+
+	zio_compress_ksp = kstat_create("zfs", 0, "zio_compress_stats", "misc",
+	    KSTAT_TYPE_RAW, 0, KSTAT_FLAG_VIRTUAL);
+	if (zio_compress_ksp != NULL) {
+		zio_compress_ksp->ks_data = NULL;
+		zio_compress_ksp->ks_ndata = UINT32_MAX;
+		kstat_set_raw_ops(zio_compress_ksp, zio_compress_kstat_headers,
+		    zio_compress_kstat_data, zio_compress_kstat_addr);
+		kstat_install(zio_compress_ksp);
+	}
+}
+
+void
+zio_compress_fini(void)
+{
+	if (zio_compress_ksp != NULL) {
+		kstat_delete(zio_compress_ksp);
+		zio_compress_ksp = NULL;
+	}
+	kmem_free(zio_compress_counts, zio_ncompress_counts *
+	    sizeof (zio_compress_counts_t));
+	zio_compress_counts = NULL;
+	zio_ncompress_counts = 0;
+}
+
 /*ARGSUSED*/
 static int
 zio_compress_zeroed_cb(void *data, size_t len, void *private)
@@ -122,9 +236,51 @@ zio_compress_zeroed_cb(void *data, size_t len, void *private)
 	return (0);
 }
 
+/*
+ * Returns B_TRUE if the slow compressor c at level complevel is unlikely
+ * to save d_len bytes on the s_len bytes at src, see
+ * zio_compress_earlyabort.  dst is used as scratch space.
+ */
+static boolean_t
+zio_compress_earlyabort_check(enum zio_compress c, uint8_t complevel,
+    void *src, void *dst, size_t s_len, size_t d_len)
+{
+	if (!zio_compress_earlyabort || s_len < zio_compress_earlyabort_size)
+		return (B_FALSE);
+
+	if (c == ZIO_COMPRESS_ZSTD) {
+		if (complevel < ZIO_ZSTD_LEVEL_10 ||
+		    complevel > ZIO_ZSTD_LEVEL_MAX)
+			return (B_FALSE);
+	} else if (c < ZIO_COMPRESS_GZIP_1 || c > ZIO_COMPRESS_GZIP_9) {
+		return (B_FALSE);
+	}
+
+	if (lz4_compress_zfs(src, dst, s_len, d_len, 0) <= d_len)
+		return (B_FALSE);
+
+	/*
+	 * LZ4 does no entropy coding, so it misses blocks which only have
+	 * a skewed byte distribution, such as text.  zstd-1 catches those.
+	 */
+	if (zfs_zstd_compress(src, dst, s_len, d_len, ZIO_ZSTD_LEVEL_1) <=
+	    d_len)
+		return (B_FALSE);
+
+	return (B_TRUE);
+}
+
+/*
+ * Compresses s_len bytes of src into dst, returning the compressed size,
+ * 0 if the data is all zeroes, or s_len if it does not compress well
+ * enough.  If earlyabort is set the data may be stored uncompressed
+ * without running a slow compressor, see zio_compress_earlyabort.  Only
+ * writes of new blocks set it: data which must compress to the size it
+ * has on disk cannot use it, and dst must then hold s_len bytes.
+ */
 size_t
 zio_compress_data(enum zio_compress c, abd_t *src, void *dst, size_t s_len,
-    uint8_t level)
+    uint8_t level, boolean_t earlyabort)
 {
 	size_t c_len, d_len;
 	uint8_t complevel;
@@ -163,7 +319,14 @@ zio_compress_data(enum zio_compress c, abd_t *src, void *dst, size_t s_len,
 
 	/* No compression algorithms can read from ABDs directly */
 	void *tmp = abd_borrow_buf_copy(src, s_len);
-	c_len = ci->ci_compress(tmp, dst, s_len, d_len, complevel);
+	if (earlyabort && zio_compress_earlyabort_check(c, complevel, tmp,
+	    dst, s_len, d_len)) {
+		ZIO_COMPRESS_STAT_ADD(skipped, c, s_len);
+		c_len = s_len;
+	} else {
+		ZIO_COMPRESS_STAT_ADD(attempted, c, s_len);
+		c_len = ci->ci_compress(tmp, dst, s_len, d_len, complevel);
+	}
 	abd_return_buf(src, tmp, s_len);
 
 	if (c_len > d_len)
@@ -218,3 +381,11 @@ zio_compress_to_feature(enum zio_compress comp)
 	}
 	return (SPA_FEATURE_NONE);
 }
+
+/* BEGIN CSTYLED */
+ZFS_MODULE_PARAM(zfs_zio, zio_, compress_earlyabort, INT, ZMOD_RW,
+	"Skip slow compressors on blocks that LZ4 and zstd-1 cannot compress");
+
+ZFS_MODULE_PARAM(zfs_zio, zio_, compress_earlyabort_size, UINT, ZMOD_RW,
+	"Min block size checked for compressibility before slow compressors");
+/* END CSTYLED */
@@ -64,6 +64,10 @@ typedef struct zstd_stats {
 	kstat_named_t	zstd_stat_dec_fail;
 	kstat_named_t	zstd_stat_buffers;
 	kstat_named_t	zstd_stat_size;
+	kstat_named_t	zstd_stat_cache_hit;
+	kstat_named_t	zstd_stat_pool_hit;
+	kstat_named_t	zstd_stat_cache_miss;
+	kstat_named_t	zstd_stat_pool_full;
 } zstd_stats_t;
 
 static zstd_stats_t zstd_stats = {
@@ -78,6 +82,10 @@ static zstd_stats_t zstd_stats = {
 	{ "decompress_failed",		KSTAT_DATA_UINT64 },
 	{ "buffers",			KSTAT_DATA_UINT64 },
 	{ "size",			KSTAT_DATA_UINT64 },
+	{ "cache_hit",			KSTAT_DATA_UINT64 },
+	{ "pool_hit",			KSTAT_DATA_UINT64 },
+	{ "cache_miss",			KSTAT_DATA_UINT64 },
+	{ "pool_full",			KSTAT_DATA_UINT64 },
 };
 
 /* Enums describing the allocator type specified by kmem_type in zstd_kmem */
@@ -85,26 +93,15 @@ enum zstd_kmem_type {
 	ZSTD_KMEM_UNKNOWN = 0,
 	/* Allocation type using kmem_vmalloc */
 	ZSTD_KMEM_DEFAULT,
-	/* Pool based allocation using mempool_alloc */
-	ZSTD_KMEM_POOL,
 	/* Reserved fallback memory for decompression only */
 	ZSTD_KMEM_DCTX,
 	ZSTD_KMEM_COUNT,
 };
 
-/* Structure for pooled memory objects */
-struct zstd_pool {
-	void *mem;
-	size_t size;
-	kmutex_t barrier;
-	hrtime_t timeout;
-};
-
 /* Global structure for handling memory allocations */
 struct zstd_kmem {
 	enum zstd_kmem_type kmem_type;
 	size_t kmem_size;
-	struct zstd_pool *pool;
 };
 
 /* Fallback memory structure used for decompression only if memory runs out */
@@ -126,25 +123,12 @@ struct zstd_levelmap {
  * memory allocation in case memory runs out.
  *
  * The ZSTD handlers were split up for the most simplified implementation.
+ * Their opaque argument is the zstd_ctx_t of the context allocating.
  */
 static void *zstd_alloc(void *opaque, size_t size);
 static void *zstd_dctx_alloc(void *opaque, size_t size);
 static void zstd_free(void *opaque, void *ptr);
 
-/* Compression memory handler */
-static const ZSTD_customMem zstd_malloc = {
-	zstd_alloc,
-	zstd_free,
-	NULL,
-};
-
-/* Decompression memory handler */
-static const ZSTD_customMem zstd_dctx_malloc = {
-	zstd_dctx_alloc,
-	zstd_free,
-	NULL,
-};
-
 /* Level map for converting ZFS internal levels to ZSTD levels and vice versa */
 static struct zstd_levelmap zstd_levels[] = {
 	{ZIO_ZSTD_LEVEL_1, ZIO_ZSTD_LEVEL_1},
@@ -189,6 +173,35 @@ static struct zstd_levelmap zstd_levels[] = {
 	{-1000, ZIO_ZSTD_LEVEL_FAST_1000},
 };
 
+/*
+ * Compression and decompression contexts are expensive to set up, so they
+ * are kept for reuse.  Every CPU caches up to ZSTD_CPU_CCTX compression
+ * contexts, each tagged with the level it was last used for, and one
+ * decompression context.  A context finding no free slot goes to a shared
+ * pool of pool_count slots instead.  Slots are emptied and filled with
+ * atomic_cas_ptr(), so neither the per-CPU caches nor the pool ever make
+ * a context wait for another.  Contexts which have not been used for
+ * ZSTD_POOL_TIMEOUT seconds are freed by zfs_zstd_cache_reap_now(), and
+ * all of them when the ARC reaps its caches under memory pressure.
+ */
+typedef struct zstd_ctx {
+	void		*zc_ctx;	/* ZSTD_CCtx or ZSTD_DCtx */
+	boolean_t	zc_dctx;
+	boolean_t	zc_nocache;	/* uses the fallback memory */
+	hrtime_t	zc_timeout;
+} zstd_ctx_t;
+
+#define	ZSTD_CPU_CCTX	4
+
+typedef struct zstd_cpu_cache {
+	zstd_ctx_t	*zcc_cctx[ZSTD_CPU_CCTX];
+	uint8_t		zcc_level[ZSTD_CPU_CCTX]; /* zstd_levels index */
+	zstd_ctx_t	*zcc_dctx;
+	uint64_t	zcc_hits;
+	uint64_t	zcc_pool_hits;
+	uint64_t	zcc_misses;
+} ____cacheline_aligned zstd_cpu_cache_t;
+
 /*
  * This variable represents the maximum count of the pool based on the number
  * of CPUs plus some buffer. We default to cpu count * 4, see init_zstd.
@@ -199,161 +212,238 @@ static int pool_count = 16;
 #define	ZSTD_POOL_TIMEOUT	60 * 2
 
 static struct zstd_fallback_mem zstd_dctx_fallback;
-static struct zstd_pool *zstd_mempool_cctx;
-static struct zstd_pool *zstd_mempool_dctx;
+static zstd_cpu_cache_t *zstd_cpu_caches;
+static uint_t zstd_ncpu_caches;
+static zstd_ctx_t **zstd_mempool_cctx;
+static zstd_ctx_t **zstd_mempool_dctx;
+
+/* Take the context out of a slot, if any */
+static zstd_ctx_t *
+zstd_slot_take(zstd_ctx_t **slot)
+{
+	zstd_ctx_t *zc = *slot;
 
+	if (zc != NULL && atomic_cas_ptr(slot, zc, NULL) == zc)
+		return (zc);
+	return (NULL);
+}
 
-static void
-zstd_mempool_reap(struct zstd_pool *zstd_mempool)
+/* Put a context into a slot if it is empty */
+static boolean_t
+zstd_slot_fill(zstd_ctx_t **slot, zstd_ctx_t *zc)
+{
+	return (*slot == NULL && atomic_cas_ptr(slot, NULL, zc) == NULL);
+}
+
+/* Take any context out of the pool, starting the search at this CPU's share */
+static zstd_ctx_t *
+zstd_mempool_take(zstd_ctx_t **zstd_mempool)
 {
-	struct zstd_pool *pool;
+	uint_t start = CPU_SEQID_UNSTABLE * 4;
+	zstd_ctx_t *zc;
 
-	if (!zstd_mempool || !ZSTDSTAT(zstd_stat_buffers)) {
-		return;
+	for (int i = 0; i < ZSTD_POOL_MAX; i++) {
+		zc = zstd_slot_take(&zstd_mempool[(start + i) % ZSTD_POOL_MAX]);
+		if (zc != NULL)
+			return (zc);
 	}
+	return (NULL);
+}
+
+static boolean_t
+zstd_mempool_fill(zstd_ctx_t **zstd_mempool, zstd_ctx_t *zc)
+{
+	uint_t start = CPU_SEQID_UNSTABLE * 4;
 
-	/* free obsolete slots */
 	for (int i = 0; i < ZSTD_POOL_MAX; i++) {
-		pool = &zstd_mempool[i];
-		if (pool->mem && mutex_tryenter(&pool->barrier)) {
-			/* Free memory if unused object older than 2 minutes */
-			if (pool->mem && gethrestime_sec() > pool->timeout) {
-				vmem_free(pool->mem, pool->size);
-				ZSTDSTAT_SUB(zstd_stat_buffers, 1);
-				ZSTDSTAT_SUB(zstd_stat_size, pool->size);
-				pool->mem = NULL;
-				pool->size = 0;
-				pool->timeout = 0;
-			}
-			mutex_exit(&pool->barrier);
+		if (zstd_slot_fill(&zstd_mempool[(start + i) % ZSTD_POOL_MAX],
+		    zc))
+			return (B_TRUE);
+	}
+	return (B_FALSE);
+}
+
+static zstd_ctx_t *
+zstd_ctx_create(boolean_t dctx)
+{
+	zstd_ctx_t *zc = kmem_zalloc(sizeof (*zc), KM_SLEEP);
+	ZSTD_customMem mem = {
+		dctx ? zstd_dctx_alloc : zstd_alloc,
+		zstd_free,
+		zc,
+	};
+
+	zc->zc_dctx = dctx;
+	if (dctx) {
+		zc->zc_ctx = ZSTD_createDCtx_advanced(mem);
+		/* Set header type to "magicless" */
+		if (zc->zc_ctx != NULL) {
+			ZSTD_DCtx_setParameter(zc->zc_ctx, ZSTD_d_format,
+			    ZSTD_f_zstd1_magicless);
 		}
+	} else {
+		zc->zc_ctx = ZSTD_createCCtx_advanced(mem);
+	}
+
+	if (zc->zc_ctx == NULL) {
+		kmem_free(zc, sizeof (*zc));
+		return (NULL);
 	}
+	return (zc);
+}
+
+static void
+zstd_ctx_destroy(zstd_ctx_t *zc)
+{
+	if (zc->zc_dctx)
+		ZSTD_freeDCtx(zc->zc_ctx);
+	else
+		ZSTD_freeCCtx(zc->zc_ctx);
+	kmem_free(zc, sizeof (*zc));
 }
 
 /*
- * Try to get a cached allocated buffer from memory pool or allocate a new one
- * if necessary. If a object is older than 2 minutes and does not fit the
- * requested size, it will be released and a new cached entry will be allocated.
- * If other pooled objects are detected without being used for 2 minutes, they
- * will be released, too.
- *
- * The concept is that high frequency memory allocations of bigger objects are
- * expensive. So if a lot of work is going on, allocations will be kept for a
- * while and can be reused in that time frame.
- *
- * The scheduled release will be updated every time a object is reused.
+ * Take a compression context last used for the level with index idx from
+ * a per-CPU cache.  The tag is only a hint, a context set up for another
+ * level still works.
  */
-
-static void *
-zstd_mempool_alloc(struct zstd_pool *zstd_mempool, size_t size)
+static zstd_ctx_t *
+zstd_cpu_cctx_take(zstd_cpu_cache_t *zcc, uint_t idx)
 {
-	struct zstd_pool *pool;
-	struct zstd_kmem *mem = NULL;
+	zstd_ctx_t *zc;
 
-	if (!zstd_mempool) {
-		return (NULL);
+	for (int i = 0; i < ZSTD_CPU_CCTX; i++) {
+		if (zcc->zcc_level[i] == idx &&
+		    (zc = zstd_slot_take(&zcc->zcc_cctx[i])) != NULL)
+			return (zc);
 	}
+	return (NULL);
+}
 
-	/* Seek for preallocated memory slot and free obsolete slots */
-	for (int i = 0; i < ZSTD_POOL_MAX; i++) {
-		pool = &zstd_mempool[i];
-		/*
-		 * This lock is simply a marker for a pool object being in use.
-		 * If it's already hold, it will be skipped.
-		 *
-		 * We need to create it before checking it to avoid race
-		 * conditions caused by running in a threaded context.
-		 *
-		 * The lock is later released by zstd_mempool_free.
-		 */
-		if (mutex_tryenter(&pool->barrier)) {
-			/*
-			 * Check if objects fits the size, if so we take it and
-			 * update the timestamp.
-			 */
-			if (pool->mem && size <= pool->size) {
-				pool->timeout = gethrestime_sec() +
-				    ZSTD_POOL_TIMEOUT;
-				mem = pool->mem;
-				return (mem);
-			}
-			mutex_exit(&pool->barrier);
+static boolean_t
+zstd_cpu_cctx_fill(zstd_cpu_cache_t *zcc, zstd_ctx_t *zc, uint_t idx)
+{
+	for (int i = 0; i < ZSTD_CPU_CCTX; i++) {
+		if (zstd_slot_fill(&zcc->zcc_cctx[i], zc)) {
+			zcc->zcc_level[i] = idx;
+			return (B_TRUE);
 		}
 	}
+	return (B_FALSE);
+}
+
+/*
+ * Get a compression context for the level with index idx in zstd_levels,
+ * or a decompression context, from the caches or newly created.
+ */
+static zstd_ctx_t *
+zstd_ctx_get(boolean_t dctx, uint_t idx)
+{
+	zstd_cpu_cache_t *zcc =
+	    &zstd_cpu_caches[CPU_SEQID_UNSTABLE % zstd_ncpu_caches];
+	zstd_ctx_t *zc;
+
+	zc = dctx ? zstd_slot_take(&zcc->zcc_dctx) :
+	    zstd_cpu_cctx_take(zcc, idx);
+	if (zc != NULL) {
+		atomic_inc_64(&zcc->zcc_hits);
+		return (zc);
+	}
 
-	/*
-	 * If no preallocated slot was found, try to fill in a new one.
-	 *
-	 * We run a similar algorithm twice here to avoid pool fragmentation.
-	 * The first one may generate holes in the list if objects get released.
-	 * We always make sure that these holes get filled instead of adding new
-	 * allocations constantly at the end.
-	 */
-	for (int i = 0; i < ZSTD_POOL_MAX; i++) {
-		pool = &zstd_mempool[i];
-		if (mutex_tryenter(&pool->barrier)) {
-			/* Object is free, try to allocate new one */
-			if (!pool->mem) {
-				mem = vmem_alloc(size, KM_SLEEP);
-				if (mem) {
-					ZSTDSTAT_ADD(zstd_stat_buffers, 1);
-					ZSTDSTAT_ADD(zstd_stat_size, size);
-					pool->mem = mem;
-					pool->size = size;
-					/* Keep track for later release */
-					mem->pool = pool;
-					mem->kmem_type = ZSTD_KMEM_POOL;
-					mem->kmem_size = size;
-				}
-			}
-
-			if (size <= pool->size) {
-				/* Update timestamp */
-				pool->timeout = gethrestime_sec() +
-				    ZSTD_POOL_TIMEOUT;
-
-				return (pool->mem);
-			}
-
-			mutex_exit(&pool->barrier);
-		}
+	zc = zstd_mempool_take(dctx ? zstd_mempool_dctx : zstd_mempool_cctx);
+	if (zc != NULL) {
+		atomic_inc_64(&zcc->zcc_pool_hits);
+		return (zc);
 	}
 
-	/*
-	 * If the pool is full or the allocation failed, try lazy allocation
-	 * instead.
-	 */
-	if (!mem) {
-		mem = vmem_alloc(size, KM_NOSLEEP);
-		if (mem) {
-			mem->pool = NULL;
-			mem->kmem_type = ZSTD_KMEM_DEFAULT;
-			mem->kmem_size = size;
-		}
+	atomic_inc_64(&zcc->zcc_misses);
+	return (zstd_ctx_create(dctx));
+}
+
+/* Return a context from zstd_ctx_get() to the caches */
+static void
+zstd_ctx_put(zstd_ctx_t *zc, uint_t idx)
+{
+	zstd_cpu_cache_t *zcc =
+	    &zstd_cpu_caches[CPU_SEQID_UNSTABLE % zstd_ncpu_caches];
+
+	/* The fallback memory must be released for the next user */
+	if (zc->zc_nocache) {
+		zstd_ctx_destroy(zc);
+		return;
 	}
 
-	return (mem);
+	zc->zc_timeout = gethrestime_sec() + ZSTD_POOL_TIMEOUT;
+	if (zc->zc_dctx ? zstd_slot_fill(&zcc->zcc_dctx, zc) :
+	    zstd_cpu_cctx_fill(zcc, zc, idx))
+		return;
+	if (zstd_mempool_fill(zc->zc_dctx ? zstd_mempool_dctx :
+	    zstd_mempool_cctx, zc))
+		return;
+
+	ZSTDSTAT_BUMP(zstd_stat_pool_full);
+	zstd_ctx_destroy(zc);
 }
 
-/* Mark object as released by releasing the barrier mutex */
+/* Free the contexts in the slots which timed out, or all of them */
 static void
-zstd_mempool_free(struct zstd_kmem *z)
+zstd_mempool_reap(zstd_ctx_t **slots, int nslots, boolean_t all)
 {
-	mutex_exit(&z->pool->barrier);
+	zstd_ctx_t *zc;
+
+	for (int i = 0; i < nslots; i++) {
+		if ((zc = zstd_slot_take(&slots[i])) == NULL)
+			continue;
+		if (all || gethrestime_sec() > zc->zc_timeout ||
+		    !zstd_slot_fill(&slots[i], zc))
+			zstd_ctx_destroy(zc);
+	}
 }
 
-/* Convert ZFS internal enum to ZSTD level */
+static void
+zstd_reap_all(boolean_t all)
+{
+	for (uint_t c = 0; c < zstd_ncpu_caches; c++) {
+		zstd_mempool_reap(zstd_cpu_caches[c].zcc_cctx, ZSTD_CPU_CCTX,
+		    all);
+		zstd_mempool_reap(&zstd_cpu_caches[c].zcc_dctx, 1, all);
+	}
+	zstd_mempool_reap(zstd_mempool_cctx, ZSTD_POOL_MAX, all);
+	zstd_mempool_reap(zstd_mempool_dctx, ZSTD_POOL_MAX, all);
+}
+
+/* Sum the per-CPU cache counters into the kstat */
 static int
-zstd_enum_to_level(enum zio_zstd_levels level, int16_t *zstd_level)
+zstd_kstat_update(kstat_t *ksp, int rw)
+{
+	uint64_t hits = 0, pool_hits = 0, misses = 0;
+
+	if (rw == KSTAT_WRITE)
+		return (SET_ERROR(EACCES));
+
+	for (uint_t c = 0; c < zstd_ncpu_caches; c++) {
+		hits += zstd_cpu_caches[c].zcc_hits;
+		pool_hits += zstd_cpu_caches[c].zcc_pool_hits;
+		misses += zstd_cpu_caches[c].zcc_misses;
+	}
+	ZSTDSTAT(zstd_stat_cache_hit) = hits;
+	ZSTDSTAT(zstd_stat_pool_hit) = pool_hits;
+	ZSTDSTAT(zstd_stat_cache_miss) = misses;
+
+	return (0);
+}
+
+/* Convert ZFS internal enum to an index into zstd_levels */
+static int
+zstd_enum_to_index(enum zio_zstd_levels level, uint_t *idx)
 {
 	if (level > 0 && level <= ZIO_ZSTD_LEVEL_19) {
-		*zstd_level = zstd_levels[level - 1].zstd_level;
+		*idx = level - 1;
 		return (0);
 	}
 	if (level >= ZIO_ZSTD_LEVEL_FAST_1 &&
 	    level <= ZIO_ZSTD_LEVEL_FAST_1000) {
-		*zstd_level = zstd_levels[level - ZIO_ZSTD_LEVEL_FAST_1
-		    + ZIO_ZSTD_LEVEL_19].zstd_level;
+		*idx = level - ZIO_ZSTD_LEVEL_FAST_1 + ZIO_ZSTD_LEVEL_19;
 		return (0);
 	}
 
@@ -361,6 +451,19 @@ zstd_enum_to_level(enum zio_zstd_levels level, int16_t *zstd_level)
 	return (1);
 }
 
+/* Convert ZFS internal enum to ZSTD level */
+static int
+zstd_enum_to_level(enum zio_zstd_levels level, int16_t *zstd_level)
+{
+	uint_t idx;
+
+	if (zstd_enum_to_index(level, &idx))
+		return (1);
+
+	*zstd_level = zstd_levels[idx].zstd_level;
+	return (0);
+}
+
 /* Compress block using zstd */
 size_t
 zfs_zstd_compress(void *s_start, void *d_start, size_t s_len, size_t d_len,
@@ -368,33 +471,40 @@ zfs_zstd_compress(void *s_start, void *d_start, size_t s_len, size_t d_len,
 {
 	size_t c_len;
 	int16_t zstd_level;
+	uint_t idx;
 	zfs_zstdhdr_t *hdr;
+	zstd_ctx_t *zc;
 	ZSTD_CCtx *cctx;
 
 	hdr = (zfs_zstdhdr_t *)d_start;
 
 	/* Skip compression if the specified level is invalid */
-	if (zstd_enum_to_level(level, &zstd_level)) {
+	if (zstd_enum_to_index(level, &idx)) {
 		ZSTDSTAT_BUMP(zstd_stat_com_inval);
 		return (s_len);
 	}
+	zstd_level = zstd_levels[idx].zstd_level;
 
 	ASSERT3U(d_len, >=, sizeof (*hdr));
 	ASSERT3U(d_len, <=, s_len);
 	ASSERT3U(zstd_level, !=, 0);
 
-	cctx = ZSTD_createCCtx_advanced(zstd_malloc);
+	zc = zstd_ctx_get(B_FALSE, idx);
 
 	/*
 	 * Out of kernel memory, gently fall through - this will disable
 	 * compression in zio_compress_data
 	 */
-	if (!cctx) {
+	if (zc == NULL) {
 		ZSTDSTAT_BUMP(zstd_stat_com_alloc_fail);
 		return (s_len);
 	}
+	cctx = zc->zc_ctx;
 
-	/* Set the compression level */
+	/*
+	 * Set the compression level.  A cached context may have been used at
+	 * another level, so it is always set.
+	 */
 	ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, zstd_level);
 
 	/* Use the "magicless" zstd header which saves us 4 header bytes */
@@ -412,7 +522,7 @@ zfs_zstd_compress(void *s_start, void *d_start, size_t s_len, size_t d_len,
 	    d_len - sizeof (*hdr),
 	    s_start, s_len);
 
-	ZSTD_freeCCtx(cctx);
+	zstd_ctx_put(zc, idx);
 
 	/* Error in the compression routine, disable compression. */
 	if (ZSTD_isError(c_len)) {
@@ -470,7 +580,7 @@ int
 zfs_zstd_decompress_level(void *s_start, void *d_start, size_t s_len,
     size_t d_len, uint8_t *level)
 {
-	ZSTD_DCtx *dctx;
+	zstd_ctx_t *zc;
 	size_t result;
 	int16_t zstd_level;
 	uint32_t c_len;
@@ -511,18 +621,16 @@ zfs_zstd_decompress_level(void *s_start, void *d_start, size_t s_len,
 		return (1);
 	}
 
-	dctx = ZSTD_createDCtx_advanced(zstd_dctx_malloc);
-	if (!dctx) {
+	zc = zstd_ctx_get(B_TRUE, 0);
+	if (zc == NULL) {
 		ZSTDSTAT_BUMP(zstd_stat_dec_alloc_fail);
 		return (1);
 	}
 
-	/* Set header type to "magicless" */
-	ZSTD_DCtx_setParameter(dctx, ZSTD_d_format, ZSTD_f_zstd1_magicless);
-
 	/* Decompress the data and release the context */
-	result = ZSTD_decompressDCtx(dctx, d_start, d_len, hdr->data, c_len);
-	ZSTD_freeDCtx(dctx);
+	result = ZSTD_decompressDCtx(zc->zc_ctx, d_start, d_len, hdr->data,
+	    c_len);
+	zstd_ctx_put(zc, 0);
 
 	/*
 	 * Returns 0 on success (decompression function returned non-negative)
@@ -550,44 +658,46 @@ zfs_zstd_decompress(void *s_start, void *d_start, size_t s_len, size_t d_len,
 	    NULL));
 }
 
-/* Allocator for zstd compression context using mempool_allocator */
+/* Allocator for zstd compression context */
 static void *
 zstd_alloc(void *opaque __maybe_unused, size_t size)
 {
 	size_t nbytes = sizeof (struct zstd_kmem) + size;
 	struct zstd_kmem *z = NULL;
 
-	z = (struct zstd_kmem *)zstd_mempool_alloc(zstd_mempool_cctx, nbytes);
+	z = vmem_alloc(nbytes, KM_SLEEP);
 
 	if (!z) {
 		ZSTDSTAT_BUMP(zstd_stat_alloc_fail);
 		return (NULL);
 	}
 
+	z->kmem_type = ZSTD_KMEM_DEFAULT;
+	z->kmem_size = nbytes;
+	ZSTDSTAT_ADD(zstd_stat_buffers, 1);
+	ZSTDSTAT_ADD(zstd_stat_size, nbytes);
+
 	return ((void*)z + (sizeof (struct zstd_kmem)));
 }
 
 /*
- * Allocator for zstd decompression context using mempool_allocator with
- * fallback to reserved memory if allocation fails
+ * Allocator for zstd decompression context with fallback to reserved memory
+ * if allocation fails
  */
 static void *
-zstd_dctx_alloc(void *opaque __maybe_unused, size_t size)
+zstd_dctx_alloc(void *opaque, size_t size)
 {
 	size_t nbytes = sizeof (struct zstd_kmem) + size;
 	struct zstd_kmem *z = NULL;
 	enum zstd_kmem_type type = ZSTD_KMEM_DEFAULT;
 
-	z = (struct zstd_kmem *)zstd_mempool_alloc(zstd_mempool_dctx, nbytes);
-	if (!z) {
-		/* Try harder, decompression shall not fail */
-		z = vmem_alloc(nbytes, KM_SLEEP);
-		if (z) {
-			z->pool = NULL;
-		}
-		ZSTDSTAT_BUMP(zstd_stat_alloc_fail);
+	/* Try hard, decompression shall not fail */
+	z = vmem_alloc(nbytes, KM_SLEEP);
+	if (z) {
+		ZSTDSTAT_ADD(zstd_stat_buffers, 1);
+		ZSTDSTAT_ADD(zstd_stat_size, nbytes);
 	} else {
-		return ((void*)z + (sizeof (struct zstd_kmem)));
+		ZSTDSTAT_BUMP(zstd_stat_alloc_fail);
 	}
 
 	/* Fallback if everything fails */
@@ -595,12 +705,14 @@ zstd_dctx_alloc(void *opaque __maybe_unused, size_t size)
 		/*
 		 * Barrier since we only can handle it in a single thread. All
 		 * other following threads need to wait here until decompression
-		 * is completed. zstd_free will release this barrier later.
+		 * is completed. zstd_free will release this barrier later, so
+		 * the context must not be cached.
 		 */
 		mutex_enter(&zstd_dctx_fallback.barrier);
 
 		z = zstd_dctx_fallback.mem;
 		type = ZSTD_KMEM_DCTX;
+		((zstd_ctx_t *)opaque)->zc_nocache = B_TRUE;
 		ZSTDSTAT_BUMP(zstd_stat_alloc_fallback);
 	}
 
@@ -628,11 +740,10 @@ zstd_free(void *opaque __maybe_unused, void *ptr)
 	type = z->kmem_type;
 	switch (type) {
 	case ZSTD_KMEM_DEFAULT:
+		ZSTDSTAT_SUB(zstd_stat_buffers, 1);
+		ZSTDSTAT_SUB(zstd_stat_size, z->kmem_size);
 		vmem_free(z, z->kmem_size);
 		break;
-	case ZSTD_KMEM_POOL:
-		zstd_mempool_free(z);
-		break;
 	case ZSTD_KMEM_DCTX:
 		mutex_exit(&zstd_dctx_fallback.barrier);
 		break;
@@ -650,21 +761,17 @@ create_fallback_mem(struct zstd_fallback_mem *mem, size_t size)
 	mutex_init(&mem->barrier, NULL, MUTEX_DEFAULT, NULL);
 }
 
-/* Initialize memory pool barrier mutexes */
+/* Initialize the per-CPU context caches and the context pools */
 static void __init
 zstd_mempool_init(void)
 {
-	zstd_mempool_cctx = (struct zstd_pool *)
-	    kmem_zalloc(ZSTD_POOL_MAX * sizeof (struct zstd_pool), KM_SLEEP);
-	zstd_mempool_dctx = (struct zstd_pool *)
-	    kmem_zalloc(ZSTD_POOL_MAX * sizeof (struct zstd_pool), KM_SLEEP);
-
-	for (int i = 0; i < ZSTD_POOL_MAX; i++) {
-		mutex_init(&zstd_mempool_cctx[i].barrier, NULL,
-		    MUTEX_DEFAULT, NULL);
-		mutex_init(&zstd_mempool_dctx[i].barrier, NULL,
-		    MUTEX_DEFAULT, NULL);
-	}
+	zstd_ncpu_caches = boot_ncpus;
+	zstd_cpu_caches = kmem_zalloc(zstd_ncpu_caches *
+	    sizeof (zstd_cpu_cache_t), KM_SLEEP);
+	zstd_mempool_cctx = kmem_zalloc(ZSTD_POOL_MAX * sizeof (zstd_ctx_t *),
+	    KM_SLEEP);
+	zstd_mempool_dctx = kmem_zalloc(ZSTD_POOL_MAX * sizeof (zstd_ctx_t *),
+	    KM_SLEEP);
 }
 
 /* Initialize zstd-related memory handling */
@@ -684,42 +791,33 @@ zstd_meminit(void)
 	return (0);
 }
 
-/* Release object from pool and free memory */
-static void __exit
-release_pool(struct zstd_pool *pool)
-{
-	mutex_destroy(&pool->barrier);
-	vmem_free(pool->mem, pool->size);
-	pool->mem = NULL;
-	pool->size = 0;
-}
-
-/* Release memory pool objects */
+/* Free all cached contexts and the caches */
 static void __exit
 zstd_mempool_deinit(void)
 {
-	for (int i = 0; i < ZSTD_POOL_MAX; i++) {
-		release_pool(&zstd_mempool_cctx[i]);
-		release_pool(&zstd_mempool_dctx[i]);
-	}
+	zstd_reap_all(B_TRUE);
 
-	kmem_free(zstd_mempool_dctx, ZSTD_POOL_MAX * sizeof (struct zstd_pool));
-	kmem_free(zstd_mempool_cctx, ZSTD_POOL_MAX * sizeof (struct zstd_pool));
+	kmem_free(zstd_mempool_dctx, ZSTD_POOL_MAX * sizeof (zstd_ctx_t *));
+	kmem_free(zstd_mempool_cctx, ZSTD_POOL_MAX * sizeof (zstd_ctx_t *));
+	kmem_free(zstd_cpu_caches, zstd_ncpu_caches *
+	    sizeof (zstd_cpu_cache_t));
 	zstd_mempool_dctx = NULL;
 	zstd_mempool_cctx = NULL;
+	zstd_cpu_caches = NULL;
+	zstd_ncpu_caches = 0;
 }
 
-/* release unused memory from pool */
-
+/*
+ * Release the cached contexts which timed out, or all of them when the
+ * system is short of memory.
+ */
 void
-zfs_zstd_cache_reap_now(void)
+zfs_zstd_cache_reap_now(boolean_t all)
 {
-	/*
-	 * calling alloc with zero size seeks
-	 * and releases old unused objects
-	 */
-	zstd_mempool_reap(zstd_mempool_cctx);
-	zstd_mempool_reap(zstd_mempool_dctx);
+	if (ZSTDSTAT(zstd_stat_buffers) == 0)
+		return;
+
+	zstd_reap_all(all);
 }
 
 extern int __init
@@ -735,6 +833,7 @@ zstd_init(void)
 	    KSTAT_FLAG_VIRTUAL);
 	if (zstd_ksp != NULL) {
 		zstd_ksp->ks_data = &zstd_stats;
+		zstd_ksp->ks_update = zstd_kstat_update;
 		kstat_install(zstd_ksp);
 	}
 
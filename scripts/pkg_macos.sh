@@ -147,6 +147,7 @@ ${WORKDIR}/${bindir}/zpool
 ${WORKDIR}/${bindir}/zstream
 ${WORKDIR}/${bindir}/ztest
 ${WORKDIR}/${bindir}/raidz_test
+${WORKDIR}/${bindir}/zbench
 ${WORKDIR}/${bindir}/zfs_ids_to_path
 ${WORKDIR}/${bindir}/InvariantDisks
 ${WORKDIR}/${bindir}/zfs_util
@@ -257,7 +258,7 @@ function delete_and_keep
 function do_prune
 {
 
-    delete_and_keep "${WORKDIR}/${bindir}/" "(zfs|zpool|zdb|zed|zhack|zinject|zstream|zstreamdump|ztest|InvariantDisks|zfs_util|zconfigd|arc_summary|arcstat|dbufstat|fsck.zfs|raidz_test|zfs_ids_to_path|zpool_influxdb|mount_zfs|zsysctl)"
+    delete_and_keep "${WORKDIR}/${bindir}/" "(zfs|zpool|zdb|zed|zhack|zinject|zstream|zstreamdump|ztest|InvariantDisks|zfs_util|zconfigd|arc_summary|arcstat|dbufstat|fsck.zfs|raidz_test|zbench|zfs_ids_to_path|zpool_influxdb|mount_zfs|zsysctl)"
 
     pushd "${WORKDIR}" || fail "Unable to cd to ${WORKDIR}"
 
@@ -130,6 +130,35 @@ const uint8_t	sha512_test_digests[][64] = {
 	}
 };
 
+/*
+ * Digests of the one million 'a' message, which is hashed in chunks of
+ * different sizes to cover both the partial block buffering and the
+ * multi-block transforms.
+ */
+#define	LONG_MSG_LEN	1000000
+
+const uint8_t	sha256_long_test_digest[32] = {
+	0xCD, 0xC7, 0x6E, 0x5C, 0x99, 0x14, 0xFB, 0x92,
+	0x81, 0xA1, 0xC7, 0xE2, 0x84, 0xD7, 0x3E, 0x67,
+	0xF1, 0x80, 0x9A, 0x48, 0xA4, 0x97, 0x20, 0x0E,
+	0x04, 0x6D, 0x39, 0xCC, 0xC7, 0x11, 0x2C, 0xD0
+};
+
+const uint8_t	sha512_long_test_digest[64] = {
+	0xE7, 0x18, 0x48, 0x3D, 0x0C, 0xE7, 0x69, 0x64,
+	0x4E, 0x2E, 0x42, 0xC7, 0xBC, 0x15, 0xB4, 0x63,
+	0x8E, 0x1F, 0x98, 0xB1, 0x3B, 0x20, 0x44, 0x28,
+	0x56, 0x32, 0xA8, 0x03, 0xAF, 0xA9, 0x73, 0xEB,
+	0xDE, 0x0F, 0xF2, 0x44, 0x87, 0x7E, 0xA6, 0x0A,
+	0x4C, 0xB0, 0x43, 0x2C, 0xE5, 0x77, 0xC3, 0x1B,
+	0xEB, 0x00, 0x9C, 0x5C, 0x2C, 0x49, 0xAA, 0x2E,
+	0x4E, 0xAD, 0xB2, 0x17, 0xAD, 0x8C, 0xC0, 0x9B
+};
+
+const size_t	long_msg_chunks[] = { 1, 63, 129, 997, 8192, LONG_MSG_LEN };
+
+uint8_t		long_msg[LONG_MSG_LEN];
+
 const uint8_t	sha512_224_test_digests[][28] = {
 	{
 		/* for test_msg0 */
@@ -177,10 +206,15 @@ main(int argc, char *argv[])
 {
 	boolean_t	failed = B_FALSE;
 	uint64_t	cpu_mhz = 0;
+	uint32_t	id;
+	int		i;
 
 	if (argc == 2)
 		cpu_mhz = atoi(argv[1]);
 
+	(void) memset(long_msg, 'a', sizeof (long_msg));
+	sha2_impl_init();
+
 #define	SHA2_ALGO_TEST(_m, mode, diglen, testdigest)			\
 	do {								\
 		SHA2_CTX		ctx;				\
@@ -188,8 +222,33 @@ main(int argc, char *argv[])
 		SHA2Init(SHA ## mode ## _MECH_INFO_TYPE, &ctx);		\
 		SHA2Update(&ctx, _m, strlen(_m));			\
 		SHA2Final(digest, &ctx);				\
-		(void) printf("SHA%-9sMessage: " #_m			\
-		    "\tResult: ", #mode);				\
+		(void) printf("SHA%-9s%-8sMessage: " #_m		\
+		    "\tResult: ", #mode,				\
+		    sha2_impl_getname(SHA ## mode ## _MECH_INFO_TYPE));	\
+		if (bcmp(digest, testdigest, diglen / 8) == 0) {	\
+			(void) printf("OK\n");				\
+		} else {						\
+			(void) printf("FAILED!\n");			\
+			failed = B_TRUE;				\
+		}							\
+		NOTE(CONSTCOND)						\
+	} while (0)
+
+#define	SHA2_LONG_TEST(mode, diglen, chunk, testdigest)		\
+	do {								\
+		SHA2_CTX		ctx;				\
+		uint8_t			digest[diglen / 8];		\
+		size_t			off, n;				\
+		SHA2Init(SHA ## mode ## _MECH_INFO_TYPE, &ctx);		\
+		for (off = 0; off < LONG_MSG_LEN; off += n) {		\
+			n = MIN(chunk, LONG_MSG_LEN - off);		\
+			SHA2Update(&ctx, &long_msg[off], n);		\
+		}							\
+		SHA2Final(digest, &ctx);				\
+		(void) printf("SHA%-9s%-8sMessage: 1M a, chunk %-7zu"	\
+		    "\tResult: ", #mode,				\
+		    sha2_impl_getname(SHA ## mode ## _MECH_INFO_TYPE),	\
+		    (size_t)chunk);					\
 		if (bcmp(digest, testdigest, diglen / 8) == 0) {	\
 			(void) printf("OK\n");				\
 		} else {						\
@@ -206,7 +265,6 @@ main(int argc, char *argv[])
 		uint8_t		block[131072];				\
 		uint64_t	delta;					\
 		double		cpb = 0;				\
-		int		i;					\
 		struct timeval	start, end;				\
 		bzero(block, sizeof (block));				\
 		(void) gettimeofday(&start, NULL);			\
@@ -221,30 +279,55 @@ main(int argc, char *argv[])
 			cpb = (cpu_mhz * 1e6 * ((double)delta /		\
 			    1000000)) / (8192 * 128 * 1024);		\
 		}							\
-		(void) printf("SHA%-9s%llu us (%.02f CPB)\n", #mode,	\
+		(void) printf("SHA%-9s%-8s%llu us (%.02f CPB)\n", #mode, \
+		    sha2_impl_getname(SHA ## mode ## _MECH_INFO_TYPE),	\
 		    (u_longlong_t)delta, cpb);				\
 		NOTE(CONSTCOND)						\
 	} while (0)
 
 	(void) printf("Running algorithm correctness tests:\n");
-	SHA2_ALGO_TEST(test_msg0, 256, 256, sha256_test_digests[0]);
-	SHA2_ALGO_TEST(test_msg1, 256, 256, sha256_test_digests[1]);
-	SHA2_ALGO_TEST(test_msg0, 384, 384, sha384_test_digests[0]);
-	SHA2_ALGO_TEST(test_msg2, 384, 384, sha384_test_digests[2]);
-	SHA2_ALGO_TEST(test_msg0, 512, 512, sha512_test_digests[0]);
-	SHA2_ALGO_TEST(test_msg2, 512, 512, sha512_test_digests[2]);
-	SHA2_ALGO_TEST(test_msg0, 512_224, 224, sha512_224_test_digests[0]);
-	SHA2_ALGO_TEST(test_msg2, 512_224, 224, sha512_224_test_digests[2]);
-	SHA2_ALGO_TEST(test_msg0, 512_256, 256, sha512_256_test_digests[0]);
-	SHA2_ALGO_TEST(test_msg2, 512_256, 256, sha512_256_test_digests[2]);
+	for (id = 0; id < sha2_impl_getcnt(SHA256); id++) {
+		sha2_impl_setid(SHA256, id);
+		SHA2_ALGO_TEST(test_msg0, 256, 256, sha256_test_digests[0]);
+		SHA2_ALGO_TEST(test_msg1, 256, 256, sha256_test_digests[1]);
+		for (i = 0; i < ARRAY_SIZE(long_msg_chunks); i++) {
+			SHA2_LONG_TEST(256, 256, long_msg_chunks[i],
+			    sha256_long_test_digest);
+		}
+	}
+	for (id = 0; id < sha2_impl_getcnt(SHA512); id++) {
+		sha2_impl_setid(SHA512, id);
+		SHA2_ALGO_TEST(test_msg0, 384, 384, sha384_test_digests[0]);
+		SHA2_ALGO_TEST(test_msg2, 384, 384, sha384_test_digests[2]);
+		SHA2_ALGO_TEST(test_msg0, 512, 512, sha512_test_digests[0]);
+		SHA2_ALGO_TEST(test_msg2, 512, 512, sha512_test_digests[2]);
+		SHA2_ALGO_TEST(test_msg0, 512_224, 224,
+		    sha512_224_test_digests[0]);
+		SHA2_ALGO_TEST(test_msg2, 512_224, 224,
+		    sha512_224_test_digests[2]);
+		SHA2_ALGO_TEST(test_msg0, 512_256, 256,
+		    sha512_256_test_digests[0]);
+		SHA2_ALGO_TEST(test_msg2, 512_256, 256,
+		    sha512_256_test_digests[2]);
+		for (i = 0; i < ARRAY_SIZE(long_msg_chunks); i++) {
+			SHA2_LONG_TEST(512, 512, long_msg_chunks[i],
+			    sha512_long_test_digest);
+		}
+	}
 
 	if (failed)
 		return (1);
 
 	(void) printf("Running performance tests (hashing 1024 MiB of "
 	    "data):\n");
-	SHA2_PERF_TEST(256, 256);
-	SHA2_PERF_TEST(512, 512);
+	for (id = 0; id < sha2_impl_getcnt(SHA256); id++) {
+		sha2_impl_setid(SHA256, id);
+		SHA2_PERF_TEST(256, 256);
+	}
+	for (id = 0; id < sha2_impl_getcnt(SHA512); id++) {
+		sha2_impl_setid(SHA512, id);
+		SHA2_PERF_TEST(512, 512);
+	}
 
 	return (0);
 }